@@ -3,6 +3,14 @@
 #define __XJSON__H__
 
 #include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <unordered_map>
+
+/* build with -DX_JSON_STATS=0 to compile the statistics hooks out */
+#ifndef X_JSON_STATS
+#define X_JSON_STATS 1
+#endif
 
 namespace xJson {
 enum class xType {
@@ -24,7 +32,83 @@ enum class xState {
     X_PARSE_MISS_COMMA_OR_SQUARE_BRACKET,
     X_PARSE_MISS_KEY,
     X_PARSE_MISS_COLON,
-    X_PARSE_MISS_COMMA_OR_CURLY_BRACKET
+    X_PARSE_MISS_COMMA_OR_CURLY_BRACKET,
+    X_PARSE_TYPE_MISMATCH,
+    X_PARSE_INVALID_UTF8,
+    X_PARSE_DEPTH_EXCEEDED,
+    X_PARSE_SCHEMA_MISMATCH,
+    X_PARSE_FILE_ERROR
+};
+
+/**
+ * @brief optional parser features, selected at compile time via xParsePolicy.
+ */
+enum xParseFlag : unsigned {
+    X_PARSE_FLAG_NONE = 0,
+    /** accept // line and block comments wherever whitespace is allowed */
+    X_PARSE_FLAG_COMMENTS = 1u << 0,
+    /** accept one comma before ] and } */
+    X_PARSE_FLAG_TRAILING_COMMAS = 1u << 1,
+    /** accept NaN, Infinity and -Infinity as numbers */
+    X_PARSE_FLAG_NAN_INF = 1u << 2,
+    /** reject strings that are not well-formed utf-8 */
+    X_PARSE_FLAG_VALIDATE_UTF8 = 1u << 3,
+    /** keep the text of numbers, convert only when they are read */
+    X_PARSE_FLAG_LAZY_NUMBERS = 1u << 4,
+    /** keep the escaped text of strings, decode only when they are read */
+    X_PARSE_FLAG_LAZY_STRINGS = 1u << 5,
+    /** store arrays of numbers only as double[] or int64_t[] */
+    X_PARSE_FLAG_DENSE_ARRAYS = 1u << 6,
+    /** store the members of objects sorted by key */
+    X_PARSE_FLAG_SORTED_KEYS = 1u << 7
+};
+
+/**
+ * @brief compile-time parser configuration.
+ * @tparam Flags or-ed xParseFlag
+ * @tparam MaxDepth nesting limit of arrays and objects, 0 for none
+ */
+template <unsigned Flags, unsigned MaxDepth = 0>
+struct xParsePolicy {
+    static constexpr unsigned flags = Flags;
+    static constexpr unsigned maxDepth = MaxDepth;
+};
+
+/** rfc 8259 only, what xParse uses */
+typedef xParsePolicy<X_PARSE_FLAG_NONE> xStrictPolicy;
+/** hand written configuration files */
+typedef xParsePolicy<X_PARSE_FLAG_COMMENTS | X_PARSE_FLAG_TRAILING_COMMAS
+    | X_PARSE_FLAG_NAN_INF> xRelaxedPolicy;
+/** untrusted input */
+typedef xParsePolicy<X_PARSE_FLAG_VALIDATE_UTF8, 512> xSafePolicy;
+/** pass-through pipelines, numbers and strings are written as read */
+typedef xParsePolicy<X_PARSE_FLAG_LAZY_NUMBERS | X_PARSE_FLAG_LAZY_STRINGS>
+    xLazyPolicy;
+/** numeric payloads: coordinates, embeddings, time series */
+typedef xParsePolicy<X_PARSE_FLAG_DENSE_ARRAYS> xDensePolicy;
+/** documents that are looked up by key, hashed or signed */
+typedef xParsePolicy<X_PARSE_FLAG_SORTED_KEYS> xSortedPolicy;
+
+/**
+ * @brief bits of xValue::flags and xMember::flags.
+ */
+enum xValueFlag : unsigned {
+    /** str.s (or the key of a member) points into a caller owned buffer */
+    X_VALUE_FLAG_BORROWED = 1u << 0,
+    /** a number holding its json text in str instead of n */
+    X_VALUE_FLAG_RAW_NUMBER = 1u << 1,
+    /** str is valid json string text and is stringified without escaping */
+    X_VALUE_FLAG_RAW_STRING = 1u << 2,
+    /** str still holds escape sequences, decoded in place on first read */
+    X_VALUE_FLAG_ESCAPED = 1u << 3,
+    /** an array holding its numbers in dense.d instead of array.e */
+    X_VALUE_FLAG_DENSE_DOUBLE = 1u << 4,
+    /** an array holding its integers in dense.i instead of array.e */
+    X_VALUE_FLAG_DENSE_INT64 = 1u << 5,
+    /** an object whose members are in byte order of their keys */
+    X_VALUE_FLAG_SORTED_KEYS = 1u << 6,
+    /** a string holding the bytes its base64 text decodes to */
+    X_VALUE_FLAG_BINARY = 1u << 7
 };
 
 typedef struct xMember xMember;
@@ -43,17 +127,158 @@ struct xValue{
             xMember* m;
             size_t size;
         } object;
+        struct {
+            union {
+                double* d;
+                int64_t* i;
+            };
+            size_t len;
+        } dense;
         double n;
     };
     xType type;
+    unsigned flags;
 };
 
 struct xMember {
     char* k;
     size_t klen;
     xValue v;
+    unsigned flags;
+    uint32_t hash;      /* xHashKey(k, klen), kept by every member */
+};
+
+static const size_t X_KEY_NOT_EXIST = (size_t)-1;
+
+/** @fn uint32_t xHashKey(const char* key, size_t klen)
+ * @brief the hash stored in xMember::hash, for code that builds members
+ * itself or looks keys up in a loop.
+ */
+uint32_t xHashKey(const char* key, size_t klen);
+
+/** @fn bool xSameKey(const xMember* a, const xMember* b)
+ * @brief whether two members have the same key, different hashes settle
+ * most mismatches without reading the keys.
+ */
+inline bool xSameKey(const xMember* a, const xMember* b) {
+    return a->hash == b->hash && a->klen == b->klen
+        && memcmp(a->k, b->k, a->klen) == 0;
+}
+
+/**
+ * @brief memory hooks behind every block of a tree and of the parse and
+ * stringify buffers. blocks are always exactly sized, free and realloc
+ * receive the size the block was allocated with.
+ */
+struct xAllocator {
+    void* (*alloc)(void* ctx, size_t size);
+    void* (*realloc)(void* ctx, void* p, size_t oldSize, size_t newSize);
+    void (*free)(void* ctx, void* p, size_t size);
+    void* ctx;
+};
+
+/**
+ * @brief allocation counters of an xAllocatorScope.
+ */
+struct xAllocStats {
+    size_t allocs;
+    size_t reallocs;
+    size_t frees;
+    size_t bytes;       /* bytes requested, realloc growth included */
+    ptrdiff_t live;     /* bytes held, frees of older blocks lower it */
+    size_t peak;        /* high-water mark of live */
+};
+
+/** @fn const xAllocator* xSetDefaultAllocator(const xAllocator* allocator)
+ * @brief replace the process wide allocator, nullptr restores malloc.
+ * must not race with other calls into the library.
+ * @return const xAllocator* the previous allocator
+ */
+const xAllocator* xSetDefaultAllocator(const xAllocator* allocator);
+
+/**
+ * @brief routes the allocations of the current thread while in scope.
+ * values must be freed under the allocator they were built with.
+ *
+ *     xAllocStats stats = {};
+ *     {
+ *         xAllocatorScope scope(&pool, &stats);
+ *         xParse(&v, json);
+ *     }
+ */
+class xAllocatorScope {
+ private:
+    const xAllocator* allocator;
+    xAllocStats* stats;
+
+ public:
+    /**
+     * @param allocator nullptr keeps the active allocator
+     * @param stats optional, counts every call made in scope
+     */
+    explicit xAllocatorScope(const xAllocator* allocator,
+        xAllocStats* stats = nullptr);
+    ~xAllocatorScope();
+    xAllocatorScope(const xAllocatorScope&) = delete;
+    xAllocatorScope& operator=(const xAllocatorScope&) = delete;
+};
+
+/**
+ * @brief counters of the parses and stringifies run in an xStatsScope.
+ * they accumulate, zero the struct between documents for per document
+ * figures. all of them stay zero when built with X_JSON_STATS=0.
+ */
+struct xStats {
+    size_t parses;
+    size_t stringifies;
+    size_t values[7];   /* values read or written, indexed by xType */
+    size_t stringBytes; /* decoded bytes of strings and keys */
+    size_t escapes;     /* escape sequences decoded or written */
+    size_t maxDepth;    /* deepest container nesting */
+    size_t stackPeak;   /* high-water mark of the scratch stack */
+    size_t outputBytes; /* bytes written by stringify */
+    uint64_t parseNs;   /* phase timings, only when timing is on */
+    uint64_t stringifyNs;
+};
+
+/**
+ * @brief receives the duration of every parse ("parse") and stringify
+ * ("stringify") run in scope, e.g. to feed a sampling profiler.
+ */
+struct xTracer {
+    void (*phase)(void* ctx, const char* name, const xStats* stats,
+        uint64_t ns);
+    void* ctx;
+};
+
+/**
+ * @brief collect xStats on the current thread while in scope.
+ * without a scope the hooks cost one predictable branch per value.
+ */
+class xStatsScope {
+ private:
+    xStats* stats;
+    const xTracer* tracer;
+    bool timing;
+
+ public:
+    /**
+     * @param stats counters to update
+     * @param timing also fill parseNs and stringifyNs
+     * @param tracer optional, implies timing
+     */
+    explicit xStatsScope(xStats* stats, bool timing = false,
+        const xTracer* tracer = nullptr);
+    ~xStatsScope();
+    xStatsScope(const xStatsScope&) = delete;
+    xStatsScope& operator=(const xStatsScope&) = delete;
 };
 
+/** allocate through the active allocator, for trees built by hand */
+void* xAlloc(size_t size);
+void* xRealloc(void* p, size_t oldSize, size_t newSize);
+void xDealloc(void* p, size_t size);
+
 /** @fn int xParse(xValue* v, const char* json)
  * @brief parse json to get corresponding value.
  * @param v 
@@ -62,8 +287,160 @@ struct xMember {
 */
 xState xParse(xValue* v, const char* json);
 
+/** @fn xState xValidate(const char* data, size_t len, size_t* offset)
+ * @brief check that data is one json text without building a tree.
+ * the grammar and the xState codes are those of xParse, strings are not
+ * decoded, numbers are not converted and nothing is allocated. data needs
+ * no terminator, an embedded nul byte is an error.
+ * @param data 
+ * @param len 
+ * @param offset optional, receives the position of the error, or len
+ * @return xState 
+ */
+xState xValidate(const char* data, size_t len, size_t* offset = nullptr);
+
+/** @fn xState xSkip(const char* data, size_t len, size_t* end, size_t* count)
+ * @brief step over the value at the start of data without parsing it,
+ * to count the elements of a large array or to slice a subdocument out
+ * of the text unchanged. the value is not checked: strings are jumped
+ * over, brackets and commas are found 16 bytes at a time and nothing is
+ * decoded or allocated. run xValidate first on text that is not trusted.
+ * @param data the value, leading whitespace is skipped
+ * @param len 
+ * @param end receives the offset just past the value, or len when the
+ * text ends inside it
+ * @param count optional, receives the elements of an array or the
+ * members of an object, 0 for other values
+ * @return xState X_PARSE_EXPECT_VALUE, X_PARSE_INVALID_VALUE when data
+ * starts with a delimiter, X_PARSE_MISS_QUOTATION_MARK or
+ * X_PARSE_MISS_COMMA_OR_..._BRACKET when the text ends inside the value
+ */
+xState xSkip(const char* data, size_t len, size_t* end,
+    size_t* count = nullptr);
+
+/**
+ * @brief sink of streamed output text.
+ */
+struct xWriter {
+    void (*write)(void* ctx, const char* data, size_t len);
+    void* ctx;
+};
+
+struct xFormatOptions {
+    unsigned indent = 0;    /* spaces per level, 0 minifies */
+    bool tabs = false;      /* one tab per level, whatever indent is */
+};
+
+/** @fn xState xFormat(const char* data, size_t len, const xWriter* out, const xFormatOptions* options, size_t* offset)
+ * @brief minify or pretty-print json text without building a tree.
+ * strings and numbers are copied byte for byte, only whitespace changes.
+ * memory use is constant and the input is checked as by xValidate, on
+ * failure out has received the text formatted up to the error.
+ * @param data 
+ * @param len 
+ * @param out receives the formatted text in chunks
+ * @param options optional, minify by default
+ * @param offset optional, receives the position of the error, or len
+ * @return xState 
+ */
+xState xFormat(const char* data, size_t len, const xWriter* out,
+    const xFormatOptions* options = nullptr, size_t* offset = nullptr);
+
+/** @fn xState xParseWith(xValue* v, const char* json)
+ * @brief parse json with the features enabled by Policy.
+ * the library exports xStrictPolicy, xRelaxedPolicy and xSafePolicy,
+ * features that are not enabled cost nothing.
+ * @param v 
+ * @param json json text as c-type string
+ * @return xState 
+ */
+template <class Policy>
+xState xParseWith(xValue* v, const char* json);
+
+/** @fn xState xParseInsitu(xValue* v, char* json)
+ * @brief parse json decoding strings and keys in place.
+ * json is modified and must outlive v, strings and keys of v point into
+ * it (X_VALUE_FLAG_BORROWED) instead of being allocated.
+ * @param v 
+ * @param json mutable json text as c-type string
+ * @return xState 
+ */
+template <class Policy>
+xState xParseInsitu(xValue* v, char* json);
+
+extern template xState xParseWith<xStrictPolicy>(xValue*, const char*);
+extern template xState xParseWith<xRelaxedPolicy>(xValue*, const char*);
+extern template xState xParseWith<xSafePolicy>(xValue*, const char*);
+extern template xState xParseWith<xLazyPolicy>(xValue*, const char*);
+extern template xState xParseWith<xDensePolicy>(xValue*, const char*);
+extern template xState xParseWith<xSortedPolicy>(xValue*, const char*);
+extern template xState xParseInsitu<xStrictPolicy>(xValue*, char*);
+extern template xState xParseInsitu<xRelaxedPolicy>(xValue*, char*);
+extern template xState xParseInsitu<xLazyPolicy>(xValue*, char*);
+extern template xState xParseInsitu<xSortedPolicy>(xValue*, char*);
+
+/** @fn char* xStringify(const xValue* v, size_t* length)
+ * @brief stringify v.
+ * @param v 
+ * @param length optional, receives the length without the terminator
+ * @return char* release with free(), or with xDealloc(s, *length + 1)
+ * when a custom allocator is active
+ */
 char* xStringify(const xValue* v, size_t* length);
 
+/** @fn char* xStringifyCanonical(const xValue* v, size_t* length)
+ * @brief stringify v in one canonical form, for hashing and signing:
+ * members in byte order of their keys (stable for duplicates), strings
+ * escaped and numbers printed as by xStringify whatever their storage.
+ * objects with X_VALUE_FLAG_SORTED_KEYS are written as they are, the
+ * others through a sorted permutation of their members.
+ * @param v 
+ * @param length optional, receives the length without the terminator
+ * @return char* released as described at xStringify
+ */
+char* xStringifyCanonical(const xValue* v, size_t* length);
+
+/** @fn bool xEqual(const xValue* lhs, const xValue* rhs)
+ * @brief deep equality of two values.
+ * objects are compared regardless of member order, numbers with ==.
+ * @param lhs 
+ * @param rhs 
+ * @return bool 
+ */
+bool xEqual(const xValue* lhs, const xValue* rhs);
+
+/**
+ * @brief per-node memo of structural hashes.
+ * entries are keyed by node address, so the cache must be cleared
+ * (or the node erased) whenever the hashed tree is modified or freed.
+ */
+class xHashCache {
+ private:
+    std::unordered_map<const xValue*, uint64_t> table;
+
+ public:
+    bool find(const xValue* v, uint64_t* hash) const {
+        auto it = table.find(v);
+        if (it == table.end())
+            return false;
+        *hash = it->second;
+        return true;
+    }
+    void insert(const xValue* v, uint64_t hash) { table[v] = hash; }
+    void erase(const xValue* v) { table.erase(v); }
+    void clear() { table.clear(); }
+    size_t size() const { return table.size(); }
+};
+
+/** @fn uint64_t xHash(const xValue* v, xHashCache* cache)
+ * @brief structural hash of a value, consistent with xEqual.
+ * equal values hash equal, member order of objects does not matter.
+ * @param v 
+ * @param cache optional, strings and containers are memoized in it
+ * @return uint64_t 
+ */
+uint64_t xHash(const xValue* v, xHashCache* cache = nullptr);
+
 class xHelper {
  private:
     xValue* value;
@@ -71,6 +448,33 @@ class xHelper {
  public:
     explicit xHelper(xValue* v);
     ~xHelper();
+    xHelper(const xHelper&) = delete;
+    xHelper& operator=(const xHelper&) = delete;
+
+    /** @fn void xCopy(xValue* dst, const xValue* src)
+     * @brief deep copy src into dst, dst is freed first.
+     * each element/member array is duplicated with one allocation and
+     * one memcpy, only the owning children are copied afterwards.
+     * @param dst destination value
+     * @param src source value, left untouched
+     */
+    static void xCopy(xValue* dst, const xValue* src);
+
+    /** @fn void xMove(xValue* dst, xValue* src)
+     * @brief transfer ownership of src into dst in O(1).
+     * dst is freed first, src is left as null.
+     * @param dst destination value
+     * @param src source value
+     */
+    static void xMove(xValue* dst, xValue* src);
+
+    /** @fn void xSwap(xValue* lhs, xValue* rhs)
+     * @brief exchange two values in O(1).
+     * @param lhs 
+     * @param rhs 
+     */
+    static void xSwap(xValue* lhs, xValue* rhs);
+
     /**
      * @brief 
      * 
@@ -102,12 +506,29 @@ class xHelper {
 
     /** @fn double xGetNumber(const xValue* v)
      * @brief 
-     * 
+     * a raw number (X_VALUE_FLAG_RAW_NUMBER) is converted on every call.
      * @param v 
      * @return double 
      */
     static double xGetNumber(const xValue* v);
 
+    /** @fn bool xGetInt64(const xValue* v, int64_t* i)
+     * @brief the number as an exact integer, raw numbers of plain digits
+     * are converted without going through double.
+     * @param v 
+     * @param i receives the value
+     * @return bool false when v is not integral or does not fit
+     */
+    static bool xGetInt64(const xValue* v, int64_t* i);
+
+    /** @fn const char* xGetNumberText(const xValue* v, size_t* len)
+     * @brief the json text of a raw number, e.g. for a decimal type.
+     * @param v 
+     * @param len receives the length, the text is not nul-terminated
+     * @return const char* nullptr when v was converted at parse time
+     */
+    static const char* xGetNumberText(const xValue* v, size_t* len);
+
     /**
      * @brief 
      * 
@@ -116,21 +537,215 @@ class xHelper {
      */
     static void xSetNumber(xValue* v, double n);
 
+    /** @fn const char* xGetString(const xValue* v)
+     * @brief the decoded string. the first read of an escaped lazy string
+     * (X_VALUE_FLAG_ESCAPED) decodes it in place, concurrent first reads
+     * of the same value must be serialized by the caller. a binary string
+     * (X_VALUE_FLAG_BINARY) is left as it is and its base64 text returned
+     * in a buffer of the calling thread, valid until the next read of a
+     * binary string on that thread: strcmp(xGetString(a), xGetString(b))
+     * of two binary strings compares that buffer with itself. keep
+     * several at once through xGetString(v, out).
+     * @param v 
+     * @return const char* nul-terminated
+     */
     static const char* xGetString(const xValue* v);
 
+    /** @fn const char* xGetString(const xValue* v, char* out)
+     * @brief the decoded string, the base64 text of a binary string is
+     * written to out instead of the thread buffer. text strings are
+     * returned in place and out is left untouched.
+     * @param v 
+     * @param out room for xGetStringLength(v) + 1 bytes
+     * @return const char* nul-terminated, out for a binary string
+     */
+    static const char* xGetString(const xValue* v, char* out);
+
+    /** @fn size_t xGetStringLength(const xValue* v)
+     * @brief decoded length, decodes like xGetString.
+     */
     static size_t xGetStringLength(const xValue* v);
 
     static void xSetString(xValue* v, const char* s, size_t len);
 
+    /** @fn const uint8_t* xGetBinary(const xValue* v, size_t* len)
+     * @brief the bytes of a binary string (X_VALUE_FLAG_BINARY), v is
+     * never written.
+     * @param v a string
+     * @param len receives the number of bytes
+     * @return const uint8_t* nullptr when v is text, see xDecodeBinary
+     */
+    static const uint8_t* xGetBinary(const xValue* v, size_t* len);
+
+    /** @fn bool xGetBinary(const xValue* v, uint8_t* out, size_t* len)
+     * @brief decode the base64 text of v into out, or copy the bytes of a
+     * binary string. v keeps its text, for const and shared trees.
+     * only canonical padded base64 is decoded.
+     * @param v a string
+     * @param out room for xGetStringLength(v) / 4 * 3 bytes
+     * @param len receives the number of bytes
+     * @return bool false when v is not base64, out is undefined then
+     */
+    static bool xGetBinary(const xValue* v, uint8_t* out, size_t* len);
+
+    /** @fn bool xDecodeBinary(xValue* v)
+     * @brief replace the base64 text of v with its bytes and mark it
+     * X_VALUE_FLAG_BINARY, it is written as the same base64 text by
+     * xStringify.
+     * @param v a string owned by the caller, not a shared tree
+     * @return bool false when v is not base64, v is unchanged then
+     */
+    static bool xDecodeBinary(xValue* v);
+
+    /** @fn void xSetBinary(xValue* v, const void* data, size_t len)
+     * @brief set v to a binary string, written as base64.
+     */
+    static void xSetBinary(xValue* v, const void* data, size_t len);
+
     static size_t xGetArraySize(const xValue* v);
 
+    /** @fn xValue* xGetArrayElement(const xValue* v, size_t index)
+     * @brief element at index, a dense array is expanded first as by
+     * xGetArrayElements.
+     */
     xValue* xGetArrayElement(const xValue* v, size_t index);
 
+    /** @fn xValue* xGetArrayElements(const xValue* v)
+     * @brief the elements of v as xValues. the first read of a dense array
+     * (X_VALUE_FLAG_DENSE_DOUBLE, X_VALUE_FLAG_DENSE_INT64) expands it in
+     * place, integers become doubles, concurrent first reads of the same
+     * value must be serialized by the caller.
+     * @param v 
+     * @return xValue* xGetArraySize elements
+     */
+    static xValue* xGetArrayElements(const xValue* v);
+
+    /** @fn const double* xGetDoubleArray(const xValue* v)
+     * @brief the numbers of a dense array of doubles, without copying.
+     * @param v 
+     * @return const double* xGetArraySize numbers, nullptr when v is not
+     * stored that way
+     */
+    static const double* xGetDoubleArray(const xValue* v);
+
+    /** @fn const int64_t* xGetInt64Array(const xValue* v)
+     * @brief the numbers of a dense array of integers, without copying.
+     * @return const int64_t* nullptr when v is not stored that way
+     */
+    static const int64_t* xGetInt64Array(const xValue* v);
+
+    /** @fn void xSetDoubleArray(xValue* v, const double* d, size_t len)
+     * @brief set v to a dense array holding a copy of d.
+     */
+    static void xSetDoubleArray(xValue* v, const double* d, size_t len);
+
+    /** @fn void xSetInt64Array(xValue* v, const int64_t* i, size_t len)
+     * @brief set v to a dense array holding a copy of i.
+     */
+    static void xSetInt64Array(xValue* v, const int64_t* i, size_t len);
+
     size_t xGetObjectSize(const xValue* v);
     const char* xGetObjectKey(const xValue* v, size_t index);
     size_t xGetObjectKeyLength(const xValue* v, size_t index);
     xValue* xGetObjectValue(const xValue* v, size_t index);
+
+    static void xSetArray(xValue* v);
+
+    /** @fn xValue* xInsertArrayElement(xValue* v, size_t index)
+     * @brief open a null slot at index, later elements shift up.
+     * @return xValue* the new element
+     */
+    static xValue* xInsertArrayElement(xValue* v, size_t index);
+
+    /** @fn void xEraseArrayElement(xValue* v, size_t index, size_t count)
+     * @brief free count elements from index, later elements shift down.
+     */
+    static void xEraseArrayElement(xValue* v, size_t index, size_t count);
+
+    static void xSetObject(xValue* v);
+
+    /** @fn xValue* xSetObjectValue(xValue* v, const char* key, size_t klen)
+     * @brief value of key, a null member is appended when key is missing.
+     * v stays X_VALUE_FLAG_SORTED_KEYS only when key sorts after the others.
+     * @return xValue* 
+     */
+    static xValue* xSetObjectValue(xValue* v, const char* key, size_t klen);
+
+    /** @fn void xRemoveObjectValue(xValue* v, size_t index)
+     * @brief free the member at index, later members shift down.
+     */
+    static void xRemoveObjectValue(xValue* v, size_t index);
+
+    /** @fn void xSortObjectKeys(xValue* v)
+     * @brief sort the members of v by key, keeping the order of duplicates,
+     * and mark it X_VALUE_FLAG_SORTED_KEYS.
+     */
+    static void xSortObjectKeys(xValue* v);
+
+    /** @fn size_t xFindObjectIndex(const xValue* v, const char* key, size_t klen)
+     * @brief find the first member with the given key, by binary search
+     * when v is X_VALUE_FLAG_SORTED_KEYS.
+     * @return size_t index of the member or X_KEY_NOT_EXIST
+     */
+    static size_t xFindObjectIndex(const xValue* v,
+        const char* key, size_t klen);
+    static xValue* xFindObjectValue(const xValue* v,
+        const char* key, size_t klen);
+};
+
+/**
+ * @brief owning json document.
+ * the root value is freed with the document. moving a document only
+ * transfers the root and its allocator (O(1)), copies are explicit
+ * through clone() and share the allocator.
+ */
+class xDocument {
+ private:
+    xValue root;
+    const xAllocator* allocator;
+
+ public:
+    xDocument();
+    /**
+     * @param allocator every block of the document comes from it,
+     * nullptr uses the allocator active at each call
+     */
+    explicit xDocument(const xAllocator* allocator);
+    ~xDocument();
+    xDocument(xDocument&& other) noexcept;
+    xDocument& operator=(xDocument&& other) noexcept;
+    xDocument(const xDocument&) = delete;
+    xDocument& operator=(const xDocument&) = delete;
+
+    /**
+     * @brief parse json into the document, the old root is released.
+     * @param json json text as c-type string
+     * @return xState 
+     */
+    xState parse(const char* json);
+
+    /**
+     * @brief stringify the root, see xStringify.
+     * @param length 
+     * @return char* released as described at xStringify
+     */
+    char* stringify(size_t* length) const;
+
+    /**
+     * @brief deep copy of the document.
+     * @return xDocument 
+     */
+    xDocument clone() const;
+
+    void swap(xDocument& other) noexcept;
+
+    xValue* value() { return &root; }
+    const xValue* value() const { return &root; }
 };
+
+inline void swap(xDocument& lhs, xDocument& rhs) noexcept {
+    lhs.swap(rhs);
+}
 }  // namespace xJson
 
 #endif  //!__XJSON__H__
\ No newline at end of file
@@ -0,0 +1,100 @@
+/* copyright 2021 xkxsxkx */
+#ifndef __XJSON_BATCH__H__
+#define __XJSON_BATCH__H__
+
+#include <stddef.h>
+#include <vector>
+#include "xjson.h"
+
+namespace xJson {
+
+/**
+ * @brief the text of one document in an xBatchWriter. it has the layout
+ * of struct iovec, an array of spans can be passed to writev or sendmsg
+ * as it is.
+ */
+struct xSpan {
+    const char* data;
+    size_t len;
+};
+
+/**
+ * @brief stringifies many roots into one arena that is kept between
+ * batches, once it has grown to the size of a batch no document costs
+ * an allocation. the documents are laid out back to back without
+ * terminators.
+ *
+ *     xBatchWriter& w = xBatchWriter::local();
+ *     w.clear();
+ *     for (i = 0; i < n; i++)
+ *         w.add(&responses[i]);
+ *     writev(fd, (const struct iovec*)w.spans(), (int)w.size());
+ *
+ * writev takes at most IOV_MAX spans per call, and a span is only valid
+ * until the next add, clear or release.
+ */
+class xBatchWriter {
+ private:
+    char* arena;
+    size_t capacity, top;
+    const xAllocator* allocator;
+    std::vector<size_t> ends;       /* end of each document in arena */
+    std::vector<xSpan> views;
+
+ public:
+    /**
+     * @param allocator the arena comes from it, nullptr uses the
+     * allocator active at construction
+     */
+    explicit xBatchWriter(const xAllocator* allocator = nullptr);
+    ~xBatchWriter();
+    xBatchWriter(const xBatchWriter&) = delete;
+    xBatchWriter& operator=(const xBatchWriter&) = delete;
+
+    /**
+     * @brief the writer of the calling thread, created on first use. its
+     * arena lives until the thread exits, so it comes from the process
+     * wide allocator of that moment (xSetDefaultAllocator), never from an
+     * xAllocatorScope active at the call.
+     */
+    static xBatchWriter& local();
+
+    /**
+     * @brief stringify v at the end of the batch, as by xStringify.
+     * @return size_t index of its span
+     */
+    size_t add(const xValue* v);
+
+    /** @brief as add, with the text of xStringifyCanonical */
+    size_t addCanonical(const xValue* v);
+
+    /** @brief drop the documents, the arena is kept */
+    void clear();
+
+    /** @brief drop the documents and free the arena */
+    void release();
+
+    /** @brief number of documents */
+    size_t size() const { return ends.size(); }
+
+    /** @brief the span of document i */
+    xSpan span(size_t i) const {
+        size_t begin = i == 0 ? 0 : ends[i - 1];
+        return xSpan{ arena + begin, ends[i] - begin };
+    }
+
+    /** @brief the spans of all documents, in order */
+    const xSpan* spans();
+
+    /** @brief all documents as one block, for a single write */
+    const char* data() const { return arena; }
+    size_t length() const { return top; }
+
+ private:
+    template <bool Canonical>
+    size_t append(const xValue* v);
+};
+
+}  // namespace xJson
+
+#endif  //!__XJSON_BATCH__H__
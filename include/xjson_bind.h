@@ -0,0 +1,438 @@
+/* copyright 2021 xkxsxkx */
+#ifndef __XJSON_BIND__H__
+#define __XJSON_BIND__H__
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <charconv>
+#include <limits>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "xjson.h"
+#include "xjson_lexer.h"
+#include "xjson_phash.h"
+
+namespace xJson {
+
+/**
+ * @brief one json key bound to one data member.
+ */
+template <class C, class M>
+struct xFieldDesc {
+    typedef C Class;
+    typedef M Member;
+    const char* name;
+    size_t len;
+    M C::* member;
+};
+
+template <class C, class M, size_t N>
+constexpr xFieldDesc<C, M> xField(const char (&name)[N], M C::* member) {
+    return xFieldDesc<C, M>{ name, N - 1, member };
+}
+
+/**
+ * @brief field mappings of a struct, specialize it once per struct:
+ *
+ *     template <> struct xJson::xBinding<Point> {
+ *         static constexpr auto fields = std::make_tuple(
+ *             xJson::xField("x", &Point::x),
+ *             xJson::xField("name", &Point::name));
+ *     };
+ *
+ * the same declaration drives xBindParse and xBindStringify, keys are
+ * dispatched through a compile-time xPerfectHash. supported members are
+ * bool, integers, floating point, std::string, std::vector of a supported
+ * type and other bound structs.
+ */
+template <class T>
+struct xBinding;
+
+template <class T, class = void>
+struct xIsBound : std::false_type {};
+template <class T>
+struct xIsBound<T, std::void_t<decltype(xBinding<T>::fields)>>
+    : std::true_type {};
+
+/**
+ * @brief compile-time perfect hash over the keys of xBinding<T>.
+ */
+template <class T>
+struct xBindingKeys {
+    static constexpr size_t size =
+        std::tuple_size<decltype(xBinding<T>::fields)>::value;
+
+    template <size_t... I>
+    static constexpr xPerfectHash<sizeof...(I)> make(
+        std::index_sequence<I...>) {
+        return xPerfectHash<sizeof...(I)>(
+            std::array<std::string_view, sizeof...(I)>{ std::string_view(
+                std::get<I>(xBinding<T>::fields).name,
+                std::get<I>(xBinding<T>::fields).len)... });
+    }
+
+    static constexpr auto hash = make(std::make_index_sequence<size>());
+};
+
+template <class T>
+struct xIsVector : std::false_type {};
+template <class E, class A>
+struct xIsVector<std::vector<E, A>> : std::true_type {};
+
+/**
+ * @brief fills bound structs straight from json text, no xValue is built.
+ */
+class xBindReader {
+ public:
+    struct xStringSink {
+        std::string* s;
+        void put(char ch) { s->push_back(ch); }
+    };
+
+    /**
+     * @brief read one value at *p into out.
+     * a json null leaves out untouched.
+     * @return xState, X_PARSE_TYPE_MISMATCH when the json type does not
+     * fit the member type
+     */
+    template <class T>
+    static xState readValue(const char** p, T* out) {
+        if (**p == 'n')
+            return xLexer::scanLiteral(*p, p, "null");
+        if constexpr (std::is_same<T, bool>::value) {
+            return readBoolean(p, out);
+        } else if constexpr (std::is_integral<T>::value) {
+            return readInteger(p, out);
+        } else if constexpr (std::is_floating_point<T>::value) {
+            return readFloat(p, out);
+        } else if constexpr (std::is_same<T, std::string>::value) {
+            return readString(p, out);
+        } else if constexpr (xIsVector<T>::value) {
+            return readArray(p, out);
+        } else {
+            static_assert(xIsBound<T>::value, "type has no xBinding");
+            return readObject(p, out);
+        }
+    }
+
+    static xState readBoolean(const char** p, bool* out) {
+        if (**p == 't') {
+            *out = true;
+            return xLexer::scanLiteral(*p, p, "true");
+        }
+        if (**p == 'f') {
+            *out = false;
+            return xLexer::scanLiteral(*p, p, "false");
+        }
+        return mismatch(p);
+    }
+
+    template <class T>
+    static xState readInteger(const char** p, T* out) {
+        const char* q = *p;
+        const char* end;
+        xState ret;
+        bool neg = false;
+        unsigned long long u = 0;
+        if (**p != '-' && !X_LEX_ISDIGIT(**p))
+            return mismatch(p);
+        if ((ret = xLexer::scanNumber(*p, &end)) != xState::X_PARSE_OK)
+            return ret;
+        if (*q == '-') {
+            neg = true;
+            q++;
+        }
+        for (; q < end && X_LEX_ISDIGIT(*q); q++) {
+            unsigned d = *q - '0';
+            if (u > (std::numeric_limits<unsigned long long>::max() - d) / 10)
+                return xState::X_PARSE_NUMBER_TOO_BIG;
+            u = u * 10 + d;
+        }
+        if (q != end) {
+            /* fraction or exponent, accept only integral values */
+            double n = strtod(*p, nullptr);
+            if (n != floor(n))
+                return xState::X_PARSE_TYPE_MISMATCH;
+            /* max() rounds up to 2^digits as a double, compare exactly */
+            const double limit = ldexp(1.0, std::numeric_limits<T>::digits);
+            if (n >= limit || n < (std::is_signed<T>::value ? -limit : 0.0))
+                return xState::X_PARSE_NUMBER_TOO_BIG;
+            *out = (T)n;
+        } else if (neg) {
+            if (u == 0) {
+                *out = 0;
+            } else {
+                if (!std::is_signed<T>::value
+                    || u - 1 > (unsigned long long)
+                    std::numeric_limits<T>::max())
+                    return xState::X_PARSE_NUMBER_TOO_BIG;
+                *out = (T)(-(long long)(u - 1) - 1);
+            }
+        } else {
+            if (u > (unsigned long long)std::numeric_limits<T>::max())
+                return xState::X_PARSE_NUMBER_TOO_BIG;
+            *out = (T)u;
+        }
+        *p = end;
+        return xState::X_PARSE_OK;
+    }
+
+    template <class T>
+    static xState readFloat(const char** p, T* out) {
+        const char* end;
+        xState ret;
+        double n;
+        if (**p != '-' && !X_LEX_ISDIGIT(**p))
+            return mismatch(p);
+        if ((ret = xLexer::scanNumber(*p, &end)) != xState::X_PARSE_OK)
+            return ret;
+        errno = 0;
+        n = strtod(*p, nullptr);
+        if (errno == ERANGE && (n == HUGE_VAL || n == -HUGE_VAL))
+            return xState::X_PARSE_NUMBER_TOO_BIG;
+        *out = (T)n;
+        *p = end;
+        return xState::X_PARSE_OK;
+    }
+
+    static xState readString(const char** p, std::string* out) {
+        const char* q;
+        xStringSink sink = { out };
+        if (**p != '"')
+            return mismatch(p);
+        /* copy the leading run without escapes in one go */
+        for (q = *p + 1; (unsigned char)*q >= 0x20
+            && *q != '"' && *q != '\\'; q++) {}
+        out->assign(*p + 1, q);
+        if (*q == '"') {
+            *p = q + 1;
+            return xState::X_PARSE_OK;
+        }
+        return xLexer::scanString(q, p, &sink);
+    }
+
+    template <class V>
+    static xState readArray(const char** p, V* out) {
+        xState ret;
+        if (**p != '[')
+            return mismatch(p);
+        out->clear();
+        *p = xLexer::skipWhiteSpace(*p + 1);
+        if (**p == ']') {
+            (*p)++;
+            return xState::X_PARSE_OK;
+        }
+        for (;;) {
+            out->emplace_back();
+            if ((ret = readValue(p, &out->back())) != xState::X_PARSE_OK)
+                return ret;
+            *p = xLexer::skipWhiteSpace(*p);
+            if (**p == ',') {
+                *p = xLexer::skipWhiteSpace(*p + 1);
+            } else if (**p == ']') {
+                (*p)++;
+                return xState::X_PARSE_OK;
+            } else {
+                return xState::X_PARSE_MISS_COMMA_OR_SQUARE_BRACKET;
+            }
+        }
+    }
+
+    /**
+     * @brief read the value of key into the matching member of out,
+     * unknown keys are skipped.
+     */
+    template <class T>
+    static xState readField(const char* key, size_t klen,
+        const char** p, T* out) {
+        return dispatch(key, klen, p, out,
+            std::make_index_sequence<xBindingKeys<T>::size>());
+    }
+
+    template <class T, size_t I>
+    static xState readMember(const char** p, T* out) {
+        return readValue(p, &(out->*std::get<I>(xBinding<T>::fields).member));
+    }
+
+    template <class T, size_t... I>
+    static xState dispatch(const char* key, size_t klen,
+        const char** p, T* out, std::index_sequence<I...>) {
+        typedef xState (*xReadMember)(const char**, T*);
+        static constexpr xReadMember readers[] = { &readMember<T, I>... };
+        size_t index = xBindingKeys<T>::hash.find(key, klen);
+        if (index == X_KEY_NOT_EXIST)
+            return xLexer::skipValue(*p, p);
+        return readers[index](p, out);
+    }
+
+    template <class T>
+    static xState readObject(const char** p, T* out) {
+        std::string buffer;
+        xStringSink sink = { &buffer };
+        xState ret;
+        if (**p != '{')
+            return mismatch(p);
+        *p = xLexer::skipWhiteSpace(*p + 1);
+        if (**p == '}') {
+            (*p)++;
+            return xState::X_PARSE_OK;
+        }
+        for (;;) {
+            const char* key;
+            const char* q;
+            size_t klen;
+            if (**p != '"')
+                return xState::X_PARSE_MISS_KEY;
+            /* keys without escapes are matched in place */
+            for (q = key = *p + 1; (unsigned char)*q >= 0x20
+                && *q != '"' && *q != '\\'; q++) {}
+            if (*q == '"') {
+                klen = q - key;
+                *p = q + 1;
+            } else {
+                buffer.assign(key, q);
+                if ((ret = xLexer::scanString(q, p, &sink))
+                    != xState::X_PARSE_OK)
+                    return ret;
+                key = buffer.data();
+                klen = buffer.size();
+            }
+            *p = xLexer::skipWhiteSpace(*p);
+            if (**p != ':')
+                return xState::X_PARSE_MISS_COLON;
+            *p = xLexer::skipWhiteSpace(*p + 1);
+            if ((ret = readField(key, klen, p, out)) != xState::X_PARSE_OK)
+                return ret;
+            *p = xLexer::skipWhiteSpace(*p);
+            if (**p == ',') {
+                *p = xLexer::skipWhiteSpace(*p + 1);
+            } else if (**p == '}') {
+                (*p)++;
+                return xState::X_PARSE_OK;
+            } else {
+                return xState::X_PARSE_MISS_COMMA_OR_CURLY_BRACKET;
+            }
+        }
+    }
+
+ private:
+    static xState mismatch(const char** p) {
+        xState ret = xLexer::skipValue(*p, p);
+        return ret == xState::X_PARSE_OK ? xState::X_PARSE_TYPE_MISMATCH : ret;
+    }
+};
+
+/**
+ * @brief writes bound structs straight to json text.
+ */
+class xBindWriter {
+ public:
+    template <class T>
+    static void writeValue(std::string* out, const T& v) {
+        if constexpr (std::is_same<T, bool>::value) {
+            out->append(v ? "true" : "false");
+        } else if constexpr (std::is_integral<T>::value) {
+            char buffer[24];
+            out->append(buffer,
+                std::to_chars(buffer, buffer + sizeof(buffer), v).ptr);
+        } else if constexpr (std::is_floating_point<T>::value) {
+            char buffer[32];
+            out->append(buffer, snprintf(buffer, sizeof(buffer),
+                "%.17g", (double)v));
+        } else if constexpr (std::is_same<T, std::string>::value) {
+            writeString(out, v.data(), v.size());
+        } else if constexpr (xIsVector<T>::value) {
+            out->push_back('[');
+            for (size_t i = 0; i < v.size(); i++) {
+                if (i > 0)
+                    out->push_back(',');
+                writeValue(out, v[i]);
+            }
+            out->push_back(']');
+        } else {
+            static_assert(xIsBound<T>::value, "type has no xBinding");
+            constexpr size_t n =
+                std::tuple_size<decltype(xBinding<T>::fields)>::value;
+            out->push_back('{');
+            writeFields(out, v, std::make_index_sequence<n>());
+            out->push_back('}');
+        }
+    }
+
+    template <class T, size_t... I>
+    static void writeFields(std::string* out, const T& v,
+        std::index_sequence<I...>) {
+        constexpr auto& fields = xBinding<T>::fields;
+        ((I > 0 ? out->push_back(',') : (void)0,
+          writeString(out, std::get<I>(fields).name, std::get<I>(fields).len),
+          out->push_back(':'),
+          writeValue(out, v.*std::get<I>(fields).member)), ...);
+    }
+
+    static void writeString(std::string* out, const char* s, size_t len) {
+        static const char hex_digits[] = "0123456789ABCDEF";
+        size_t i;
+        out->push_back('"');
+        for (i = 0; i < len; i++) {
+            unsigned char ch = (unsigned char)s[i];
+            switch (ch) {
+                case '\"': out->append("\\\"", 2); break;
+                case '\\': out->append("\\\\", 2); break;
+                case '\b': out->append("\\b", 2); break;
+                case '\f': out->append("\\f", 2); break;
+                case '\n': out->append("\\n", 2); break;
+                case '\r': out->append("\\r", 2); break;
+                case '\t': out->append("\\t", 2); break;
+                default:
+                    if (ch < 0x20) {
+                        out->append("\\u00", 4);
+                        out->push_back(hex_digits[ch >> 4]);
+                        out->push_back(hex_digits[ch & 15]);
+                    } else {
+                        out->push_back(s[i]);
+                    }
+            }
+        }
+        out->push_back('"');
+    }
+};
+
+/** @fn xState xBindParse(const char* json, T* out)
+ * @brief parse json text straight into a bound struct (or vector of them).
+ * @param json json text as c-type string
+ * @param out members named in the json are overwritten
+ * @return xState
+ */
+template <class T>
+xState xBindParse(const char* json, T* out) {
+    const char* p = xLexer::skipWhiteSpace(json);
+    xState ret;
+    assert(out != nullptr);
+    if (*p == '\0')
+        return xState::X_PARSE_EXPECT_VALUE;
+    if ((ret = xBindReader::readValue(&p, out)) != xState::X_PARSE_OK)
+        return ret;
+    if (*xLexer::skipWhiteSpace(p) != '\0')
+        return xState::X_PARSE_ROOT_NOT_SINGULAR;
+    return xState::X_PARSE_OK;
+}
+
+/** @fn std::string xBindStringify(const T& in)
+ * @brief serialize a bound struct, members appear in declaration order.
+ */
+template <class T>
+std::string xBindStringify(const T& in) {
+    std::string out;
+    xBindWriter::writeValue(&out, in);
+    return out;
+}
+
+}  // namespace xJson
+
+#endif  //!__XJSON_BIND__H__
@@ -0,0 +1,115 @@
+/* copyright 2021 xkxsxkx */
+#ifndef __XJSON_COLUMN__H__
+#define __XJSON_COLUMN__H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "xjson.h"
+
+namespace xJson {
+
+/**
+ * @brief inferred type of a column, a column is widened as records with
+ * other types arrive: INT64 becomes DOUBLE, any other mix becomes JSON.
+ */
+enum class xColumnType {
+    X_COLUMN_NULL,      /* no value seen yet */
+    X_COLUMN_BOOL,      /* bools */
+    X_COLUMN_INT64,     /* ints */
+    X_COLUMN_DOUBLE,    /* doubles */
+    X_COLUMN_STRING,    /* offsets and data, decoded */
+    X_COLUMN_JSON       /* offsets and data, minified json text */
+};
+
+/**
+ * @brief one field of every record, in struct-of-arrays form.
+ * each row has a slot in the vector of its type, a null or missing field
+ * leaves its bit in valid clear and its slot zero (or empty).
+ */
+struct xColumn {
+    std::string name;
+    xColumnType type = xColumnType::X_COLUMN_NULL;
+    std::vector<uint64_t> valid;    /* bit per row, set when not null */
+    std::vector<uint8_t> bools;
+    std::vector<int64_t> ints;
+    std::vector<double> doubles;
+    std::vector<size_t> offsets;    /* rows + 1, for STRING and JSON */
+    std::string data;
+    size_t rows = 0;
+
+    bool isValid(size_t row) const {
+        return (valid[row >> 6] >> (row & 63)) & 1;
+    }
+    /** @brief text of a STRING or JSON row */
+    const char* text(size_t row, size_t* len) const {
+        *len = offsets[row + 1] - offsets[row];
+        return data.data() + offsets[row];
+    }
+};
+
+/**
+ * @brief an array of objects pivoted into one xColumn per member name.
+ * the columns are created in order of first appearance and their types
+ * inferred from the values; a record without a member is null in that
+ * column. several arrays can be appended to the same table.
+ *
+ *     xColumnTable t;
+ *     t.parse(json, len);
+ *     const xColumn* price = t.column("price", 5);
+ *     for (size_t i = 0; i < t.size(); i++)
+ *         sum += price->type == xColumnType::X_COLUMN_INT64
+ *             ? (double)price->ints[i] : price->doubles[i];
+ */
+class xColumnTable {
+ private:
+    std::vector<xColumn> cols;
+    std::unordered_map<std::string, size_t> index;
+    std::vector<size_t> hints;  /* column of the i-th member of the last row */
+    size_t count;
+    std::string tmp;
+
+ public:
+    xColumnTable() : count(0) {}
+
+    /**
+     * @brief append the records of a json array of objects, without
+     * building a tree.
+     * @param data
+     * @param len
+     * @param offset optional, receives the position of the error, or len
+     * @return xState X_PARSE_TYPE_MISMATCH when the text is not an array
+     * or an element is another json value, a syntax error otherwise; the
+     * rows of the records before the error are kept
+     */
+    xState parse(const char* data, size_t len, size_t* offset = nullptr);
+
+    /**
+     * @brief append the records of an array of objects. a raw number is
+     * classified from its text as parse does it, any other number counts
+     * as an integer when it is integral and exactly representable.
+     * @param v
+     * @return xState X_PARSE_TYPE_MISMATCH as for parse, nothing is
+     * appended then
+     */
+    xState append(const xValue* v);
+
+    void clear();
+
+    size_t size() const { return count; }
+    size_t columnCount() const { return cols.size(); }
+    const xColumn& column(size_t i) const { return cols[i]; }
+    /** @return const xColumn* nullptr when no record has the member */
+    const xColumn* column(const char* name, size_t len) const;
+
+ private:
+    xColumn* find(const char* name, size_t len, size_t position);
+    void endRow();
+    xState parseRecord(const char* p, const char* end, const char** out);
+};
+
+}  // namespace xJson
+
+#endif  //!__XJSON_COLUMN__H__
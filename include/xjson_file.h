@@ -0,0 +1,100 @@
+/* copyright 2021 xkxsxkx */
+#ifndef __XJSON_FILE__H__
+#define __XJSON_FILE__H__
+
+#include <stddef.h>
+#include "xjson.h"
+
+namespace xJson {
+
+struct xMapOptions {
+    bool writable = false;  /* private copy-on-write pages, for xParseInsitu */
+    bool populate = false;  /* fault the whole file in up front */
+    bool hugePages = false; /* ask for transparent huge pages */
+};
+
+/**
+ * @brief a whole file mapped into memory and followed by at least one
+ * zero byte, so the parser can read it as a c-type string without a
+ * copy. the mapping is advised for sequential access. where mmap is not
+ * available the file is read into one allocated block instead.
+ */
+class xMappedFile {
+ private:
+    char* base;
+    size_t length;      /* bytes of the file */
+    size_t mapped;      /* bytes of the mapping, terminator included */
+    bool write;
+
+ public:
+    xMappedFile();
+    ~xMappedFile();
+    xMappedFile(xMappedFile&& other) noexcept;
+    xMappedFile& operator=(xMappedFile&& other) noexcept;
+    xMappedFile(const xMappedFile&) = delete;
+    xMappedFile& operator=(const xMappedFile&) = delete;
+
+    /**
+     * @brief map path, the previous mapping is released.
+     * @param path
+     * @param options optional, read-only by default
+     * @return xState X_PARSE_FILE_ERROR with errno set when the file
+     * cannot be opened or mapped
+     */
+    xState open(const char* path, const xMapOptions* options = nullptr);
+    void close();
+
+    const char* data() const { return base; }
+    /** @brief nullptr unless mapped writable */
+    char* mutableData() { return write ? base : nullptr; }
+    size_t size() const { return length; }
+};
+
+/** @fn xState xParseFile(xValue* v, const char* path, const xMapOptions* options)
+ * @brief parse a file through a temporary mapping, see xMappedFile.
+ * a nul byte inside the file is an error instead of its end.
+ * @param v
+ * @param path
+ * @param options optional
+ * @return xState X_PARSE_FILE_ERROR with errno set on i/o failure
+ */
+xState xParseFile(xValue* v, const char* path,
+    const xMapOptions* options = nullptr);
+
+/** @fn xState xParseFileWith(xValue* v, const char* path, const xMapOptions* options)
+ * @brief xParseFile with the features enabled by Policy, see xParseWith.
+ */
+template <class Policy>
+xState xParseFileWith(xValue* v, const char* path,
+    const xMapOptions* options = nullptr);
+
+/** @fn xState xParseInsitu(xValue* v, xMappedFile* file)
+ * @brief parse a writable mapping in place, strings (and lazy numbers)
+ * of v point into the mapping, which must outlive v. only the pages that
+ * are written to are copied.
+ * @param v
+ * @param file opened with xMapOptions::writable
+ * @return xState
+ */
+template <class Policy>
+xState xParseInsitu(xValue* v, xMappedFile* file);
+
+extern template xState xParseFileWith<xStrictPolicy>(xValue*, const char*,
+    const xMapOptions*);
+extern template xState xParseFileWith<xRelaxedPolicy>(xValue*, const char*,
+    const xMapOptions*);
+extern template xState xParseFileWith<xSafePolicy>(xValue*, const char*,
+    const xMapOptions*);
+extern template xState xParseFileWith<xLazyPolicy>(xValue*, const char*,
+    const xMapOptions*);
+extern template xState xParseFileWith<xDensePolicy>(xValue*, const char*,
+    const xMapOptions*);
+extern template xState xParseFileWith<xSortedPolicy>(xValue*, const char*,
+    const xMapOptions*);
+extern template xState xParseInsitu<xStrictPolicy>(xValue*, xMappedFile*);
+extern template xState xParseInsitu<xRelaxedPolicy>(xValue*, xMappedFile*);
+extern template xState xParseInsitu<xLazyPolicy>(xValue*, xMappedFile*);
+
+}  // namespace xJson
+
+#endif  //!__XJSON_FILE__H__
@@ -0,0 +1,312 @@
+/* copyright 2021 xkxsxkx */
+#ifndef __XJSON_LEXER__H__
+#define __XJSON_LEXER__H__
+
+#include <assert.h>
+#include "xjson.h"
+
+namespace xJson {
+
+#define X_LEX_ISDIGIT(ch) ((ch) >= '0' && (ch) <= '9')
+#define X_LEX_ISDIGIT1TO9(ch) ((ch) >= '1' && (ch) <= '9')
+
+/**
+ * @brief token level scanning shared by xParse and the header-only layers.
+ * every routine works on nul-terminated text and never allocates, decoded
+ * string bytes are handed to a sink which only needs `void put(char)`.
+ */
+class xLexer {
+ public:
+    /** @brief sink that drops decoded bytes, used to only check a string. */
+    struct xNullSink {
+        void put(char) {}
+    };
+    /** @brief sink that only counts the decoded bytes. */
+    struct xCountSink {
+        size_t n;
+        void put(char) { n++; }
+    };
+    /** @brief sink that writes through a pointer, also over its source. */
+    struct xPointerSink {
+        char* w;
+        void put(char ch) { *w++ = ch; }
+    };
+
+    static const char* skipWhiteSpace(const char* p) {
+        while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')
+            p++;
+        return p;
+    }
+
+    /**
+     * @brief check the number grammar without converting.
+     * @param p first character of the number
+     * @param end receives the first character after the number
+     * @return xState X_PARSE_OK or X_PARSE_INVALID_VALUE
+     */
+    static xState scanNumber(const char* p, const char** end) {
+        if (*p == '-') p++;
+        if (*p == '0') {
+            p++;
+        } else {
+            if (!X_LEX_ISDIGIT1TO9(*p))
+                return xState::X_PARSE_INVALID_VALUE;
+            for (p++; X_LEX_ISDIGIT(*p); p++) {}
+        }
+        if (*p == '.') {
+            p++;
+            if (!X_LEX_ISDIGIT(*p))
+                return xState::X_PARSE_INVALID_VALUE;
+            for (p++; X_LEX_ISDIGIT(*p); p++) {}
+        }
+        if (*p == 'e' || *p == 'E') {
+            p++;
+            if (*p == '+' || *p == '-') p++;
+            if (!X_LEX_ISDIGIT(*p))
+                return xState::X_PARSE_INVALID_VALUE;
+            for (p++; X_LEX_ISDIGIT(*p); p++) {}
+        }
+        *end = p;
+        return xState::X_PARSE_OK;
+    }
+
+    static const char* parseHex4(const char* p, unsigned* u) {
+        int i;
+        *u = 0;
+        for (i = 0; i < 4; i++) {
+            char ch = *p++;
+            *u <<= 4;
+            if (ch >= '0' && ch <= '9') *u |= ch - '0';
+            else if (ch >= 'A' && ch <= 'F') *u |= ch - ('A' - 10);
+            else if (ch >= 'a' && ch <= 'f') *u |= ch - ('a' - 10);
+            else return nullptr;
+        }
+        return p;
+    }
+
+    /**
+     * @brief check one utf-8 sequence, rejecting overlong forms, surrogates
+     * and code points above U+10FFFF.
+     * @param p lead byte of the sequence, at least 0x80
+     * @return const char* first byte after the sequence, nullptr if invalid
+     */
+    static const char* scanUtf8(const char* p) {
+        const unsigned char* s = (const unsigned char*)p;
+        unsigned u;
+        int i, n;
+        if (s[0] < 0xC2) return nullptr;
+        else if (s[0] < 0xE0) { n = 1; u = s[0] & 0x1F; }
+        else if (s[0] < 0xF0) { n = 2; u = s[0] & 0x0F; }
+        else if (s[0] < 0xF5) { n = 3; u = s[0] & 0x07; }
+        else return nullptr;
+        /* a nul terminator fails the continuation test and stops here */
+        for (i = 1; i <= n; i++) {
+            if ((s[i] & 0xC0) != 0x80)
+                return nullptr;
+            u = (u << 6) | (s[i] & 0x3F);
+        }
+        if (n == 2 && (u < 0x800 || (u >= 0xD800 && u <= 0xDFFF)))
+            return nullptr;
+        if (n == 3 && (u < 0x10000 || u > 0x10FFFF))
+            return nullptr;
+        return p + n + 1;
+    }
+
+    template <class Sink>
+    static void encodeUtf8(Sink* s, unsigned u) {
+        if (u <= 0x7F) {
+            s->put(u & 0xFF);
+        } else if (u <= 0x7FF) {
+            s->put(0xC0 | ((u >> 6) & 0xFF));
+            s->put(0x80 | (u & 0x3F));
+        } else if (u <= 0xFFFF) {
+            s->put(0xE0 | ((u >> 12) & 0xFF));
+            s->put(0x80 | ((u >> 6) & 0x3F));
+            s->put(0x80 | (u & 0x3F));
+        } else {
+            assert(u <= 0x10FFFF);
+            s->put(0xF0 | ((u >> 18) & 0xFF));
+            s->put(0x80 | ((u >> 12) & 0x3F));
+            s->put(0x80 | ((u >> 6) & 0x3F));
+            s->put(0x80 | (u & 0x3F));
+        }
+    }
+
+    /**
+     * @brief decode one escape sequence.
+     * @param p first character after the backslash, moved past the sequence
+     * @param s sink of the decoded bytes
+     * @return xState
+     */
+    template <class Sink>
+    static xState scanEscape(const char** p, Sink* s) {
+        unsigned u, u2;
+        switch (*(*p)++) {
+            case '\"': s->put('\"'); break;
+            case '\\': s->put('\\'); break;
+            case '/': s->put('/'); break;
+            case 'b': s->put('\b'); break;
+            case 'f': s->put('\f'); break;
+            case 'n': s->put('\n'); break;
+            case 'r': s->put('\r'); break;
+            case 't': s->put('\t'); break;
+            case 'u':
+                if (!(*p = parseHex4(*p, &u)))
+                    return xState::X_PARSE_INVALID_UNICODE_HEX;
+                if (u >= 0xD800 && u <= 0xDBFF) {
+                    if (*(*p)++ != '\\')
+                        return xState::X_PARSE_INVALID_UNICODE_SURROGATE;
+                    if (*(*p)++ != 'u')
+                        return xState::X_PARSE_INVALID_UNICODE_SURROGATE;
+                    if (!(*p = parseHex4(*p, &u2)))
+                        return xState::X_PARSE_INVALID_UNICODE_HEX;
+                    if (u2 < 0xDC00 || u2 > 0xDFFF)
+                        return xState::X_PARSE_INVALID_UNICODE_SURROGATE;
+                    u = (((u - 0xD800) << 10) | (u2 - 0xDC00)) + 0x10000;
+                }
+                encodeUtf8(s, u);
+                break;
+            default:
+                return xState::X_PARSE_INVALID_STRING_ESCAPE;
+        }
+        return xState::X_PARSE_OK;
+    }
+
+    /**
+     * @brief decode the body of a string into sink.
+     * @param p first character after the opening quotation mark
+     * @param end receives the first character after the closing mark
+     * @param s sink of the decoded bytes
+     * @tparam ValidateUtf8 also reject malformed utf-8 in raw bytes
+     * @return xState
+     */
+    template <bool ValidateUtf8 = false, class Sink>
+    static xState scanString(const char* p, const char** end, Sink* s) {
+        xState ret;
+        for (;;) {
+            char ch = *p++;
+            switch (ch) {
+            case '\"':
+                *end = p;
+                return xState::X_PARSE_OK;
+            case '\\':
+                if ((ret = scanEscape(&p, s)) != xState::X_PARSE_OK)
+                    return ret;
+                break;
+            case '\0':
+                return xState::X_PARSE_MISS_QUOTATION_MARK;
+            default:
+                if ((unsigned char)ch < 0x20)
+                    return xState::X_PARSE_INVALID_STRING_CHAR;
+                s->put(ch);
+                if (ValidateUtf8 && (unsigned char)ch >= 0x80) {
+                    const char* q = scanUtf8(p - 1);
+                    if (q == nullptr)
+                        return xState::X_PARSE_INVALID_UTF8;
+                    for (; p < q; p++)
+                        s->put(*p);
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief decode checked string text in place, escapes never grow.
+     * @param text body of a string that scanString accepted
+     * @param len length of text
+     * @return size_t the decoded length
+     */
+    static size_t unescape(char* text, size_t len) {
+        const char* p = text;
+        const char* end = text + len;
+        xPointerSink sink = { text };
+        while (p < end) {
+            if (*p == '\\') {
+                p++;
+                scanEscape(&p, &sink);
+            } else {
+                sink.put(*p++);
+            }
+        }
+        return sink.w - text;
+    }
+
+    static xState scanLiteral(const char* p, const char** end,
+        const char* literal) {
+        for (; *literal; literal++, p++)
+            if (*p != *literal)
+                return xState::X_PARSE_INVALID_VALUE;
+        *end = p;
+        return xState::X_PARSE_OK;
+    }
+
+    /**
+     * @brief check and step over one value of any type.
+     * @param p first character of the value
+     * @param end receives the first character after the value
+     * @return xState the same codes xParse reports
+     */
+    static xState skipValue(const char* p, const char** end) {
+        xState ret;
+        xNullSink sink;
+        switch (*p) {
+            case 't': return scanLiteral(p, end, "true");
+            case 'f': return scanLiteral(p, end, "false");
+            case 'n': return scanLiteral(p, end, "null");
+            case '"': return scanString(p + 1, end, &sink);
+            case '\0': return xState::X_PARSE_EXPECT_VALUE;
+            case '[':
+                p = skipWhiteSpace(p + 1);
+                if (*p == ']') {
+                    *end = p + 1;
+                    return xState::X_PARSE_OK;
+                }
+                for (;;) {
+                    if ((ret = skipValue(p, &p)) != xState::X_PARSE_OK)
+                        return ret;
+                    p = skipWhiteSpace(p);
+                    if (*p == ',') {
+                        p = skipWhiteSpace(p + 1);
+                    } else if (*p == ']') {
+                        *end = p + 1;
+                        return xState::X_PARSE_OK;
+                    } else {
+                        return xState::X_PARSE_MISS_COMMA_OR_SQUARE_BRACKET;
+                    }
+                }
+            case '{':
+                p = skipWhiteSpace(p + 1);
+                if (*p == '}') {
+                    *end = p + 1;
+                    return xState::X_PARSE_OK;
+                }
+                for (;;) {
+                    if (*p != '"')
+                        return xState::X_PARSE_MISS_KEY;
+                    if ((ret = scanString(p + 1, &p, &sink))
+                        != xState::X_PARSE_OK)
+                        return ret;
+                    p = skipWhiteSpace(p);
+                    if (*p != ':')
+                        return xState::X_PARSE_MISS_COLON;
+                    p = skipWhiteSpace(p + 1);
+                    if ((ret = skipValue(p, &p)) != xState::X_PARSE_OK)
+                        return ret;
+                    p = skipWhiteSpace(p);
+                    if (*p == ',') {
+                        p = skipWhiteSpace(p + 1);
+                    } else if (*p == '}') {
+                        *end = p + 1;
+                        return xState::X_PARSE_OK;
+                    } else {
+                        return xState::X_PARSE_MISS_COMMA_OR_CURLY_BRACKET;
+                    }
+                }
+            default: return scanNumber(p, end);
+        }
+    }
+};
+
+}  // namespace xJson
+
+#endif  //!__XJSON_LEXER__H__
@@ -0,0 +1,74 @@
+/* copyright 2021 xkxsxkx */
+#ifndef __XJSON_PATCH__H__
+#define __XJSON_PATCH__H__
+
+#include <stddef.h>
+#include "xjson.h"
+
+namespace xJson {
+
+enum class xPatchState {
+    X_PATCH_OK,
+    X_PATCH_INVALID_OPERATION,
+    X_PATCH_INVALID_POINTER,
+    X_PATCH_PATH_NOT_FOUND,
+    X_PATCH_TEST_FAILED
+};
+
+/** @fn xValue* xResolvePointer(const xValue* root, const char* pointer, size_t len)
+ * @brief resolve a rfc 6901 json pointer.
+ * @param root
+ * @param pointer "" is the root, "/a/0" the first element of member a
+ * @param len length of pointer
+ * @return xValue* the value or nullptr
+ */
+xValue* xResolvePointer(const xValue* root, const char* pointer, size_t len);
+
+/** @fn xPatchState xApplyPatch(xValue* doc, const xValue* patch, size_t* failed)
+ * @brief apply a rfc 6902 json patch to doc in place.
+ * only the containers named by the operations are modified, all other
+ * subtrees stay where they are. the patch is atomic: when an operation
+ * fails (including a failing test) every earlier operation is rolled
+ * back and doc is left exactly as it was.
+ * @param doc
+ * @param patch array of operation objects
+ * @param failed optional, receives the index of the failing operation
+ * @return xPatchState
+ */
+xPatchState xApplyPatch(xValue* doc, const xValue* patch, size_t* failed);
+
+/** @fn void xApplyMergePatch(xValue* doc, const xValue* patch)
+ * @brief apply a rfc 7386 merge patch to doc in place.
+ * @param doc
+ * @param patch
+ */
+void xApplyMergePatch(xValue* doc, const xValue* patch);
+
+struct xDiffOptions {
+    /* array elements are matched by this member when set, e.g. "id" */
+    const char* key = nullptr;
+    size_t klen = 0;
+    /* optional, reused across diffs against the same unmodified tree */
+    xHashCache* cache = nullptr;
+    /* largest lcs table (cells) before falling back to positional diff */
+    size_t lcsLimit = (size_t)1 << 22;
+};
+
+/** @fn void xDiff(xValue* patch, const xValue* from, const xValue* to, const xDiffOptions* options)
+ * @brief compute a json patch turning from into to.
+ * subtrees with equal structural hashes are skipped after one compare,
+ * objects are diffed by key, arrays by the longest common subsequence of
+ * their elements (or of their key members) after the common head and
+ * tail are stripped. changed elements at the same position are diffed
+ * recursively instead of being replaced.
+ * @param patch receives an array of operations for xApplyPatch
+ * @param from
+ * @param to
+ * @param options optional
+ */
+void xDiff(xValue* patch, const xValue* from, const xValue* to,
+    const xDiffOptions* options = nullptr);
+
+}  // namespace xJson
+
+#endif  //!__XJSON_PATCH__H__
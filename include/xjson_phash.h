@@ -0,0 +1,170 @@
+/* copyright 2021 xkxsxkx */
+#ifndef __XJSON_PHASH__H__
+#define __XJSON_PHASH__H__
+
+#include <assert.h>
+#include <stdint.h>
+#include <array>
+#include <string_view>
+#include "xjson.h"
+
+namespace xJson {
+
+/**
+ * @brief perfect hash over a key set fixed at compile time.
+ * the table is built in a constant expression by hash and displace, so
+ * lookups need no runtime setup: one fnv-1a over the key picks a bucket,
+ * the displacement stored for the bucket moves the hash to a slot, one
+ * compare confirms the key. buckets are placed largest first and each
+ * tries displacements until its keys land on free slots; with twice as
+ * many slots as keys that takes a few tries per bucket, so the search
+ * grows linearly with the key count. duplicate keys make the
+ * construction fail to compile.
+ *
+ *     static constexpr auto keys = xJson::xMakePerfectHash("id", "name");
+ *     size_t field = keys.find(k, klen);  // 0, 1 or X_KEY_NOT_EXIST
+ */
+template <size_t N>
+class xPerfectHash {
+ public:
+    static constexpr size_t kSlots = [] {
+        size_t slots = 2;
+        while (slots < 2 * N)
+            slots <<= 1;
+        return slots;
+    }();
+    /* two keys per bucket on average */
+    static constexpr size_t kBuckets = (N + 1) / 2;
+
+    constexpr explicit xPerfectHash(
+        const std::array<std::string_view, N>& keys)
+        : keys(keys), slots(), displace() {
+        static_assert(N > 0 && N < 0xFFFF, "unsupported key count");
+        std::array<uint32_t, N> h{};
+        std::array<uint16_t, N> order{};        /* keys grouped by bucket */
+        std::array<size_t, kBuckets + 1> first{};
+        size_t i = 0, b = 0, count = 0, most = 0;
+        for (i = 0; i < N; i++) {
+            h[i] = hashOf(keys[i].data(), keys[i].size());
+            first[bucketOf(h[i]) + 1]++;
+        }
+        for (b = 0; b < kBuckets; b++) {
+            if (first[b + 1] > most)
+                most = first[b + 1];
+            first[b + 1] += first[b];
+        }
+        std::array<size_t, kBuckets> fill{};
+        for (i = 0; i < N; i++) {
+            b = bucketOf(h[i]);
+            order[first[b] + fill[b]++] = (uint16_t)i;
+        }
+        for (count = most; count > 0; count--) {
+            for (b = 0; b < kBuckets; b++) {
+                if (first[b + 1] - first[b] == count
+                    && !place(b, &order[first[b]], count, h))
+                    throw "no perfect hash found, are the keys unique?";
+            }
+        }
+    }
+
+    /**
+     * @brief map a key to its position in the key list.
+     * @return size_t index of the key or X_KEY_NOT_EXIST
+     */
+    constexpr size_t find(const char* key, size_t len) const {
+        uint32_t h = hashOf(key, len);
+        uint16_t slot = slots[slotOf(h, displace[bucketOf(h)])];
+        if (slot == 0 || keys[slot - 1] != std::string_view(key, len))
+            return X_KEY_NOT_EXIST;
+        return slot - 1;
+    }
+
+    /**
+     * @brief pick the values of all known keys from an object in one pass.
+     * @param o an X_TYPE_OBJECT value
+     * @param values values[i] receives the value of key i or nullptr,
+     * the first occurrence wins on duplicated keys
+     * @return size_t number of keys found
+     */
+    size_t collect(const xValue* o, xValue* values[N]) const {
+        size_t i, found = 0;
+        assert(o != nullptr && o->type == xType::X_TYPE_OBJECT);
+        for (i = 0; i < N; i++)
+            values[i] = nullptr;
+        for (i = 0; i < o->object.size && found < N; i++) {
+            xMember* m = &o->object.m[i];
+            size_t index = find(m->k, m->klen);
+            if (index != X_KEY_NOT_EXIST && values[index] == nullptr) {
+                values[index] = &m->v;
+                found++;
+            }
+        }
+        return found;
+    }
+
+    constexpr const std::string_view& key(size_t index) const {
+        return keys[index];
+    }
+    static constexpr size_t size() { return N; }
+
+ private:
+    std::array<std::string_view, N> keys;
+    uint16_t slots[kSlots];
+    uint16_t displace[kBuckets];
+
+    static constexpr uint32_t hashOf(const char* key, size_t len) {
+        uint32_t h = 2166136261u;
+        for (size_t i = 0; i < len; i++)
+            h = (h ^ (unsigned char)key[i]) * 16777619u;
+        return h;
+    }
+
+    static constexpr size_t bucketOf(uint32_t h) {
+        return (size_t)(((uint64_t)h * kBuckets) >> 32);
+    }
+
+    static constexpr size_t slotOf(uint32_t h, uint16_t d) {
+        h ^= d * 0x9E3779B1u;
+        h ^= h >> 16;
+        h *= 0x85EBCA6Bu;
+        h ^= h >> 13;
+        h *= 0xC2B2AE35u;
+        h ^= h >> 16;
+        return h & (kSlots - 1);
+    }
+
+    /**
+     * @brief find a displacement that puts the count keys of bucket b on
+     * free slots, and take them.
+     */
+    constexpr bool place(size_t b, const uint16_t* bucket, size_t count,
+        const std::array<uint32_t, N>& h) {
+        size_t i = 0, s = 0;
+        for (uint32_t d = 0; d <= 0xFFFF; d++) {
+            for (i = 0; i < count; i++) {
+                s = slotOf(h[bucket[i]], (uint16_t)d);
+                if (slots[s] != 0)
+                    break;
+                slots[s] = (uint16_t)(bucket[i] + 1);
+            }
+            if (i == count) {
+                displace[b] = (uint16_t)d;
+                return true;
+            }
+            while (i-- > 0)
+                slots[slotOf(h[bucket[i]], (uint16_t)d)] = 0;
+        }
+        return false;
+    }
+};
+
+template <class... Keys>
+constexpr xPerfectHash<sizeof...(Keys)> xMakePerfectHash(Keys... keys) {
+    return xPerfectHash<sizeof...(Keys)>(
+        std::array<std::string_view, sizeof...(Keys)>{
+            std::string_view(keys)... });
+}
+
+}  // namespace xJson
+
+#endif  //!__XJSON_PHASH__H__
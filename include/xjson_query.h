@@ -0,0 +1,108 @@
+/* copyright 2021 xkxsxkx */
+#ifndef __XJSON_QUERY__H__
+#define __XJSON_QUERY__H__
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include "xjson.h"
+
+namespace xJson {
+
+enum class xQueryState {
+    X_QUERY_OK,
+    X_QUERY_INVALID,        /* malformed expression */
+    X_QUERY_UNSUPPORTED     /* valid jq outside the compiled subset */
+};
+
+/** one step of a path: .name, [index] or [] */
+struct xQueryStep {
+    enum Kind { FIELD, INDEX, ITERATE } kind;
+    std::string name;       /* decoded member name */
+    size_t index;
+};
+
+/** a literal operand of a comparison */
+struct xQueryLiteral {
+    xType type;
+    double n;
+    std::string s;          /* decoded string */
+};
+
+/**
+ * @brief node of a select() condition, the operands of and/or are the
+ * indices of other nodes of the same plan.
+ */
+struct xQueryCond {
+    enum Op { TRUTHY, EQ, NE, LT, LE, GT, GE, AND, OR } op;
+    std::vector<xQueryStep> path;
+    xQueryLiteral literal;
+    size_t lhs, rhs;
+};
+
+/** a member of an object construction, key: path */
+struct xQueryField {
+    std::string key;        /* escaped, ready to be written */
+    std::vector<xQueryStep> path;
+};
+
+/** one filter of the pipeline */
+struct xQueryStage {
+    enum Kind { PATH, SELECT, OBJECT } kind;
+    std::vector<xQueryStep> path;
+    size_t cond;            /* root node of a select */
+    std::vector<xQueryField> fields;
+};
+
+/**
+ * @brief a jq-like filter compiled once into a plan of stages and run
+ * over json text without building a tree.
+ * supported: paths (., .a, ."a b", .[2], .[], .a[].b), select() with
+ * ==, !=, <, <=, >, >= between a path and a scalar literal, bare paths
+ * (truthiness), and, or and parentheses, object construction
+ * ({id, price, name: .a.b}) and pipes between them.
+ *
+ * values are text ranges of the input: members that no stage asks for
+ * are skipped with a scan, only the scalars that a condition compares
+ * are decoded. a step that does not apply (.a of an array, [0] of a
+ * string) yields null and [] of a scalar yields nothing, like jq's ?.
+ *
+ *     xQuery q;
+ *     q.compile(".items[] | select(.price > 10) | {id, price}");
+ *     q.run(ndjson, len, &out);
+ */
+class xQuery {
+ private:
+    std::vector<xQueryStage> stages;
+    std::vector<xQueryCond> conds;
+
+ public:
+    /**
+     * @brief compile expr, the old plan is dropped.
+     * @param expr c-type string
+     * @param offset optional, receives the position of the error
+     * @return xQueryState
+     */
+    xQueryState compile(const char* expr, size_t* offset = nullptr);
+
+    /**
+     * @brief run the plan over a sequence of json texts, such as ndjson
+     * or one large document. every result is written minified and
+     * followed by a line break.
+     * @param data
+     * @param len
+     * @param out receives the results in chunks
+     * @param count optional, receives the number of results
+     * @param offset optional, receives the position of the error, or len
+     * @return xState the input is checked as by xValidate, results
+     * before the error have been written
+     */
+    xState run(const char* data, size_t len, const xWriter* out,
+        size_t* count = nullptr, size_t* offset = nullptr) const;
+
+    const std::vector<xQueryStage>& plan() const { return stages; }
+};
+
+}  // namespace xJson
+
+#endif  //!__XJSON_QUERY__H__
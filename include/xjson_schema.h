@@ -0,0 +1,168 @@
+/* copyright 2021 xkxsxkx */
+#ifndef __XJSON_SCHEMA__H__
+#define __XJSON_SCHEMA__H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <memory>
+#include <string>
+#include <vector>
+#include "xjson.h"
+
+namespace xJson {
+
+enum class xSchemaState {
+    X_SCHEMA_OK,
+    X_SCHEMA_INVALID,       /* malformed keyword value */
+    X_SCHEMA_UNSUPPORTED    /* keyword that cannot be compiled ($ref ...) */
+};
+
+/** bits of xSchemaNode::types */
+enum xSchemaType : unsigned {
+    X_SCHEMA_NULL = 1u << 0,
+    X_SCHEMA_BOOLEAN = 1u << 1,
+    X_SCHEMA_INTEGER = 1u << 2,
+    X_SCHEMA_NUMBER = 1u << 3,
+    X_SCHEMA_STRING = 1u << 4,
+    X_SCHEMA_ARRAY = 1u << 5,
+    X_SCHEMA_OBJECT = 1u << 6,
+    X_SCHEMA_ANY = (1u << 7) - 1
+};
+
+/** bits of xSchemaNode::checks, only the set checks are evaluated */
+enum xSchemaCheck : unsigned {
+    X_SCHEMA_CHECK_MINIMUM = 1u << 0,
+    X_SCHEMA_CHECK_MAXIMUM = 1u << 1,
+    X_SCHEMA_CHECK_EXCLUSIVE_MINIMUM = 1u << 2,
+    X_SCHEMA_CHECK_EXCLUSIVE_MAXIMUM = 1u << 3,
+    X_SCHEMA_CHECK_LENGTH = 1u << 4,
+    X_SCHEMA_CHECK_ITEMS = 1u << 5,
+    X_SCHEMA_CHECK_PROPERTIES = 1u << 6,
+    X_SCHEMA_CHECK_ENUM = 1u << 7,
+    X_SCHEMA_CHECK_BASE64 = 1u << 8     /* contentEncoding base64 */
+};
+
+struct xSchemaNode;
+
+struct xSchemaKey {
+    std::string name;
+    uint32_t hash;              /* xHashKey of name */
+    uint32_t required;          /* bit index among required keys or -1 */
+    const xSchemaNode* node;
+};
+
+/**
+ * @brief one compiled schema. every keyword is flattened into a field,
+ * the properties of an object schema into an open addressing table.
+ * a nullptr node accepts anything.
+ */
+struct xSchemaNode {
+    unsigned types = X_SCHEMA_ANY;
+    unsigned checks = 0;
+    double minimum = 0, maximum = 0;
+    double exclusiveMinimum = 0, exclusiveMaximum = 0;
+    size_t minLength = 0, maxLength = (size_t)-1;     /* code points */
+    size_t minItems = 0, maxItems = (size_t)-1;
+    size_t minProperties = 0, maxProperties = (size_t)-1;
+    const xSchemaNode* items = nullptr;
+    const xSchemaNode* additional = nullptr;    /* other members */
+    std::vector<xSchemaKey> keys;
+    std::vector<uint32_t> slots;    /* key index + 1, 0 is empty */
+    uint32_t requiredCount = 0;
+    std::vector<xValue> values;     /* enum and const */
+
+    /**
+     * @brief the property entry of key.
+     * @return const xSchemaKey* nullptr when key is not a property
+     */
+    const xSchemaKey* find(const char* key, size_t len) const {
+        return find(key, len, xHashKey(key, len));
+    }
+
+    /**
+     * @brief as find, with the xHashKey of key already at hand, as in
+     * xMember::hash.
+     */
+    const xSchemaKey* find(const char* key, size_t len, uint32_t h) const {
+        uint32_t mask, i;
+        if (slots.empty())
+            return nullptr;
+        mask = (uint32_t)slots.size() - 1;
+        for (i = h & mask; slots[i] != 0; i = (i + 1) & mask) {
+            const xSchemaKey* k = &keys[slots[i] - 1];
+            if (k->hash == h && k->name.size() == len
+                && memcmp(k->name.data(), key, len) == 0)
+                return k;
+        }
+        return nullptr;
+    }
+
+    ~xSchemaNode();
+};
+
+/**
+ * @brief where and why a document failed its schema.
+ */
+struct xSchemaError {
+    std::string path;       /* json pointer of the failing value */
+    const char* keyword;    /* "type", "required", "maximum" ... */
+    size_t offset;          /* start of the value, or its closing bracket */
+};
+
+/**
+ * @brief a json schema compiled once for repeated validation.
+ * supported: type, enum, const, minimum, maximum, exclusiveMinimum,
+ * exclusiveMaximum, minLength, maxLength, items (one schema), minItems,
+ * maxItems, properties, required, additionalProperties, minProperties,
+ * maxProperties, contentEncoding and boolean schemas. annotations are
+ * ignored, keywords that would change the result but are not supported
+ * fail to compile.
+ */
+class xSchema {
+ private:
+    std::vector<std::unique_ptr<xSchemaNode>> nodes;
+    const xSchemaNode* top;
+
+ public:
+    xSchema() : top(nullptr) {}
+    xSchema(xSchema&&) = default;
+    xSchema& operator=(xSchema&&) = default;
+    xSchema(const xSchema&) = delete;
+    xSchema& operator=(const xSchema&) = delete;
+
+    /**
+     * @brief compile a parsed schema, the old one is dropped.
+     * @param schema
+     * @param error optional, receives the json pointer of the bad keyword
+     * @return xSchemaState
+     */
+    xSchemaState compile(const xValue* schema, std::string* error = nullptr);
+
+    const xSchemaNode* root() const { return top; }
+
+ private:
+    const xSchemaNode* compileNode(const xValue* schema, std::string* path,
+        xSchemaState* state);
+};
+
+/** @fn xState xParseWithSchema(xValue* v, const char* json, const xSchema& schema, xSchemaError* error)
+ * @brief parse json and validate it against schema in the same pass.
+ * each value is checked as soon as it is read, a container is refused
+ * on its first character when its type is not allowed, so an invalid
+ * document stops the parse early and no tree is left behind.
+ * a string under "contentEncoding": "base64" is decoded into its bytes
+ * (X_VALUE_FLAG_BINARY, see xHelper::xGetBinary) as it is read, text
+ * that is not base64 fails with the keyword "contentEncoding".
+ * @param v
+ * @param json json text as c-type string
+ * @param schema compiled schema
+ * @param error optional, filled on X_PARSE_SCHEMA_MISMATCH
+ * @return xState X_PARSE_SCHEMA_MISMATCH when the document is invalid
+ */
+xState xParseWithSchema(xValue* v, const char* json, const xSchema& schema,
+    xSchemaError* error = nullptr);
+
+}  // namespace xJson
+
+#endif  //!__XJSON_SCHEMA__H__
@@ -0,0 +1,137 @@
+/* copyright 2021 xkxsxkx */
+#ifndef __XJSON_SHARED__H__
+#define __XJSON_SHARED__H__
+
+#include <stddef.h>
+#include <atomic>
+#include <mutex>
+#include "xjson.h"
+#include "xjson_patch.h"
+
+namespace xJson {
+
+struct xSharedRoot;
+class xSharedSlot;
+
+/**
+ * @brief immutable, reference counted json document.
+ * the element and member arrays, keys and string texts of the tree carry
+ * a reference count and are shared between documents: set() and remove()
+ * copy only the arrays on the path from the root to the changed value,
+ * every other subtree and every key or text is shared with the source
+ * version. copying a document only takes a
+ * reference, so any number of threads may read the same version through
+ * value() without locking. lazy strings are decoded when a tree is
+ * shared, so reading never writes to it.
+ *
+ *     xSharedDocument next;
+ *     if (config.set(&next, "/limits/workers", 15, &workers)
+ *         == xPatchState::X_PATCH_OK)
+ *         slot.store(next);
+ */
+class xSharedDocument {
+ private:
+    xSharedRoot* root;
+
+    friend class xSharedSlot;
+
+ public:
+    /** the empty document, value() is null */
+    xSharedDocument();
+    /**
+     * @brief share a deep copy of v.
+     * @param v
+     * @param allocator every block of this and of the derived versions
+     * comes from it, nullptr uses the allocator active at each call
+     */
+    explicit xSharedDocument(const xValue* v,
+        const xAllocator* allocator = nullptr);
+    ~xSharedDocument();
+    xSharedDocument(const xSharedDocument& other) noexcept;
+    xSharedDocument& operator=(const xSharedDocument& other) noexcept;
+    xSharedDocument(xSharedDocument&& other) noexcept;
+    xSharedDocument& operator=(xSharedDocument&& other) noexcept;
+
+    /**
+     * @brief a new version with value at pointer.
+     * an existing value is replaced, a missing member of an object is
+     * added and "-" appends to an array. this version is not modified.
+     * @param next receives the new version
+     * @param pointer rfc 6901 json pointer, "" replaces the root
+     * @param len length of pointer
+     * @param value copied into the new version
+     * @return xPatchState next is left untouched on failure
+     */
+    xPatchState set(xSharedDocument* next, const char* pointer, size_t len,
+        const xValue* value) const;
+
+    /**
+     * @brief a new version without the value at pointer.
+     * @param next receives the new version
+     * @param pointer rfc 6901 json pointer of a member or an element
+     * @param len length of pointer
+     * @return xPatchState next is left untouched on failure
+     */
+    xPatchState remove(xSharedDocument* next, const char* pointer,
+        size_t len) const;
+
+    const xValue* value() const;
+
+    bool operator==(const xSharedDocument& other) const {
+        return root == other.root;
+    }
+    bool operator!=(const xSharedDocument& other) const {
+        return root != other.root;
+    }
+
+    void swap(xSharedDocument& other) noexcept {
+        xSharedRoot* r = root;
+        root = other.root;
+        other.root = r;
+    }
+};
+
+/**
+ * @brief the published version of a shared document.
+ * load() never blocks: it announces itself on one of two reader counters,
+ * reads the root pointer and takes a reference. a publisher swaps the
+ * pointer, then flips the reader epoch twice and waits for each counter
+ * to drain before it releases the old version, so the version a reader
+ * is about to retain is never freed under it. publishers are serialized
+ * by a mutex that readers never touch.
+ * a reader keeps the version it loaded for as long as it holds it.
+ */
+class xSharedSlot {
+ private:
+    std::atomic<xSharedRoot*> current;
+    mutable std::atomic<size_t> readers[2];
+    std::atomic<size_t> epoch;
+    std::mutex publish;
+
+    void quiesce();
+
+ public:
+    xSharedSlot();
+    explicit xSharedSlot(xSharedDocument doc);
+    ~xSharedSlot();
+    xSharedSlot(const xSharedSlot&) = delete;
+    xSharedSlot& operator=(const xSharedSlot&) = delete;
+
+    /** @brief the current version */
+    xSharedDocument load() const;
+
+    /** @brief publish doc, readers that loaded earlier keep their version */
+    void store(xSharedDocument doc);
+
+    /**
+     * @brief publish next only if expected is still current, for several
+     * publishers deriving versions from load().
+     * @return bool false when another version was published meanwhile
+     */
+    bool compareExchange(const xSharedDocument& expected,
+        xSharedDocument next);
+};
+
+}  // namespace xJson
+
+#endif  //!__XJSON_SHARED__H__
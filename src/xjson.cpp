@@ -1,14 +1,32 @@
 /*copyright 2021 xkxsxkx*/
 #include "xjson.h"
+#include "xjson_base64.h"
+#include "xjson_batch.h"
+#include "xjson_file.h"
+#include "xjson_lexer.h"
+#include "xjson_scan.h"
+#include "xjson_schema.h"
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
 #include <iostream>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/uio.h>
+#endif
 
 using xJson::xValue;
 using xJson::xState;
 using xJson::xType;
 using xJson::xHelper;
 using xJson::xMember;
+using xJson::xLexer;
+using xJson::xStrictPolicy;
 
 #ifndef X_PARSE_STACK_INIT_SIZE
 #define X_PARSE_STACK_INIT_SIZE 256
@@ -18,47 +36,500 @@ using xJson::xMember;
 #define X_PARSE_STRINGIFY_INIT_SIZE 256
 #endif
 
+/* frames of xFree and xStringify kept on the C stack before spilling */
+#ifndef X_WALK_STACK_INIT_SIZE
+#define X_WALK_STACK_INIT_SIZE 64
+#endif
+
 #define EXPECT(c, ch) do { assert(*c->json == (ch)); c->json++;} while (0)
-#define ISDIGIT(ch) ((ch) >= '0' && (ch) <= '9')
-#define ISDIGIT1TO9(ch) ((ch) >= '1' && (ch) <= '9')
+
+static void* xMallocHook(void*, size_t size) {
+    return malloc(size);
+}
+
+static void* xReallocHook(void*, void* p, size_t, size_t size) {
+    return realloc(p, size);
+}
+
+static void xFreeHook(void*, void* p, size_t) {
+    free(p);
+}
+
+static const xJson::xAllocator xMallocAllocator = {
+    xMallocHook, xReallocHook, xFreeHook, nullptr
+};
+static const xJson::xAllocator* xDefaultAllocator = &xMallocAllocator;
+static thread_local const xJson::xAllocator* xActiveAllocator = nullptr;
+static thread_local xJson::xAllocStats* xActiveStats = nullptr;
+
+static inline const xJson::xAllocator* xCurrentAllocator() {
+    return xActiveAllocator != nullptr ? xActiveAllocator : xDefaultAllocator;
+}
+
+static void xAccount(xJson::xAllocStats* s, size_t grow, size_t shrink) {
+    s->bytes += grow;
+    s->live += (ptrdiff_t)grow - (ptrdiff_t)shrink;
+    if (s->live > 0 && (size_t)s->live > s->peak)
+        s->peak = (size_t)s->live;
+}
+
+/**
+ * @brief every block of the library goes through these three, plain
+ * malloc without stats skips the indirect call.
+ */
+static inline void* xAllocate(size_t size) {
+    const xJson::xAllocator* a = xCurrentAllocator();
+    if (xActiveStats != nullptr) {
+        xActiveStats->allocs++;
+        xAccount(xActiveStats, size, 0);
+    } else if (a == &xMallocAllocator) {
+        return malloc(size);
+    }
+    return a->alloc(a->ctx, size);
+}
+
+static inline void* xReallocate(void* p, size_t oldSize, size_t size) {
+    const xJson::xAllocator* a = xCurrentAllocator();
+    if (xActiveStats != nullptr) {
+        if (p == nullptr)
+            xActiveStats->allocs++;
+        else
+            xActiveStats->reallocs++;
+        xAccount(xActiveStats, size > oldSize ? size - oldSize : 0,
+            size < oldSize ? oldSize - size : 0);
+    } else if (a == &xMallocAllocator) {
+        return realloc(p, size);
+    }
+    if (p == nullptr)
+        return a->alloc(a->ctx, size);
+    return a->realloc(a->ctx, p, oldSize, size);
+}
+
+static inline void xDeallocate(void* p, size_t size) {
+    const xJson::xAllocator* a = xCurrentAllocator();
+    if (p == nullptr)
+        return;
+    if (xActiveStats != nullptr) {
+        xActiveStats->frees++;
+        xActiveStats->live -= (ptrdiff_t)size;
+    } else if (a == &xMallocAllocator) {
+        free(p);
+        return;
+    }
+    a->free(a->ctx, p, size);
+}
+
+const xJson::xAllocator* xJson::xSetDefaultAllocator(
+    const xAllocator* allocator) {
+    const xAllocator* old = xDefaultAllocator;
+    xDefaultAllocator = allocator != nullptr ? allocator : &xMallocAllocator;
+    return old;
+}
+
+xJson::xAllocatorScope::xAllocatorScope(const xAllocator* allocator,
+    xAllocStats* stats) {
+    this->allocator = xActiveAllocator;
+    this->stats = xActiveStats;
+    if (allocator != nullptr)
+        xActiveAllocator = allocator;
+    if (stats != nullptr)
+        xActiveStats = stats;
+}
+
+xJson::xAllocatorScope::~xAllocatorScope() {
+    xActiveAllocator = this->allocator;
+    xActiveStats = this->stats;
+}
+
+void* xJson::xAlloc(size_t size) {
+    return xAllocate(size);
+}
+
+void* xJson::xRealloc(void* p, size_t oldSize, size_t newSize) {
+    return xReallocate(p, oldSize, newSize);
+}
+
+void xJson::xDealloc(void* p, size_t size) {
+    xDeallocate(p, size);
+}
+
+/** both dense layouts, elements are 8 bytes either way */
+#define X_DENSE_FLAGS \
+    (xJson::X_VALUE_FLAG_DENSE_DOUBLE | xJson::X_VALUE_FLAG_DENSE_INT64)
+
+/**
+ * @brief explicit stack of the containers being walked, so that nesting
+ * costs no C stack. the first frames live inline, deeper ones in a block
+ * of the current allocator grown like the xContext stack.
+ */
+template <class T>
+class xWalkStack {
+ public:
+    xWalkStack() : base(small), top(0), cap(X_WALK_STACK_INIT_SIZE) {}
+    ~xWalkStack() {
+        if (base != small)
+            xDeallocate(base, cap * sizeof(T));
+    }
+    xWalkStack(const xWalkStack&) = delete;
+    xWalkStack& operator=(const xWalkStack&) = delete;
+
+    T* push() {
+        T* p;
+        if (top == cap) {
+            p = (T*)xAllocate(cap * 2 * sizeof(T));
+            memcpy(p, base, cap * sizeof(T));
+            if (base != small)
+                xDeallocate(base, cap * sizeof(T));
+            base = p;
+            cap *= 2;
+        }
+        return &base[top++];
+    }
+    /** @return T* nullptr when empty */
+    T* back() { return top > 0 ? &base[top - 1] : nullptr; }
+    void pop() { top--; }
+    T* at(size_t i) { return &base[i]; }
+    size_t size() const { return top; }
+    /** @brief drop the entries from n on */
+    void truncate(size_t n) {
+        assert(n <= top);
+        top = n;
+    }
+
+ private:
+    T small[X_WALK_STACK_INIT_SIZE];
+    T* base;
+    size_t top, cap;
+};
+
+/**
+ * @brief xDeallocate for the many blocks of one teardown, the allocator
+ * and the stats are looked up once instead of per block.
+ */
+class xReleaser {
+ public:
+    xReleaser() : a(xCurrentAllocator()),
+        plain(xActiveStats == nullptr && a == &xMallocAllocator),
+        direct(xActiveStats == nullptr) {}
+    void operator()(void* p, size_t size) const {
+        if (plain)
+            free(p);
+        else if (!direct)
+            xDeallocate(p, size);
+        else if (p != nullptr)
+            a->free(a->ctx, p, size);
+    }
+
+ private:
+    const xJson::xAllocator* a;
+    bool plain, direct;
+};
+
+/** a container whose children are being released */
+typedef struct {
+    void* block;        /* xValue[] or xMember[] */
+    size_t len, i;
+    bool object;
+} xFreeFrame;
+
+/** @fn void xFreeValue(const xReleaser& release, xWalkStack<xFreeFrame>* stack, xValue* v)
+ * @brief release what v holds directly, a container with children is
+ * pushed to be walked instead.
+ */
+static inline void xFreeValue(const xReleaser& release,
+    xWalkStack<xFreeFrame>* stack, xValue* v) {
+    xFreeFrame* f;
+    switch (v->type) {
+        case xType::X_TYPE_NUMBER:
+            if ((v->flags & xJson::X_VALUE_FLAG_RAW_NUMBER)
+                && !(v->flags & xJson::X_VALUE_FLAG_BORROWED))
+                release(v->str.s, v->str.len + 1);
+            break;
+        case xType::X_TYPE_STRING:
+            if (!(v->flags & xJson::X_VALUE_FLAG_BORROWED))
+                release(v->str.s, v->str.len + 1);
+            break;
+        case xType::X_TYPE_ARRAY:
+            if (v->flags & X_DENSE_FLAGS) {
+                release(v->dense.d, v->dense.len * 8);
+            } else if (v->array.len == 0) {
+                release(v->array.e, 0);
+            } else {
+                f = stack->push();
+                f->block = v->array.e;
+                f->len = v->array.len;
+                f->i = 0;
+                f->object = false;
+            }
+            break;
+        case xType::X_TYPE_OBJECT:
+            if (v->object.size == 0) {
+                release(v->object.m, 0);
+            } else {
+                f = stack->push();
+                f->block = v->object.m;
+                f->len = v->object.size;
+                f->i = 0;
+                f->object = true;
+            }
+            break;
+        default: break;
+    }
+}
 
 /** @fn void xFree(xValue* v)
- * @brief 
+ * @brief release everything v holds and set it to null.
+ * the tree is walked depth first with an explicit stack, an element or
+ * member array is released once all its children are.
  * @param v 
  */
 static void xFree(xValue* v) {
-    size_t i;
+    xFreeFrame* f;
     assert(v != nullptr);
-    switch (v->type) {
+    if (v->type < xType::X_TYPE_ARRAY) {
+        /* scalars never touch the stack */
+        xFreeValue(xReleaser(), nullptr, v);
+    } else {
+        xReleaser release;
+        xWalkStack<xFreeFrame> stack;
+        xFreeValue(release, &stack, v);
+        while ((f = stack.back()) != nullptr) {
+            if (f->i == f->len) {
+                release(f->block,
+                    f->len * (f->object ? sizeof(xMember) : sizeof(xValue)));
+                stack.pop();
+            } else if (f->object) {
+                xMember* m = (xMember*)f->block + f->i++;
+                if (!(m->flags & xJson::X_VALUE_FLAG_BORROWED))
+                    release(m->k, m->klen + 1);
+                xFreeValue(release, &stack, &m->v);
+            } else {
+                xFreeValue(release, &stack, (xValue*)f->block + f->i++);
+            }
+        }
+    }
+    v->type = xType::X_TYPE_NULL;
+    v->flags = 0;
+}
+
+/** @fn bool xOwnsBlock(const xValue* v)
+ * @brief whether a copy of v needs more than its 24 bytes.
+ */
+static inline bool xOwnsBlock(const xValue* v) {
+    return v->type >= xType::X_TYPE_STRING
+        || (v->flags & xJson::X_VALUE_FLAG_RAW_NUMBER);
+}
+
+/** @fn void xCopyValue(xValue* dst, const xValue* src)
+ * @brief deep copy src into the uninitialized dst.
+ * element and member arrays are duplicated in bulk, then only the
+ * children that own memory are fixed up.
+ * @param dst 
+ * @param src 
+ */
+static void xCopyValue(xValue* dst, const xValue* src) {
+    size_t i, size;
+    *dst = *src;
+    dst->flags &= ~xJson::X_VALUE_FLAG_BORROWED;
+    switch (src->type) {
+        case xType::X_TYPE_NUMBER:
+            if (!(src->flags & xJson::X_VALUE_FLAG_RAW_NUMBER))
+                break;
+            /* borrowed text is not terminated */
+            dst->str.s = (char*)xAllocate(src->str.len + 1);
+            memcpy(dst->str.s, src->str.s, src->str.len);
+            dst->str.s[src->str.len] = '\0';
+            break;
         case xType::X_TYPE_STRING:
-            free(v->str.s);
+            dst->str.s = (char*)xAllocate(src->str.len + 1);
+            memcpy(dst->str.s, src->str.s, src->str.len + 1);
             break;
         case xType::X_TYPE_ARRAY:
-            for (i = 0; i < v->array.len; i++)
-                xFree(&v->array.e[i]);
-            free(v->array.e);
+            if (src->array.len == 0)
+                break;
+            if (src->flags & X_DENSE_FLAGS) {
+                size = src->dense.len * 8;
+                memcpy(dst->dense.d = (double*)xAllocate(size),
+                    src->dense.d, size);
+                break;
+            }
+            size = src->array.len * sizeof(xValue);
+            memcpy(dst->array.e = (xValue*)xAllocate(size), src->array.e, size);
+            for (i = 0; i < src->array.len; i++)
+                if (xOwnsBlock(&src->array.e[i]))
+                    xCopyValue(&dst->array.e[i], &src->array.e[i]);
             break;
         case xType::X_TYPE_OBJECT:
-            for (i = 0; i < v->object.size; i++) {
-                free(v->object.m[i].k);
-                xFree(&v->object.m[i].v);
+            if (src->object.size == 0)
+                break;
+            size = src->object.size * sizeof(xMember);
+            memcpy(dst->object.m = (xMember*)xAllocate(size),
+                src->object.m, size);
+            for (i = 0; i < src->object.size; i++) {
+                xMember* dm = &dst->object.m[i];
+                const xMember* sm = &src->object.m[i];
+                memcpy(dm->k = (char*)xAllocate(sm->klen + 1),
+                    sm->k, sm->klen + 1);
+                dm->flags &= ~xJson::X_VALUE_FLAG_BORROWED;
+                if (xOwnsBlock(&sm->v))
+                    xCopyValue(&dm->v, &sm->v);
             }
-            free(v->object.m);
             break;
         default: break;
     }
-    v->type = xType::X_TYPE_NULL;
+}
+
+/** @fn void xShrink(void** p, size_t len, size_t newLen, size_t size)
+ * @brief keep an element or member array exactly sized after removals.
+ */
+static void xShrink(void** p, size_t len, size_t newLen, size_t size) {
+    if (newLen == 0) {
+        xDeallocate(*p, len * size);
+        *p = nullptr;
+    } else {
+        *p = xReallocate(*p, len * size, newLen * size);
+    }
+}
+
+/** @fn uint32_t xKeyHash(const char* key, size_t klen)
+ * @brief hash of a member key, eight bytes at a time.
+ */
+static inline uint32_t xKeyHash(const char* key, size_t klen) {
+    uint64_t h = 0x9e3779b97f4a7c15ULL ^ klen;
+    uint64_t w;
+    for (; klen >= 8; key += 8, klen -= 8) {
+        memcpy(&w, key, 8);
+        h = (h ^ w) * 0xff51afd7ed558ccdULL;
+        h ^= h >> 32;
+    }
+    if (klen > 0) {
+        w = 0;
+        memcpy(&w, key, klen);
+        h = (h ^ w) * 0xff51afd7ed558ccdULL;
+    }
+    h ^= h >> 29;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    return (uint32_t)(h >> 32);
+}
+
+uint32_t xJson::xHashKey(const char* key, size_t klen) {
+    assert(key != nullptr || klen == 0);
+    return xKeyHash(key, klen);
+}
+
+/** @brief byte order of keys, a prefix sorts first */
+static inline bool xKeyLess(const char* a, size_t alen,
+    const char* b, size_t blen) {
+    int r = memcmp(a, b, alen < blen ? alen : blen);
+    return r < 0 || (r == 0 && alen < blen);
+}
+
+static inline bool xMemberLess(const xMember& a, const xMember& b) {
+    return xKeyLess(a.k, a.klen, b.k, b.klen);
+}
+
+/** @fn void xSortMembers(xValue* v)
+ * @brief sort the members of the object v by key and mark it sorted,
+ * input that is already in order is only checked.
+ */
+static void xSortMembers(xValue* v) {
+    xMember* m = v->object.m;
+    xMember* end = m + v->object.size;
+    if (!std::is_sorted(m, end, xMemberLess))
+        std::stable_sort(m, end, xMemberLess);
+    v->flags |= xJson::X_VALUE_FLAG_SORTED_KEYS;
 }
 
 // #define xSetNull(v) xFree(v)
-#define xInit(v) do { (v)->type = xType::X_TYPE_NULL; } while (0)
+#define xInit(v) do { (v)->type = xType::X_TYPE_NULL; (v)->flags = 0; } while (0)
 
 typedef struct {
     const char* json;
     char* stack;
     size_t size, top;
+    unsigned depth;
+    xJson::xStats* stats;
+    /* schema checks, only read by a Checked parse */
+    const char* begin;
+    const xJson::xSchemaNode* node;
+    xJson::xSchemaError* error;
 } xContext;
 
+static thread_local xJson::xStats* xActiveCounters = nullptr;
+static thread_local const xJson::xTracer* xActiveTracer = nullptr;
+static thread_local bool xActiveTiming = false;
+
+#if X_JSON_STATS
+#define X_STAT(c, stmt)\
+    do { xJson::xStats* s = (c)->stats; if (s != nullptr) { stmt; } } while (0)
+#else
+#define X_STAT(c, stmt) do {} while (0)
+#endif
+
+xJson::xStatsScope::xStatsScope(xStats* stats, bool timing,
+    const xTracer* tracer) {
+    assert(stats != nullptr);
+    this->stats = xActiveCounters;
+    this->tracer = xActiveTracer;
+    this->timing = xActiveTiming;
+    xActiveCounters = stats;
+    xActiveTracer = tracer;
+    xActiveTiming = timing || tracer != nullptr;
+}
+
+xJson::xStatsScope::~xStatsScope() {
+    xActiveCounters = this->stats;
+    xActiveTracer = this->tracer;
+    xActiveTiming = this->timing;
+}
+
+#if X_JSON_STATS
+/** @fn size_t xCountEscapes(const char* p, const char* end)
+ * @brief escape sequences in an escaped string body.
+ */
+static size_t xCountEscapes(const char* p, const char* end) {
+    size_t n = 0;
+    while (p < end) {
+        if (*p == '\\') {
+            n++;
+            p += 2;
+        } else {
+            p++;
+        }
+    }
+    return n;
+}
+#endif
+
+/**
+ * @brief times one phase when timing is on and reports it to the tracer.
+ */
+class xPhaseTimer {
+ public:
+    xPhaseTimer(xJson::xStats* stats, uint64_t xJson::xStats::*field,
+        const char* name) : stats(stats), field(field), name(name) {
+        if (stats != nullptr && xActiveTiming)
+            start = std::chrono::steady_clock::now();
+        else
+            this->stats = nullptr;
+    }
+    ~xPhaseTimer() {
+        if (stats == nullptr)
+            return;
+        uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count();
+        stats->*field += ns;
+        if (xActiveTracer != nullptr)
+            xActiveTracer->phase(xActiveTracer->ctx, name, stats, ns);
+    }
+
+ private:
+    xJson::xStats* stats;
+    uint64_t xJson::xStats::*field;
+    const char* name;
+    std::chrono::steady_clock::time_point start;
+};
+
 /**
  * @brief expend memory.
  * @param c context which need to expand
@@ -67,16 +538,18 @@ typedef struct {
  */
 void* xContextPush(xContext* c, size_t size) {
     void* ret;
+    size_t old = c->size;
     assert(size > 0);
     if (c->top + size >= c->size) {
         if (c->size == 0)
             c->size = X_PARSE_STACK_INIT_SIZE;
         while (c->top + size >= c->size)
             c->size += c->size >> 1;
-        c->stack = (char*)realloc(c->stack, c->size);
+        c->stack = (char*)xReallocate(c->stack, old, c->size);
     }
     ret = c->stack + c->top;
     c->top += size;
+    X_STAT(c, if (c->top > s->stackPeak) s->stackPeak = c->top);
     return ret;
 }
 /**
@@ -93,13 +566,54 @@ void* xContextPop(xContext* c, size_t size) {
 #define PUTC(c, ch) do { *(char*)xContextPush(c, sizeof(char)) = (ch); } while (0)
 #define PUTS(c, s, len) memcpy(xContextPush(c, len), s, len)
 
+/**
+ * @brief recursive descent parser.
+ * every optional feature is gated on Policy at compile time, a disabled
+ * feature leaves no code behind. with Insitu strings and keys are decoded
+ * over the input text and borrowed by the values. with Checked every
+ * value is validated against c->node as soon as it is read.
+ */
+template <class Policy, bool Insitu = false, bool Checked = false>
 class xParse {
  public:
+    static constexpr bool kComments =
+        (Policy::flags & xJson::X_PARSE_FLAG_COMMENTS) != 0;
+    static constexpr bool kTrailingCommas =
+        (Policy::flags & xJson::X_PARSE_FLAG_TRAILING_COMMAS) != 0;
+    static constexpr bool kNanInf =
+        (Policy::flags & xJson::X_PARSE_FLAG_NAN_INF) != 0;
+    static constexpr bool kValidateUtf8 =
+        (Policy::flags & xJson::X_PARSE_FLAG_VALIDATE_UTF8) != 0;
+    static constexpr bool kLazyNumbers =
+        (Policy::flags & xJson::X_PARSE_FLAG_LAZY_NUMBERS) != 0;
+    static constexpr bool kLazyStrings =
+        (Policy::flags & xJson::X_PARSE_FLAG_LAZY_STRINGS) != 0;
+    static constexpr bool kSortedKeys =
+        (Policy::flags & xJson::X_PARSE_FLAG_SORTED_KEYS) != 0;
+    /* raw numbers keep their text, a checked parse checks every element */
+    static constexpr bool kDenseArrays =
+        (Policy::flags & xJson::X_PARSE_FLAG_DENSE_ARRAYS) != 0
+        && !kLazyNumbers && !Checked;
+
     static void parseWhiteSpace(xContext* c) {
-        const char *p = c->json;
-        while (*p == ' ' || *p == '\t'
-            || *p == '\n' || *p == '\r') {
-            p++;
+        const char* p = xLexer::skipWhiteSpace(c->json);
+        if constexpr (kComments) {
+            /* an unterminated comment is left in place as a syntax error */
+            while (*p == '/') {
+                if (p[1] == '/') {
+                    for (p += 2; *p != '\n' && *p != '\0'; p++) {}
+                } else if (p[1] == '*') {
+                    const char* q = p + 2;
+                    while (*q != '\0' && !(q[0] == '*' && q[1] == '/'))
+                        q++;
+                    if (*q == '\0')
+                        break;
+                    p = q + 2;
+                } else {
+                    break;
+                }
+                p = xLexer::skipWhiteSpace(p);
+            }
         }
         c->json = p;
     }
@@ -114,55 +628,40 @@ class xParse {
         v->type = type;
         return xState::X_PARSE_OK;
     }
-    static xState parseTrue(xContext* c, xValue* v) {
-        EXPECT(c, 't');
-        if (c->json[0] != 'r' || c->json[1] != 'u' || c->json[2] != 'e')
-            return xState::X_PARSE_INVALID_VALUE;
-        c->json += 3;
-        v->type = xType::X_TYPE_TRUE;
-        return xState::X_PARSE_OK;
-    }
-    static xState parseFalse(xContext* c, xValue* v) {
-        EXPECT(c, 'f');
-        if (c->json[0] != 'a' || c->json[1] != 'l'
-            || c->json[2] != 's' || c->json[3] != 'e')
-            return xState::X_PARSE_INVALID_VALUE;
-        c->json += 4;
-        v->type = xType::X_TYPE_FALSE;
-        return xState::X_PARSE_OK;
-    }
-    static xState parseNull(xContext* c, xValue* v) {
-        EXPECT(c, 'n');
-        if (c->json[0] != 'u' || c->json[1] != 'l' || c->json[2] != 'l')
+    static xState parseNonFinite(xContext* c, xValue* v) {
+        const char* p = c->json;
+        double sign = 1.0;
+        if (*p == '-') {
+            sign = -1.0;
+            p++;
+        }
+        if (*p == 'I' && xLexer::scanLiteral(p, &p, "Infinity")
+            == xState::X_PARSE_OK) {
+            v->n = sign * HUGE_VAL;
+        } else if (sign > 0 && *p == 'N'
+            && xLexer::scanLiteral(p, &p, "NaN") == xState::X_PARSE_OK) {
+            v->n = NAN;
+        } else {
             return xState::X_PARSE_INVALID_VALUE;
-        c->json += 3;
-        v->type = xType::X_TYPE_NULL;
+        }
+        c->json = p;
+        v->type = xType::X_TYPE_NUMBER;
         return xState::X_PARSE_OK;
     }
     static xState parseNumber(xContext* c, xValue* v) {
-        const char* p = c->json;
-        if (*p == '-') p++;
-        if (*p == '0') p++;
-        else {
-            if (!ISDIGIT1TO9(*p))
-                return xState::X_PARSE_INVALID_VALUE;
-            for (p++; ISDIGIT(*p); p++) {}
-        }
-        if (*p == '.') {
-            p++;
-            if (!ISDIGIT(*p))
-                return xState::X_PARSE_INVALID_VALUE;
-            for (p++; ISDIGIT(*p); p++) {}
-        }
-        if (*p == 'e' || *p == 'E') {
-            p++;
-            if (*p == '+' || *p == '-') p++;
-            if (!ISDIGIT(*p)) return xState::X_PARSE_INVALID_VALUE;
-            for (p++; ISDIGIT(*p); p++) {}
+        const char* p;
+        xState ret;
+        if constexpr (kNanInf) {
+            if (*c->json == 'N' || *c->json == 'I'
+                || (c->json[0] == '-' && c->json[1] == 'I'))
+                return parseNonFinite(c, v);
         }
+        if ((ret = xLexer::scanNumber(c->json, &p)) != xState::X_PARSE_OK)
+            return ret;
+        if constexpr (kLazyNumbers)
+            return parseRawNumber(c, v, p);
         errno = 0;
-        char* end;
-        v->n = strtod(c->json, &end);
+        v->n = strtod(c->json, nullptr);
         if (errno == ERANGE && (v->n == HUGE_VAL
             || v->n == -HUGE_VAL))
             return xState::X_PARSE_NUMBER_TOO_BIG;
@@ -170,138 +669,296 @@ class xParse {
         v->type = xType::X_TYPE_NUMBER;
         return xState::X_PARSE_OK;
     }
-    static const char* parseHex4(const char* p, unsigned* u) {
-        int i;
-        *u = 0;
-        for (i = 0; i < 4; i++) {
-            char ch = *p++;
-            *u <<= 4;
-            if (ch >= '0' && ch <= '9') *u |= ch - '0';
-            else if (ch >= 'A' && ch <= 'F') *u |= ch - ('A' - 10);
-            else if (ch >= 'a' && ch <= 'f') *u |= ch - ('a' - 10);
-            else return nullptr;
-        }
-        return p;
-    }
-    static void encodeUtf8(xContext* c, unsigned u) {
-        if (u <= 0x7F)
-            PUTC(c, u & 0xFF);
-        else if (u <= 0x7FF) {
-            PUTC(c, 0xC0 | ((u >> 6) & 0xFF));
-            PUTC(c, 0x80 | (u & 0x3F));
-        } else if (u <= 0xFFFF) {
-            PUTC(c, 0xE0 | (u >> 12) & 0xFF);
-            PUTC(c, 0x80 | (u >> 6) & 0x3F);
-            PUTC(c, 0x80 | (u & 0x3F));
+    /**
+     * @brief keep the text of the number in [c->json, end), overflow is
+     * still refused but found from the digits, nothing is converted.
+     */
+    static xState parseRawNumber(xContext* c, xValue* v, const char* end) {
+        size_t len = end - c->json;
+        xState ret;
+        if ((ret = xJson::xScanner::scanNumber(c->json, end, &end))
+            != xState::X_PARSE_OK)
+            return ret;
+        if constexpr (Insitu) {
+            v->str.s = const_cast<char*>(c->json);
+            v->flags = xJson::X_VALUE_FLAG_RAW_NUMBER
+                | xJson::X_VALUE_FLAG_BORROWED;
         } else {
-            assert(u <= 0x10FFFF);
-            PUTC(c, 0xF0 | ((u >> 18) & 0xFF));
-            PUTC(c, 0x80 | ((u >> 12) & 0x3F));
-            PUTC(c, 0x80 | ((u >> 6) & 0x3F));
-            PUTC(c, 0x80 | (u & 0x3F));
+            memcpy(v->str.s = (char*)xAllocate(len + 1), c->json, len);
+            v->str.s[len] = '\0';
+            v->flags = xJson::X_VALUE_FLAG_RAW_NUMBER;
         }
+        v->str.len = len;
+        c->json = end;
+        v->type = xType::X_TYPE_NUMBER;
+        return xState::X_PARSE_OK;
     }
-    #define STRING_ERROR(ret) do {c->top = head; return ret; } while (0)
+    struct xContextSink {
+        xContext* c;
+        void put(char ch) { PUTC(c, ch); }
+    };
+    /**
+     * @brief decode a string, str points to the context stack or, in situ,
+     * into the input text where the result is nul-terminated.
+     */
     static xState parseStringRaw(xContext* c, char** str, size_t* len) {
-        size_t head = c->top;
-        unsigned u, u2;
+        xState ret;
+#if X_JSON_STATS
+        const char* begin = c->json;
+#endif
+        EXPECT(c, '\"');
+        if constexpr (Insitu) {
+            /* decoding never outgrows the escaped text it reads */
+            xLexer::xPointerSink sink = { const_cast<char*>(c->json) };
+            *str = sink.w;
+            ret = xLexer::scanString<kValidateUtf8>(c->json, &c->json, &sink);
+            if (ret != xState::X_PARSE_OK)
+                return ret;
+            *sink.w = '\0';
+            *len = sink.w - *str;
+        } else {
+            size_t head = c->top;
+            xContextSink sink = { c };
+            ret = xLexer::scanString<kValidateUtf8>(c->json, &c->json, &sink);
+            if (ret != xState::X_PARSE_OK) {
+                c->top = head;
+                return ret;
+            }
+            *len = c->top - head;
+            *str = (char*)xContextPop(c, *len);
+        }
+        X_STAT(c, s->stringBytes += *len;
+            s->escapes += xCountEscapes(begin + 1, c->json - 1));
+        return xState::X_PARSE_OK;
+    }
+    /**
+     * @brief keep the escaped text of a string, only checked and counted.
+     * a decoded length below the text length means there are escapes.
+     */
+    static xState parseLazyString(xContext* c, xValue* v) {
+        xLexer::xCountSink count = { 0 };
         const char* p;
+        size_t len;
+        xState ret;
         EXPECT(c, '\"');
         p = c->json;
-        for (;;) {
-            char ch = *p++;
-            switch (ch) {
-            case '\"':
-                *len = c->top - head;
-                *str = (char*)xContextPop(c, *len);
-                /*
-                xHelper::xSetString(v,
-                    (const char*)xContextPop(c, len), len);
-                */
-                c->json = p;
-                return xState::X_PARSE_OK;
-            case '\\':
-                switch (*p++) {
-                    case '\"': PUTC(c, '\"'); break;
-                    case '\\': PUTC(c, '\\'); break;
-                    case '/': PUTC(c, '/'); break;
-                    case 'b': PUTC(c, '\b'); break;
-                    case 'f': PUTC(c, '\f'); break;
-                    case 'n': PUTC(c, '\n'); break;
-                    case 'r': PUTC(c, '\r'); break;
-                    case 't': PUTC(c, '\t'); break;
-                    case 'u':
-                        if (!(p = xParse::parseHex4(p, &u)))
-                            STRING_ERROR(xState::X_PARSE_INVALID_UNICODE_HEX);
-                        if (u >= 0xD800 && u <= 0xDBFF) {
-                            if (*p++ != '\\')
-                                STRING_ERROR(
-                                    xState::X_PARSE_INVALID_UNICODE_SURROGATE);
-                            if (*p++ != 'u')
-                                STRING_ERROR(
-                                    xState::X_PARSE_INVALID_UNICODE_SURROGATE);
-                            if (!(p = xParse::parseHex4(p, &u2)))
-                                STRING_ERROR(
-                                    xState::X_PARSE_INVALID_UNICODE_HEX);
-                            if (u2 < 0xDC00 || u2 > 0xDFFF)
-                                STRING_ERROR(
-                                    xState::X_PARSE_INVALID_UNICODE_SURROGATE);
-                            u = (((u - 0xD800) << 10) | (u2 - 0xDC00))
-                                + 0x10000;
-                        }
-                        xParse::encodeUtf8(c, u);
-                        break;
-                    default:
-                        STRING_ERROR(xState::X_PARSE_INVALID_STRING_ESCAPE);
-                }
-                break;
-            case '\0':
-                STRING_ERROR(xState::X_PARSE_MISS_QUOTATION_MARK);
-            default:
-                if ((unsigned char)ch < 0x20) {
-                    STRING_ERROR(xState::X_PARSE_INVALID_STRING_CHAR);
-                }
-                PUTC(c, ch);
-            }
+        ret = xLexer::scanString<kValidateUtf8>(p, &c->json, &count);
+        if (ret != xState::X_PARSE_OK)
+            return ret;
+        len = c->json - 1 - p;
+        if constexpr (Insitu) {
+            v->str.s = const_cast<char*>(p);
+            v->flags = xJson::X_VALUE_FLAG_BORROWED;
+        } else {
+            memcpy(v->str.s = (char*)xAllocate(len + 1), p, len);
+            v->flags = 0;
         }
+        v->str.s[len] = '\0';
+        v->str.len = len;
+        v->type = xType::X_TYPE_STRING;
+        v->flags |= xJson::X_VALUE_FLAG_RAW_STRING;
+        if (count.n != len)
+            v->flags |= xJson::X_VALUE_FLAG_ESCAPED;
+        X_STAT(c, s->stringBytes += count.n;
+            s->escapes += xCountEscapes(p, p + len));
+        return xState::X_PARSE_OK;
     }
     static xState parseString(xContext* c, xValue* v) {
         xState ret;
         char* s;
         size_t len;
-        if ((ret = parseStringRaw(c, &s, &len)) == xState::X_PARSE_OK)
+        if constexpr (kLazyStrings)
+            return parseLazyString(c, v);
+        if ((ret = parseStringRaw(c, &s, &len)) != xState::X_PARSE_OK)
+            return ret;
+        if constexpr (Insitu) {
+            v->str.s = s;
+            v->str.len = len;
+            v->type = xType::X_TYPE_STRING;
+            v->flags = xJson::X_VALUE_FLAG_BORROWED;
+        } else {
             xHelper::xSetString(v, s, len);
+        }
         return ret;
     }
+    /**
+     * @brief a string whose schema says it is base64, decoded from the
+     * stack straight into the block of a binary value.
+     */
+    static xState parseBinary(xContext* c, xValue* v, const char* start) {
+        xState ret;
+        char* s;
+        size_t len, n;
+        uint8_t* bytes;
+        if ((ret = parseStringRaw(c, &s, &len)) != xState::X_PARSE_OK)
+            return ret;
+        bytes = (uint8_t*)xAllocate(len / 4 * 3 + 1);
+        if (!xJson::xBase64::decode(s, len, bytes, &n)) {
+            xDeallocate(bytes, len / 4 * 3 + 1);
+            return schemaFail(c, "contentEncoding", start);
+        }
+        /* the padding is known only now, the block is shrunk to fit */
+        if (n != len / 4 * 3)
+            bytes = (uint8_t*)xReallocate(bytes, len / 4 * 3 + 1, n + 1);
+        bytes[n] = '\0';
+        v->str.s = (char*)bytes;
+        v->str.len = n;
+        v->type = xType::X_TYPE_STRING;
+        v->flags = xJson::X_VALUE_FLAG_BINARY;
+        return ret;
+    }
+    /**
+     * @brief the integer of a number lexeme [p, end) of plain digits,
+     * up to 18 so that it cannot overflow. -0 is not one, it would lose
+     * its sign.
+     */
+    static bool parseDenseInt64(const char* p, const char* end, int64_t* i) {
+        bool minus = *p == '-';
+        uint64_t u = 0;
+        p += minus;
+        if (end - p > 18)
+            return false;
+        for (; p < end && *p >= '0' && *p <= '9'; p++)
+            u = u * 10 + (*p - '0');
+        if (p != end || (minus && u == 0))
+            return false;
+        *i = minus ? -(int64_t)u : (int64_t)u;
+        return true;
+    }
+    /**
+     * @brief read the leading numbers of an array as 8-byte slots on the
+     * stack, integers while every number is one and doubles from the
+     * first number that is not.
+     * @param done set when the array holds numbers only, v is then a dense
+     * array. otherwise the *size numbers read are left on the stack as
+     * xValues for parseArray to go on from the next element.
+     */
+    static xState parseDense(xContext* c, xValue* v, size_t* size,
+        bool* done) {
+        size_t i, n = 0, head = c->top;
+        bool integers = true;
+        const char* p;
+        int64_t k;
+        double d;
+        *done = false;
+        while ((*c->json == '-' || (*c->json >= '0' && *c->json <= '9'))
+            && xLexer::scanNumber(c->json, &p) == xState::X_PARSE_OK) {
+            if (integers && parseDenseInt64(c->json, p, &k)) {
+                memcpy(xContextPush(c, 8), &k, 8);
+            } else {
+                if (integers) {
+                    for (i = 0; i < n; i++) {
+                        memcpy(&k, c->stack + head + i * 8, 8);
+                        d = (double)k;
+                        memcpy(c->stack + head + i * 8, &d, 8);
+                    }
+                    integers = false;
+                }
+                errno = 0;
+                d = strtod(c->json, nullptr);
+                if (errno == ERANGE && (d == HUGE_VAL || d == -HUGE_VAL)) {
+                    c->top = head;
+                    return xState::X_PARSE_NUMBER_TOO_BIG;
+                }
+                memcpy(xContextPush(c, 8), &d, 8);
+            }
+            c->json = p;
+            n++;
+            parseWhiteSpace(c);
+            if (*c->json == ',') {
+                c->json++;
+                parseWhiteSpace(c);
+                if (kTrailingCommas && *c->json == ']')
+                    goto close;
+            } else if (*c->json == ']') {
+            close:
+                c->json++;
+                v->type = xType::X_TYPE_ARRAY;
+                v->flags = integers ? xJson::X_VALUE_FLAG_DENSE_INT64
+                    : xJson::X_VALUE_FLAG_DENSE_DOUBLE;
+                v->dense.len = n;
+                memcpy(v->dense.d = (double*)xAllocate(n * 8),
+                    xContextPop(c, n * 8), n * 8);
+                X_STAT(c, s->values[(int)xType::X_TYPE_NUMBER] += n);
+                *done = true;
+                return xState::X_PARSE_OK;
+            } else {
+                c->top = head;
+                return xState::X_PARSE_MISS_COMMA_OR_SQUARE_BRACKET;
+            }
+        }
+        /* widen the slots to xValues from the back, the stack may move */
+        if (n > 0)
+            xContextPush(c, n * (sizeof(xValue) - 8));
+        for (i = n; i-- > 0;) {
+            xValue e;
+            xInit(&e);
+            e.type = xType::X_TYPE_NUMBER;
+            if (integers) {
+                memcpy(&k, c->stack + head + i * 8, 8);
+                e.n = (double)k;
+            } else {
+                memcpy(&e.n, c->stack + head + i * 8, 8);
+            }
+            memcpy(c->stack + head + i * sizeof(xValue), &e, sizeof(xValue));
+        }
+        X_STAT(c, s->values[(int)xType::X_TYPE_NUMBER] += n);
+        *size = n;
+        return xState::X_PARSE_OK;
+    }
     static xState parseArray(xContext* c, xValue* v) {
         size_t i, size = 0;
         xState ret;
+        const xJson::xSchemaNode* node = c->node;
         EXPECT(c, '[');
         parseWhiteSpace(c);
         if (*c->json == ']') {
+            if constexpr (Checked) {
+                if ((ret = checkItems(c, node, 0)) != xState::X_PARSE_OK)
+                    return ret;
+            }
             c->json++;
             v->type = xType::X_TYPE_ARRAY;
             v->array.len = 0;
             v->array.e = nullptr;
             return xState::X_PARSE_OK;
         }
+        if constexpr (kDenseArrays) {
+            bool done;
+            if ((ret = parseDense(c, v, &size, &done)) != xState::X_PARSE_OK
+                || done)
+                return ret;
+        }
         for (;;) {
             xValue e;
             xInit(&e);
-            if ((ret = parseValue(&e, c)) != xState::X_PARSE_OK)
+            if constexpr (Checked)
+                c->node = node != nullptr ? node->items : nullptr;
+            if ((ret = parseValue(&e, c)) != xState::X_PARSE_OK) {
+                if (Checked && ret == xState::X_PARSE_SCHEMA_MISMATCH
+                    && c->error != nullptr)
+                    c->error->path.insert(0, "/" + std::to_string(size));
                 break;
+            }
             memcpy(xContextPush(c, sizeof(xValue)), &e, sizeof(xValue));
             size++;
             parseWhiteSpace(c);
             if (*c->json == ',') {
                 c->json++;
                 parseWhiteSpace(c);
+                if (kTrailingCommas && *c->json == ']')
+                    goto close;
             } else if (*c->json == ']') {
+            close:
+                if constexpr (Checked) {
+                    if ((ret = checkItems(c, node, size)) != xState::X_PARSE_OK)
+                        break;
+                }
                 c->json++;
                 v->type = xType::X_TYPE_ARRAY;
                 v->array.len = size;
                 size *= sizeof(xValue);
-                memcpy(v->array.e = (xValue*)malloc(size),
+                memcpy(v->array.e = (xValue*)xAllocate(size),
                     xContextPop(c, size), size);
                 return xState::X_PARSE_OK;
             } else {
@@ -317,16 +974,26 @@ class xParse {
         size_t i, size;
         xMember m;
         xState ret;
+        const xJson::xSchemaNode* node = c->node;
+        xRequired required(Checked ? node : nullptr);
         EXPECT(c, '{');
         parseWhiteSpace(c);
         if (*c->json == '}') {
+            if constexpr (Checked) {
+                if ((ret = checkMembers(c, node, 0, &required))
+                    != xState::X_PARSE_OK)
+                    return ret;
+            }
             c->json++;
             v->type = xType::X_TYPE_OBJECT;
             v->object.m = 0;
             v->object.size = 0;
+            if constexpr (kSortedKeys)
+                v->flags = xJson::X_VALUE_FLAG_SORTED_KEYS;
             return xState::X_PARSE_OK;
         }
         m.k = nullptr;
+        m.flags = Insitu ? (unsigned)xJson::X_VALUE_FLAG_BORROWED : 0u;
         size = 0;
         for (;;) {
             char* str;
@@ -335,11 +1002,17 @@ class xParse {
                 ret = xState::X_PARSE_MISS_KEY;
                 break;
             }
-            if ((ret = xParse::parseStringRaw(c, &str, &m.klen))
+            if ((ret = parseStringRaw(c, &str, &m.klen))
                 != xState::X_PARSE_OK)
                 break;
-            memcpy(m.k = (char*)malloc(m.klen + 1), str, m.klen);
-            m.k[m.klen] = '\0';
+            /* the key was just scanned and is still in cache */
+            m.hash = xKeyHash(str, m.klen);
+            if constexpr (Insitu) {
+                m.k = str;
+            } else {
+                memcpy(m.k = (char*)xAllocate(m.klen + 1), str, m.klen);
+                m.k[m.klen] = '\0';
+            }
             parseWhiteSpace(c);
             if (*c->json != ':') {
                 ret = xState::X_PARSE_MISS_COLON;
@@ -347,8 +1020,16 @@ class xParse {
             }
             c->json++;
             parseWhiteSpace(c);
-            if ((ret = parseValue(&m.v, c)) != xState::X_PARSE_OK)
+            if constexpr (Checked) {
+                if ((ret = checkMember(c, node, &m, &required))
+                    != xState::X_PARSE_OK)
+                    break;
+            }
+            if ((ret = parseValue(&m.v, c)) != xState::X_PARSE_OK) {
+                if (Checked && ret == xState::X_PARSE_SCHEMA_MISMATCH)
+                    prependKey(c, m.k, m.klen);
                 break;
+            }
             memcpy(xContextPush(c, sizeof(xMember)), &m, sizeof(xMember));
             size++;
             m.k = nullptr;
@@ -356,67 +1037,362 @@ class xParse {
             if (*c->json == ',') {
                 c->json++;
                 parseWhiteSpace(c);
+                if (kTrailingCommas && *c->json == '}')
+                    goto close;
             } else if (*c->json == '}') {
+            close:
+                if constexpr (Checked) {
+                    if ((ret = checkMembers(c, node, size, &required))
+                        != xState::X_PARSE_OK)
+                        break;
+                }
                 size_t s = sizeof(xMember) * size;
                 c->json++;
                 v->type = xType::X_TYPE_OBJECT;
                 v->object.size = size;
-                memcpy(v->object.m = (xMember*)malloc(s),
+                memcpy(v->object.m = (xMember*)xAllocate(s),
                     xContextPop(c, s), s);
+                if constexpr (kSortedKeys)
+                    xSortMembers(v);
                 return xState::X_PARSE_OK;
             } else {
                 ret = xState::X_PARSE_MISS_COMMA_OR_CURLY_BRACKET;
                 break;
             }
         }
-        free(m.k);
+        if (!Insitu)
+            xDeallocate(m.k, m.klen + 1);
         for (i = 0; i < size; i++) {
             xMember* m = (xMember*)xContextPop(c, sizeof(xMember));
-            free(m->k);
+            if (!Insitu)
+                xDeallocate(m->k, m->klen + 1);
             xFree(&m->v);
         }
         v->type = xType::X_TYPE_NULL;
         return ret;
     }
+    static xState parseContainer(xValue* v, xContext* c) {
+        xState ret;
+        if constexpr (Policy::maxDepth > 0) {
+            if (c->depth >= Policy::maxDepth)
+                return xState::X_PARSE_DEPTH_EXCEEDED;
+        }
+        c->depth++;
+        X_STAT(c, if (c->depth > s->maxDepth) s->maxDepth = c->depth);
+        ret = *c->json == '[' ? parseArray(c, v) : parseObject(c, v);
+        c->depth--;
+        return ret;
+    }
     static xState parseValue(xValue* v, xContext* c) {
+        xState ret;
+        const xJson::xSchemaNode* node = c->node;
+        const char* start = c->json;
+        if constexpr (Checked) {
+            if (node != nullptr && !(node->types & schemaType(*c->json)))
+                return schemaFail(c, "type");
+        }
         switch (*c->json) {
-            case 't': return xParse::parseLiteral(c, v,
-                "true", xType::X_TYPE_TRUE);
-            case 'f': return xParse::parseLiteral(c, v,
-                "false", xType::X_TYPE_FALSE);
-            case 'n': return xParse::parseLiteral(c, v,
-                "null", xType::X_TYPE_NULL);
-            default: return xParse::parseNumber(c, v);
-            case '"': return xParse::parseString(c, v);
-            case '[': return xParse::parseArray(c, v);
-            case '{': return xParse::parseObject(c, v);
+            case 't': ret = parseLiteral(c, v,
+                "true", xType::X_TYPE_TRUE); break;
+            case 'f': ret = parseLiteral(c, v,
+                "false", xType::X_TYPE_FALSE); break;
+            case 'n': ret = parseLiteral(c, v,
+                "null", xType::X_TYPE_NULL); break;
+            default: ret = parseNumber(c, v); break;
+            case '"':
+                if (Checked && node != nullptr
+                    && (node->checks & xJson::X_SCHEMA_CHECK_BASE64))
+                    ret = parseBinary(c, v, start);
+                else
+                    ret = parseString(c, v);
+                break;
+            case '[': case '{': ret = parseContainer(v, c); break;
             case '\0': return xState::X_PARSE_EXPECT_VALUE;
         }
+        if constexpr (Checked) {
+            if (ret == xState::X_PARSE_OK && node != nullptr
+                && (ret = checkValue(c, node, v, start)) != xState::X_PARSE_OK)
+                xFree(v);
+        }
+        X_STAT(c, if (ret == xState::X_PARSE_OK) s->values[(int)v->type]++);
+        return ret;
+    }
+
+    /**
+     * @brief required keys seen in one object, on the C stack unless the
+     * schema requires more than 64 keys.
+     */
+    struct xRequired {
+        uint64_t small;
+        std::vector<uint64_t> large;
+        size_t found;
+        explicit xRequired(const xJson::xSchemaNode* node)
+            : small(0), found(0) {
+            if (node != nullptr && node->requiredCount > 64)
+                large.assign((node->requiredCount + 63) / 64, 0);
+        }
+        bool seen(uint32_t bit) const {
+            uint64_t w = large.empty() ? small : large[bit >> 6];
+            return (w >> (bit & 63)) & 1;
+        }
+        void mark(uint32_t bit) {
+            uint64_t* w = large.empty() ? &small : &large[bit >> 6];
+            if (!((*w >> (bit & 63)) & 1)) {
+                *w |= (uint64_t)1 << (bit & 63);
+                found++;
+            }
+        }
+    };
+    static unsigned schemaType(char ch) {
+        switch (ch) {
+            case 'n': return xJson::X_SCHEMA_NULL;
+            case 't': case 'f': return xJson::X_SCHEMA_BOOLEAN;
+            case '"': return xJson::X_SCHEMA_STRING;
+            case '[': return xJson::X_SCHEMA_ARRAY;
+            case '{': return xJson::X_SCHEMA_OBJECT;
+            default:
+                /* anything else is left to the grammar */
+                if (ch == '-' || (ch >= '0' && ch <= '9'))
+                    return xJson::X_SCHEMA_NUMBER | xJson::X_SCHEMA_INTEGER;
+                return xJson::X_SCHEMA_ANY;
+        }
+    }
+    static xState schemaFail(xContext* c, const char* keyword,
+        const char* at = nullptr) {
+        if (c->error != nullptr) {
+            c->error->path.clear();
+            c->error->keyword = keyword;
+            c->error->offset = (at != nullptr ? at : c->json) - c->begin;
+        }
+        return xState::X_PARSE_SCHEMA_MISMATCH;
+    }
+    static void prependKey(xContext* c, const char* k, size_t klen) {
+        std::string segment = "/";
+        if (c->error == nullptr)
+            return;
+        for (size_t i = 0; i < klen; i++) {
+            if (k[i] == '~')
+                segment.append("~0");
+            else if (k[i] == '/')
+                segment.append("~1");
+            else
+                segment.push_back(k[i]);
+        }
+        c->error->path.insert(0, segment);
+    }
+    /**
+     * @brief checks that need the whole value, reported at its start.
+     */
+    static xState checkValue(xContext* c, const xJson::xSchemaNode* node,
+        const xValue* v, const char* start) {
+        size_t i, n;
+        if (v->type == xType::X_TYPE_NUMBER) {
+            if (!(node->types & xJson::X_SCHEMA_NUMBER) && v->n != floor(v->n))
+                return schemaFail(c, "type", start);
+            if ((node->checks & xJson::X_SCHEMA_CHECK_MINIMUM)
+                && !(v->n >= node->minimum))
+                return schemaFail(c, "minimum", start);
+            if ((node->checks & xJson::X_SCHEMA_CHECK_MAXIMUM)
+                && !(v->n <= node->maximum))
+                return schemaFail(c, "maximum", start);
+            if ((node->checks & xJson::X_SCHEMA_CHECK_EXCLUSIVE_MINIMUM)
+                && !(v->n > node->exclusiveMinimum))
+                return schemaFail(c, "exclusiveMinimum", start);
+            if ((node->checks & xJson::X_SCHEMA_CHECK_EXCLUSIVE_MAXIMUM)
+                && !(v->n < node->exclusiveMaximum))
+                return schemaFail(c, "exclusiveMaximum", start);
+        } else if (v->type == xType::X_TYPE_STRING
+            && (node->checks & xJson::X_SCHEMA_CHECK_LENGTH)) {
+            /* code points, continuation bytes are not counted */
+            if (v->flags & xJson::X_VALUE_FLAG_BINARY)
+                n = xJson::xBase64::encodedLength(v->str.len);
+            else
+                for (i = n = 0; i < v->str.len; i++)
+                    n += ((unsigned char)v->str.s[i] & 0xC0) != 0x80;
+            if (n < node->minLength)
+                return schemaFail(c, "minLength", start);
+            if (n > node->maxLength)
+                return schemaFail(c, "maxLength", start);
+        }
+        if (node->checks & xJson::X_SCHEMA_CHECK_ENUM) {
+            for (i = 0; i < node->values.size(); i++)
+                if (xJson::xEqual(v, &node->values[i]))
+                    return xState::X_PARSE_OK;
+            return schemaFail(c, "enum", start);
+        }
+        return xState::X_PARSE_OK;
+    }
+    static xState checkItems(xContext* c, const xJson::xSchemaNode* node,
+        size_t size) {
+        if (node == nullptr || !(node->checks & xJson::X_SCHEMA_CHECK_ITEMS))
+            return xState::X_PARSE_OK;
+        if (size < node->minItems)
+            return schemaFail(c, "minItems");
+        if (size > node->maxItems)
+            return schemaFail(c, "maxItems");
+        return xState::X_PARSE_OK;
+    }
+    /**
+     * @brief look key up in the property table and select the schema of
+     * its value.
+     */
+    static xState checkMember(xContext* c, const xJson::xSchemaNode* node,
+        const xMember* m, xRequired* required) {
+        const xJson::xSchemaKey* key;
+        if (node == nullptr) {
+            c->node = nullptr;
+            return xState::X_PARSE_OK;
+        }
+        /* the table is keyed by xHashKey, the hash the member keeps */
+        if ((key = node->find(m->k, m->klen, m->hash)) != nullptr) {
+            if (key->required != (uint32_t)-1)
+                required->mark(key->required);
+            c->node = key->node;
+            return xState::X_PARSE_OK;
+        }
+        if (node->additional != nullptr && node->additional->types == 0) {
+            schemaFail(c, "additionalProperties");
+            prependKey(c, m->k, m->klen);
+            return xState::X_PARSE_SCHEMA_MISMATCH;
+        }
+        c->node = node->additional;
+        return xState::X_PARSE_OK;
+    }
+    static xState checkMembers(xContext* c, const xJson::xSchemaNode* node,
+        size_t size, const xRequired* required) {
+        if (node == nullptr)
+            return xState::X_PARSE_OK;
+        if (required->found < node->requiredCount) {
+            /* report the first missing key */
+            for (const xJson::xSchemaKey& key : node->keys) {
+                if (key.required != (uint32_t)-1 && !required->seen(key.required)) {
+                    schemaFail(c, "required");
+                    prependKey(c, key.name.data(), key.name.size());
+                    break;
+                }
+            }
+            return xState::X_PARSE_SCHEMA_MISMATCH;
+        }
+        if (node->checks & xJson::X_SCHEMA_CHECK_PROPERTIES) {
+            if (size < node->minProperties)
+                return schemaFail(c, "minProperties");
+            if (size > node->maxProperties)
+                return schemaFail(c, "maxProperties");
+        }
+        return xState::X_PARSE_OK;
+    }
+
+    /**
+     * @param end optional, the root must end exactly there: text that is
+     * not nul-terminated by the caller (a mapped file) may hold a nul
+     */
+    static xState parse(xValue* v, const char* json,
+        const xJson::xSchemaNode* node = nullptr,
+        xJson::xSchemaError* error = nullptr, const char* end = nullptr) {
+        xContext c;
+        xState ret;
+        assert(v != nullptr);
+        c.json = json;
+        c.stack = nullptr;
+        c.size = c.top = 0;
+        c.depth = 0;
+        c.begin = json;
+        c.node = node;
+        c.error = error;
+        c.stats = X_JSON_STATS ? xActiveCounters : nullptr;
+        X_STAT(&c, s->parses++);
+        xPhaseTimer timer(c.stats, &xJson::xStats::parseNs, "parse");
+        xInit(v);
+        parseWhiteSpace(&c);
+        if ((ret = parseValue(v, &c)) == xState::X_PARSE_OK) {
+            parseWhiteSpace(&c);
+            if (end != nullptr ? c.json != end : *c.json != '\0') {
+                xFree(v);
+                ret = xState::X_PARSE_ROOT_NOT_SINGULAR;
+            }
+        }
+        assert(c.top == 0);
+        xDeallocate(c.stack, c.size);
+        return ret;
     }
 };
 
 xState xJson::xParse(xValue* v, const char* json) {
-    xContext c;
+    return ::xParse<xStrictPolicy>::parse(v, json);
+}
+
+template <class Policy>
+xState xJson::xParseWith(xValue* v, const char* json) {
+    return ::xParse<Policy>::parse(v, json);
+}
+
+template <class Policy>
+xState xJson::xParseInsitu(xValue* v, char* json) {
+    return ::xParse<Policy, true>::parse(v, json);
+}
+
+xState xJson::xParseWithSchema(xValue* v, const char* json,
+    const xSchema& schema, xSchemaError* error) {
+    return ::xParse<xStrictPolicy, false, true>::parse(v, json,
+        schema.root(), error);
+}
+
+xState xJson::xParseFile(xValue* v, const char* path,
+    const xMapOptions* options) {
+    return xParseFileWith<xStrictPolicy>(v, path, options);
+}
+
+template <class Policy>
+xState xJson::xParseFileWith(xValue* v, const char* path,
+    const xMapOptions* options) {
+    xMappedFile file;
     xState ret;
     assert(v != nullptr);
-    c.json = json;
-    c.stack = nullptr;
-    v->type = xType::X_TYPE_NULL;
-    c.size = c.top = 0;
-    xInit(v);
-    xParse::parseWhiteSpace(&c);
-    if ((ret = xParse::parseValue(v, &c)) == xState::X_PARSE_OK) {
-        xParse::parseWhiteSpace(&c);
-        if (*c.json != '\0') {
-            v->type = xType::X_TYPE_NULL;
-            ret = xState::X_PARSE_ROOT_NOT_SINGULAR;
-        }
-    }
-    assert(c.top == 0);
-    free(c.stack);
-    return ret;
+    if ((ret = file.open(path, options)) != xState::X_PARSE_OK) {
+        xInit(v);
+        return ret;
+    }
+    /* the tree is a copy, the mapping goes away with file */
+    return ::xParse<Policy>::parse(v, file.data(), nullptr, nullptr,
+        file.data() + file.size());
+}
+
+template <class Policy>
+xState xJson::xParseInsitu(xValue* v, xMappedFile* file) {
+    assert(file != nullptr && file->mutableData() != nullptr);
+    return ::xParse<Policy, true>::parse(v, file->mutableData(), nullptr,
+        nullptr, file->data() + file->size());
 }
 
+template xState xJson::xParseWith<xJson::xStrictPolicy>(xValue*, const char*);
+template xState xJson::xParseWith<xJson::xRelaxedPolicy>(xValue*, const char*);
+template xState xJson::xParseWith<xJson::xSafePolicy>(xValue*, const char*);
+template xState xJson::xParseWith<xJson::xLazyPolicy>(xValue*, const char*);
+template xState xJson::xParseWith<xJson::xDensePolicy>(xValue*, const char*);
+template xState xJson::xParseWith<xJson::xSortedPolicy>(xValue*, const char*);
+template xState xJson::xParseInsitu<xJson::xStrictPolicy>(xValue*, char*);
+template xState xJson::xParseInsitu<xJson::xRelaxedPolicy>(xValue*, char*);
+template xState xJson::xParseInsitu<xJson::xLazyPolicy>(xValue*, char*);
+template xState xJson::xParseInsitu<xJson::xSortedPolicy>(xValue*, char*);
+template xState xJson::xParseFileWith<xJson::xStrictPolicy>(xValue*,
+    const char*, const xMapOptions*);
+template xState xJson::xParseFileWith<xJson::xRelaxedPolicy>(xValue*,
+    const char*, const xMapOptions*);
+template xState xJson::xParseFileWith<xJson::xSafePolicy>(xValue*,
+    const char*, const xMapOptions*);
+template xState xJson::xParseFileWith<xJson::xLazyPolicy>(xValue*,
+    const char*, const xMapOptions*);
+template xState xJson::xParseFileWith<xJson::xDensePolicy>(xValue*,
+    const char*, const xMapOptions*);
+template xState xJson::xParseFileWith<xJson::xSortedPolicy>(xValue*,
+    const char*, const xMapOptions*);
+template xState xJson::xParseInsitu<xJson::xStrictPolicy>(xValue*,
+    xMappedFile*);
+template xState xJson::xParseInsitu<xJson::xRelaxedPolicy>(xValue*,
+    xMappedFile*);
+template xState xJson::xParseInsitu<xJson::xLazyPolicy>(xValue*,
+    xMappedFile*);
+
 class xStringify {
  public:
     xStringify() {}
@@ -456,57 +1432,317 @@ class xStringify {
         }
         *p++ = '"';
         c->top -= size - (p - head);
+        X_STAT(c, s->stringBytes += len;
+            s->escapes += xCountEscapes(head + 1, p - 1));
     }
-    static void stringifyValue(xContext* c, const xValue* v) {
+    static void stringifyNumber(xContext* c, double n) {
+        if (isfinite(n))
+            c->top -= 32 - sprintf((char*)xContextPush(c, 32), "%.17g", n);
+        else if (isnan(n))
+            PUTS(c, "NaN", 3);
+        else if (n > 0)
+            PUTS(c, "Infinity", 8);
+        else
+            PUTS(c, "-Infinity", 9);
+    }
+    /**
+     * @brief numbers straight from a dense array, integers are written
+     * without going through sprintf. canonical output prints them as
+     * doubles, like the same numbers held by xValues.
+     */
+    template <bool Canonical>
+    static void stringifyDense(xContext* c, const xValue* v) {
         size_t i;
+        char* p;
+        PUTC(c, '[');
+        if (!Canonical && (v->flags & xJson::X_VALUE_FLAG_DENSE_INT64)) {
+            for (i = 0; i < v->dense.len; i++) {
+                int64_t k = v->dense.i[i];
+                uint64_t u = k < 0 ? 0 - (uint64_t)k : (uint64_t)k;
+                char digits[20];
+                size_t n = 0;
+                do {
+                    digits[n++] = (char)('0' + u % 10);
+                    u /= 10;
+                } while (u != 0);
+                p = (char*)xContextPush(c, n + 2);
+                if (i > 0)
+                    *p++ = ',';
+                if (k < 0)
+                    *p++ = '-';
+                while (n > 0)
+                    *p++ = digits[--n];
+                c->top = p - c->stack;
+            }
+        } else {
+            for (i = 0; i < v->dense.len; i++) {
+                if (i > 0)
+                    PUTC(c, ',');
+                stringifyNumber(c, (v->flags & xJson::X_VALUE_FLAG_DENSE_INT64)
+                    ? (double)v->dense.i[i] : v->dense.d[i]);
+            }
+        }
+        PUTC(c, ']');
+        X_STAT(c, s->values[(int)xType::X_TYPE_NUMBER] += v->dense.len);
+    }
+    /**
+     * @brief the base64 text of a binary string, it never needs escapes.
+     */
+    static void stringifyBinary(xContext* c, const xValue* v) {
+        size_t len = xJson::xBase64::encodedLength(v->str.len);
+        char* p = (char*)xContextPush(c, len + 2);
+        p[0] = '"';
+        xJson::xBase64::encode((const uint8_t*)v->str.s, v->str.len, p + 1);
+        p[len + 1] = '"';
+        X_STAT(c, s->stringBytes += len);
+    }
+    /**
+     * @brief a value without children to walk: a scalar, an empty
+     * container or a dense array.
+     */
+    template <bool Canonical>
+    static void stringifyLeaf(xContext* c, const xValue* v) {
         switch (v->type) {
             case xType::X_TYPE_NULL:   PUTS(c, "null",  4); break;
             case xType::X_TYPE_FALSE:  PUTS(c, "false", 5); break;
             case xType::X_TYPE_TRUE:   PUTS(c, "true",  4); break;
             case xType::X_TYPE_NUMBER:
-                c->top -= 32 - sprintf((char*)xContextPush(c, 32), "%.17g", v->n);
+                if (Canonical)
+                    stringifyNumber(c, xHelper::xGetNumber(v));
+                else if (v->flags & xJson::X_VALUE_FLAG_RAW_NUMBER)
+                    PUTS(c, v->str.s, v->str.len);
+                else
+                    stringifyNumber(c, v->n);
                 break;
             case xType::X_TYPE_STRING:
-                stringifyString(c, v->str.s, v->str.len);
+                /* raw text without escapes reads the same either way */
+                if (Canonical && (v->flags & xJson::X_VALUE_FLAG_ESCAPED))
+                    xHelper::xGetString(v);
+                if (v->flags & xJson::X_VALUE_FLAG_BINARY) {
+                    stringifyBinary(c, v);
+                } else if (v->flags & xJson::X_VALUE_FLAG_RAW_STRING) {
+                    /* json text already, escapes are kept as read */
+                    char* p = (char*)xContextPush(c, v->str.len + 2);
+                    p[0] = '"';
+                    memcpy(p + 1, v->str.s, v->str.len);
+                    p[v->str.len + 1] = '"';
+                    X_STAT(c, s->stringBytes += v->str.len);
+                } else {
+                    stringifyString(c, v->str.s, v->str.len);
+                }
                 break;
             case xType::X_TYPE_ARRAY:
-                PUTC(c, '[');
-                for (i = 0; i < v->array.len; i++) {
-                    if (i > 0)
-                        PUTC(c, ',');
-                    stringifyValue(c, &v->array.e[i]);
-                }
-                PUTC(c, ']');
+                if (v->flags & X_DENSE_FLAGS)
+                    stringifyDense<Canonical>(c, v);
+                else
+                    PUTS(c, "[]", 2);
                 break;
-            case xType::X_TYPE_OBJECT:
+            case xType::X_TYPE_OBJECT: PUTS(c, "{}", 2); break;
+            default: assert(0 && "invalid type");
+        }
+    }
+
+    /** a container being written, i is the child being written */
+    typedef struct {
+        const xValue* v;
+        size_t i;
+        size_t order;       /* first slot of its permutation, or kNoOrder */
+    } xOutFrame;
+    static constexpr size_t kNoOrder = (size_t)-1;
+
+    /**
+     * @brief write the key of the i-th member of f, in canonical order when
+     * the object has a permutation.
+     * @return const xValue* the value of the member, to be written next
+     */
+    static const xValue* stringifyKey(xContext* c, const xOutFrame* f,
+        xWalkStack<const xMember*>* order) {
+        const xMember* m = f->order != kNoOrder
+            ? *order->at(f->order + f->i) : &f->v->object.m[f->i];
+        stringifyString(c, m->k, m->klen);
+        PUTC(c, ':');
+        return &m->v;
+    }
+
+    /**
+     * @brief write v depth first with an explicit stack of open
+     * containers, so that nesting costs no C stack.
+     */
+    template <bool Canonical>
+    static void stringifyValue(xContext* c, const xValue* v) {
+        xWalkStack<xOutFrame> stack;
+        /* permutations of the open objects, through the current allocator */
+        xWalkStack<const xMember*> order;
+        xOutFrame* f;
+        size_t i, n;
+        for (;;) {
+            X_STAT(c, s->values[(int)v->type]++);
+            if (v->type == xType::X_TYPE_ARRAY && v->array.len > 0
+                && !(v->flags & X_DENSE_FLAGS)) {
+                PUTC(c, '[');
+                f = stack.push();
+                f->v = v;
+                f->i = 0;
+                v = &v->array.e[0];
+                continue;
+            }
+            if (v->type == xType::X_TYPE_OBJECT && v->object.size > 0) {
                 PUTC(c, '{');
-                for (i = 0; i < v->object.size; i++) {
-                    if (i > 0)
-                        PUTC(c, ',');
-                    stringifyString(c, v->object.m[i].k,
-                        v->object.m[i].klen);
-                    PUTC(c, ':');
-                    stringifyValue(c, &v->object.m[i].v);
+                f = stack.push();
+                f->v = v;
+                f->i = 0;
+                f->order = kNoOrder;
+                if (Canonical && !(v->flags & xJson::X_VALUE_FLAG_SORTED_KEYS)
+                    && v->object.size > 1) {
+                    f->order = order.size();
+                    for (i = 0; i < v->object.size; i++)
+                        *order.push() = &v->object.m[i];
+                    /* equal keys keep their member order, std::stable_sort
+                     * would take its buffer from operator new */
+                    std::sort(order.at(f->order), order.at(order.size()),
+                        [](const xMember* a, const xMember* b) {
+                            return xMemberLess(*a, *b)
+                                || (!xMemberLess(*b, *a) && a < b);
+                        });
                 }
-                PUTC(c, '}');
-                break;
-            default: assert(0 && "invalid type");
+                v = stringifyKey(c, f, &order);
+                continue;
+            }
+            stringifyLeaf<Canonical>(c, v);
+            /* on to the next sibling, closing the containers that are done */
+            for (;;) {
+                if ((f = stack.back()) == nullptr)
+                    return;
+                n = f->v->type == xType::X_TYPE_ARRAY ? f->v->array.len
+                    : f->v->object.size;
+                if (++f->i < n) {
+                    PUTC(c, ',');
+                    v = f->v->type == xType::X_TYPE_ARRAY
+                        ? &f->v->array.e[f->i] : stringifyKey(c, f, &order);
+                    break;
+                }
+                if (f->v->type == xType::X_TYPE_ARRAY) {
+                    PUTC(c, ']');
+                } else {
+                    PUTC(c, '}');
+                    if (f->order != kNoOrder)
+                        order.truncate(f->order);
+                }
+                stack.pop();
+            }
         }
     }
 };
 
-char* xJson::xStringify(const xValue* v, size_t* length) {
+/** @fn char* xStringifyWith(const xValue* v, size_t* length)
+ * @brief body of xStringify and xStringifyCanonical.
+ */
+template <bool Canonical>
+static char* xStringifyWith(const xValue* v, size_t* length) {
     xContext c;
     assert(v != nullptr);
-    c.stack = (char*)malloc(c.size = X_PARSE_STRINGIFY_INIT_SIZE);
+    c.stack = (char*)xAllocate(c.size = X_PARSE_STRINGIFY_INIT_SIZE);
     c.top = 0;
-    xStringify::stringifyValue(&c, v);
+    c.stats = X_JSON_STATS ? xActiveCounters : nullptr;
+    X_STAT(&c, s->stringifies++);
+    {
+        xPhaseTimer timer(c.stats, &xJson::xStats::stringifyNs, "stringify");
+        xStringify::stringifyValue<Canonical>(&c, v);
+    }
+    X_STAT(&c, s->outputBytes += c.top);
     if (length)
         *length = c.top;
     PUTC(&c, '\0');
+    /* sized deallocation needs the exact size the caller knows */
+    if (xCurrentAllocator() != &xMallocAllocator)
+        c.stack = (char*)xReallocate(c.stack, c.size, c.top);
     return c.stack;
 }
 
+char* xJson::xStringify(const xValue* v, size_t* length) {
+    return xStringifyWith<false>(v, length);
+}
+
+char* xJson::xStringifyCanonical(const xValue* v, size_t* length) {
+    return xStringifyWith<true>(v, length);
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+static_assert(sizeof(xJson::xSpan) == sizeof(struct iovec)
+    && offsetof(xJson::xSpan, data) == offsetof(struct iovec, iov_base)
+    && offsetof(xJson::xSpan, len) == offsetof(struct iovec, iov_len),
+    "xSpan must have the layout of struct iovec");
+#endif
+
+xJson::xBatchWriter::xBatchWriter(const xAllocator* allocator)
+    : arena(nullptr), capacity(0), top(0),
+    allocator(allocator != nullptr ? allocator : xCurrentAllocator()) {}
+
+xJson::xBatchWriter::~xBatchWriter() {
+    release();
+}
+
+xJson::xBatchWriter& xJson::xBatchWriter::local() {
+    /* it outlives any scope active at first use */
+    static thread_local xBatchWriter writer(xDefaultAllocator);
+    return writer;
+}
+
+/** @fn size_t xBatchWriter::append(const xValue* v)
+ * @brief body of add and addCanonical, the arena is the stack of the
+ * stringify context and grows like it.
+ */
+template <bool Canonical>
+size_t xJson::xBatchWriter::append(const xValue* v) {
+    xAllocatorScope scope(this->allocator);
+    xContext c;
+    assert(v != nullptr);
+    c.stack = this->arena;
+    c.size = this->capacity;
+    c.top = this->top;
+    c.stats = X_JSON_STATS ? xActiveCounters : nullptr;
+    X_STAT(&c, s->stringifies++);
+    {
+        xPhaseTimer timer(c.stats, &xJson::xStats::stringifyNs, "stringify");
+        ::xStringify::stringifyValue<Canonical>(&c, v);
+    }
+    X_STAT(&c, s->outputBytes += c.top - this->top);
+    this->arena = c.stack;
+    this->capacity = c.size;
+    this->top = c.top;
+    this->ends.push_back(c.top);
+    return this->ends.size() - 1;
+}
+
+size_t xJson::xBatchWriter::add(const xValue* v) {
+    return append<false>(v);
+}
+
+size_t xJson::xBatchWriter::addCanonical(const xValue* v) {
+    return append<true>(v);
+}
+
+void xJson::xBatchWriter::clear() {
+    this->top = 0;
+    this->ends.clear();
+}
+
+void xJson::xBatchWriter::release() {
+    xAllocatorScope scope(this->allocator);
+    xDeallocate(this->arena, this->capacity);
+    this->arena = nullptr;
+    this->capacity = 0;
+    clear();
+}
+
+const xJson::xSpan* xJson::xBatchWriter::spans() {
+    /* pointers are made only now, the arena may have moved while growing */
+    this->views.resize(this->ends.size());
+    for (size_t i = 0; i < this->ends.size(); i++)
+        this->views[i] = span(i);
+    return this->views.data();
+}
+
 xHelper::xHelper(xValue* v) {
     this->value = v;
     xInit(this->value);
@@ -516,6 +1752,29 @@ xHelper::~xHelper() {
     xFree(this->value);
 }
 
+void xHelper::xCopy(xValue* dst, const xValue* src) {
+    assert(dst != nullptr && src != nullptr && dst != src);
+    xFree(dst);
+    xCopyValue(dst, src);
+}
+
+void xHelper::xMove(xValue* dst, xValue* src) {
+    assert(dst != nullptr && src != nullptr && dst != src);
+    xFree(dst);
+    memcpy(dst, src, sizeof(xValue));
+    xInit(src);
+}
+
+void xHelper::xSwap(xValue* lhs, xValue* rhs) {
+    assert(lhs != nullptr && rhs != nullptr);
+    if (lhs != rhs) {
+        xValue temp;
+        memcpy(&temp, lhs, sizeof(xValue));
+        memcpy(lhs, rhs, sizeof(xValue));
+        memcpy(rhs, &temp, sizeof(xValue));
+    }
+}
+
 void xHelper::xSetNull(xValue* v) {
     xFree(v);
 }
@@ -540,35 +1799,177 @@ void xHelper::xSetBoolean(xValue* v, int b) {
 
 double xHelper::xGetNumber(const xValue* v) {
     assert(v != nullptr && v->type == xType::X_TYPE_NUMBER);
+    /* borrowed text ends at a delimiter, which strtod stops at */
+    if (v->flags & xJson::X_VALUE_FLAG_RAW_NUMBER)
+        return strtod(v->str.s, nullptr);
     return v->n;
 }
 
+bool xHelper::xGetInt64(const xValue* v, int64_t* i) {
+    const char* p;
+    const char* q;
+    const char* end;
+    uint64_t u = 0;
+    bool neg;
+    double n;
+    assert(v != nullptr && v->type == xType::X_TYPE_NUMBER && i != nullptr);
+    if (v->flags & xJson::X_VALUE_FLAG_RAW_NUMBER) {
+        p = v->str.s;
+        end = p + v->str.len;
+        if ((neg = *p == '-'))
+            p++;
+        for (q = p; q < end && *q >= '0' && *q <= '9'; q++) {}
+        /* plain digits are exact or out of range, never rounded */
+        if (q == end) {
+            /* no leading zeros, more than 19 digits is past 2^63 */
+            if (end - p > 19)
+                return false;
+            for (; p < end; p++)
+                u = u * 10 + (*p - '0');
+            if (u > (uint64_t)INT64_MAX + neg)
+                return false;
+            *i = neg ? (u == 0 ? 0 : -(int64_t)(u - 1) - 1) : (int64_t)u;
+            return true;
+        }
+    }
+    n = xGetNumber(v);
+    /* 2^63 is exact as a double, the range is half open */
+    if (!(n >= -9223372036854775808.0 && n < 9223372036854775808.0)
+        || n != floor(n))
+        return false;
+    *i = (int64_t)n;
+    return true;
+}
+
+const char* xHelper::xGetNumberText(const xValue* v, size_t* len) {
+    assert(v != nullptr && v->type == xType::X_TYPE_NUMBER && len != nullptr);
+    if (!(v->flags & xJson::X_VALUE_FLAG_RAW_NUMBER))
+        return nullptr;
+    *len = v->str.len;
+    return v->str.s;
+}
+
 void xHelper::xSetNumber(xValue* v, double n) {
     xFree(v);
     v->n = n;
     v->type = xType::X_TYPE_NUMBER;
 }
 
+/** @fn void xUnescape(xValue* v)
+ * @brief decode a lazily parsed string in place, an owned block is
+ * shrunk to the decoded length so it is freed with the right size.
+ */
+static void xUnescape(xValue* v) {
+    size_t len = xLexer::unescape(v->str.s, v->str.len);
+    if (!(v->flags & xJson::X_VALUE_FLAG_BORROWED))
+        v->str.s = (char*)xReallocate(v->str.s, v->str.len + 1, len + 1);
+    v->str.s[len] = '\0';
+    v->str.len = len;
+    v->flags &= ~(xJson::X_VALUE_FLAG_RAW_STRING | xJson::X_VALUE_FLAG_ESCAPED);
+}
+
+/** @fn const char* xBinaryText(const xValue* v, char* out)
+ * @brief the base64 text of a binary string, written to out. v keeps its
+ * bytes, so a const tree stays unchanged when read.
+ */
+static const char* xBinaryText(const xValue* v, char* out) {
+    size_t len = xJson::xBase64::encodedLength(v->str.len);
+    xJson::xBase64::encode((const uint8_t*)v->str.s, v->str.len, out);
+    out[len] = '\0';
+    return out;
+}
+
 const char* xHelper::xGetString(const xValue* v) {
+    static thread_local std::vector<char> text;
+    assert(v != nullptr && v->type == xType::X_TYPE_STRING);
+    if (v->flags & xJson::X_VALUE_FLAG_ESCAPED)
+        xUnescape(const_cast<xValue*>(v));
+    else if (v->flags & xJson::X_VALUE_FLAG_BINARY) {
+        text.resize(xJson::xBase64::encodedLength(v->str.len) + 1);
+        return xBinaryText(v, text.data());
+    }
+    return v->str.s;
+}
+
+const char* xHelper::xGetString(const xValue* v, char* out) {
     assert(v != nullptr && v->type == xType::X_TYPE_STRING);
+    if (v->flags & xJson::X_VALUE_FLAG_ESCAPED)
+        xUnescape(const_cast<xValue*>(v));
+    else if (v->flags & xJson::X_VALUE_FLAG_BINARY) {
+        assert(out != nullptr);
+        return xBinaryText(v, out);
+    }
     return v->str.s;
 }
 
 size_t xHelper::xGetStringLength(const xValue* v) {
     assert(v != nullptr && v->type == xType::X_TYPE_STRING);
+    if (v->flags & xJson::X_VALUE_FLAG_ESCAPED)
+        xUnescape(const_cast<xValue*>(v));
+    else if (v->flags & xJson::X_VALUE_FLAG_BINARY)
+        return xJson::xBase64::encodedLength(v->str.len);
     return v->str.len;
 }
 
 void xHelper::xSetString(xValue* v, const char* s, size_t len) {
     assert(v != nullptr && (s != nullptr || len == 0));
     xFree(v);
-    v->str.s = (char*)malloc(len + 1);
+    v->str.s = (char*)xAllocate(len + 1);
     memcpy(v->str.s, s, len);
     v->str.s[len] = '\0';
     v->str.len = len;
     v->type = xType::X_TYPE_STRING;
 }
 
+const uint8_t* xHelper::xGetBinary(const xValue* v, size_t* len) {
+    assert(v != nullptr && v->type == xType::X_TYPE_STRING && len != nullptr);
+    if (!(v->flags & xJson::X_VALUE_FLAG_BINARY))
+        return nullptr;
+    *len = v->str.len;
+    return (const uint8_t*)v->str.s;
+}
+
+bool xHelper::xGetBinary(const xValue* v, uint8_t* out, size_t* len) {
+    assert(v != nullptr && v->type == xType::X_TYPE_STRING);
+    assert(out != nullptr && len != nullptr);
+    if (v->flags & xJson::X_VALUE_FLAG_BINARY) {
+        memcpy(out, v->str.s, *len = v->str.len);
+        return true;
+    }
+    xGetString(v);
+    return xJson::xBase64::decode(v->str.s, v->str.len, out, len);
+}
+
+bool xHelper::xDecodeBinary(xValue* v) {
+    uint8_t* bytes;
+    size_t size, n;
+    assert(v != nullptr && v->type == xType::X_TYPE_STRING);
+    if (v->flags & xJson::X_VALUE_FLAG_BINARY)
+        return true;
+    xGetString(v);
+    /* a new block, text that is not base64 must be left as it was */
+    size = v->str.len / 4 * 3 + 1;
+    bytes = (uint8_t*)xAllocate(size);
+    if (!xJson::xBase64::decode(v->str.s, v->str.len, bytes, &n)) {
+        xDeallocate(bytes, size);
+        return false;
+    }
+    if (n + 1 != size)
+        bytes = (uint8_t*)xReallocate(bytes, size, n + 1);
+    bytes[n] = '\0';
+    if (!(v->flags & xJson::X_VALUE_FLAG_BORROWED))
+        xDeallocate(v->str.s, v->str.len + 1);
+    v->str.s = (char*)bytes;
+    v->str.len = n;
+    v->flags = xJson::X_VALUE_FLAG_BINARY;
+    return true;
+}
+
+void xHelper::xSetBinary(xValue* v, const void* data, size_t len) {
+    xSetString(v, (const char*)data, len);
+    v->flags = xJson::X_VALUE_FLAG_BINARY;
+}
+
 size_t xHelper::xGetArraySize(const xValue* v) {
     assert(v != nullptr && v->type == xType::X_TYPE_ARRAY);
     return v->array.len;
@@ -577,7 +1978,63 @@ size_t xHelper::xGetArraySize(const xValue* v) {
 xValue* xHelper::xGetArrayElement(const xValue* v, size_t index) {
     assert(v != nullptr && v->type == xType::X_TYPE_ARRAY);
     assert(index < v->array.len);
-    return &v->array.e[index];
+    return &xGetArrayElements(v)[index];
+}
+
+xValue* xHelper::xGetArrayElements(const xValue* v) {
+    xValue* e;
+    size_t i;
+    assert(v != nullptr && v->type == xType::X_TYPE_ARRAY);
+    if (!(v->flags & X_DENSE_FLAGS))
+        return v->array.e;
+    e = v->dense.len > 0
+        ? (xValue*)xAllocate(v->dense.len * sizeof(xValue)) : nullptr;
+    for (i = 0; i < v->dense.len; i++) {
+        xInit(&e[i]);
+        e[i].type = xType::X_TYPE_NUMBER;
+        e[i].n = (v->flags & xJson::X_VALUE_FLAG_DENSE_INT64)
+            ? (double)v->dense.i[i] : v->dense.d[i];
+    }
+    xDeallocate(v->dense.d, v->dense.len * 8);
+    /* the value is the same, only its layout changes */
+    ((xValue*)v)->array.e = e;
+    ((xValue*)v)->flags &= ~X_DENSE_FLAGS;
+    return e;
+}
+
+const double* xHelper::xGetDoubleArray(const xValue* v) {
+    assert(v != nullptr && v->type == xType::X_TYPE_ARRAY);
+    return (v->flags & xJson::X_VALUE_FLAG_DENSE_DOUBLE) ? v->dense.d
+        : nullptr;
+}
+
+const int64_t* xHelper::xGetInt64Array(const xValue* v) {
+    assert(v != nullptr && v->type == xType::X_TYPE_ARRAY);
+    return (v->flags & xJson::X_VALUE_FLAG_DENSE_INT64) ? v->dense.i
+        : nullptr;
+}
+
+/** @fn void xSetDense(xValue* v, const void* p, size_t len, unsigned flag)
+ * @brief set v to a dense array of len 8-byte numbers copied from p.
+ */
+static void xSetDense(xValue* v, const void* p, size_t len, unsigned flag) {
+    void* d;
+    assert(v != nullptr && (p != nullptr || len == 0));
+    /* p may point into v */
+    d = len > 0 ? memcpy(xAllocate(len * 8), p, len * 8) : nullptr;
+    xFree(v);
+    v->type = xType::X_TYPE_ARRAY;
+    v->flags = flag;
+    v->dense.d = (double*)d;
+    v->dense.len = len;
+}
+
+void xHelper::xSetDoubleArray(xValue* v, const double* d, size_t len) {
+    xSetDense(v, d, len, xJson::X_VALUE_FLAG_DENSE_DOUBLE);
+}
+
+void xHelper::xSetInt64Array(xValue* v, const int64_t* i, size_t len) {
+    xSetDense(v, i, len, xJson::X_VALUE_FLAG_DENSE_INT64);
 }
 
 size_t xHelper::xGetObjectSize(const xValue* v) {
@@ -602,3 +2059,189 @@ xValue* xHelper::xGetObjectValue(const xValue* v, size_t index) {
     assert(index < v->object.size);
     return &v->object.m[index].v;
 }
+
+xJson::xDocument::xDocument() {
+    xInit(&this->root);
+    this->allocator = nullptr;
+}
+
+xJson::xDocument::xDocument(const xAllocator* allocator) {
+    xInit(&this->root);
+    this->allocator = allocator;
+}
+
+xJson::xDocument::~xDocument() {
+    xAllocatorScope scope(this->allocator);
+    xFree(&this->root);
+}
+
+xJson::xDocument::xDocument(xDocument&& other) noexcept {
+    memcpy(&this->root, &other.root, sizeof(xValue));
+    this->allocator = other.allocator;
+    xInit(&other.root);
+}
+
+xJson::xDocument& xJson::xDocument::operator=(xDocument&& other) noexcept {
+    if (this != &other) {
+        {
+            xAllocatorScope scope(this->allocator);
+            xFree(&this->root);
+        }
+        memcpy(&this->root, &other.root, sizeof(xValue));
+        this->allocator = other.allocator;
+        xInit(&other.root);
+    }
+    return *this;
+}
+
+xState xJson::xDocument::parse(const char* json) {
+    xAllocatorScope scope(this->allocator);
+    xFree(&this->root);
+    return xJson::xParse(&this->root, json);
+}
+
+char* xJson::xDocument::stringify(size_t* length) const {
+    xAllocatorScope scope(this->allocator);
+    return xJson::xStringify(&this->root, length);
+}
+
+xJson::xDocument xJson::xDocument::clone() const {
+    xAllocatorScope scope(this->allocator);
+    xDocument doc(this->allocator);
+    xCopyValue(&doc.root, &this->root);
+    return doc;
+}
+
+void xJson::xDocument::swap(xDocument& other) noexcept {
+    const xAllocator* allocator = this->allocator;
+    xHelper::xSwap(&this->root, &other.root);
+    this->allocator = other.allocator;
+    other.allocator = allocator;
+}
+
+void xHelper::xSetArray(xValue* v) {
+    assert(v != nullptr);
+    xFree(v);
+    v->type = xType::X_TYPE_ARRAY;
+    v->array.e = nullptr;
+    v->array.len = 0;
+}
+
+xValue* xHelper::xInsertArrayElement(xValue* v, size_t index) {
+    xValue* e;
+    assert(v != nullptr && v->type == xType::X_TYPE_ARRAY);
+    assert(index <= v->array.len);
+    xGetArrayElements(v);
+    v->array.e = (xValue*)xReallocate(v->array.e,
+        v->array.len * sizeof(xValue), (v->array.len + 1) * sizeof(xValue));
+    e = &v->array.e[index];
+    memmove(e + 1, e, (v->array.len - index) * sizeof(xValue));
+    v->array.len++;
+    xInit(e);
+    return e;
+}
+
+void xHelper::xEraseArrayElement(xValue* v, size_t index, size_t count) {
+    size_t i;
+    assert(v != nullptr && v->type == xType::X_TYPE_ARRAY);
+    assert(index + count <= v->array.len);
+    xGetArrayElements(v);
+    for (i = index; i < index + count; i++)
+        xFree(&v->array.e[i]);
+    memmove(&v->array.e[index], &v->array.e[index + count],
+        (v->array.len - index - count) * sizeof(xValue));
+    xShrink((void**)&v->array.e, v->array.len, v->array.len - count,
+        sizeof(xValue));
+    v->array.len -= count;
+}
+
+void xHelper::xSetObject(xValue* v) {
+    assert(v != nullptr);
+    xFree(v);
+    v->type = xType::X_TYPE_OBJECT;
+    v->object.m = nullptr;
+    v->object.size = 0;
+}
+
+/** @fn size_t xFindIndex(const xValue* v, const char* key, size_t klen, uint32_t hash)
+ * @brief xFindObjectIndex with the hash of key already known.
+ */
+static size_t xFindIndex(const xValue* v, const char* key, size_t klen,
+    uint32_t hash) {
+    size_t i, lo, hi;
+    assert(v != nullptr && v->type == xType::X_TYPE_OBJECT);
+    assert(key != nullptr || klen == 0);
+    if (v->flags & xJson::X_VALUE_FLAG_SORTED_KEYS) {
+        /* lower bound, the first of duplicate keys */
+        for (lo = 0, hi = v->object.size; lo < hi;) {
+            i = lo + (hi - lo) / 2;
+            if (xKeyLess(v->object.m[i].k, v->object.m[i].klen, key, klen))
+                lo = i + 1;
+            else
+                hi = i;
+        }
+        if (lo < v->object.size && v->object.m[lo].hash == hash
+            && v->object.m[lo].klen == klen
+            && memcmp(v->object.m[lo].k, key, klen) == 0)
+            return lo;
+        return xJson::X_KEY_NOT_EXIST;
+    }
+    for (i = 0; i < v->object.size; i++)
+        if (v->object.m[i].hash == hash && v->object.m[i].klen == klen
+            && memcmp(v->object.m[i].k, key, klen) == 0)
+            return i;
+    return xJson::X_KEY_NOT_EXIST;
+}
+
+xValue* xHelper::xSetObjectValue(xValue* v, const char* key, size_t klen) {
+    uint32_t hash = xKeyHash(key, klen);
+    size_t index = xFindIndex(v, key, klen, hash);
+    xMember* m;
+    if (index != xJson::X_KEY_NOT_EXIST)
+        return &v->object.m[index].v;
+    m = v->object.size > 0 ? &v->object.m[v->object.size - 1] : nullptr;
+    if (m != nullptr && xKeyLess(key, klen, m->k, m->klen))
+        v->flags &= ~xJson::X_VALUE_FLAG_SORTED_KEYS;
+    v->object.m = (xMember*)xReallocate(v->object.m,
+        v->object.size * sizeof(xMember),
+        (v->object.size + 1) * sizeof(xMember));
+    m = &v->object.m[v->object.size++];
+    memcpy(m->k = (char*)xAllocate(klen + 1), key, klen);
+    m->k[klen] = '\0';
+    m->klen = klen;
+    m->flags = 0;
+    m->hash = hash;
+    xInit(&m->v);
+    return &m->v;
+}
+
+void xHelper::xRemoveObjectValue(xValue* v, size_t index) {
+    xMember* m;
+    assert(v != nullptr && v->type == xType::X_TYPE_OBJECT);
+    assert(index < v->object.size);
+    m = &v->object.m[index];
+    if (!(m->flags & xJson::X_VALUE_FLAG_BORROWED))
+        xDeallocate(m->k, m->klen + 1);
+    xFree(&m->v);
+    memmove(m, m + 1, (v->object.size - index - 1) * sizeof(xMember));
+    xShrink((void**)&v->object.m, v->object.size, v->object.size - 1,
+        sizeof(xMember));
+    v->object.size--;
+}
+
+void xHelper::xSortObjectKeys(xValue* v) {
+    assert(v != nullptr && v->type == xType::X_TYPE_OBJECT);
+    xSortMembers(v);
+}
+
+size_t xHelper::xFindObjectIndex(const xValue* v,
+    const char* key, size_t klen) {
+    assert(key != nullptr || klen == 0);
+    return xFindIndex(v, key, klen, xKeyHash(key, klen));
+}
+
+xValue* xHelper::xFindObjectValue(const xValue* v,
+    const char* key, size_t klen) {
+    size_t index = xFindObjectIndex(v, key, klen);
+    return index != xJson::X_KEY_NOT_EXIST ? &v->object.m[index].v : nullptr;
+}
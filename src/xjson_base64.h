@@ -0,0 +1,254 @@
+/* copyright 2021 xkxsxkx */
+#ifndef __XJSON_BASE64__H__
+#define __XJSON_BASE64__H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * the SSSE3 loops are always built on x86 with gcc and clang: inline when
+ * the target has SSSE3, otherwise under a target attribute and chosen at
+ * run time by the cpu.
+ */
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#define X_BASE64_SSSE3 1
+#define X_BASE64_TARGET
+#elif (defined(__GNUC__) || defined(__clang__)) \
+    && (defined(__x86_64__) || defined(__i386__))
+#include <tmmintrin.h>
+#define X_BASE64_SSSE3 1
+#define X_BASE64_DISPATCH 1
+#define X_BASE64_TARGET __attribute__((target("ssse3")))
+#endif
+
+namespace xJson {
+
+/**
+ * @brief standard base64 (rfc 4648, padded). decoding is strict: the
+ * length is a multiple of 4, '=' only ends the text and the unused bits
+ * of the last character are zero, so that every byte string has exactly
+ * one text and a decoded value is written back as it was read.
+ * with SSSE3 both directions run 16 characters at a time, the scalar
+ * loops finish the tail. vector = false keeps to the scalar loops, for
+ * tests and for comparing the two.
+ */
+class xBase64 {
+ public:
+    static size_t encodedLength(size_t n) {
+        return (n + 2) / 3 * 4;
+    }
+
+    /**
+     * @brief write the encodedLength(n) characters of [src, src + n).
+     */
+    static void encode(const uint8_t* src, size_t n, char* out,
+        bool vector = hasVector()) {
+        static const char alphabet[] =
+            "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        uint32_t w;
+#if defined(X_BASE64_SSSE3)
+        if (vector) {
+            size_t done = encodeVector(src, n, out);
+            src += done, n -= done, out += done / 3 * 4;
+        }
+#else
+        (void)vector;
+#endif
+        for (; n >= 3; n -= 3, src += 3) {
+            w = (uint32_t)src[0] << 16 | (uint32_t)src[1] << 8 | src[2];
+            *out++ = alphabet[w >> 18];
+            *out++ = alphabet[(w >> 12) & 63];
+            *out++ = alphabet[(w >> 6) & 63];
+            *out++ = alphabet[w & 63];
+        }
+        if (n > 0) {
+            w = (uint32_t)src[0] << 16 | (n == 2 ? (uint32_t)src[1] << 8 : 0);
+            *out++ = alphabet[w >> 18];
+            *out++ = alphabet[(w >> 12) & 63];
+            *out++ = n == 2 ? alphabet[(w >> 6) & 63] : '=';
+            *out++ = '=';
+        }
+    }
+
+    /**
+     * @brief decode [s, s + len) into out, which may be s itself and has
+     * room for len / 4 * 3 bytes.
+     * @param n receives the number of bytes
+     * @return bool false when the text is not canonical base64, out is
+     * undefined then
+     */
+    static bool decode(const char* s, size_t len, uint8_t* out, size_t* n,
+        bool vector = hasVector()) {
+        const uint8_t* p = (const uint8_t*)s;
+        const uint8_t* end = p + len;
+        uint8_t* head = out;
+        uint32_t a, b, c, d;
+        if (len % 4 != 0)
+            return false;
+#if defined(X_BASE64_SSSE3)
+        if (vector) {
+            size_t done = decodeVector(p, len, out);
+            if (done == (size_t)-1)
+                return false;
+            p += done, out += done / 4 * 3;
+        }
+#else
+        (void)vector;
+#endif
+        for (; end - p > 4; p += 4) {
+            a = table()[p[0]], b = table()[p[1]];
+            c = table()[p[2]], d = table()[p[3]];
+            if ((a | b | c | d) & 0x80)
+                return false;
+            *out++ = (uint8_t)(a << 2 | b >> 4);
+            *out++ = (uint8_t)(b << 4 | c >> 2);
+            *out++ = (uint8_t)(c << 6 | d);
+        }
+        if (p < end) {
+            a = table()[p[0]], b = table()[p[1]];
+            c = table()[p[2]], d = table()[p[3]];
+            if ((a | b) & 0x80)
+                return false;
+            *out++ = (uint8_t)(a << 2 | b >> 4);
+            if (p[2] == '=') {
+                if (p[3] != '=' || (b & 15) != 0)
+                    return false;
+            } else if (p[3] == '=') {
+                if ((c & 0x80) || (c & 3) != 0)
+                    return false;
+                *out++ = (uint8_t)(b << 4 | c >> 2);
+            } else {
+                if ((c | d) & 0x80)
+                    return false;
+                *out++ = (uint8_t)(b << 4 | c >> 2);
+                *out++ = (uint8_t)(c << 6 | d);
+            }
+        }
+        *n = out - head;
+        return true;
+    }
+
+    /** @brief whether the SSSE3 loops are built and the cpu runs them */
+    static bool hasVector() {
+#if defined(X_BASE64_DISPATCH)
+        static const bool ssse3 = __builtin_cpu_supports("ssse3");
+        return ssse3;
+#elif defined(X_BASE64_SSSE3)
+        return true;
+#else
+        return false;
+#endif
+    }
+
+ private:
+    /** @brief 6 bit value of each character, 0x80 when it is not one */
+    static const uint8_t* table() {
+        static const struct xTable {
+            uint8_t v[256];
+            xTable() {
+                const char* alphabet =
+                    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+                for (int i = 0; i < 256; i++)
+                    v[i] = 0x80;
+                for (int i = 0; i < 64; i++)
+                    v[(uint8_t)alphabet[i]] = (uint8_t)i;
+            }
+        } t;
+        return t.v;
+    }
+
+#if defined(X_BASE64_SSSE3)
+    /**
+     * @brief encode whole blocks of 12 bytes while 16 can be loaded.
+     * @return size_t number of bytes encoded
+     */
+    X_BASE64_TARGET static size_t encodeVector(const uint8_t* src, size_t n,
+        char* out) {
+        size_t done = 0;
+        /* 12 bytes per round, the load reads 4 more */
+        for (; n - done >= 16; done += 12, out += 16)
+            _mm_storeu_si128((__m128i*)out,
+                encodeBlock(_mm_loadu_si128((const __m128i*)(src + done))));
+        return done;
+    }
+
+    /**
+     * @brief decode whole blocks of 16 characters. 16 characters give 12
+     * bytes but the store writes 16, 8 more characters keep it inside
+     * out, and '=' out of the block.
+     * @return size_t number of characters decoded, (size_t)-1 when one
+     * is not in the alphabet
+     */
+    X_BASE64_TARGET static size_t decodeVector(const uint8_t* p, size_t len,
+        uint8_t* out) {
+        size_t done = 0;
+        __m128i v;
+        for (; len - done >= 24; done += 16, out += 12) {
+            if (!decodeBlock(_mm_loadu_si128((const __m128i*)(p + done)), &v))
+                return (size_t)-1;
+            _mm_storeu_si128((__m128i*)out, v);
+        }
+        return done;
+    }
+
+    /**
+     * @brief bytes 0..11 of in to 16 characters: each group of 3 is
+     * spread over a 32 bit lane, the four 6 bit fields moved to their
+     * own byte with two multiplies, then offset into the alphabet by
+     * range (A-Z, a-z, 0-9, +, /) with a shuffle.
+     */
+    X_BASE64_TARGET static __m128i encodeBlock(__m128i in) {
+        const __m128i offsets = _mm_setr_epi8(65, 71, -4, -4, -4, -4, -4, -4,
+            -4, -4, -4, -4, -19, -16, 0, 0);
+        __m128i t0, t1, t2, t3, index;
+        in = _mm_shuffle_epi8(in, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7,
+            4, 5, 3, 4, 1, 2, 0, 1));
+        t0 = _mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00));
+        t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+        t2 = _mm_and_si128(in, _mm_set1_epi32(0x003f03f0));
+        t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+        in = _mm_or_si128(t1, t3);
+        /* 0 for A-Z, 1 for a-z, 2..11 for 0-9, 12 for + and 13 for / */
+        index = _mm_subs_epu8(in, _mm_set1_epi8(51));
+        index = _mm_sub_epi8(index, _mm_cmpgt_epi8(in, _mm_set1_epi8(25)));
+        return _mm_add_epi8(in, _mm_shuffle_epi8(offsets, index));
+    }
+
+    /**
+     * @brief 16 characters to 12 bytes in out. the nibbles of each
+     * character index two class tables whose and is zero only for the
+     * alphabet, the high nibble (and '/') picks the offset back to 0..63,
+     * then the 6 bit fields are packed with two multiply-adds.
+     * @return bool false when a character is not in the alphabet
+     */
+    X_BASE64_TARGET static bool decodeBlock(__m128i in, __m128i* out) {
+        const __m128i lo_classes = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11,
+            0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B,
+            0x1B, 0x1A);
+        const __m128i hi_classes = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02,
+            0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+            0x10, 0x10);
+        const __m128i offsets = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71,
+            -71, 0, 0, 0, 0, 0, 0, 0, 0);
+        const __m128i mask = _mm_set1_epi8(0x2F);
+        __m128i hi, lo, v;
+        hi = _mm_and_si128(_mm_srli_epi32(in, 4), mask);
+        lo = _mm_shuffle_epi8(lo_classes, _mm_and_si128(in, mask));
+        v = _mm_and_si128(lo, _mm_shuffle_epi8(hi_classes, hi));
+        if (_mm_movemask_epi8(_mm_cmpgt_epi8(v, _mm_setzero_si128())) != 0)
+            return false;
+        in = _mm_add_epi8(in, _mm_shuffle_epi8(offsets,
+            _mm_add_epi8(_mm_cmpeq_epi8(in, mask), hi)));
+        in = _mm_maddubs_epi16(in, _mm_set1_epi32(0x01400140));
+        in = _mm_madd_epi16(in, _mm_set1_epi32(0x00011000));
+        *out = _mm_shuffle_epi8(in, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9,
+            8, 14, 13, 12, -1, -1, -1, -1));
+        return true;
+    }
+#endif
+};
+
+}  // namespace xJson
+
+#endif  //!__XJSON_BASE64__H__
@@ -0,0 +1,489 @@
+/*copyright 2021 xkxsxkx*/
+#include "xjson_column.h"
+#include "xjson_lexer.h"
+#include "xjson_scan.h"
+#include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <charconv>
+
+using xJson::xValue;
+using xJson::xType;
+using xJson::xState;
+using xJson::xHelper;
+using xJson::xLexer;
+using xJson::xScanner;
+using xJson::xScanStack;
+using xJson::xWriter;
+using xJson::xColumn;
+using xJson::xColumnType;
+using xJson::xColumnTable;
+
+/**
+ * @brief one value on its way into a column. json is its text when it
+ * is already at hand, otherwise a JSON column formats the payload.
+ */
+struct xCell {
+    xColumnType type;
+    bool b;
+    int64_t i;
+    double d;
+    const char* s;      /* decoded string */
+    size_t len;
+    const char* json;
+    size_t jlen;
+};
+
+/** @brief the type a column of type from takes to also hold to */
+static xColumnType xWiden(xColumnType from, xColumnType to) {
+    if (from == xColumnType::X_COLUMN_NULL || from == to)
+        return to;
+    if ((from == xColumnType::X_COLUMN_INT64 && to == xColumnType::X_COLUMN_DOUBLE)
+        || (from == xColumnType::X_COLUMN_DOUBLE && to == xColumnType::X_COLUMN_INT64))
+        return xColumnType::X_COLUMN_DOUBLE;
+    return xColumnType::X_COLUMN_JSON;
+}
+
+/** @brief the json text of a scalar payload */
+static void xAppendText(std::string* out, xColumnType type, bool b, int64_t i,
+    double d, const char* s, size_t len) {
+    char buf[32];
+    switch (type) {
+        case xColumnType::X_COLUMN_BOOL:
+            out->append(b ? "true" : "false");
+            break;
+        case xColumnType::X_COLUMN_INT64:
+            out->append(buf, snprintf(buf, sizeof(buf), "%" PRId64, i));
+            break;
+        case xColumnType::X_COLUMN_DOUBLE:
+            out->append(buf, snprintf(buf, sizeof(buf), "%.17g", d));
+            break;
+        default:
+            xScanner::appendQuoted(out, s, len);
+            break;
+    }
+}
+
+/**
+ * @brief change the type of c, the rows it holds are converted.
+ */
+static void xColumnRetype(xColumn* c, xColumnType type) {
+    size_t row;
+    switch (c->type) {
+        case xColumnType::X_COLUMN_NULL:
+            if (type == xColumnType::X_COLUMN_BOOL)
+                c->bools.assign(c->rows, 0);
+            else if (type == xColumnType::X_COLUMN_INT64)
+                c->ints.assign(c->rows, 0);
+            else if (type == xColumnType::X_COLUMN_DOUBLE)
+                c->doubles.assign(c->rows, 0);
+            else
+                c->offsets.assign(c->rows + 1, 0);
+            break;
+        case xColumnType::X_COLUMN_INT64:
+            if (type == xColumnType::X_COLUMN_DOUBLE) {
+                c->doubles.assign(c->ints.begin(), c->ints.end());
+                std::vector<int64_t>().swap(c->ints);
+                break;
+            }
+            /* fall through */
+        default: {
+            std::string data;
+            std::vector<size_t> offsets(1, 0);
+            assert(type == xColumnType::X_COLUMN_JSON);
+            offsets.reserve(c->rows + 1);
+            for (row = 0; row < c->rows; row++) {
+                if (c->isValid(row)) {
+                    size_t len = 0;
+                    const char* s = c->type == xColumnType::X_COLUMN_STRING
+                        ? c->text(row, &len) : nullptr;
+                    xAppendText(&data, c->type,
+                        c->type == xColumnType::X_COLUMN_BOOL && c->bools[row],
+                        c->type == xColumnType::X_COLUMN_INT64 ? c->ints[row] : 0,
+                        c->type == xColumnType::X_COLUMN_DOUBLE ? c->doubles[row] : 0,
+                        s, len);
+                }
+                offsets.push_back(data.size());
+            }
+            c->data.swap(data);
+            c->offsets.swap(offsets);
+            std::vector<uint8_t>().swap(c->bools);
+            std::vector<int64_t>().swap(c->ints);
+            std::vector<double>().swap(c->doubles);
+            break;
+        }
+    }
+    c->type = type;
+}
+
+static void xColumnNull(xColumn* c) {
+    switch (c->type) {
+        case xColumnType::X_COLUMN_NULL: break;
+        case xColumnType::X_COLUMN_BOOL: c->bools.push_back(0); break;
+        case xColumnType::X_COLUMN_INT64: c->ints.push_back(0); break;
+        case xColumnType::X_COLUMN_DOUBLE: c->doubles.push_back(0); break;
+        default: c->offsets.push_back(c->data.size()); break;
+    }
+    if ((c->rows & 63) == 0)
+        c->valid.push_back(0);
+    c->rows++;
+}
+
+static void xColumnPut(xColumn* c, const xCell* cell) {
+    xColumnType type = xWiden(c->type, cell->type);
+    if (type != c->type)
+        xColumnRetype(c, type);
+    switch (c->type) {
+        case xColumnType::X_COLUMN_BOOL:
+            c->bools.push_back(cell->b);
+            break;
+        case xColumnType::X_COLUMN_INT64:
+            c->ints.push_back(cell->i);
+            break;
+        case xColumnType::X_COLUMN_DOUBLE:
+            c->doubles.push_back(cell->type == xColumnType::X_COLUMN_INT64
+                ? (double)cell->i : cell->d);
+            break;
+        case xColumnType::X_COLUMN_STRING:
+            c->data.append(cell->s, cell->len);
+            c->offsets.push_back(c->data.size());
+            break;
+        default:
+            if (cell->json != nullptr) {
+                /* checked text, only minified */
+                xWriter w = { xScanner::appendWriter, &c->data };
+                xJson::xFormat(cell->json, cell->jlen, &w);
+            } else {
+                xAppendText(&c->data, cell->type, cell->b, cell->i, cell->d,
+                    cell->s, cell->len);
+            }
+            c->offsets.push_back(c->data.size());
+            break;
+    }
+    if ((c->rows & 63) == 0)
+        c->valid.push_back(0);
+    c->valid[c->rows >> 6] |= (uint64_t)1 << (c->rows & 63);
+    c->rows++;
+}
+
+/** @brief drop the last row of c, its type stays */
+static void xColumnPop(xColumn* c) {
+    c->rows--;
+    c->valid[c->rows >> 6] &= ~((uint64_t)1 << (c->rows & 63));
+    if ((c->rows & 63) == 0)
+        c->valid.pop_back();
+    switch (c->type) {
+        case xColumnType::X_COLUMN_NULL: break;
+        case xColumnType::X_COLUMN_BOOL: c->bools.pop_back(); break;
+        case xColumnType::X_COLUMN_INT64: c->ints.pop_back(); break;
+        case xColumnType::X_COLUMN_DOUBLE: c->doubles.pop_back(); break;
+        default:
+            c->offsets.pop_back();
+            c->data.resize(c->offsets.back());
+            break;
+    }
+}
+
+/**
+ * @brief a checked number lexeme as INT64 when it is plain digits that
+ * fit, DOUBLE otherwise.
+ */
+static void xNumberCell(xCell* cell, const char* p, const char* q) {
+    const char* s;
+    for (s = p; s < q; s++)
+        if (*s == '.' || *s == 'e' || *s == 'E')
+            break;
+    if (s == q && std::from_chars(p, q, cell->i).ec == std::errc()) {
+        cell->type = xColumnType::X_COLUMN_INT64;
+        return;
+    }
+    cell->type = xColumnType::X_COLUMN_DOUBLE;
+    cell->d = xScanner::toDouble(p, q);
+}
+
+/**
+ * @brief the error for ch where a record was expected: another value is
+ * the wrong type, anything else is not json.
+ */
+static xState xNotRecord(char ch) {
+    return ch != '\0' && strchr("\"tfn[{-0123456789", ch) != nullptr
+        ? xState::X_PARSE_TYPE_MISMATCH : xState::X_PARSE_INVALID_VALUE;
+}
+
+xColumn* xColumnTable::find(const char* name, size_t len, size_t position) {
+    size_t i;
+    if (position < hints.size()) {
+        xColumn* c = &cols[hints[position]];
+        if (c->name.size() == len && memcmp(c->name.data(), name, len) == 0)
+            return c;
+    }
+    std::string key(name, len);
+    auto it = index.find(key);
+    if (it != index.end()) {
+        i = it->second;
+    } else {
+        /* a new column, null in every earlier row */
+        i = cols.size();
+        cols.emplace_back();
+        cols[i].name = key;
+        for (size_t row = 0; row < count; row++)
+            xColumnNull(&cols[i]);
+        index.emplace(std::move(key), i);
+    }
+    if (position >= hints.size())
+        hints.resize(position + 1);
+    hints[position] = i;
+    return &cols[i];
+}
+
+const xColumn* xColumnTable::column(const char* name, size_t len) const {
+    auto it = index.find(std::string(name, len));
+    return it != index.end() ? &cols[it->second] : nullptr;
+}
+
+void xColumnTable::endRow() {
+    for (xColumn& c : cols)
+        if (c.rows == count)
+            xColumnNull(&c);
+    count++;
+}
+
+void xColumnTable::clear() {
+    cols.clear();
+    index.clear();
+    hints.clear();
+    count = 0;
+}
+
+/**
+ * @brief one record, from its '{', into a new row. on failure the caller
+ * rolls the row back.
+ */
+xState xColumnTable::parseRecord(const char* p, const char* end,
+    const char** out) {
+    xScanStack stack;
+    xCell cell = xCell();
+    const char* q;
+    const char* key;
+    size_t position = 0;
+    bool escapes;
+    xState ret = xState::X_PARSE_OK;
+    p = xScanner::skipWhiteSpace(p + 1, end);
+    if (p < end && *p == '}') {
+        *out = p + 1;
+        endRow();
+        return xState::X_PARSE_OK;
+    }
+    for (;; position++) {
+        if (p == end || *p != '"') {
+            ret = xState::X_PARSE_MISS_KEY;
+            goto fail;
+        }
+        key = p + 1;
+        escapes = false;
+        if ((ret = xScanner::scanString(key, end, &p, &escapes))
+            != xState::X_PARSE_OK)
+            goto fail;
+        size_t klen = p - 1 - key;
+        if (escapes) {
+            tmp.assign(key, klen);
+            klen = xLexer::unescape(&tmp[0], klen);
+            key = tmp.data();
+        }
+        xColumn* c = find(key, klen, position);
+        p = xScanner::skipWhiteSpace(p, end);
+        if (p == end || *p != ':') {
+            ret = xState::X_PARSE_MISS_COLON;
+            goto fail;
+        }
+        p = xScanner::skipWhiteSpace(p + 1, end);
+        cell = xCell();
+        cell.json = p;
+        switch (p < end ? *p : '\0') {
+            case '"':
+                escapes = false;
+                if ((ret = xScanner::scanString(p + 1, end, &q, &escapes))
+                    != xState::X_PARSE_OK)
+                    break;
+                cell.type = xColumnType::X_COLUMN_STRING;
+                cell.s = p + 1;
+                cell.len = q - p - 2;
+                if (escapes) {
+                    tmp.assign(cell.s, cell.len);
+                    cell.len = xLexer::unescape(&tmp[0], cell.len);
+                    cell.s = tmp.data();
+                }
+                break;
+            case 't':
+                ret = xScanner::scanLiteral(p, end, &q, "true", 4);
+                cell.type = xColumnType::X_COLUMN_BOOL;
+                cell.b = true;
+                break;
+            case 'f':
+                ret = xScanner::scanLiteral(p, end, &q, "false", 5);
+                cell.type = xColumnType::X_COLUMN_BOOL;
+                cell.b = false;
+                break;
+            case 'n':
+                ret = xScanner::scanLiteral(p, end, &q, "null", 4);
+                break;
+            case '[':
+            case '{':
+                ret = xScanner::skipValue(p, end, &q, &stack);
+                cell.type = xColumnType::X_COLUMN_JSON;
+                break;
+            default:
+                if ((ret = xScanner::scanNumber(p, end, &q)) == xState::X_PARSE_OK)
+                    xNumberCell(&cell, p, q);
+                break;
+        }
+        if (ret != xState::X_PARSE_OK) {
+            p = q;
+            goto fail;
+        }
+        cell.jlen = q - p;
+        /* a repeated member keeps its first value */
+        if (c->rows == count && cell.type != xColumnType::X_COLUMN_NULL)
+            xColumnPut(c, &cell);
+        p = xScanner::skipWhiteSpace(q, end);
+        if (p < end && *p == ',') {
+            p = xScanner::skipWhiteSpace(p + 1, end);
+            continue;
+        }
+        if (p < end && *p == '}') {
+            *out = p + 1;
+            endRow();
+            return xState::X_PARSE_OK;
+        }
+        ret = xState::X_PARSE_MISS_COMMA_OR_CURLY_BRACKET;
+        goto fail;
+    }
+fail:
+    *out = p;
+    return ret;
+}
+
+xState xColumnTable::parse(const char* data, size_t len, size_t* offset) {
+    const char* p = data;
+    const char* end = data + len;
+    xState ret = xState::X_PARSE_OK;
+    assert(data != nullptr || len == 0);
+    p = xScanner::skipWhiteSpace(p, end);
+    if (p == end) {
+        ret = xState::X_PARSE_EXPECT_VALUE;
+        goto fail;
+    }
+    if (*p != '[') {
+        ret = xNotRecord(*p);
+        goto fail;
+    }
+    p = xScanner::skipWhiteSpace(p + 1, end);
+    if (p < end && *p == ']') {
+        p++;
+    } else {
+        for (;;) {
+            if (p == end || *p != '{') {
+                ret = p == end ? xState::X_PARSE_EXPECT_VALUE
+                    : xNotRecord(*p);
+                goto fail;
+            }
+            size_t before = cols.size();
+            if ((ret = parseRecord(p, end, &p)) != xState::X_PARSE_OK) {
+                /* the rows already taken stay, the broken one goes */
+                for (size_t i = 0; i < before; i++)
+                    if (cols[i].rows > count)
+                        xColumnPop(&cols[i]);
+                for (size_t i = before; i < cols.size(); i++)
+                    index.erase(cols[i].name);
+                cols.resize(before);
+                hints.clear();
+                goto fail;
+            }
+            p = xScanner::skipWhiteSpace(p, end);
+            if (p < end && *p == ',') {
+                p = xScanner::skipWhiteSpace(p + 1, end);
+                continue;
+            }
+            if (p < end && *p == ']') {
+                p++;
+                break;
+            }
+            ret = xState::X_PARSE_MISS_COMMA_OR_SQUARE_BRACKET;
+            goto fail;
+        }
+    }
+    p = xScanner::skipWhiteSpace(p, end);
+    if (p != end) {
+        ret = xState::X_PARSE_ROOT_NOT_SINGULAR;
+        goto fail;
+    }
+    if (offset != nullptr)
+        *offset = len;
+    return xState::X_PARSE_OK;
+fail:
+    if (offset != nullptr)
+        *offset = p - data;
+    return ret;
+}
+
+xState xColumnTable::append(const xValue* v) {
+    size_t i, j, len;
+    xCell cell = xCell();
+    assert(v != nullptr);
+    if (v->type != xType::X_TYPE_ARRAY)
+        return xState::X_PARSE_TYPE_MISMATCH;
+    /* a dense array holds numbers, not records */
+    if ((v->flags & (xJson::X_VALUE_FLAG_DENSE_DOUBLE
+        | xJson::X_VALUE_FLAG_DENSE_INT64)) && v->array.len > 0)
+        return xState::X_PARSE_TYPE_MISMATCH;
+    for (i = 0; i < v->array.len; i++)
+        if (v->array.e[i].type != xType::X_TYPE_OBJECT)
+            return xState::X_PARSE_TYPE_MISMATCH;
+    for (i = 0; i < v->array.len; i++) {
+        const xValue* record = &v->array.e[i];
+        for (j = 0; j < record->object.size; j++) {
+            const xValue* e = &record->object.m[j].v;
+            xColumn* c = find(record->object.m[j].k, record->object.m[j].klen, j);
+            char* json = nullptr;
+            cell = xCell();
+            switch (e->type) {
+                case xType::X_TYPE_NULL:
+                    continue;
+                case xType::X_TYPE_TRUE:
+                case xType::X_TYPE_FALSE:
+                    cell.type = xColumnType::X_COLUMN_BOOL;
+                    cell.b = e->type == xType::X_TYPE_TRUE;
+                    break;
+                case xType::X_TYPE_NUMBER:
+                    /* raw text is classified as parse does it */
+                    if (e->flags & xJson::X_VALUE_FLAG_RAW_NUMBER) {
+                        xNumberCell(&cell, e->str.s, e->str.s + e->str.len);
+                    } else if (xHelper::xGetInt64(e, &cell.i)) {
+                        cell.type = xColumnType::X_COLUMN_INT64;
+                    } else {
+                        cell.type = xColumnType::X_COLUMN_DOUBLE;
+                        cell.d = xHelper::xGetNumber(e);
+                    }
+                    break;
+                case xType::X_TYPE_STRING:
+                    cell.type = xColumnType::X_COLUMN_STRING;
+                    cell.s = xHelper::xGetString(e);
+                    cell.len = xHelper::xGetStringLength(e);
+                    break;
+                default:
+                    cell.type = xColumnType::X_COLUMN_JSON;
+                    cell.json = json = xStringify(e, &len);
+                    cell.jlen = len;
+                    break;
+            }
+            if (c->rows == count)
+                xColumnPut(c, &cell);
+            if (json != nullptr)
+                xJson::xDealloc(json, len + 1);
+        }
+        endRow();
+    }
+    return xState::X_PARSE_OK;
+}
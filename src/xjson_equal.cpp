@@ -0,0 +1,253 @@
+/*copyright 2021 xkxsxkx*/
+#include "xjson.h"
+#include "xjson_base64.h"
+#include <assert.h>
+#include <string.h>
+#include <string>
+
+using xJson::xValue;
+using xJson::xType;
+using xJson::xHelper;
+using xJson::xMember;
+using xJson::xHashCache;
+
+#define X_HASH_SEED_NULL   0x9e3779b97f4a7c15ULL
+#define X_HASH_SEED_FALSE  0xbf58476d1ce4e5b9ULL
+#define X_HASH_SEED_TRUE   0x94d049bb133111ebULL
+#define X_HASH_SEED_NUMBER 0x2545f4914f6cdd1dULL
+#define X_HASH_SEED_STRING 0x9fb21c651e98df25ULL
+#define X_HASH_SEED_ARRAY  0xd6e8feb86659fd93ULL
+#define X_HASH_SEED_OBJECT 0xa0761d6478bd642fULL
+
+/** both dense layouts, elements are 8 bytes either way */
+#define X_DENSE_FLAGS \
+    (xJson::X_VALUE_FLAG_DENSE_DOUBLE | xJson::X_VALUE_FLAG_DENSE_INT64)
+
+static inline uint64_t xHashMix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+/**
+ * @brief the text of a string. a binary one is encoded into tmp, not in
+ * place, so that comparing or hashing it keeps its bytes.
+ */
+static const char* xStringText(const xValue* v, std::string* tmp,
+    size_t* len) {
+    *len = xHelper::xGetStringLength(v);
+    if (v->flags & xJson::X_VALUE_FLAG_BINARY)
+        tmp->resize(*len + 1);
+    return xHelper::xGetString(v, &(*tmp)[0]);
+}
+
+/**
+ * @brief hash a byte range eight bytes at a time.
+ */
+static uint64_t xHashBytes(const char* p, size_t len, uint64_t seed) {
+    uint64_t h = seed ^ (len * 0x87c37b91114253d5ULL);
+    uint64_t w;
+    for (; len >= 8; p += 8, len -= 8) {
+        memcpy(&w, p, 8);
+        h = xHashMix(h ^ w) + 0x52dce729;
+    }
+    if (len > 0) {
+        w = 0;
+        memcpy(&w, p, len);
+        h = xHashMix(h ^ w);
+    }
+    return xHashMix(h);
+}
+
+static const xMember* xFindMember(const xValue* o, size_t hint,
+    const xMember* m) {
+    size_t i;
+    /* same member order is by far the common case */
+    if (hint < o->object.size && xJson::xSameKey(&o->object.m[hint], m))
+        return &o->object.m[hint];
+    if (o->flags & xJson::X_VALUE_FLAG_SORTED_KEYS) {
+        i = xHelper::xFindObjectIndex(o, m->k, m->klen);
+        return i != xJson::X_KEY_NOT_EXIST ? &o->object.m[i] : nullptr;
+    }
+    /* the stored hashes reject the other keys without reading them */
+    for (i = 0; i < o->object.size; i++)
+        if (xJson::xSameKey(&o->object.m[i], m))
+            return &o->object.m[i];
+    return nullptr;
+}
+
+/**
+ * @brief a number reduced to one form, an int64 when it is integral and
+ * fits, the double otherwise. equal numbers reduce alike whatever their
+ * layout, so comparing and hashing the forms is exact and transitive.
+ */
+typedef struct {
+    bool integral;
+    int64_t i;
+    double d;
+} xNumberForm;
+
+static inline xNumberForm xFormOf(const xValue* v) {
+    xNumberForm f = { true, 0, 0.0 };
+    if (!xHelper::xGetInt64(v, &f.i)) {
+        f.integral = false;
+        f.d = xHelper::xGetNumber(v);
+    }
+    return f;
+}
+
+/**
+ * @brief element i of an array as a number, read from a dense array
+ * without expanding it.
+ * @return bool false when the element is not a number
+ */
+static inline bool xElementForm(const xValue* a, size_t i, xNumberForm* f) {
+    xValue tmp;
+    if (a->flags & xJson::X_VALUE_FLAG_DENSE_INT64) {
+        f->integral = true;
+        f->i = a->dense.i[i];
+        return true;
+    }
+    if (a->flags & xJson::X_VALUE_FLAG_DENSE_DOUBLE) {
+        tmp.type = xType::X_TYPE_NUMBER;
+        tmp.flags = 0;
+        tmp.n = a->dense.d[i];
+        *f = xFormOf(&tmp);
+        return true;
+    }
+    if (a->array.e[i].type != xType::X_TYPE_NUMBER)
+        return false;
+    *f = xFormOf(&a->array.e[i]);
+    return true;
+}
+
+static inline bool xFormEqual(const xNumberForm& l, const xNumberForm& r) {
+    if (l.integral != r.integral)
+        return false;
+    return l.integral ? l.i == r.i : l.d == r.d;
+}
+
+static inline uint64_t xFormHash(const xNumberForm& f) {
+    uint64_t h = (uint64_t)f.i;
+    if (!f.integral)
+        memcpy(&h, &f.d, sizeof(h));
+    return xHashMix(h ^ X_HASH_SEED_NUMBER ^ f.integral);
+}
+
+bool xJson::xEqual(const xValue* lhs, const xValue* rhs) {
+    size_t i;
+    assert(lhs != nullptr && rhs != nullptr);
+    if (lhs == rhs)
+        return true;
+    if (lhs->type != rhs->type)
+        return false;
+    switch (lhs->type) {
+        case xType::X_TYPE_NUMBER:
+            return xFormEqual(xFormOf(lhs), xFormOf(rhs));
+        case xType::X_TYPE_STRING: {
+            std::string ltmp, rtmp;
+            const char* l;
+            const char* r;
+            size_t llen, rlen;
+            /* base64 is one to one, the bytes compare like the text */
+            if (lhs->flags & rhs->flags & xJson::X_VALUE_FLAG_BINARY)
+                return lhs->str.len == rhs->str.len
+                    && memcmp(lhs->str.s, rhs->str.s, lhs->str.len) == 0;
+            /* raw text with escapes must be decoded before comparing */
+            l = xStringText(lhs, &ltmp, &llen);
+            r = xStringText(rhs, &rtmp, &rlen);
+            return llen == rlen && memcmp(l, r, llen) == 0;
+        }
+        case xType::X_TYPE_ARRAY:
+            if (lhs->array.len != rhs->array.len)
+                return false;
+            if (lhs->array.e == rhs->array.e)
+                return true;
+            /* integers are compared exactly, not as doubles */
+            if ((lhs->flags & rhs->flags & xJson::X_VALUE_FLAG_DENSE_INT64))
+                return memcmp(lhs->dense.i, rhs->dense.i,
+                    lhs->dense.len * sizeof(int64_t)) == 0;
+            if ((lhs->flags | rhs->flags) & X_DENSE_FLAGS) {
+                for (i = 0; i < lhs->array.len; i++) {
+                    xNumberForm l, r;
+                    if (!xElementForm(lhs, i, &l) || !xElementForm(rhs, i, &r)
+                        || !xFormEqual(l, r))
+                        return false;
+                }
+                return true;
+            }
+            for (i = 0; i < lhs->array.len; i++)
+                if (!xEqual(&lhs->array.e[i], &rhs->array.e[i]))
+                    return false;
+            return true;
+        case xType::X_TYPE_OBJECT:
+            if (lhs->object.size != rhs->object.size)
+                return false;
+            if (lhs->object.m == rhs->object.m)
+                return true;
+            for (i = 0; i < lhs->object.size; i++) {
+                const xMember* m = &lhs->object.m[i];
+                const xMember* other = xFindMember(rhs, i, m);
+                if (other == nullptr || !xEqual(&m->v, &other->v))
+                    return false;
+            }
+            return true;
+        default:
+            return true;
+    }
+}
+
+uint64_t xJson::xHash(const xValue* v, xHashCache* cache) {
+    uint64_t h, sum;
+    size_t i;
+    assert(v != nullptr);
+    switch (v->type) {
+        case xType::X_TYPE_NULL:  return X_HASH_SEED_NULL;
+        case xType::X_TYPE_FALSE: return X_HASH_SEED_FALSE;
+        case xType::X_TYPE_TRUE:  return X_HASH_SEED_TRUE;
+        case xType::X_TYPE_NUMBER:
+            /* -0 reduces to the integer 0 like 0 does */
+            return xFormHash(xFormOf(v));
+        default: break;
+    }
+    if (cache != nullptr && cache->find(v, &h))
+        return h;
+    switch (v->type) {
+        case xType::X_TYPE_STRING: {
+            std::string tmp;
+            const char* s = xStringText(v, &tmp, &i);
+            h = xHashBytes(s, i, X_HASH_SEED_STRING);
+            break;
+        }
+        case xType::X_TYPE_ARRAY:
+            h = X_HASH_SEED_ARRAY ^ v->array.len;
+            for (i = 0; i < v->array.len; i++) {
+                xNumberForm f;
+                uint64_t e = (v->flags & X_DENSE_FLAGS)
+                    ? (xElementForm(v, i, &f), xFormHash(f))
+                    : xHash(&v->array.e[i], cache);
+                h = xHashMix(h ^ e) + 0x38495ab5;
+            }
+            h = xHashMix(h);
+            break;
+        case xType::X_TYPE_OBJECT:
+            /* members are summed so that their order does not matter */
+            sum = 0;
+            for (i = 0; i < v->object.size; i++) {
+                const xMember* m = &v->object.m[i];
+                sum += xHashMix((m->hash ^ X_HASH_SEED_STRING)
+                    ^ (xHash(&m->v, cache) * 0x9e3779b97f4a7c15ULL));
+            }
+            h = xHashMix(sum ^ X_HASH_SEED_OBJECT ^ v->object.size);
+            break;
+        default:
+            assert(0 && "invalid type");
+            h = 0;
+    }
+    if (cache != nullptr)
+        cache->insert(v, h);
+    return h;
+}
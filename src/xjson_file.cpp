@@ -0,0 +1,152 @@
+/*copyright 2021 xkxsxkx*/
+#include "xjson_file.h"
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define X_FILE_MMAP 1
+#endif
+
+using xJson::xState;
+using xJson::xMappedFile;
+using xJson::xMapOptions;
+
+xMappedFile::xMappedFile()
+    : base(nullptr), length(0), mapped(0), write(false) {}
+
+xMappedFile::~xMappedFile() {
+    close();
+}
+
+xMappedFile::xMappedFile(xMappedFile&& other) noexcept
+    : base(other.base), length(other.length), mapped(other.mapped),
+    write(other.write) {
+    other.base = nullptr;
+    other.length = other.mapped = 0;
+}
+
+xMappedFile& xMappedFile::operator=(xMappedFile&& other) noexcept {
+    if (this != &other) {
+        close();
+        base = other.base;
+        length = other.length;
+        mapped = other.mapped;
+        write = other.write;
+        other.base = nullptr;
+        other.length = other.mapped = 0;
+    }
+    return *this;
+}
+
+void xMappedFile::close() {
+    if (base != nullptr) {
+#if defined(X_FILE_MMAP)
+        munmap(base, mapped);
+#else
+        xJson::xDealloc(base, mapped);
+#endif
+    }
+    base = nullptr;
+    length = mapped = 0;
+}
+
+#if defined(X_FILE_MMAP)
+xState xMappedFile::open(const char* path, const xMapOptions* options) {
+    static const xMapOptions defaults;
+    struct stat st;
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    int fd, prot, flags, err;
+    char* p;
+    assert(path != nullptr);
+    close();
+    if (options == nullptr)
+        options = &defaults;
+    if ((fd = ::open(path, O_RDONLY)) < 0)
+        return xState::X_PARSE_FILE_ERROR;
+    if (fstat(fd, &st) != 0) {
+        err = errno;
+        ::close(fd);
+        errno = err;
+        return xState::X_PARSE_FILE_ERROR;
+    }
+    length = (size_t)st.st_size;
+    /*
+     * the file is mapped over an anonymous reservation one byte longer:
+     * the tail of its last page is zero-filled by the kernel and when the
+     * size is a multiple of the page size the zero page behind it is the
+     * terminator, so the end is never read past.
+     */
+    mapped = (length + 1 + page - 1) / page * page;
+    prot = PROT_READ | (options->writable ? PROT_WRITE : 0);
+    p = (char*)mmap(nullptr, mapped, prot, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == (char*)MAP_FAILED) {
+        err = errno;
+        ::close(fd);
+        length = mapped = 0;
+        errno = err;
+        return xState::X_PARSE_FILE_ERROR;
+    }
+    if (length > 0) {
+        flags = MAP_PRIVATE | MAP_FIXED;
+#if defined(MAP_POPULATE)
+        if (options->populate)
+            flags |= MAP_POPULATE;
+#endif
+#if defined(POSIX_FADV_SEQUENTIAL)
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+        if (mmap(p, length, prot, flags, fd, 0) == MAP_FAILED) {
+            err = errno;
+            munmap(p, mapped);
+            ::close(fd);
+            length = mapped = 0;
+            errno = err;
+            return xState::X_PARSE_FILE_ERROR;
+        }
+        madvise(p, length, MADV_SEQUENTIAL);
+#if defined(MADV_HUGEPAGE)
+        /* only a hint, file backed huge pages depend on the filesystem */
+        if (options->hugePages)
+            madvise(p, length, MADV_HUGEPAGE);
+#endif
+    }
+    ::close(fd);
+    base = p;
+    write = options->writable;
+    return xState::X_PARSE_OK;
+}
+#else
+xState xMappedFile::open(const char* path, const xMapOptions* options) {
+    FILE* f;
+    long size;
+    assert(path != nullptr);
+    close();
+    if ((f = fopen(path, "rb")) == nullptr)
+        return xState::X_PARSE_FILE_ERROR;
+    if (fseek(f, 0, SEEK_END) != 0 || (size = ftell(f)) < 0
+        || fseek(f, 0, SEEK_SET) != 0) {
+        fclose(f);
+        return xState::X_PARSE_FILE_ERROR;
+    }
+    length = (size_t)size;
+    mapped = length + 1;
+    base = (char*)xJson::xAlloc(mapped);
+    if (fread(base, 1, length, f) != length) {
+        fclose(f);
+        close();
+        return xState::X_PARSE_FILE_ERROR;
+    }
+    fclose(f);
+    base[length] = '\0';
+    /* the block is always writable */
+    write = true;
+    (void)options;
+    return xState::X_PARSE_OK;
+}
+#endif
@@ -0,0 +1,120 @@
+/*copyright 2021 xkxsxkx*/
+#include "xjson.h"
+#include "xjson_scan.h"
+#include <assert.h>
+#include <string.h>
+
+using xJson::xState;
+using xJson::xScanner;
+using xJson::xScanStack;
+using xJson::xWriter;
+using xJson::xFormatOptions;
+
+#ifndef X_FORMAT_BUFFER_SIZE
+#define X_FORMAT_BUFFER_SIZE 4096
+#endif
+
+/**
+ * @brief fixed output buffer in front of the writer, lexemes that do not
+ * fit are passed through without copying. it receives the events of
+ * xScanner::walkValue and lays them out.
+ */
+class xFormatBuffer : public xScanner::xScanSink {
+ public:
+    xFormatBuffer(const xWriter* out, const xFormatOptions* options)
+        : out(out), options(options), n(0),
+        pretty(options->indent > 0 || options->tabs) {}
+    ~xFormatBuffer() { flush(); }
+
+    void flush() {
+        if (n > 0)
+            out->write(out->ctx, buf, n);
+        n = 0;
+    }
+    void put(char ch) {
+        if (n == X_FORMAT_BUFFER_SIZE)
+            flush();
+        buf[n++] = ch;
+    }
+    void append(const char* p, size_t len) {
+        if (len > X_FORMAT_BUFFER_SIZE - n) {
+            flush();
+            if (len >= X_FORMAT_BUFFER_SIZE) {
+                out->write(out->ctx, p, len);
+                return;
+            }
+        }
+        memcpy(buf + n, p, len);
+        n += len;
+    }
+    /**
+     * @brief line break and indentation of the given depth.
+     */
+    void newline(size_t depth) {
+        static const char spaces[] = "                                ";
+        size_t width;
+        if (!pretty)
+            return;
+        put('\n');
+        if (options->tabs) {
+            for (; depth > 0; depth--)
+                put('\t');
+            return;
+        }
+        for (width = depth * options->indent; width > 32; width -= 32)
+            append(spaces, 32);
+        append(spaces, width);
+    }
+
+    void scalar(const char* p, const char* q) { append(p, q - p); }
+    void key(const char* p, const char* q) { append(p, q - p); }
+    void colon() {
+        if (pretty)
+            append(": ", 2);
+        else
+            put(':');
+    }
+    void open(char ch, size_t depth) {
+        (void)depth;
+        put(ch);
+    }
+    void first(size_t depth) { newline(depth); }
+    void comma(size_t depth) {
+        put(',');
+        newline(depth);
+    }
+    void close(char ch, size_t depth, bool empty) {
+        if (!empty)
+            newline(depth);
+        put(ch);
+    }
+
+ private:
+    const xWriter* out;
+    const xFormatOptions* options;
+    size_t n;
+    bool pretty;
+    char buf[X_FORMAT_BUFFER_SIZE];
+};
+
+xState xJson::xFormat(const char* data, size_t len, const xWriter* out,
+    const xFormatOptions* options, size_t* offset) {
+    const char* p = data;
+    const char* end = data + len;
+    xFormatOptions defaults;
+    xScanStack stack;
+    xState ret;
+    assert((data != nullptr || len == 0) && out != nullptr);
+    xFormatBuffer o(out, options != nullptr ? options : &defaults);
+    /* the walk of xValidate, every lexeme is copied as it was read */
+    p = xScanner::skipWhiteSpace(p, end);
+    if ((ret = xScanner::walkValue(p, end, &p, &stack, &o))
+        == xState::X_PARSE_OK) {
+        p = xScanner::skipWhiteSpace(p, end);
+        if (p != end)
+            ret = xState::X_PARSE_ROOT_NOT_SINGULAR;
+    }
+    if (offset != nullptr)
+        *offset = ret == xState::X_PARSE_OK ? len : p - data;
+    return ret;
+}
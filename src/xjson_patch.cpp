@@ -0,0 +1,713 @@
+/*copyright 2021 xkxsxkx*/
+#include "xjson_patch.h"
+#include "xjson_pointer.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+using xJson::xValue;
+using xJson::xType;
+using xJson::xHelper;
+using xJson::xMember;
+using xJson::xPatchState;
+using xJson::xHashCache;
+using xJson::xDiffOptions;
+
+#define xPatchNull(v) do { (v)->type = xType::X_TYPE_NULL; (v)->flags = 0; } while (0)
+
+xValue* xJson::xResolvePointer(const xValue* root,
+    const char* pointer, size_t len) {
+    const char* p = pointer;
+    const char* end = pointer + len;
+    xValue* v = const_cast<xValue*>(root);
+    std::string token;
+    size_t index;
+    assert(root != nullptr && (pointer != nullptr || len == 0));
+    if (len > 0 && *p != '/')
+        return nullptr;
+    while (p < end) {
+        p++;
+        if (!xPointerToken(&p, end, &token))
+            return nullptr;
+        if (v->type == xType::X_TYPE_OBJECT) {
+            v = xHelper::xFindObjectValue(v, token.data(), token.size());
+            if (v == nullptr)
+                return nullptr;
+        } else if (v->type == xType::X_TYPE_ARRAY) {
+            if (!xPointerIndex(token, &index) || index >= v->array.len)
+                return nullptr;
+            v = &xHelper::xGetArrayElements(v)[index];
+        } else {
+            return nullptr;
+        }
+    }
+    return v;
+}
+
+/**
+ * @brief applies the operations of one patch and keeps an undo log.
+ * containers are re-resolved from their pointer on undo, since later
+ * operations may have moved them in memory.
+ */
+class xPatcher {
+ public:
+    explicit xPatcher(xValue* doc) : doc(doc) {
+        xPatchNull(&carried);
+    }
+
+    xPatchState apply(const xValue* op) {
+        std::string name, path, from;
+        const xValue* value;
+        xValue temp;
+        xPatchState ret;
+        if (!field(op, "op", &name) || !field(op, "path", &path))
+            return xPatchState::X_PATCH_INVALID_OPERATION;
+        if (!xPointerValid(path.data(), path.size()))
+            return xPatchState::X_PATCH_INVALID_POINTER;
+        if (name == "test") {
+            if ((value = xHelper::xFindObjectValue(op, "value", 5)) == nullptr)
+                return xPatchState::X_PATCH_INVALID_OPERATION;
+            const xValue* target = xJson::xResolvePointer(doc,
+                path.data(), path.size());
+            if (target == nullptr)
+                return xPatchState::X_PATCH_PATH_NOT_FOUND;
+            return xJson::xEqual(target, value) ? xPatchState::X_PATCH_OK
+                : xPatchState::X_PATCH_TEST_FAILED;
+        }
+        if (name == "remove")
+            return remove(path.data(), path.size(), nullptr);
+        if (name == "add" || name == "replace") {
+            if ((value = xHelper::xFindObjectValue(op, "value", 5)) == nullptr)
+                return xPatchState::X_PATCH_INVALID_OPERATION;
+            xPatchNull(&temp);
+            xHelper::xCopy(&temp, value);
+            ret = name == "add"
+                ? add(path.data(), path.size(), &temp, false)
+                : replace(path.data(), path.size(), &temp);
+            xHelper::xSetNull(&temp);
+            return ret;
+        }
+        if (name == "move" || name == "copy") {
+            if (!field(op, "from", &from))
+                return xPatchState::X_PATCH_INVALID_OPERATION;
+            if (!xPointerValid(from.data(), from.size()))
+                return xPatchState::X_PATCH_INVALID_POINTER;
+            if (name == "copy") {
+                value = xJson::xResolvePointer(doc, from.data(), from.size());
+                if (value == nullptr)
+                    return xPatchState::X_PATCH_PATH_NOT_FOUND;
+                xPatchNull(&temp);
+                xHelper::xCopy(&temp, value);
+                ret = add(path.data(), path.size(), &temp, false);
+                xHelper::xSetNull(&temp);
+                return ret;
+            }
+            return move(from.data(), from.size(), path.data(), path.size());
+        }
+        return xPatchState::X_PATCH_INVALID_OPERATION;
+    }
+
+    /**
+     * @brief undo every logged step, newest first.
+     */
+    void rollback() {
+        while (!log.empty()) {
+            xUndo& u = log.back();
+            undo(&u);
+            log.pop_back();
+        }
+        xHelper::xSetNull(&carried);
+    }
+
+    /**
+     * @brief release what the applied operations replaced or removed.
+     */
+    void commit() {
+        for (xUndo& u : log) {
+            if (u.kind == X_UNDO_INSERTED)
+                continue;
+            if (u.kind == X_UNDO_REMOVED && u.member.k != nullptr
+                && !(u.member.flags & xJson::X_VALUE_FLAG_BORROWED))
+                xJson::xDealloc(u.member.k, u.member.klen + 1);
+            /* the source of a move was handed on, its slot is null */
+            xHelper::xSetNull(&u.member.v);
+        }
+        log.clear();
+    }
+
+ private:
+    enum { X_UNDO_INSERTED, X_UNDO_REMOVED, X_UNDO_REPLACED };
+    struct xUndo {
+        int kind;
+        bool root;
+        bool moved;        /* the value travels with a move operation */
+        std::string parent;
+        size_t index;
+        xMember member;    /* removed member or the replaced value */
+    };
+
+    xValue* doc;
+    xValue carried;        /* value of a move between its two steps */
+    std::vector<xUndo> log;
+
+    /**
+     * @brief copy the text of a string member of op, the operation keeps
+     * several at once and a binary value is only text through a copy.
+     */
+    static bool field(const xValue* op, const char* key, std::string* text) {
+        const xValue* v = xHelper::xFindObjectValue(op, key, strlen(key));
+        if (v == nullptr || v->type != xType::X_TYPE_STRING)
+            return false;
+        text->assign(xHelper::xGetString(v), xHelper::xGetStringLength(v));
+        return true;
+    }
+
+    /**
+     * @brief resolve the container of path and decode its last token.
+     */
+    xValue* parent(const char* path, size_t len, std::string* pointer,
+        std::string* token) {
+        const char* last = path + len;
+        while (last > path && last[-1] != '/')
+            last--;
+        assert(last > path);
+        pointer->assign(path, last - 1 - path);
+        if (!xPointerToken(&last, path + len, token))
+            return nullptr;
+        return xJson::xResolvePointer(doc, pointer->data(), pointer->size());
+    }
+
+    xUndo* record(int kind, const std::string& pointer, size_t index,
+        bool moved) {
+        log.emplace_back();
+        xUndo* u = &log.back();
+        u->kind = kind;
+        u->root = false;
+        u->moved = moved;
+        u->parent = pointer;
+        u->index = index;
+        u->member.k = nullptr;
+        u->member.klen = 0;
+        u->member.flags = 0;
+        u->member.hash = 0;
+        xPatchNull(&u->member.v);
+        return u;
+    }
+
+    /**
+     * @brief add the value, which is moved into doc.
+     */
+    xPatchState add(const char* path, size_t len, xValue* value, bool moved) {
+        std::string pointer, token;
+        xValue* p;
+        size_t index;
+        if (len == 0)
+            return replace(path, len, value, moved);
+        if ((p = parent(path, len, &pointer, &token)) == nullptr)
+            return xPatchState::X_PATCH_PATH_NOT_FOUND;
+        if (p->type == xType::X_TYPE_ARRAY) {
+            if (token == "-")
+                index = p->array.len;
+            else if (!xPointerIndex(token, &index) || index > p->array.len)
+                return xPatchState::X_PATCH_PATH_NOT_FOUND;
+            xHelper::xMove(xHelper::xInsertArrayElement(p, index), value);
+            record(X_UNDO_INSERTED, pointer, index, moved);
+        } else if (p->type == xType::X_TYPE_OBJECT) {
+            index = xHelper::xFindObjectIndex(p, token.data(), token.size());
+            if (index != xJson::X_KEY_NOT_EXIST)
+                return replaceAt(p, pointer, index, value, moved);
+            xHelper::xMove(xHelper::xSetObjectValue(p,
+                token.data(), token.size()), value);
+            record(X_UNDO_INSERTED, pointer, p->object.size - 1, moved);
+        } else {
+            return xPatchState::X_PATCH_PATH_NOT_FOUND;
+        }
+        return xPatchState::X_PATCH_OK;
+    }
+
+    xPatchState replaceAt(xValue* p, const std::string& pointer,
+        size_t index, xValue* value, bool moved) {
+        xValue* slot = p->type == xType::X_TYPE_ARRAY
+            ? &xHelper::xGetArrayElements(p)[index] : &p->object.m[index].v;
+        xUndo* u = record(X_UNDO_REPLACED, pointer, index, moved);
+        memcpy(&u->member.v, slot, sizeof(xValue));
+        memcpy(slot, value, sizeof(xValue));
+        xPatchNull(value);
+        return xPatchState::X_PATCH_OK;
+    }
+
+    xPatchState replace(const char* path, size_t len, xValue* value,
+        bool moved = false) {
+        std::string pointer, token;
+        xValue* p;
+        size_t index;
+        if (len == 0) {
+            xUndo* u = record(X_UNDO_REPLACED, pointer, 0, moved);
+            u->root = true;
+            memcpy(&u->member.v, doc, sizeof(xValue));
+            memcpy(doc, value, sizeof(xValue));
+            xPatchNull(value);
+            return xPatchState::X_PATCH_OK;
+        }
+        if ((p = parent(path, len, &pointer, &token)) == nullptr)
+            return xPatchState::X_PATCH_PATH_NOT_FOUND;
+        if (!locate(p, token, &index))
+            return xPatchState::X_PATCH_PATH_NOT_FOUND;
+        return replaceAt(p, pointer, index, value, moved);
+    }
+
+    static bool locate(const xValue* p, const std::string& token,
+        size_t* index) {
+        if (p->type == xType::X_TYPE_ARRAY)
+            return xPointerIndex(token, index) && *index < p->array.len;
+        if (p->type == xType::X_TYPE_OBJECT) {
+            *index = xHelper::xFindObjectIndex(p, token.data(), token.size());
+            return *index != xJson::X_KEY_NOT_EXIST;
+        }
+        return false;
+    }
+
+    /**
+     * @brief detach the target, out receives it for a move.
+     */
+    xPatchState remove(const char* path, size_t len, xValue* out) {
+        std::string pointer, token;
+        xValue* p;
+        size_t index;
+        if (len == 0)
+            return xPatchState::X_PATCH_INVALID_OPERATION;
+        if ((p = parent(path, len, &pointer, &token)) == nullptr
+            || !locate(p, token, &index))
+            return xPatchState::X_PATCH_PATH_NOT_FOUND;
+        xUndo* u = record(X_UNDO_REMOVED, pointer, index, out != nullptr);
+        if (p->type == xType::X_TYPE_ARRAY) {
+            xValue* e = &xHelper::xGetArrayElements(p)[index];
+            memcpy(&u->member.v, e, sizeof(xValue));
+            xPatchNull(e);
+            xHelper::xEraseArrayElement(p, index, 1);
+        } else {
+            memcpy(&u->member, &p->object.m[index], sizeof(xMember));
+            /* the log owns key and value now, only the slot is dropped */
+            p->object.m[index].flags = xJson::X_VALUE_FLAG_BORROWED;
+            xPatchNull(&p->object.m[index].v);
+            xHelper::xRemoveObjectValue(p, index);
+        }
+        if (out != nullptr) {
+            memcpy(out, &u->member.v, sizeof(xValue));
+            xPatchNull(&u->member.v);
+        }
+        return xPatchState::X_PATCH_OK;
+    }
+
+    xPatchState move(const char* from, size_t flen,
+        const char* path, size_t len) {
+        xPatchState ret;
+        if (flen == len && memcmp(from, path, len) == 0)
+            return xJson::xResolvePointer(doc, from, flen) != nullptr
+                ? xPatchState::X_PATCH_OK : xPatchState::X_PATCH_PATH_NOT_FOUND;
+        /* a value cannot be moved into one of its own children */
+        if (len > flen && memcmp(from, path, flen) == 0 && path[flen] == '/')
+            return xPatchState::X_PATCH_INVALID_OPERATION;
+        if ((ret = remove(from, flen, &carried)) != xPatchState::X_PATCH_OK)
+            return ret;
+        /* on failure carried is still owned here and restored by rollback */
+        return add(path, len, &carried, true);
+    }
+
+    /**
+     * @brief take the value out of a slot that is being undone.
+     */
+    void release(xValue* slot, bool moved) {
+        if (moved) {
+            memcpy(&carried, slot, sizeof(xValue));
+            xPatchNull(slot);
+        } else {
+            xHelper::xSetNull(slot);
+        }
+    }
+
+    void undo(xUndo* u) {
+        xValue* p = u->root ? doc
+            : xJson::xResolvePointer(doc, u->parent.data(), u->parent.size());
+        assert(p != nullptr);
+        switch (u->kind) {
+            case X_UNDO_INSERTED:
+                if (p->type == xType::X_TYPE_ARRAY) {
+                    release(&p->array.e[u->index], u->moved);
+                    xHelper::xEraseArrayElement(p, u->index, 1);
+                } else {
+                    release(&p->object.m[u->index].v, u->moved);
+                    xHelper::xRemoveObjectValue(p, u->index);
+                }
+                break;
+            case X_UNDO_REPLACED: {
+                xValue* slot = u->root ? doc
+                    : p->type == xType::X_TYPE_ARRAY ? &p->array.e[u->index]
+                    : &p->object.m[u->index].v;
+                release(slot, u->moved);
+                memcpy(slot, &u->member.v, sizeof(xValue));
+                break;
+            }
+            case X_UNDO_REMOVED:
+                if (u->moved) {
+                    memcpy(&u->member.v, &carried, sizeof(xValue));
+                    xPatchNull(&carried);
+                }
+                if (p->type == xType::X_TYPE_ARRAY) {
+                    memcpy(xHelper::xInsertArrayElement(p, u->index),
+                        &u->member.v, sizeof(xValue));
+                } else {
+                    p->object.m = (xMember*)xJson::xRealloc(p->object.m,
+                        p->object.size * sizeof(xMember),
+                        (p->object.size + 1) * sizeof(xMember));
+                    memmove(&p->object.m[u->index + 1], &p->object.m[u->index],
+                        (p->object.size - u->index) * sizeof(xMember));
+                    memcpy(&p->object.m[u->index], &u->member, sizeof(xMember));
+                    p->object.size++;
+                }
+                break;
+        }
+    }
+};
+
+xPatchState xJson::xApplyPatch(xValue* doc, const xValue* patch,
+    size_t* failed) {
+    xPatcher patcher(doc);
+    xPatchState ret = xPatchState::X_PATCH_OK;
+    const xValue* ops;
+    size_t i;
+    assert(doc != nullptr && patch != nullptr);
+    if (patch->type != xType::X_TYPE_ARRAY)
+        return xPatchState::X_PATCH_INVALID_OPERATION;
+    /* a dense patch holds numbers, they fail as operations below */
+    ops = xHelper::xGetArrayElements(patch);
+    for (i = 0; i < patch->array.len; i++) {
+        const xValue* op = &ops[i];
+        ret = op->type == xType::X_TYPE_OBJECT ? patcher.apply(op)
+            : xPatchState::X_PATCH_INVALID_OPERATION;
+        if (ret != xPatchState::X_PATCH_OK)
+            break;
+    }
+    if (ret != xPatchState::X_PATCH_OK) {
+        patcher.rollback();
+        if (failed != nullptr)
+            *failed = i;
+    } else {
+        patcher.commit();
+    }
+    return ret;
+}
+
+void xJson::xApplyMergePatch(xValue* doc, const xValue* patch) {
+    size_t i, index;
+    assert(doc != nullptr && patch != nullptr);
+    if (patch->type != xType::X_TYPE_OBJECT) {
+        xHelper::xCopy(doc, patch);
+        return;
+    }
+    if (doc->type != xType::X_TYPE_OBJECT)
+        xHelper::xSetObject(doc);
+    for (i = 0; i < patch->object.size; i++) {
+        const xMember* m = &patch->object.m[i];
+        if (m->v.type == xType::X_TYPE_NULL) {
+            index = xHelper::xFindObjectIndex(doc, m->k, m->klen);
+            if (index != xJson::X_KEY_NOT_EXIST)
+                xHelper::xRemoveObjectValue(doc, index);
+        } else {
+            xApplyMergePatch(xHelper::xSetObjectValue(doc, m->k, m->klen),
+                &m->v);
+        }
+    }
+}
+
+/**
+ * @brief walks two trees and collects the patch operations.
+ * the path of the current node is kept in one string that grows and
+ * shrinks with the recursion.
+ */
+class xDiffer {
+ public:
+    explicit xDiffer(const xDiffOptions& options)
+        : options(options),
+          cache(options.cache != nullptr ? options.cache : &local) {}
+
+    void diff(const xValue* a, const xValue* b) {
+        if (same(a, b))
+            return;
+        if (a->type != b->type) {
+            emit("replace", b);
+        } else if (a->type == xType::X_TYPE_OBJECT) {
+            diffObject(a, b);
+        } else if (a->type == xType::X_TYPE_ARRAY) {
+            diffArray(a, b);
+        } else {
+            emit("replace", b);
+        }
+    }
+
+    /**
+     * @brief move the collected operations into patch with one allocation.
+     */
+    void finish(xValue* patch) {
+        xHelper::xSetArray(patch);
+        if (ops.empty())
+            return;
+        patch->array.e = (xValue*)xJson::xAlloc(ops.size() * sizeof(xValue));
+        memcpy(patch->array.e, ops.data(), ops.size() * sizeof(xValue));
+        patch->array.len = ops.size();
+        ops.clear();
+    }
+
+    ~xDiffer() {
+        for (xValue& op : ops)
+            xHelper::xSetNull(&op);
+    }
+
+ private:
+    const xDiffOptions& options;
+    xHashCache local;
+    xHashCache* cache;
+    std::string path;
+    std::vector<xValue> ops;
+
+    bool same(const xValue* a, const xValue* b) {
+        if (a == b)
+            return true;
+        if (a->type != b->type || xJson::xHash(a, cache) != xJson::xHash(b, cache))
+            return false;
+        return xJson::xEqual(a, b);
+    }
+
+    void emit(const char* name, const xValue* value) {
+        ops.emplace_back();
+        xValue* op = &ops.back();
+        xPatchNull(op);
+        xHelper::xSetObject(op);
+        xHelper::xSetString(xHelper::xSetObjectValue(op, "op", 2),
+            name, strlen(name));
+        xHelper::xSetString(xHelper::xSetObjectValue(op, "path", 4),
+            path.data(), path.size());
+        if (value != nullptr)
+            xHelper::xCopy(xHelper::xSetObjectValue(op, "value", 5), value);
+    }
+
+    size_t pushKey(const char* key, size_t klen) {
+        size_t mark = path.size();
+        path.push_back('/');
+        for (size_t i = 0; i < klen; i++) {
+            if (key[i] == '~')
+                path.append("~0");
+            else if (key[i] == '/')
+                path.append("~1");
+            else
+                path.push_back(key[i]);
+        }
+        return mark;
+    }
+
+    size_t pushIndex(size_t index) {
+        size_t mark = path.size();
+        path.push_back('/');
+        path.append(std::to_string(index));
+        return mark;
+    }
+
+    void diffObject(const xValue* a, const xValue* b) {
+        std::vector<size_t> table;
+        std::vector<bool> seen(b->object.size, false);
+        size_t i, j, mark, mask = 0;
+        /*
+         * members mostly keep their order, so the same slot is tried first.
+         * large objects are indexed by the stored key hashes, open
+         * addressing that keeps the first of duplicate keys.
+         */
+        if (b->object.size > 8) {
+            for (mask = 15; mask < b->object.size * 2; mask = mask * 2 + 1) {}
+            table.assign(mask + 1, xJson::X_KEY_NOT_EXIST);
+            for (j = 0; j < b->object.size; j++) {
+                const xMember* bm = &b->object.m[j];
+                for (i = bm->hash & mask; table[i] != xJson::X_KEY_NOT_EXIST;
+                    i = (i + 1) & mask)
+                    if (xJson::xSameKey(&b->object.m[table[i]], bm))
+                        break;
+                if (table[i] == xJson::X_KEY_NOT_EXIST)
+                    table[i] = j;
+            }
+        }
+        for (i = 0; i < a->object.size; i++) {
+            const xMember* m = &a->object.m[i];
+            if (i < b->object.size && xJson::xSameKey(&b->object.m[i], m)) {
+                j = i;
+            } else if (!table.empty()) {
+                for (j = m->hash & mask; table[j] != xJson::X_KEY_NOT_EXIST
+                    && !xJson::xSameKey(&b->object.m[table[j]], m);
+                    j = (j + 1) & mask) {}
+                j = table[j];
+            } else {
+                for (j = 0; j < b->object.size
+                    && !xJson::xSameKey(&b->object.m[j], m); j++) {}
+                if (j == b->object.size)
+                    j = xJson::X_KEY_NOT_EXIST;
+            }
+            mark = pushKey(m->k, m->klen);
+            if (j == xJson::X_KEY_NOT_EXIST) {
+                emit("remove", nullptr);
+            } else if (!seen[j]) {
+                seen[j] = true;
+                diff(&m->v, &b->object.m[j].v);
+            }
+            path.resize(mark);
+        }
+        for (j = 0; j < b->object.size; j++) {
+            if (seen[j])
+                continue;
+            mark = pushKey(b->object.m[j].k, b->object.m[j].klen);
+            emit("add", &b->object.m[j].v);
+            path.resize(mark);
+        }
+    }
+
+    /**
+     * @brief the value array elements are matched on, the key member in
+     * keyed mode, otherwise the element itself.
+     */
+    const xValue* identity(const xValue* e) {
+        if (options.key != nullptr && e->type == xType::X_TYPE_OBJECT) {
+            const xValue* k = xHelper::xFindObjectValue(e,
+                options.key, options.klen);
+            if (k != nullptr)
+                return k;
+        }
+        return e;
+    }
+
+    bool match(const xValue* a, const xValue* b) {
+        const xValue* ia = identity(a);
+        const xValue* ib = identity(b);
+        if ((ia == a) != (ib == b))
+            return false;
+        return same(ia, ib);
+    }
+
+    void diffElement(const xValue* a, const xValue* b, size_t k) {
+        size_t mark = pushIndex(k);
+        diff(a, b);
+        path.resize(mark);
+    }
+
+    /**
+     * @brief the elements of a, the numbers of a dense array are copied
+     * into tmp so that a const input is read without being expanded.
+     */
+    static const xValue* elements(const xValue* a, std::vector<xValue>* tmp) {
+        const double* d = xHelper::xGetDoubleArray(a);
+        const int64_t* l = xHelper::xGetInt64Array(a);
+        if (d == nullptr && l == nullptr)
+            return a->array.e;
+        tmp->resize(a->array.len);
+        for (size_t i = 0; i < a->array.len; i++) {
+            xValue* e = &(*tmp)[i];
+            xPatchNull(e);
+            e->type = xType::X_TYPE_NUMBER;
+            e->n = d != nullptr ? d[i] : (double)l[i];
+        }
+        return tmp->data();
+    }
+
+    void diffArray(const xValue* a, const xValue* b) {
+        std::vector<xValue> da, db;
+        const xValue* ea = elements(a, &da);
+        const xValue* eb = elements(b, &db);
+        size_t lo = 0, ha = a->array.len, hb = b->array.len, i, j, k;
+        std::vector<char> script;
+        while (lo < ha && lo < hb && match(&ea[lo], &eb[lo])) {
+            diffElement(&ea[lo], &eb[lo], lo);
+            lo++;
+        }
+        while (ha > lo && hb > lo && match(&ea[ha - 1], &eb[hb - 1])) {
+            ha--;
+            hb--;
+        }
+        size_t n = ha - lo, m = hb - lo;
+        if (n > 0 && m > 0 && (n + 1) * (m + 1) <= options.lcsLimit) {
+            /* table[i][j] is the lcs length of ea[lo+i..ha) and eb[lo+j..hb) */
+            std::vector<uint32_t> table((n + 1) * (m + 1), 0);
+            std::vector<uint64_t> hb64(m);
+            for (j = 0; j < m; j++)
+                hb64[j] = xJson::xHash(identity(&eb[lo + j]), cache);
+            for (i = n; i-- > 0;) {
+                uint64_t h = xJson::xHash(identity(&ea[lo + i]), cache);
+                for (j = m; j-- > 0;) {
+                    size_t c = i * (m + 1) + j;
+                    if (h == hb64[j] && match(&ea[lo + i], &eb[lo + j]))
+                        table[c] = table[c + m + 2] + 1;
+                    else
+                        table[c] = std::max(table[c + m + 1], table[c + 1]);
+                }
+            }
+            for (i = 0, j = 0; i < n || j < m;) {
+                size_t c = i * (m + 1) + j;
+                if (i < n && j < m && table[c] == table[c + m + 2] + 1
+                    && match(&ea[lo + i], &eb[lo + j])) {
+                    script.push_back('M');
+                    i++;
+                    j++;
+                } else if (j == m || (i < n && table[c + m + 1] >= table[c + 1])) {
+                    script.push_back('D');
+                    i++;
+                } else {
+                    script.push_back('I');
+                    j++;
+                }
+            }
+        } else {
+            /* positional: every element of the middle is paired in order */
+            script.assign(n, 'D');
+            script.insert(script.end(), m, 'I');
+        }
+        k = lo;
+        i = lo;
+        j = lo;
+        for (size_t s = 0; s < script.size();) {
+            if (script[s] == 'M') {
+                diffElement(&ea[i++], &eb[j++], k++);
+                s++;
+                continue;
+            }
+            size_t d = 0, c = 0, p, t, mark;
+            for (; s < script.size() && script[s] != 'M'; s++)
+                script[s] == 'D' ? d++ : c++;
+            /* in keyed mode different keys are different entities */
+            p = options.key != nullptr ? 0 : std::min(d, c);
+            for (t = 0; t < p; t++)
+                diffElement(&ea[i + t], &eb[j + t], k + t);
+            k += p;
+            for (t = p; t < d; t++) {
+                mark = pushIndex(k);
+                emit("remove", nullptr);
+                path.resize(mark);
+            }
+            for (t = p; t < c; t++) {
+                mark = pushIndex(k++);
+                emit("add", &eb[j + t]);
+                path.resize(mark);
+            }
+            i += d;
+            j += c;
+        }
+        for (; i < a->array.len; i++, j++, k++)
+            diffElement(&ea[i], &eb[j], k);
+    }
+};
+
+void xJson::xDiff(xValue* patch, const xValue* from, const xValue* to,
+    const xDiffOptions* options) {
+    xDiffOptions defaults;
+    assert(patch != nullptr && from != nullptr && to != nullptr);
+    xDiffer differ(options != nullptr ? *options : defaults);
+    differ.diff(from, to);
+    differ.finish(patch);
+}
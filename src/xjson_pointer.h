@@ -0,0 +1,62 @@
+/* copyright 2021 xkxsxkx */
+#ifndef __XJSON_POINTER__H__
+#define __XJSON_POINTER__H__
+
+#include <stddef.h>
+#include <string>
+
+/* rfc 6901 pointer tokens, shared by the patch and shared document code */
+
+/**
+ * @brief decode the pointer token starting after the '/' at *p.
+ * @return bool false on a '~' not followed by '0' or '1'
+ */
+static inline bool xPointerToken(const char** p, const char* end,
+    std::string* token) {
+    const char* q = *p;
+    token->clear();
+    for (; q < end && *q != '/'; q++) {
+        if (*q != '~') {
+            token->push_back(*q);
+        } else if (q + 1 < end && (q[1] == '0' || q[1] == '1')) {
+            token->push_back(q[1] == '0' ? '~' : '/');
+            q++;
+        } else {
+            return false;
+        }
+    }
+    *p = q;
+    return true;
+}
+
+/**
+ * @brief array index token, digits without leading zeros.
+ */
+static inline bool xPointerIndex(const std::string& token, size_t* index) {
+    size_t i, n = 0;
+    if (token.empty() || (token[0] == '0' && token.size() > 1))
+        return false;
+    for (i = 0; i < token.size(); i++) {
+        if (token[i] < '0' || token[i] > '9' || n > ((size_t)-1 - 9) / 10)
+            return false;
+        n = n * 10 + (token[i] - '0');
+    }
+    *index = n;
+    return true;
+}
+
+static inline bool xPointerValid(const char* pointer, size_t len) {
+    const char* p = pointer;
+    const char* end = pointer + len;
+    std::string token;
+    if (len > 0 && *p != '/')
+        return false;
+    while (p < end) {
+        p++;
+        if (!xPointerToken(&p, end, &token))
+            return false;
+    }
+    return true;
+}
+
+#endif  //!__XJSON_POINTER__H__
@@ -0,0 +1,793 @@
+/*copyright 2021 xkxsxkx*/
+#include "xjson_query.h"
+#include "xjson_lexer.h"
+#include "xjson_scan.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+using xJson::xState;
+using xJson::xType;
+using xJson::xLexer;
+using xJson::xScanner;
+using xJson::xScanStack;
+using xJson::xWriter;
+using xJson::xQuery;
+using xJson::xQueryState;
+using xJson::xQueryStep;
+using xJson::xQueryLiteral;
+using xJson::xQueryCond;
+using xJson::xQueryField;
+using xJson::xQueryStage;
+
+#ifndef X_QUERY_FLUSH_SIZE
+#define X_QUERY_FLUSH_SIZE 4096
+#endif
+
+typedef std::vector<xQueryStep> xQueryPath;
+
+struct xStringSink {
+    std::string* s;
+    void put(char ch) { s->push_back(ch); }
+};
+
+/* ---------------------------------------------------------------- compile */
+
+/**
+ * @brief recursive descent over the expression, the first error stops it.
+ */
+struct xQueryParser {
+    const char* p;
+    xQueryState state;
+    std::vector<xQueryCond>* conds;
+};
+
+static bool xQueryFail(xQueryParser* c, xQueryState state) {
+    if (c->state == xQueryState::X_QUERY_OK)
+        c->state = state;
+    return false;
+}
+
+static void xQuerySpace(xQueryParser* c) {
+    while (*c->p == ' ' || *c->p == '\t' || *c->p == '\n' || *c->p == '\r')
+        c->p++;
+}
+
+static inline bool xIsIdentStart(char ch) {
+    return (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || ch == '_';
+}
+
+static inline bool xIsIdent(char ch) {
+    return xIsIdentStart(ch) || (ch >= '0' && ch <= '9');
+}
+
+static bool xQueryIdent(xQueryParser* c, std::string* name) {
+    const char* begin = c->p;
+    if (!xIsIdentStart(*c->p))
+        return false;
+    while (xIsIdent(*c->p))
+        c->p++;
+    name->assign(begin, c->p - begin);
+    return true;
+}
+
+/** @brief the keyword at the current position, as a whole word */
+static bool xQueryKeyword(xQueryParser* c, const char* word) {
+    size_t len = strlen(word);
+    if (strncmp(c->p, word, len) != 0 || xIsIdent(c->p[len]))
+        return false;
+    c->p += len;
+    return true;
+}
+
+static bool xQueryString(xQueryParser* c, std::string* s) {
+    xStringSink sink = { s };
+    s->clear();
+    if (*c->p != '"')
+        return false;
+    if (xLexer::scanString(c->p + 1, &c->p, &sink) != xState::X_PARSE_OK)
+        return xQueryFail(c, xQueryState::X_QUERY_INVALID);
+    return true;
+}
+
+/**
+ * @brief a path starting at '.', a lone '.' is the identity.
+ */
+static bool xQueryParsePath(xQueryParser* c, xQueryPath* path) {
+    xQueryStep step;
+    assert(*c->p == '.');
+    c->p++;
+    if (*c->p == '.')
+        return xQueryFail(c, xQueryState::X_QUERY_UNSUPPORTED);
+    for (bool dot = true;; dot = false) {
+        if (dot || *c->p == '.') {
+            if (!dot)
+                c->p++;
+            step.kind = xQueryStep::FIELD;
+            if (xQueryIdent(c, &step.name) || xQueryString(c, &step.name)) {
+                path->push_back(step);
+                continue;
+            }
+            if (c->state != xQueryState::X_QUERY_OK)
+                return false;
+            if (!dot && *c->p != '[')
+                return xQueryFail(c, xQueryState::X_QUERY_INVALID);
+        }
+        if (*c->p != '[')
+            return true;
+        c->p++;
+        xQuerySpace(c);
+        if (*c->p == ']') {
+            c->p++;
+            step.kind = xQueryStep::ITERATE;
+            path->push_back(step);
+            continue;
+        }
+        if (*c->p == '"') {
+            step.kind = xQueryStep::FIELD;
+            if (!xQueryString(c, &step.name))
+                return false;
+        } else if (*c->p >= '0' && *c->p <= '9') {
+            step.kind = xQueryStep::INDEX;
+            step.index = (size_t)strtoull(c->p, (char**)&c->p, 10);
+        } else {
+            /* negative indices, slices and expressions */
+            return xQueryFail(c, xQueryState::X_QUERY_UNSUPPORTED);
+        }
+        xQuerySpace(c);
+        if (*c->p != ']')
+            return xQueryFail(c, *c->p == ':' || *c->p == ','
+                ? xQueryState::X_QUERY_UNSUPPORTED : xQueryState::X_QUERY_INVALID);
+        c->p++;
+        path->push_back(step);
+    }
+}
+
+/** @brief a path that yields one value, as in conditions and fields */
+static bool xQuerySinglePath(xQueryParser* c, xQueryPath* path) {
+    if (!xQueryParsePath(c, path))
+        return false;
+    for (const xQueryStep& s : *path)
+        if (s.kind == xQueryStep::ITERATE)
+            return xQueryFail(c, xQueryState::X_QUERY_UNSUPPORTED);
+    return true;
+}
+
+static bool xQueryLiteralValue(xQueryParser* c, xQueryLiteral* lit) {
+    const char* end;
+    if (*c->p == '"') {
+        lit->type = xType::X_TYPE_STRING;
+        return xQueryString(c, &lit->s);
+    }
+    if (xQueryKeyword(c, "null")) {
+        lit->type = xType::X_TYPE_NULL;
+    } else if (xQueryKeyword(c, "true")) {
+        lit->type = xType::X_TYPE_TRUE;
+    } else if (xQueryKeyword(c, "false")) {
+        lit->type = xType::X_TYPE_FALSE;
+    } else if (*c->p == '-' || (*c->p >= '0' && *c->p <= '9')) {
+        if (xLexer::scanNumber(c->p, &end) != xState::X_PARSE_OK)
+            return xQueryFail(c, xQueryState::X_QUERY_INVALID);
+        lit->type = xType::X_TYPE_NUMBER;
+        lit->n = strtod(c->p, nullptr);
+        c->p = end;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static bool xQueryOperator(xQueryParser* c, xQueryCond::Op* op) {
+    static const struct { const char* text; xQueryCond::Op op; } ops[] = {
+        { "==", xQueryCond::EQ }, { "!=", xQueryCond::NE },
+        { "<=", xQueryCond::LE }, { ">=", xQueryCond::GE },
+        { "<", xQueryCond::LT }, { ">", xQueryCond::GT },
+    };
+    for (const auto& o : ops) {
+        size_t len = strlen(o.text);
+        if (strncmp(c->p, o.text, len) == 0) {
+            c->p += len;
+            *op = o.op;
+            return true;
+        }
+    }
+    return false;
+}
+
+/** @brief the operator seen from the other side, 1 < .a is .a > 1 */
+static xQueryCond::Op xQueryMirror(xQueryCond::Op op) {
+    switch (op) {
+        case xQueryCond::LT: return xQueryCond::GT;
+        case xQueryCond::LE: return xQueryCond::GE;
+        case xQueryCond::GT: return xQueryCond::LT;
+        case xQueryCond::GE: return xQueryCond::LE;
+        default: return op;
+    }
+}
+
+static bool xQueryParseOr(xQueryParser* c, size_t* node);
+
+static bool xQueryParseCompare(xQueryParser* c, size_t* node) {
+    xQueryCond cond;
+    bool leftPath;
+    xQuerySpace(c);
+    if (*c->p == '(') {
+        c->p++;
+        if (!xQueryParseOr(c, node))
+            return false;
+        xQuerySpace(c);
+        if (*c->p != ')')
+            return xQueryFail(c, xQueryState::X_QUERY_INVALID);
+        c->p++;
+        return true;
+    }
+    if (*c->p == '.') {
+        leftPath = true;
+        if (!xQuerySinglePath(c, &cond.path))
+            return false;
+    } else if (xQueryLiteralValue(c, &cond.literal)) {
+        leftPath = false;
+    } else {
+        return xQueryFail(c, c->state != xQueryState::X_QUERY_OK ? c->state
+            : xIsIdentStart(*c->p) || *c->p == '$' || *c->p == '['
+            ? xQueryState::X_QUERY_UNSUPPORTED : xQueryState::X_QUERY_INVALID);
+    }
+    xQuerySpace(c);
+    if (!xQueryOperator(c, &cond.op)) {
+        /* a constant condition is not worth a plan node */
+        if (!leftPath)
+            return xQueryFail(c, xQueryState::X_QUERY_UNSUPPORTED);
+        cond.op = xQueryCond::TRUTHY;
+    } else {
+        xQuerySpace(c);
+        if (leftPath) {
+            if (!xQueryLiteralValue(c, &cond.literal))
+                return xQueryFail(c, c->state != xQueryState::X_QUERY_OK
+                    ? c->state : *c->p == '.' || *c->p == '$' || *c->p == '['
+                    || *c->p == '{' || xIsIdentStart(*c->p)
+                    ? xQueryState::X_QUERY_UNSUPPORTED : xQueryState::X_QUERY_INVALID);
+        } else {
+            if (*c->p != '.')
+                return xQueryFail(c, xQueryState::X_QUERY_UNSUPPORTED);
+            if (!xQuerySinglePath(c, &cond.path))
+                return false;
+            cond.op = xQueryMirror(cond.op);
+        }
+    }
+    c->conds->push_back(cond);
+    *node = c->conds->size() - 1;
+    return true;
+}
+
+static bool xQueryParseAnd(xQueryParser* c, size_t* node) {
+    xQueryCond cond;
+    size_t rhs;
+    if (!xQueryParseCompare(c, node))
+        return false;
+    for (;;) {
+        xQuerySpace(c);
+        if (!xQueryKeyword(c, "and"))
+            return true;
+        if (!xQueryParseCompare(c, &rhs))
+            return false;
+        cond.op = xQueryCond::AND;
+        cond.lhs = *node;
+        cond.rhs = rhs;
+        c->conds->push_back(cond);
+        *node = c->conds->size() - 1;
+    }
+}
+
+static bool xQueryParseOr(xQueryParser* c, size_t* node) {
+    xQueryCond cond;
+    size_t rhs;
+    if (!xQueryParseAnd(c, node))
+        return false;
+    for (;;) {
+        xQuerySpace(c);
+        if (!xQueryKeyword(c, "or"))
+            return true;
+        if (!xQueryParseAnd(c, &rhs))
+            return false;
+        cond.op = xQueryCond::OR;
+        cond.lhs = *node;
+        cond.rhs = rhs;
+        c->conds->push_back(cond);
+        *node = c->conds->size() - 1;
+    }
+}
+
+static bool xQueryParseObject(xQueryParser* c, xQueryStage* stage) {
+    xQueryField field;
+    std::string name;
+    c->p++;
+    for (;;) {
+        xQuerySpace(c);
+        if (*c->p == '}' && stage->fields.empty()) {
+            c->p++;
+            return true;
+        }
+        if (!xQueryIdent(c, &name) && !xQueryString(c, &name))
+            return xQueryFail(c, c->state != xQueryState::X_QUERY_OK ? c->state
+                : *c->p == '$' || *c->p == '(' ? xQueryState::X_QUERY_UNSUPPORTED
+                : xQueryState::X_QUERY_INVALID);
+        field.key.clear();
+        xScanner::appendQuoted(&field.key, name.data(), name.size());
+        field.path.clear();
+        xQuerySpace(c);
+        if (*c->p == ':') {
+            c->p++;
+            xQuerySpace(c);
+            if (*c->p != '.')
+                return xQueryFail(c, xQueryState::X_QUERY_UNSUPPORTED);
+            if (!xQuerySinglePath(c, &field.path))
+                return false;
+            xQuerySpace(c);
+        } else {
+            xQueryStep step;
+            step.kind = xQueryStep::FIELD;
+            step.name = name;
+            field.path.push_back(step);
+        }
+        stage->fields.push_back(field);
+        if (*c->p == '}') {
+            c->p++;
+            return true;
+        }
+        if (*c->p != ',')
+            return xQueryFail(c, xQueryState::X_QUERY_INVALID);
+        c->p++;
+    }
+}
+
+static bool xQueryParseStage(xQueryParser* c, xQueryStage* stage) {
+    xQuerySpace(c);
+    if (*c->p == '.') {
+        stage->kind = xQueryStage::PATH;
+        return xQueryParsePath(c, &stage->path);
+    }
+    if (*c->p == '{') {
+        stage->kind = xQueryStage::OBJECT;
+        return xQueryParseObject(c, stage);
+    }
+    if (xQueryKeyword(c, "select")) {
+        stage->kind = xQueryStage::SELECT;
+        xQuerySpace(c);
+        if (*c->p != '(')
+            return xQueryFail(c, xQueryState::X_QUERY_INVALID);
+        c->p++;
+        if (!xQueryParseOr(c, &stage->cond))
+            return false;
+        xQuerySpace(c);
+        if (*c->p != ')')
+            return xQueryFail(c, xQueryState::X_QUERY_INVALID);
+        c->p++;
+        return true;
+    }
+    /* builtins, variables, array construction, literals ... */
+    if (*c->p == '\0' || *c->p == '|')
+        return xQueryFail(c, xQueryState::X_QUERY_INVALID);
+    return xQueryFail(c, xQueryState::X_QUERY_UNSUPPORTED);
+}
+
+xQueryState xQuery::compile(const char* expr, size_t* offset) {
+    xQueryParser c;
+    assert(expr != nullptr);
+    stages.clear();
+    conds.clear();
+    c.p = expr;
+    c.state = xQueryState::X_QUERY_OK;
+    c.conds = &conds;
+    for (;;) {
+        xQueryStage stage;
+        if (!xQueryParseStage(&c, &stage))
+            break;
+        /* .a | .b[] runs as .a.b[] */
+        if (stage.kind == xQueryStage::PATH && !stages.empty()
+            && stages.back().kind == xQueryStage::PATH)
+            stages.back().path.insert(stages.back().path.end(),
+                stage.path.begin(), stage.path.end());
+        else
+            stages.push_back(stage);
+        xQuerySpace(&c);
+        if (*c.p == '\0')
+            break;
+        if (*c.p != '|') {
+            xQueryFail(&c, *c.p == ',' || *c.p == '?' || *c.p == '/'
+                || *c.p == '+' || *c.p == '-' || *c.p == '*'
+                ? xQueryState::X_QUERY_UNSUPPORTED : xQueryState::X_QUERY_INVALID);
+            break;
+        }
+        c.p++;
+    }
+    if (c.state != xQueryState::X_QUERY_OK) {
+        stages.clear();
+        conds.clear();
+    }
+    if (offset != nullptr)
+        *offset = c.p - expr;
+    return c.state;
+}
+
+/* -------------------------------------------------------------------- run */
+
+/**
+ * @brief the text of one value. a null begin stands for a missing value,
+ * which reads as null.
+ */
+struct xSpan {
+    const char* p;
+    const char* e;
+};
+
+static const xSpan xMissing = { nullptr, nullptr };
+
+/**
+ * @brief one run of a plan. the first stage, when it is a path, walks the
+ * input and checks it in the same pass; the later stages only see ranges
+ * that were checked already, in the input or built by an object stage.
+ */
+class xQueryRun {
+ public:
+    xQueryRun(const std::vector<xQueryStage>& stages,
+        const std::vector<xQueryCond>& conds, const xWriter* out)
+        : stages(stages), conds(conds), out(out), count(0),
+        scratch(stages.size()) {}
+    ~xQueryRun() { flush(); }
+
+    const std::vector<xQueryStage>& stages;
+    const std::vector<xQueryCond>& conds;
+    const xWriter* out;
+    size_t count;
+    std::string buf;
+    std::string tmp;
+    std::vector<std::string> scratch;   /* output of object stages */
+    xScanStack stack;
+
+    void flush() {
+        if (!buf.empty())
+            out->write(out->ctx, buf.data(), buf.size());
+        buf.clear();
+    }
+
+    void result() {
+        buf.push_back('\n');
+        count++;
+        if (buf.size() >= X_QUERY_FLUSH_SIZE)
+            flush();
+    }
+
+    /** @brief step over a value that was checked already */
+    const char* skip(const char* p, const char* end) {
+        const char* q;
+        xState ret = xScanner::skipValue(p, end, &q, &stack);
+        assert(ret == xState::X_PARSE_OK);
+        (void)ret;
+        return q;
+    }
+
+    /**
+     * @brief the next element or member of a checked container.
+     * @param more set when p is followed by a comma
+     */
+    static const char* next(const char* p, const char* end, bool* more) {
+        p = xScanner::skipWhiteSpace(p, end);
+        *more = *p == ',';
+        return xScanner::skipWhiteSpace(p + 1, end);
+    }
+
+    /** @brief the key [k, ke) equals name */
+    bool sameKey(const char* k, const char* ke, bool escapes,
+        const std::string& name) {
+        if (!escapes)
+            return (size_t)(ke - k) == name.size()
+                && memcmp(k, name.data(), name.size()) == 0;
+        tmp.assign(k, ke - k);
+        tmp.resize(xLexer::unescape(&tmp[0], tmp.size()));
+        return tmp == name;
+    }
+
+    /** @brief .name of a checked value, the first member of that name */
+    xSpan member(const xSpan& v, const std::string& name) {
+        const char* p;
+        const char* ke;
+        bool escapes, more = true;
+        if (v.p == nullptr || *v.p != '{')
+            return xMissing;
+        p = xScanner::skipWhiteSpace(v.p + 1, v.e);
+        if (*p == '}')
+            return xMissing;
+        while (more) {
+            escapes = false;
+            xScanner::scanString(p + 1, v.e, &ke, &escapes);
+            bool same = sameKey(p + 1, ke - 1, escapes, name);
+            p = xScanner::skipWhiteSpace(ke, v.e);
+            p = xScanner::skipWhiteSpace(p + 1, v.e);
+            const char* e = skip(p, v.e);
+            if (same)
+                return { p, e };
+            p = next(e, v.e, &more);
+        }
+        return xMissing;
+    }
+
+    /** @brief [index] of a checked value */
+    xSpan element(const xSpan& v, size_t index) {
+        const char* p;
+        bool more = true;
+        if (v.p == nullptr || *v.p != '[')
+            return xMissing;
+        p = xScanner::skipWhiteSpace(v.p + 1, v.e);
+        if (*p == ']')
+            return xMissing;
+        for (size_t i = 0; more; i++) {
+            const char* e = skip(p, v.e);
+            if (i == index)
+                return { p, e };
+            p = next(e, v.e, &more);
+        }
+        return xMissing;
+    }
+
+    xSpan resolve(xSpan v, const xQueryPath& path) {
+        for (const xQueryStep& s : path)
+            v = s.kind == xQueryStep::FIELD ? member(v, s.name)
+                : element(v, s.index);
+        return v;
+    }
+
+    /** @brief jq's order of types: null, false, true, numbers, strings ... */
+    static int rankOf(const char* p) {
+        switch (p == nullptr ? 'n' : *p) {
+            case 'n': return 0;
+            case 'f': return 1;
+            case 't': return 2;
+            case '"': return 4;
+            case '[': return 5;
+            case '{': return 6;
+            default: return 3;
+        }
+    }
+
+    static int rankOf(xType type) {
+        switch (type) {
+            case xType::X_TYPE_NULL: return 0;
+            case xType::X_TYPE_FALSE: return 1;
+            case xType::X_TYPE_TRUE: return 2;
+            case xType::X_TYPE_NUMBER: return 3;
+            default: return 4;
+        }
+    }
+
+    int compare(const xSpan& v, const xQueryLiteral& lit) {
+        int r = rankOf(v.p), l = rankOf(lit.type);
+        if (r != l)
+            return r < l ? -1 : 1;
+        if (r == 3) {
+            double d = xScanner::toDouble(v.p, v.e);
+            return d < lit.n ? -1 : d > lit.n ? 1 : 0;
+        }
+        if (r == 4) {
+            const char* s = v.p + 1;
+            size_t len = v.e - v.p - 2;
+            if (memchr(s, '\\', len) != nullptr) {
+                tmp.assign(s, len);
+                tmp.resize(xLexer::unescape(&tmp[0], tmp.size()));
+                s = tmp.data();
+                len = tmp.size();
+            }
+            /* utf-8 bytes sort like code points */
+            size_t n = len < lit.s.size() ? len : lit.s.size();
+            int c = n > 0 ? memcmp(s, lit.s.data(), n) : 0;
+            if (c != 0)
+                return c < 0 ? -1 : 1;
+            return len < lit.s.size() ? -1 : len > lit.s.size() ? 1 : 0;
+        }
+        return 0;
+    }
+
+    bool test(size_t node, const xSpan& v) {
+        const xQueryCond& c = conds[node];
+        int order;
+        switch (c.op) {
+            case xQueryCond::AND: return test(c.lhs, v) && test(c.rhs, v);
+            case xQueryCond::OR: return test(c.lhs, v) || test(c.rhs, v);
+            case xQueryCond::TRUTHY: return rankOf(resolve(v, c.path).p) > 1;
+            default: break;
+        }
+        order = compare(resolve(v, c.path), c.literal);
+        switch (c.op) {
+            case xQueryCond::EQ: return order == 0;
+            case xQueryCond::NE: return order != 0;
+            case xQueryCond::LT: return order < 0;
+            case xQueryCond::LE: return order <= 0;
+            case xQueryCond::GT: return order > 0;
+            default: return order >= 0;
+        }
+    }
+
+    /** @brief append a checked value, minified */
+    static void write(std::string* s, const xSpan& v) {
+        if (v.p == nullptr) {
+            s->append("null", 4);
+            return;
+        }
+        xWriter w = { xScanner::appendWriter, s };
+        xJson::xFormat(v.p, v.e - v.p, &w);
+    }
+
+    /** @brief feed v to stage k, past the last stage it is a result */
+    void process(size_t k, const xSpan& v) {
+        if (k == stages.size()) {
+            write(&buf, v);
+            result();
+            return;
+        }
+        const xQueryStage& stage = stages[k];
+        if (stage.kind == xQueryStage::PATH) {
+            walk(k, v, 0);
+        } else if (stage.kind == xQueryStage::SELECT) {
+            if (test(stage.cond, v))
+                process(k + 1, v);
+        } else {
+            /* the last stage writes straight into the output */
+            bool last = k + 1 == stages.size();
+            std::string* s = last ? &buf : &scratch[k];
+            if (!last)
+                s->clear();
+            s->push_back('{');
+            for (size_t i = 0; i < stage.fields.size(); i++) {
+                if (i > 0)
+                    s->push_back(',');
+                s->append(stage.fields[i].key);
+                s->push_back(':');
+                write(s, resolve(v, stage.fields[i].path));
+            }
+            s->push_back('}');
+            if (last)
+                result();
+            else
+                process(k + 1, { s->data(), s->data() + s->size() });
+        }
+    }
+
+    /** @brief the path of stage k from step i over a checked value */
+    void walk(size_t k, xSpan v, size_t i) {
+        const xQueryPath& path = stages[k].path;
+        for (; i < path.size() && path[i].kind != xQueryStep::ITERATE; i++)
+            v = path[i].kind == xQueryStep::FIELD ? member(v, path[i].name)
+                : element(v, path[i].index);
+        if (i == path.size()) {
+            process(k + 1, v);
+            return;
+        }
+        if (v.p == nullptr || (*v.p != '[' && *v.p != '{'))
+            return;
+        bool object = *v.p == '{', more = true;
+        const char* p = xScanner::skipWhiteSpace(v.p + 1, v.e);
+        if (*p == (object ? '}' : ']'))
+            return;
+        while (more) {
+            if (object) {
+                xScanner::scanString(p + 1, v.e, &p);
+                p = xScanner::skipWhiteSpace(p, v.e);
+                p = xScanner::skipWhiteSpace(p + 1, v.e);
+            }
+            const char* e = skip(p, v.e);
+            walk(k, { p, e }, i + 1);
+            p = next(e, v.e, &more);
+        }
+    }
+
+    /**
+     * @brief the path of the first stage from step i over unchecked input,
+     * each byte is checked as the walk passes it and the members that do
+     * not match are only scanned.
+     * @param out first byte after the value, or the error position
+     */
+    xState scan(const char* p, const char* end, size_t i, const char** out) {
+        const xQueryPath& path = stages[0].path;
+        const char* key;
+        size_t index;
+        bool object, found = false;
+        xState ret;
+        if (i == path.size()) {
+            if ((ret = xScanner::skipValue(p, end, out, &stack))
+                == xState::X_PARSE_OK)
+                process(1, { p, *out });
+            return ret;
+        }
+        const xQueryStep& s = path[i];
+        if (p < end && *p == '{' && s.kind != xQueryStep::INDEX) {
+            object = true;
+        } else if (p < end && *p == '[' && s.kind != xQueryStep::FIELD) {
+            object = false;
+        } else {
+            if ((ret = xScanner::skipValue(p, end, out, &stack))
+                == xState::X_PARSE_OK && s.kind != xQueryStep::ITERATE)
+                walk(0, xMissing, i + 1);
+            return ret;
+        }
+        p = xScanner::skipWhiteSpace(p + 1, end);
+        if (p < end && *p == (object ? '}' : ']')) {
+            p++;
+        } else {
+            for (index = 0;; index++) {
+                bool match, escapes = false;
+                if (object) {
+                    if (p == end || *p != '"') {
+                        ret = xState::X_PARSE_MISS_KEY;
+                        goto fail;
+                    }
+                    key = p + 1;
+                    if ((ret = xScanner::scanString(key, end, &p, &escapes))
+                        != xState::X_PARSE_OK)
+                        goto fail;
+                    match = s.kind == xQueryStep::ITERATE
+                        || (!found && sameKey(key, p - 1, escapes, s.name));
+                    p = xScanner::skipWhiteSpace(p, end);
+                    if (p == end || *p != ':') {
+                        ret = xState::X_PARSE_MISS_COLON;
+                        goto fail;
+                    }
+                    p = xScanner::skipWhiteSpace(p + 1, end);
+                } else {
+                    match = s.kind == xQueryStep::ITERATE || index == s.index;
+                }
+                found = found || match;
+                ret = match ? scan(p, end, i + 1, &p)
+                    : xScanner::skipValue(p, end, &p, &stack);
+                if (ret != xState::X_PARSE_OK)
+                    goto fail;
+                p = xScanner::skipWhiteSpace(p, end);
+                if (p < end && *p == ',') {
+                    p = xScanner::skipWhiteSpace(p + 1, end);
+                    continue;
+                }
+                if (p < end && *p == (object ? '}' : ']')) {
+                    p++;
+                    break;
+                }
+                ret = object ? xState::X_PARSE_MISS_COMMA_OR_CURLY_BRACKET
+                    : xState::X_PARSE_MISS_COMMA_OR_SQUARE_BRACKET;
+                goto fail;
+            }
+        }
+        if (!found && s.kind != xQueryStep::ITERATE)
+            walk(0, xMissing, i + 1);
+        *out = p;
+        return xState::X_PARSE_OK;
+    fail:
+        *out = p;
+        return ret;
+    }
+};
+
+xState xQuery::run(const char* data, size_t len, const xWriter* out,
+    size_t* count, size_t* offset) const {
+    const char* p = data;
+    const char* end = data + len;
+    const char* q = data;
+    xState ret = xState::X_PARSE_OK;
+    assert((data != nullptr || len == 0) && out != nullptr);
+    xQueryRun r(stages, conds, out);
+    bool streamed = !stages.empty() && stages[0].kind == xQueryStage::PATH;
+    for (p = xScanner::skipWhiteSpace(p, end); p < end;
+        p = xScanner::skipWhiteSpace(q, end)) {
+        if (streamed) {
+            ret = r.scan(p, end, 0, &q);
+        } else if ((ret = xScanner::skipValue(p, end, &q, &r.stack))
+            == xState::X_PARSE_OK) {
+            r.process(0, { p, q });
+        }
+        if (ret != xState::X_PARSE_OK) {
+            p = q;
+            break;
+        }
+    }
+    if (count != nullptr)
+        *count = r.count;
+    if (offset != nullptr)
+        *offset = ret == xState::X_PARSE_OK ? len : p - data;
+    return ret;
+}
@@ -0,0 +1,616 @@
+/* copyright 2021 xkxsxkx */
+#ifndef __XJSON_SCAN__H__
+#define __XJSON_SCAN__H__
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include "xjson.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define X_SCAN_SSE2 1
+#elif defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define X_SCAN_SWAR 1
+#endif
+
+#ifndef X_SCAN_MAX_DEPTH
+#define X_SCAN_MAX_DEPTH 65536
+#endif
+
+namespace xJson {
+
+/**
+ * @brief open containers of an iterative walk, one bit each, set for
+ * objects. fixed size, the walks that use it never allocate.
+ */
+struct xScanStack {
+    uint64_t bits[X_SCAN_MAX_DEPTH / 64];
+    size_t depth;
+    bool push(bool object) {
+        if (depth == X_SCAN_MAX_DEPTH)
+            return false;
+        if (object)
+            bits[depth >> 6] |= (uint64_t)1 << (depth & 63);
+        else
+            bits[depth >> 6] &= ~((uint64_t)1 << (depth & 63));
+        depth++;
+        return true;
+    }
+    bool top() const {
+        return (bits[(depth - 1) >> 6] >> ((depth - 1) & 63)) & 1;
+    }
+};
+
+/**
+ * @brief grammar checks over a bounded buffer, nothing is decoded,
+ * converted or allocated. the same xState codes as xParse are reported,
+ * on failure the returned pointer is where the error was found.
+ * toDouble, appendQuoted and appendWriter are shared by the readers built
+ * on the scanner, the query and column code.
+ */
+class xScanner {
+ public:
+    static const char* skipWhiteSpace(const char* p, const char* end) {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r'))
+            p++;
+        return p;
+    }
+
+    /**
+     * @brief first byte that ends a plain run of string text: a quotation
+     * mark, a backslash or a control character.
+     * @return const char* the byte or end
+     */
+    static const char* scanSpecial(const char* p, const char* end) {
+#if defined(X_SCAN_SSE2)
+        const __m128i quote = _mm_set1_epi8('"');
+        const __m128i slash = _mm_set1_epi8('\\');
+        const __m128i ctrl = _mm_set1_epi8(0x1F);
+        for (; end - p >= 16; p += 16) {
+            __m128i v = _mm_loadu_si128((const __m128i*)p);
+            __m128i m = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, slash)),
+                _mm_cmpeq_epi8(_mm_max_epu8(v, ctrl), ctrl));
+            int bits = _mm_movemask_epi8(m);
+            if (bits != 0)
+                return p + __builtin_ctz(bits);
+        }
+#elif defined(X_SCAN_SWAR)
+        const uint64_t ones = 0x0101010101010101ull;
+        const uint64_t high = 0x8080808080808080ull;
+        for (; end - p >= 8; p += 8) {
+            uint64_t w, q, b, m;
+            memcpy(&w, p, 8);
+            q = w ^ (ones * '"');
+            b = w ^ (ones * '\\');
+            /* the lowest flagged byte of each test is exact */
+            m = ((q - ones) & ~q) | ((b - ones) & ~b) | ((w - ones * 0x20) & ~w);
+            m &= high;
+            if (m != 0)
+                return p + (__builtin_ctzll(m) >> 3);
+        }
+#endif
+        for (; p < end; p++) {
+            unsigned char ch = (unsigned char)*p;
+            if (ch == '"' || ch == '\\' || ch < 0x20)
+                return p;
+        }
+        return end;
+    }
+
+    static const char* scanHex4(const char* p, const char* end, unsigned* u) {
+        *u = 0;
+        for (int i = 0; i < 4; i++, p++) {
+            if (p == end)
+                return nullptr;
+            char ch = *p;
+            *u <<= 4;
+            if (ch >= '0' && ch <= '9') *u |= ch - '0';
+            else if (ch >= 'A' && ch <= 'F') *u |= ch - ('A' - 10);
+            else if (ch >= 'a' && ch <= 'f') *u |= ch - ('a' - 10);
+            else return nullptr;
+        }
+        return p;
+    }
+
+    /**
+     * @brief check one escape sequence.
+     * @param p the backslash
+     * @param out first byte after the sequence, or the error position
+     */
+    static xState scanEscape(const char* p, const char* end,
+        const char** out) {
+        unsigned u;
+        const char* q;
+        *out = p;
+        if (++p == end)
+            return xState::X_PARSE_INVALID_STRING_ESCAPE;
+        switch (*p++) {
+            case '"': case '\\': case '/': case 'b':
+            case 'f': case 'n': case 'r': case 't':
+                *out = p;
+                return xState::X_PARSE_OK;
+            case 'u':
+                if ((q = scanHex4(p, end, &u)) == nullptr)
+                    return xState::X_PARSE_INVALID_UNICODE_HEX;
+                p = q;
+                if (u >= 0xD800 && u <= 0xDBFF) {
+                    if (p == end || *p++ != '\\' || p == end || *p++ != 'u')
+                        return xState::X_PARSE_INVALID_UNICODE_SURROGATE;
+                    if ((q = scanHex4(p, end, &u)) == nullptr)
+                        return xState::X_PARSE_INVALID_UNICODE_HEX;
+                    if (u < 0xDC00 || u > 0xDFFF)
+                        return xState::X_PARSE_INVALID_UNICODE_SURROGATE;
+                    p = q;
+                }
+                *out = p;
+                return xState::X_PARSE_OK;
+            default:
+                return xState::X_PARSE_INVALID_STRING_ESCAPE;
+        }
+    }
+
+    /**
+     * @brief check a string body.
+     * @param p first byte after the opening quotation mark
+     * @param out first byte after the closing mark, or the error position
+     * @param escapes optional, set when the body contains an escape
+     */
+    static xState scanString(const char* p, const char* end,
+        const char** out, bool* escapes = nullptr) {
+        xState ret;
+        for (;;) {
+            p = scanSpecial(p, end);
+            if (p == end) {
+                *out = p;
+                return xState::X_PARSE_MISS_QUOTATION_MARK;
+            }
+            if (*p == '"') {
+                *out = p + 1;
+                return xState::X_PARSE_OK;
+            }
+            if (*p != '\\') {
+                *out = p;
+                return xState::X_PARSE_INVALID_STRING_CHAR;
+            }
+            if (escapes != nullptr)
+                *escapes = true;
+            if ((ret = scanEscape(p, end, &p)) != xState::X_PARSE_OK) {
+                *out = p;
+                return ret;
+            }
+        }
+    }
+
+    /**
+     * @brief check the number grammar and whether strtod would overflow,
+     * the value itself is not computed. only numbers within a power of
+     * ten of DBL_MAX are handed to strtod, as a short mantissa.
+     * @param out first byte after the number, or the number on error
+     */
+    static xState scanNumber(const char* p, const char* end,
+        const char** out) {
+        const char* begin = p;
+        const char* digits = nullptr;   /* first significant digit */
+        long exp10 = 0;                 /* decimal exponent of digits */
+        long e = 0;
+        bool negative = false;
+        *out = begin;
+        if (p < end && *p == '-') p++;
+        if (p < end && *p == '0') {
+            p++;
+        } else {
+            if (p == end || !(*p >= '1' && *p <= '9'))
+                return xState::X_PARSE_INVALID_VALUE;
+            digits = p;
+            for (p++; p < end && *p >= '0' && *p <= '9'; p++) {}
+            exp10 = (long)(p - digits) - 1;
+        }
+        const char* intEnd = p;
+        if (p < end && *p == '.') {
+            p++;
+            if (p == end || !(*p >= '0' && *p <= '9'))
+                return xState::X_PARSE_INVALID_VALUE;
+            for (; p < end && *p >= '0' && *p <= '9'; p++) {
+                if (digits == nullptr && *p != '0') {
+                    digits = p;
+                    exp10 = -(long)(p - intEnd);
+                }
+            }
+        }
+        if (p < end && (*p == 'e' || *p == 'E')) {
+            p++;
+            if (p < end && (*p == '+' || *p == '-'))
+                negative = *p++ == '-';
+            if (p == end || !(*p >= '0' && *p <= '9'))
+                return xState::X_PARSE_INVALID_VALUE;
+            for (; p < end && *p >= '0' && *p <= '9'; p++)
+                if (e < 100000)
+                    e = e * 10 + (*p - '0');
+        }
+        if (digits != nullptr) {
+            exp10 += negative ? -e : e;
+            if (exp10 >= 309)
+                return xState::X_PARSE_NUMBER_TOO_BIG;
+            if (exp10 == 308 && overflows(digits, p, exp10))
+                return xState::X_PARSE_NUMBER_TOO_BIG;
+        }
+        *out = p;
+        return xState::X_PARSE_OK;
+    }
+
+    static xState scanLiteral(const char* p, const char* end,
+        const char** out, const char* literal, size_t len) {
+        if ((size_t)(end - p) < len || memcmp(p, literal, len) != 0) {
+            *out = p;
+            return xState::X_PARSE_INVALID_VALUE;
+        }
+        *out = p + len;
+        return xState::X_PARSE_OK;
+    }
+
+    /**
+     * @brief check and step over one value of any type, containers are
+     * walked iteratively with stack.
+     * @param p first byte of the value
+     * @param out first byte after the value, or the error position
+     */
+    static xState skipValue(const char* p, const char* end,
+        const char** out, xScanStack* stack) {
+        xScanSink sink;
+        return walkValue(p, end, out, stack, &sink);
+    }
+
+    /**
+     * @brief events of walkValue, all ignored. a walk that needs some
+     * derives from it and hides those, they are resolved at compile time.
+     */
+    struct xScanSink {
+        /** @brief a string, number or literal value, as read */
+        void scalar(const char* p, const char* q) { (void)p, (void)q; }
+        /** @brief a member key, with its quotation marks */
+        void key(const char* p, const char* q) { (void)p, (void)q; }
+        /** @brief the colon after a key */
+        void colon() {}
+        /** @brief a bracket, depth counts it */
+        void open(char ch, size_t depth) { (void)ch, (void)depth; }
+        /** @brief before the first element of a container that has one */
+        void first(size_t depth) { (void)depth; }
+        /** @brief a comma between elements */
+        void comma(size_t depth) { (void)depth; }
+        /** @brief the closing bracket, depth is outside it */
+        void close(char ch, size_t depth, bool empty) {
+            (void)ch, (void)depth, (void)empty;
+        }
+    };
+
+    /**
+     * @brief skipValue, reporting every lexeme to sink on the way. the
+     * only walk of the grammar, so that checking and formatting agree.
+     */
+    template <class Sink>
+    static xState walkValue(const char* p, const char* end,
+        const char** out, xScanStack* stack, Sink* sink) {
+        const char* lexeme;
+        xState ret = xState::X_PARSE_OK;
+        stack->depth = 0;
+    value:
+        if (p == end) {
+            ret = xState::X_PARSE_EXPECT_VALUE;
+            goto fail;
+        }
+        lexeme = p;
+        switch (*p) {
+            case '"':
+                ret = scanString(p + 1, end, &p);
+                break;
+            case 't':
+                ret = scanLiteral(p, end, &p, "true", 4);
+                break;
+            case 'f':
+                ret = scanLiteral(p, end, &p, "false", 5);
+                break;
+            case 'n':
+                ret = scanLiteral(p, end, &p, "null", 4);
+                break;
+            case '[':
+            case '{':
+                if (!stack->push(*p == '{')) {
+                    ret = xState::X_PARSE_DEPTH_EXCEEDED;
+                    goto fail;
+                }
+                sink->open(*p, stack->depth);
+                p = skipWhiteSpace(p + 1, end);
+                if (p < end && *p == (stack->top() ? '}' : ']')) {
+                    stack->depth--;
+                    sink->close(*p++, stack->depth, true);
+                    goto next;
+                }
+                sink->first(stack->depth);
+                if (stack->top())
+                    goto key;
+                goto value;
+            default:
+                ret = scanNumber(p, end, &p);
+                break;
+        }
+        if (ret != xState::X_PARSE_OK)
+            goto fail;
+        sink->scalar(lexeme, p);
+    next:
+        if (stack->depth == 0) {
+            *out = p;
+            return xState::X_PARSE_OK;
+        }
+        p = skipWhiteSpace(p, end);
+        if (p < end && *p == ',') {
+            sink->comma(stack->depth);
+            p = skipWhiteSpace(p + 1, end);
+            if (stack->top())
+                goto key;
+            goto value;
+        }
+        if (p < end && *p == (stack->top() ? '}' : ']')) {
+            stack->depth--;
+            sink->close(*p++, stack->depth, false);
+            goto next;
+        }
+        ret = stack->top() ? xState::X_PARSE_MISS_COMMA_OR_CURLY_BRACKET
+            : xState::X_PARSE_MISS_COMMA_OR_SQUARE_BRACKET;
+        goto fail;
+    key:
+        if (p == end || *p != '"') {
+            ret = xState::X_PARSE_MISS_KEY;
+            goto fail;
+        }
+        lexeme = p;
+        if ((ret = scanString(p + 1, end, &p)) != xState::X_PARSE_OK)
+            goto fail;
+        sink->key(lexeme, p);
+        p = skipWhiteSpace(p, end);
+        if (p == end || *p != ':') {
+            ret = xState::X_PARSE_MISS_COLON;
+            goto fail;
+        }
+        sink->colon();
+        p = skipWhiteSpace(p + 1, end);
+        goto value;
+    fail:
+        *out = p;
+        return ret;
+    }
+
+    /**
+     * @brief step over a string body without checking it.
+     * @param p first byte after the opening quotation mark
+     * @return const char* first byte after the closing mark, nullptr when
+     * the text ends first
+     */
+    static const char* skipString(const char* p, const char* end) {
+        for (;;) {
+            p = scanSpecial(p, end);
+            if (p == end)
+                return nullptr;
+            if (*p == '"')
+                return p + 1;
+            /* a control character is stepped over like text */
+            if (*p == '\\' && end - p < 2)
+                return nullptr;
+            p += *p == '\\' ? 2 : 1;
+        }
+    }
+
+    /**
+     * @brief bits of the n <= 16 bytes at p: quotation marks, backslashes
+     * and the structural characters (brackets and commas).
+     */
+    static void blockMasks(const char* p, size_t n, unsigned* quotes,
+        unsigned* slashes, unsigned* structurals) {
+#if defined(X_SCAN_SSE2)
+        if (n == 16) {
+            /* [ { and ] } differ only in 0x20 */
+            __m128i v = _mm_loadu_si128((const __m128i*)p);
+            __m128i folded = _mm_or_si128(v, _mm_set1_epi8(0x20));
+            __m128i m = _mm_or_si128(
+                _mm_cmpeq_epi8(v, _mm_set1_epi8(',')),
+                _mm_or_si128(_mm_cmpeq_epi8(folded, _mm_set1_epi8('{')),
+                    _mm_cmpeq_epi8(folded, _mm_set1_epi8('}'))));
+            *quotes = (unsigned)_mm_movemask_epi8(
+                _mm_cmpeq_epi8(v, _mm_set1_epi8('"')));
+            *slashes = (unsigned)_mm_movemask_epi8(
+                _mm_cmpeq_epi8(v, _mm_set1_epi8('\\')));
+            *structurals = (unsigned)_mm_movemask_epi8(m);
+            return;
+        }
+#endif
+        *quotes = *slashes = *structurals = 0;
+        for (size_t i = 0; i < n; i++) {
+            char ch = (char)(p[i] | 0x20);
+            *quotes |= (unsigned)(p[i] == '"') << i;
+            *slashes |= (unsigned)(p[i] == '\\') << i;
+            *structurals |= (unsigned)(p[i] == ',' || ch == '{' || ch == '}') << i;
+        }
+    }
+
+    /**
+     * @brief account one structural character of a container walk.
+     * @return bool true when it closes the outermost container
+     */
+    static bool skipStructural(char ch, size_t* depth, size_t* commas) {
+        if (ch == ',')
+            *commas += *depth == 1;
+        else if ((ch | 0x20) == '{')
+            ++*depth;
+        else
+            return --*depth == 0;
+        return false;
+    }
+
+    /**
+     * @brief step over one value without checking it, as a structural
+     * indexer does. per block of 16 bytes the quotation marks give the
+     * string ranges with a prefix xor, brackets and commas outside them
+     * are counted: brackets for the depth, commas at depth 1 for the
+     * elements. a block holding a backslash is walked byte by byte. no
+     * stack is kept, so the depth is not limited and [} passes for [].
+     * scalars end at the next delimiter.
+     * @param p first byte of the value
+     * @param out first byte after the value, or where the text ended
+     * @param count elements of an array or members of an object, 0 for
+     * other values
+     */
+    static xState skipRaw(const char* p, const char* end, const char** out,
+        size_t* count) {
+        const char* q;
+        size_t i, n, depth = 1, commas = 0;
+        unsigned quotes, slashes, structurals, inside;
+        unsigned string = 0;        /* all ones while in a string */
+        bool escaped = false, object;
+        *count = 0;
+        *out = p;
+        if (p == end)
+            return xState::X_PARSE_EXPECT_VALUE;
+        if (*p == '"') {
+            if ((q = skipString(p + 1, end)) == nullptr) {
+                *out = end;
+                return xState::X_PARSE_MISS_QUOTATION_MARK;
+            }
+            *out = q;
+            return xState::X_PARSE_OK;
+        }
+        if (*p != '[' && *p != '{') {
+            for (q = p; q < end && *q != ' ' && *q != '\t' && *q != '\n'
+                && *q != '\r' && *q != ',' && *q != ']' && *q != '}'; q++) {}
+            *out = q;
+            return q == p ? xState::X_PARSE_INVALID_VALUE : xState::X_PARSE_OK;
+        }
+        object = *p == '{';
+        q = skipWhiteSpace(p + 1, end);
+        if (q < end && (*q == ']' || *q == '}')) {
+            *out = q + 1;
+            return xState::X_PARSE_OK;
+        }
+        for (p++; p < end; p += n) {
+            n = end - p < 16 ? end - p : 16;
+            blockMasks(p, n, &quotes, &slashes, &structurals);
+            if (slashes == 0 && !escaped) {
+                /* bit i: the quotes up to i leave p[i] inside a string */
+                inside = quotes;
+                inside ^= inside << 1;
+                inside ^= inside << 2;
+                inside ^= inside << 4;
+                inside ^= inside << 8;
+                inside ^= string;
+                string = (inside >> (n - 1)) & 1 ? ~0u : 0;
+                for (structurals &= ~inside; structurals != 0;
+                    structurals &= structurals - 1) {
+                    q = p + __builtin_ctz(structurals);
+                    if (skipStructural(*q, &depth, &commas))
+                        goto done;
+                }
+                continue;
+            }
+            for (i = 0; i < n; i++) {
+                q = p + i;
+                if (escaped) {
+                    escaped = false;
+                } else if (string) {
+                    if (*q == '\\')
+                        escaped = true;
+                    else if (*q == '"')
+                        string = 0;
+                } else if (*q == '"') {
+                    string = ~0u;
+                } else if (((structurals >> i) & 1)
+                    && skipStructural(*q, &depth, &commas)) {
+                    goto done;
+                }
+            }
+        }
+        *out = end;
+        if (string || escaped)
+            return xState::X_PARSE_MISS_QUOTATION_MARK;
+        return object ? xState::X_PARSE_MISS_COMMA_OR_CURLY_BRACKET
+            : xState::X_PARSE_MISS_COMMA_OR_SQUARE_BRACKET;
+    done:
+        *out = q + 1;
+        *count = commas + 1;
+        return xState::X_PARSE_OK;
+    }
+
+    /**
+     * @brief the double of a checked number lexeme [p, end). the lexeme
+     * is followed by more text in the buffer, so strtod gets a copy.
+     */
+    static double toDouble(const char* p, const char* end) {
+        char small[64];
+        size_t len = end - p;
+        if (len < sizeof(small)) {
+            memcpy(small, p, len);
+            small[len] = '\0';
+            return strtod(small, nullptr);
+        }
+        return strtod(std::string(p, len).c_str(), nullptr);
+    }
+
+    /**
+     * @brief append s to out as a json string, quotes included.
+     */
+    static void appendQuoted(std::string* out, const char* s, size_t len) {
+        static const char hex[] = "0123456789ABCDEF";
+        out->push_back('"');
+        for (size_t i = 0; i < len; i++) {
+            unsigned char ch = (unsigned char)s[i];
+            switch (ch) {
+                case '\"': out->append("\\\"", 2); break;
+                case '\\': out->append("\\\\", 2); break;
+                case '\b': out->append("\\b", 2); break;
+                case '\f': out->append("\\f", 2); break;
+                case '\n': out->append("\\n", 2); break;
+                case '\r': out->append("\\r", 2); break;
+                case '\t': out->append("\\t", 2); break;
+                default:
+                    if (ch < 0x20) {
+                        out->append("\\u00", 4);
+                        out->push_back(hex[ch >> 4]);
+                        out->push_back(hex[ch & 15]);
+                    } else {
+                        out->push_back((char)ch);
+                    }
+            }
+        }
+        out->push_back('"');
+    }
+
+    /** @brief xWriter callback appending to the std::string in ctx */
+    static void appendWriter(void* ctx, const char* data, size_t len) {
+        ((std::string*)ctx)->append(data, len);
+    }
+
+ private:
+    /**
+     * @brief strtod on 0.<up to 40 significant digits>e<exp10 + 1>.
+     */
+    static bool overflows(const char* digits, const char* end, long exp10) {
+        char buf[64];
+        size_t n = 2;
+        buf[0] = '0';
+        buf[1] = '.';
+        for (; digits < end && n < 42; digits++) {
+            if (*digits >= '0' && *digits <= '9')
+                buf[n++] = *digits;
+            else if (*digits != '.')
+                break;
+        }
+        snprintf(buf + n, sizeof(buf) - n, "e%ld", exp10 + 1);
+        return strtod(buf, nullptr) == HUGE_VAL;
+    }
+};
+
+}  // namespace xJson
+
+#endif  //!__XJSON_SCAN__H__
@@ -0,0 +1,255 @@
+/*copyright 2021 xkxsxkx*/
+#include "xjson_schema.h"
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+
+using xJson::xValue;
+using xJson::xType;
+using xJson::xHelper;
+using xJson::xMember;
+using xJson::xSchema;
+using xJson::xSchemaNode;
+using xJson::xSchemaKey;
+using xJson::xSchemaState;
+
+xSchemaNode::~xSchemaNode() {
+    for (xValue& v : values)
+        xHelper::xSetNull(&v);
+}
+
+static bool xIsKey(const xMember* m, const char* key) {
+    return m->klen == strlen(key) && memcmp(m->k, key, m->klen) == 0;
+}
+
+static bool xSchemaCount(const xValue* v, size_t* n) {
+    double d;
+    if (v->type != xType::X_TYPE_NUMBER)
+        return false;
+    d = xHelper::xGetNumber(v);
+    if (d < 0 || d != floor(d))
+        return false;
+    *n = (size_t)d;
+    return true;
+}
+
+static unsigned xSchemaTypeBit(const xValue* v) {
+    static const struct { const char* name; unsigned bit; } names[] = {
+        { "null", xJson::X_SCHEMA_NULL },
+        { "boolean", xJson::X_SCHEMA_BOOLEAN },
+        { "integer", xJson::X_SCHEMA_INTEGER },
+        { "number", xJson::X_SCHEMA_NUMBER | xJson::X_SCHEMA_INTEGER },
+        { "string", xJson::X_SCHEMA_STRING },
+        { "array", xJson::X_SCHEMA_ARRAY },
+        { "object", xJson::X_SCHEMA_OBJECT },
+    };
+    if (v->type != xType::X_TYPE_STRING)
+        return 0;
+    for (const auto& n : names)
+        if (xHelper::xGetStringLength(v) == strlen(n.name)
+            && memcmp(xHelper::xGetString(v), n.name, v->str.len) == 0)
+            return n.bit;
+    return 0;
+}
+
+/**
+ * @brief keywords that constrain a value but are not compiled, silently
+ * ignoring them would accept documents the schema rejects.
+ */
+static bool xSchemaUnsupported(const xMember* m) {
+    static const char* keywords[] = {
+        "$ref", "$dynamicRef", "$recursiveRef", "allOf", "anyOf", "oneOf",
+        "not", "if", "then", "else", "pattern", "patternProperties",
+        "propertyNames", "dependencies", "dependentRequired",
+        "dependentSchemas", "prefixItems", "additionalItems", "contains",
+        "uniqueItems", "multipleOf", "unevaluatedItems",
+        "unevaluatedProperties", "format"
+    };
+    for (const char* k : keywords)
+        if (xIsKey(m, k))
+            return true;
+    return false;
+}
+
+xSchemaState xSchema::compile(const xValue* schema, std::string* error) {
+    std::string path;
+    xSchemaState state = xSchemaState::X_SCHEMA_OK;
+    assert(schema != nullptr);
+    nodes.clear();
+    top = compileNode(schema, &path, &state);
+    if (state != xSchemaState::X_SCHEMA_OK) {
+        nodes.clear();
+        top = nullptr;
+        if (error != nullptr)
+            *error = path;
+    }
+    return state;
+}
+
+#define X_SCHEMA_FAIL(s) do { *state = (s); return nullptr; } while (0)
+
+const xSchemaNode* xSchema::compileNode(const xValue* schema,
+    std::string* path, xSchemaState* state) {
+    xSchemaNode* node;
+    const xValue* required = nullptr;
+    const xValue* properties = nullptr;
+    size_t i, j, mark;
+    if (schema->type == xType::X_TYPE_TRUE)
+        return nullptr;
+    nodes.emplace_back(new xSchemaNode());
+    node = nodes.back().get();
+    if (schema->type == xType::X_TYPE_FALSE) {
+        node->types = 0;
+        return node;
+    }
+    if (schema->type != xType::X_TYPE_OBJECT)
+        X_SCHEMA_FAIL(xSchemaState::X_SCHEMA_INVALID);
+    for (i = 0; i < schema->object.size; i++) {
+        const xMember* m = &schema->object.m[i];
+        const xValue* v = &m->v;
+        mark = path->size();
+        path->push_back('/');
+        path->append(m->k, m->klen);
+        if (xSchemaUnsupported(m)) {
+            X_SCHEMA_FAIL(xSchemaState::X_SCHEMA_UNSUPPORTED);
+        } else if (xIsKey(m, "type")) {
+            node->types = xSchemaTypeBit(v);
+            if (v->type == xType::X_TYPE_ARRAY) {
+                const xValue* e = xHelper::xGetArrayElements(v);
+                for (j = 0; j < v->array.len; j++) {
+                    unsigned bit = xSchemaTypeBit(&e[j]);
+                    if (bit == 0)
+                        X_SCHEMA_FAIL(xSchemaState::X_SCHEMA_INVALID);
+                    node->types |= bit;
+                }
+            } else if (node->types == 0) {
+                X_SCHEMA_FAIL(xSchemaState::X_SCHEMA_INVALID);
+            }
+        } else if (xIsKey(m, "enum") || xIsKey(m, "const")) {
+            const xValue* e = v;
+            size_t n = 1;
+            if (xIsKey(m, "enum")) {
+                if (v->type != xType::X_TYPE_ARRAY)
+                    X_SCHEMA_FAIL(xSchemaState::X_SCHEMA_INVALID);
+                e = xHelper::xGetArrayElements(v);
+                n = v->array.len;
+            }
+            for (j = 0; j < n; j++) {
+                node->values.emplace_back();
+                xHelper::xSetNull(&node->values.back());
+                xHelper::xCopy(&node->values.back(), &e[j]);
+            }
+            node->checks |= xJson::X_SCHEMA_CHECK_ENUM;
+        } else if (xIsKey(m, "minimum") || xIsKey(m, "maximum")
+            || xIsKey(m, "exclusiveMinimum") || xIsKey(m, "exclusiveMaximum")) {
+            if (v->type != xType::X_TYPE_NUMBER)
+                X_SCHEMA_FAIL(xSchemaState::X_SCHEMA_INVALID);
+            if (xIsKey(m, "minimum")) {
+                node->minimum = xHelper::xGetNumber(v);
+                node->checks |= xJson::X_SCHEMA_CHECK_MINIMUM;
+            } else if (xIsKey(m, "maximum")) {
+                node->maximum = xHelper::xGetNumber(v);
+                node->checks |= xJson::X_SCHEMA_CHECK_MAXIMUM;
+            } else if (xIsKey(m, "exclusiveMinimum")) {
+                node->exclusiveMinimum = xHelper::xGetNumber(v);
+                node->checks |= xJson::X_SCHEMA_CHECK_EXCLUSIVE_MINIMUM;
+            } else {
+                node->exclusiveMaximum = xHelper::xGetNumber(v);
+                node->checks |= xJson::X_SCHEMA_CHECK_EXCLUSIVE_MAXIMUM;
+            }
+        } else if (xIsKey(m, "minLength") || xIsKey(m, "maxLength")) {
+            if (!xSchemaCount(v, xIsKey(m, "minLength")
+                ? &node->minLength : &node->maxLength))
+                X_SCHEMA_FAIL(xSchemaState::X_SCHEMA_INVALID);
+            node->checks |= xJson::X_SCHEMA_CHECK_LENGTH;
+        } else if (xIsKey(m, "minItems") || xIsKey(m, "maxItems")) {
+            if (!xSchemaCount(v, xIsKey(m, "minItems")
+                ? &node->minItems : &node->maxItems))
+                X_SCHEMA_FAIL(xSchemaState::X_SCHEMA_INVALID);
+            node->checks |= xJson::X_SCHEMA_CHECK_ITEMS;
+        } else if (xIsKey(m, "minProperties") || xIsKey(m, "maxProperties")) {
+            if (!xSchemaCount(v, xIsKey(m, "minProperties")
+                ? &node->minProperties : &node->maxProperties))
+                X_SCHEMA_FAIL(xSchemaState::X_SCHEMA_INVALID);
+            node->checks |= xJson::X_SCHEMA_CHECK_PROPERTIES;
+        } else if (xIsKey(m, "contentEncoding")) {
+            if (v->type != xType::X_TYPE_STRING)
+                X_SCHEMA_FAIL(xSchemaState::X_SCHEMA_INVALID);
+            /* other encodings stay annotations */
+            if (xHelper::xGetStringLength(v) == 6
+                && memcmp(xHelper::xGetString(v), "base64", 6) == 0)
+                node->checks |= xJson::X_SCHEMA_CHECK_BASE64;
+        } else if (xIsKey(m, "items")) {
+            if (v->type == xType::X_TYPE_ARRAY)
+                X_SCHEMA_FAIL(xSchemaState::X_SCHEMA_UNSUPPORTED);
+            node->items = compileNode(v, path, state);
+        } else if (xIsKey(m, "additionalProperties")) {
+            node->additional = compileNode(v, path, state);
+        } else if (xIsKey(m, "properties")) {
+            if (v->type != xType::X_TYPE_OBJECT)
+                X_SCHEMA_FAIL(xSchemaState::X_SCHEMA_INVALID);
+            properties = v;
+        } else if (xIsKey(m, "required")) {
+            if (v->type != xType::X_TYPE_ARRAY)
+                X_SCHEMA_FAIL(xSchemaState::X_SCHEMA_INVALID);
+            const xValue* e = xHelper::xGetArrayElements(v);
+            for (j = 0; j < v->array.len; j++)
+                if (e[j].type != xType::X_TYPE_STRING)
+                    X_SCHEMA_FAIL(xSchemaState::X_SCHEMA_INVALID);
+            required = v;
+        }
+        if (*state != xSchemaState::X_SCHEMA_OK)
+            return nullptr;
+        path->resize(mark);
+    }
+    /* properties and required share one key table */
+    if (properties != nullptr) {
+        mark = path->size();
+        for (i = 0; i < properties->object.size; i++) {
+            const xMember* m = &properties->object.m[i];
+            path->append("/properties/");
+            path->append(m->k, m->klen);
+            xSchemaKey k;
+            k.name.assign(m->k, m->klen);
+            k.required = (uint32_t)-1;
+            k.node = compileNode(&m->v, path, state);
+            if (*state != xSchemaState::X_SCHEMA_OK)
+                return nullptr;
+            path->resize(mark);
+            node->keys.push_back(std::move(k));
+        }
+    }
+    if (required != nullptr) {
+        for (j = 0; j < required->array.len; j++) {
+            const xValue* r = &required->array.e[j];
+            const char* s = xHelper::xGetString(r);
+            size_t len = xHelper::xGetStringLength(r);
+            for (i = 0; i < node->keys.size(); i++)
+                if (node->keys[i].name.size() == len
+                    && memcmp(node->keys[i].name.data(), s, len) == 0)
+                    break;
+            if (i == node->keys.size()) {
+                xSchemaKey k;
+                k.name.assign(s, len);
+                k.required = (uint32_t)-1;
+                k.node = nullptr;
+                node->keys.push_back(std::move(k));
+            }
+            if (node->keys[i].required == (uint32_t)-1)
+                node->keys[i].required = node->requiredCount++;
+        }
+    }
+    if (!node->keys.empty()) {
+        size_t size = 4;
+        while (size < node->keys.size() * 2)
+            size <<= 1;
+        node->slots.assign(size, 0);
+        for (i = 0; i < node->keys.size(); i++) {
+            xSchemaKey* k = &node->keys[i];
+            k->hash = xJson::xHashKey(k->name.data(), k->name.size());
+            for (j = k->hash & (size - 1); node->slots[j] != 0; j = (j + 1) & (size - 1)) {}
+            node->slots[j] = (uint32_t)i + 1;
+        }
+    }
+    return node;
+}
@@ -0,0 +1,461 @@
+/*copyright 2021 xkxsxkx*/
+#include "xjson_shared.h"
+#include "xjson_lexer.h"
+#include "xjson_pointer.h"
+#include <assert.h>
+#include <string.h>
+#include <atomic>
+#include <new>
+#include <string>
+#include <thread>
+
+using xJson::xValue;
+using xJson::xType;
+using xJson::xHelper;
+using xJson::xMember;
+using xJson::xPatchState;
+using xJson::xSharedDocument;
+using xJson::xSharedRoot;
+using xJson::xSharedSlot;
+
+/**
+ * @brief header in front of every element or member array, key and
+ * string or number text of a shared tree, size is the byte size of the
+ * block behind it.
+ */
+struct xSharedBlock {
+    std::atomic<size_t> refs;
+    size_t size;
+};
+
+struct xJson::xSharedRoot {
+    std::atomic<size_t> refs;
+    const xAllocator* allocator;
+    xValue value;
+};
+
+static const xValue xSharedNull = { {}, xType::X_TYPE_NULL, 0 };
+
+static inline xSharedBlock* xBlockOf(const void* array) {
+    return (xSharedBlock*)((char*)array - sizeof(xSharedBlock));
+}
+
+static void* xBlockNew(size_t size) {
+    xSharedBlock* b;
+    if (size == 0)
+        return nullptr;
+    b = (xSharedBlock*)xJson::xAlloc(sizeof(xSharedBlock) + size);
+    new (&b->refs) std::atomic<size_t>(1);
+    b->size = size;
+    return b + 1;
+}
+
+/** @brief the shared array of a container, nullptr for anything else */
+static inline void* xArrayOf(const xValue* v) {
+    if (v->type == xType::X_TYPE_ARRAY)
+        return v->array.e;
+    if (v->type == xType::X_TYPE_OBJECT)
+        return v->object.m;
+    return nullptr;
+}
+
+/** @brief the text block of a string or raw number, nullptr otherwise */
+static inline void* xTextOf(const xValue* v) {
+    if (v->type == xType::X_TYPE_STRING
+        || (v->flags & xJson::X_VALUE_FLAG_RAW_NUMBER))
+        return v->str.s;
+    return nullptr;
+}
+
+static inline void xRetain(const void* block) {
+    xBlockOf(block)->refs.fetch_add(1, std::memory_order_relaxed);
+}
+
+/** @brief drop a reference, true when it was the last one */
+static inline bool xDrop(const void* block) {
+    return xBlockOf(block)->refs.fetch_sub(1, std::memory_order_acq_rel) == 1;
+}
+
+static void xBlockFree(void* block) {
+    xSharedBlock* b = xBlockOf(block);
+    b->refs.~atomic();
+    xJson::xDealloc(b, sizeof(xSharedBlock) + b->size);
+}
+
+static char* xTextNew(const char* s, size_t len) {
+    /* borrowed text (raw numbers in situ) is not terminated */
+    char* t = (char*)xBlockNew(len + 1);
+    memcpy(t, s, len);
+    t[len] = '\0';
+    return t;
+}
+
+static void xRelease(xValue* v) {
+    size_t i;
+    void* array = xArrayOf(v);
+    if (array == nullptr) {
+        void* text = xTextOf(v);
+        if (text != nullptr && xDrop(text))
+            xBlockFree(text);
+        return;
+    }
+    if (!xDrop(array))
+        return;
+    if (v->type == xType::X_TYPE_ARRAY) {
+        for (i = 0; i < v->array.len; i++)
+            xRelease(&v->array.e[i]);
+    } else {
+        for (i = 0; i < v->object.size; i++) {
+            if (xDrop(v->object.m[i].k))
+                xBlockFree(v->object.m[i].k);
+            xRelease(&v->object.m[i].v);
+        }
+    }
+    xBlockFree(array);
+}
+
+/**
+ * @brief share src in dst: containers, text and keys are immutable once
+ * frozen, they all take a reference.
+ */
+static void xShare(xValue* dst, const xValue* src) {
+    void* block = xArrayOf(src);
+    *dst = *src;
+    if (block == nullptr)
+        block = xTextOf(src);
+    if (block != nullptr)
+        xRetain(block);
+}
+
+static void xShareMember(xMember* dst, const xMember* src) {
+    xRetain(src->k);
+    dst->k = src->k;
+    dst->klen = src->klen;
+    dst->flags = 0;
+    dst->hash = src->hash;
+    xShare(&dst->v, &src->v);
+}
+
+/**
+ * @brief deep copy of an ordinary tree into shared arrays.
+ */
+static void xFreeze(xValue* dst, const xValue* src) {
+    size_t i;
+    *dst = *src;
+    dst->flags &= ~xJson::X_VALUE_FLAG_BORROWED;
+    switch (src->type) {
+        case xType::X_TYPE_NUMBER:
+            if (src->flags & xJson::X_VALUE_FLAG_RAW_NUMBER)
+                dst->str.s = xTextNew(src->str.s, src->str.len);
+            break;
+        case xType::X_TYPE_STRING:
+            dst->str.s = xTextNew(src->str.s, src->str.len);
+            /* readers of a shared tree must never write to it */
+            if (src->flags & xJson::X_VALUE_FLAG_ESCAPED) {
+                dst->str.len = xJson::xLexer::unescape(dst->str.s, dst->str.len);
+                dst->str.s[dst->str.len] = '\0';
+                dst->flags &= ~(xJson::X_VALUE_FLAG_RAW_STRING
+                    | xJson::X_VALUE_FLAG_ESCAPED);
+            }
+            break;
+        case xType::X_TYPE_ARRAY:
+            dst->array.e = (xValue*)xBlockNew(src->array.len * sizeof(xValue));
+            /* dense arrays are expanded, a read must not change the tree */
+            dst->flags &= ~(xJson::X_VALUE_FLAG_DENSE_DOUBLE
+                | xJson::X_VALUE_FLAG_DENSE_INT64);
+            for (i = 0; i < src->array.len; i++) {
+                xValue* e = &dst->array.e[i];
+                if (src->flags & xJson::X_VALUE_FLAG_DENSE_DOUBLE) {
+                    e->n = src->dense.d[i];
+                } else if (src->flags & xJson::X_VALUE_FLAG_DENSE_INT64) {
+                    e->n = (double)src->dense.i[i];
+                } else {
+                    xFreeze(e, &src->array.e[i]);
+                    continue;
+                }
+                e->type = xType::X_TYPE_NUMBER;
+                e->flags = 0;
+            }
+            break;
+        case xType::X_TYPE_OBJECT:
+            dst->object.m = (xMember*)xBlockNew(
+                src->object.size * sizeof(xMember));
+            for (i = 0; i < src->object.size; i++) {
+                xMember* m = &dst->object.m[i];
+                m->k = xTextNew(src->object.m[i].k, src->object.m[i].klen);
+                m->klen = src->object.m[i].klen;
+                m->flags = 0;
+                m->hash = src->object.m[i].hash;
+                xFreeze(&m->v, &src->object.m[i].v);
+            }
+            break;
+        default: break;
+    }
+}
+
+/**
+ * @brief check that the update of pointer can be applied to root, so the
+ * copy that follows cannot fail half way.
+ * @param remove the target must exist, otherwise a missing member or "-"
+ * names a new slot
+ */
+static xPatchState xCheckPath(const xValue* root, const char* pointer,
+    size_t len, bool remove) {
+    const char* p = pointer;
+    const char* end = pointer + len;
+    const xValue* v = root;
+    std::string token;
+    size_t index;
+    if (len > 0 && *p != '/')
+        return xPatchState::X_PATCH_INVALID_POINTER;
+    if (len == 0 && remove)
+        return xPatchState::X_PATCH_INVALID_POINTER;
+    while (p < end) {
+        p++;
+        if (!xPointerToken(&p, end, &token))
+            return xPatchState::X_PATCH_INVALID_POINTER;
+        bool last = p == end;
+        if (v->type == xType::X_TYPE_OBJECT) {
+            v = xHelper::xFindObjectValue(v, token.data(), token.size());
+            if (v == nullptr)
+                return last && !remove ? xPatchState::X_PATCH_OK
+                    : xPatchState::X_PATCH_PATH_NOT_FOUND;
+        } else if (v->type == xType::X_TYPE_ARRAY) {
+            if (last && !remove && token == "-")
+                return xPatchState::X_PATCH_OK;
+            if (!xPointerIndex(token, &index) || index >= v->array.len)
+                return xPatchState::X_PATCH_PATH_NOT_FOUND;
+            v = &v->array.e[index];
+        } else {
+            return xPatchState::X_PATCH_PATH_NOT_FOUND;
+        }
+    }
+    return xPatchState::X_PATCH_OK;
+}
+
+/**
+ * @brief the new version of src in dst: the arrays on the path are copied,
+ * every other child is shared. the path was checked by xCheckPath.
+ * @param p the remaining pointer
+ * @param value new value at the end of the path, nullptr removes it
+ */
+static void xBuild(xValue* dst, const xValue* src, const char* p,
+    const char* end, const xValue* value) {
+    std::string token;
+    size_t i, j, n, index, size;
+    if (p == end) {
+        xFreeze(dst, value);
+        return;
+    }
+    p++;
+    xPointerToken(&p, end, &token);
+    bool drop = p == end && value == nullptr;
+    *dst = *src;
+    if (src->type == xType::X_TYPE_OBJECT) {
+        n = src->object.size;
+        index = xHelper::xFindObjectIndex(src, token.data(), token.size());
+        size = index == xJson::X_KEY_NOT_EXIST ? n + 1 : drop ? n - 1 : n;
+        xMember* m = (xMember*)xBlockNew(size * sizeof(xMember));
+        for (i = j = 0; i < n; i++) {
+            const xMember* sm = &src->object.m[i];
+            if (i != index) {
+                xShareMember(&m[j++], sm);
+            } else if (!drop) {
+                xRetain(sm->k);
+                m[j].k = sm->k;
+                m[j].klen = sm->klen;
+                m[j].flags = 0;
+                m[j].hash = sm->hash;
+                xBuild(&m[j++].v, &sm->v, p, end, value);
+            }
+        }
+        if (index == xJson::X_KEY_NOT_EXIST) {
+            /* the new member is appended, not inserted in order */
+            dst->flags &= ~xJson::X_VALUE_FLAG_SORTED_KEYS;
+            m[j].k = xTextNew(token.data(), token.size());
+            m[j].klen = token.size();
+            m[j].flags = 0;
+            m[j].hash = xJson::xHashKey(token.data(), token.size());
+            xFreeze(&m[j].v, value);
+        }
+        dst->object.m = m;
+        dst->object.size = size;
+    } else {
+        n = src->array.len;
+        if (token == "-")
+            index = n;
+        else
+            xPointerIndex(token, &index);
+        size = index == n ? n + 1 : drop ? n - 1 : n;
+        xValue* e = (xValue*)xBlockNew(size * sizeof(xValue));
+        for (i = j = 0; i < n; i++) {
+            if (i != index)
+                xShare(&e[j++], &src->array.e[i]);
+            else if (!drop)
+                xBuild(&e[j++], &src->array.e[i], p, end, value);
+        }
+        if (index == n)
+            xFreeze(&e[j], value);
+        dst->array.e = e;
+        dst->array.len = size;
+    }
+}
+
+static xSharedRoot* xRootNew(const xJson::xAllocator* allocator) {
+    xSharedRoot* r = (xSharedRoot*)xJson::xAlloc(sizeof(xSharedRoot));
+    new (&r->refs) std::atomic<size_t>(1);
+    r->allocator = allocator;
+    r->value = xSharedNull;
+    return r;
+}
+
+static void xRootRetain(xSharedRoot* r) {
+    if (r != nullptr)
+        r->refs.fetch_add(1, std::memory_order_relaxed);
+}
+
+static void xRootRelease(xSharedRoot* r) {
+    if (r == nullptr || r->refs.fetch_sub(1, std::memory_order_acq_rel) != 1)
+        return;
+    xJson::xAllocatorScope scope(r->allocator);
+    xRelease(&r->value);
+    r->refs.~atomic();
+    xJson::xDealloc(r, sizeof(xSharedRoot));
+}
+
+xSharedDocument::xSharedDocument() : root(nullptr) {}
+
+xSharedDocument::xSharedDocument(const xValue* v,
+    const xAllocator* allocator) {
+    assert(v != nullptr);
+    xAllocatorScope scope(allocator);
+    root = xRootNew(allocator);
+    xFreeze(&root->value, v);
+}
+
+xSharedDocument::~xSharedDocument() {
+    xRootRelease(root);
+}
+
+xSharedDocument::xSharedDocument(const xSharedDocument& other) noexcept
+    : root(other.root) {
+    xRootRetain(root);
+}
+
+xSharedDocument& xSharedDocument::operator=(
+    const xSharedDocument& other) noexcept {
+    xRootRetain(other.root);
+    xRootRelease(root);
+    root = other.root;
+    return *this;
+}
+
+xSharedDocument::xSharedDocument(xSharedDocument&& other) noexcept
+    : root(other.root) {
+    other.root = nullptr;
+}
+
+xSharedDocument& xSharedDocument::operator=(
+    xSharedDocument&& other) noexcept {
+    if (this != &other) {
+        xRootRelease(root);
+        root = other.root;
+        other.root = nullptr;
+    }
+    return *this;
+}
+
+const xValue* xSharedDocument::value() const {
+    return root != nullptr ? &root->value : &xSharedNull;
+}
+
+xPatchState xSharedDocument::set(xSharedDocument* next, const char* pointer,
+    size_t len, const xValue* value) const {
+    const xValue* from = root != nullptr ? &root->value : &xSharedNull;
+    const xAllocator* allocator = root != nullptr ? root->allocator : nullptr;
+    xSharedDocument doc;
+    xPatchState ret;
+    assert(next != nullptr && (pointer != nullptr || len == 0));
+    assert(value != nullptr);
+    if ((ret = xCheckPath(from, pointer, len, false)) != xPatchState::X_PATCH_OK)
+        return ret;
+    {
+        xAllocatorScope scope(allocator);
+        doc.root = xRootNew(allocator);
+        xBuild(&doc.root->value, from, pointer, pointer + len, value);
+    }
+    next->swap(doc);
+    return xPatchState::X_PATCH_OK;
+}
+
+xPatchState xSharedDocument::remove(xSharedDocument* next,
+    const char* pointer, size_t len) const {
+    const xValue* from = root != nullptr ? &root->value : &xSharedNull;
+    const xAllocator* allocator = root != nullptr ? root->allocator : nullptr;
+    xSharedDocument doc;
+    xPatchState ret;
+    assert(next != nullptr && (pointer != nullptr || len == 0));
+    if ((ret = xCheckPath(from, pointer, len, true)) != xPatchState::X_PATCH_OK)
+        return ret;
+    {
+        xAllocatorScope scope(allocator);
+        doc.root = xRootNew(allocator);
+        xBuild(&doc.root->value, from, pointer, pointer + len, nullptr);
+    }
+    next->swap(doc);
+    return xPatchState::X_PATCH_OK;
+}
+
+xSharedSlot::xSharedSlot() : current(nullptr), readers{ {0}, {0} }, epoch(0) {}
+
+xSharedSlot::xSharedSlot(xSharedDocument doc)
+    : current(doc.root), readers{ {0}, {0} }, epoch(0) {
+    doc.root = nullptr;
+}
+
+xSharedSlot::~xSharedSlot() {
+    xRootRelease(current.load(std::memory_order_relaxed));
+}
+
+xSharedDocument xSharedSlot::load() const {
+    xSharedDocument doc;
+    /* the counter pins whatever root is read until it is retained */
+    std::atomic<size_t>& pin = readers[epoch.load() & 1];
+    pin.fetch_add(1);
+    doc.root = current.load();
+    xRootRetain(doc.root);
+    pin.fetch_sub(1, std::memory_order_release);
+    return doc;
+}
+
+/**
+ * @brief wait until no reader can still be between reading the old root
+ * and retaining it. readers arriving after a flip use the other counter,
+ * so each wait only covers the readers that started before it. the
+ * caller holds publish, the old root is released with the by-value
+ * argument once the publisher returns.
+ */
+void xSharedSlot::quiesce() {
+    for (int i = 0; i < 2; i++) {
+        std::atomic<size_t>& pin = readers[epoch.fetch_add(1) & 1];
+        while (pin.load() != 0)
+            std::this_thread::yield();
+    }
+}
+
+void xSharedSlot::store(xSharedDocument doc) {
+    std::lock_guard<std::mutex> guard(publish);
+    doc.root = current.exchange(doc.root);
+    quiesce();
+}
+
+bool xSharedSlot::compareExchange(const xSharedDocument& expected,
+    xSharedDocument next) {
+    std::lock_guard<std::mutex> guard(publish);
+    xSharedRoot* r = expected.root;
+    if (!current.compare_exchange_strong(r, next.root))
+        return false;
+    next.root = r;
+    quiesce();
+    return true;
+}
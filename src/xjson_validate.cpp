@@ -0,0 +1,39 @@
+/*copyright 2021 xkxsxkx*/
+#include "xjson.h"
+#include "xjson_scan.h"
+#include <assert.h>
+
+using xJson::xState;
+using xJson::xScanner;
+using xJson::xScanStack;
+
+xState xJson::xValidate(const char* data, size_t len, size_t* offset) {
+    const char* p = data;
+    const char* end = data + len;
+    xScanStack stack;
+    xState ret;
+    assert(data != nullptr || len == 0);
+    p = xScanner::skipWhiteSpace(p, end);
+    if ((ret = xScanner::skipValue(p, end, &p, &stack)) == xState::X_PARSE_OK) {
+        p = xScanner::skipWhiteSpace(p, end);
+        if (p != end)
+            ret = xState::X_PARSE_ROOT_NOT_SINGULAR;
+    }
+    if (offset != nullptr)
+        *offset = ret == xState::X_PARSE_OK ? len : p - data;
+    return ret;
+}
+
+xState xJson::xSkip(const char* data, size_t len, size_t* end,
+    size_t* count) {
+    const char* p;
+    size_t n;
+    xState ret;
+    assert((data != nullptr || len == 0) && end != nullptr);
+    p = xScanner::skipWhiteSpace(data, data + len);
+    ret = xScanner::skipRaw(p, data + len, &p, &n);
+    *end = p - data;
+    if (count != nullptr)
+        *count = n;
+    return ret;
+}
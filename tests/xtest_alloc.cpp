@@ -0,0 +1,149 @@
+/*copyright 2021 xkxsxkx*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <map>
+#include "xjson.h"
+#include "xjson_patch.h"
+#include "xtest.h"
+
+using namespace xJson;
+
+/**
+ * @brief malloc backed allocator that checks every sized free.
+ */
+struct xTestPool {
+    std::map<void*, size_t> blocks;
+    size_t mismatches = 0;
+    size_t calls = 0;
+};
+
+static void* test_alloc(void* ctx, size_t size) {
+    xTestPool* pool = (xTestPool*)ctx;
+    void* p = malloc(size);
+    pool->blocks[p] = size;
+    pool->calls++;
+    return p;
+}
+
+static void* test_realloc(void* ctx, void* p, size_t oldSize, size_t size) {
+    xTestPool* pool = (xTestPool*)ctx;
+    auto it = pool->blocks.find(p);
+    if (it == pool->blocks.end() || it->second != oldSize)
+        pool->mismatches++;
+    else
+        pool->blocks.erase(it);
+    p = realloc(p, size);
+    pool->blocks[p] = size;
+    pool->calls++;
+    return p;
+}
+
+static void test_free(void* ctx, void* p, size_t size) {
+    xTestPool* pool = (xTestPool*)ctx;
+    auto it = pool->blocks.find(p);
+    if (it == pool->blocks.end() || it->second != size)
+        pool->mismatches++;
+    else
+        pool->blocks.erase(it);
+    pool->calls++;
+    free(p);
+}
+
+static const char* test_json =
+    "{\"a\":[1,\"two\",{\"b\":null}],\"c\":\"d\",\"e\":{\"f\":[[],{}]}}";
+
+static void test_alloc_stats() {
+    xValue v;
+    xHelper h(&v);
+    xAllocStats parse = {}, stringify = {}, release = {};
+    size_t length;
+    {
+        xAllocatorScope scope(nullptr, &parse);
+        EXPECT_EQ_INT(xState::X_PARSE_OK, xParse(&v, test_json));
+    }
+    /* keys a c e b f, strings two d, arrays a f [], objects root b e {},
+     * plus the parse stack */
+    EXPECT_TRUE(parse.allocs >= 13);
+    EXPECT_TRUE(parse.bytes > 0 && parse.peak >= (size_t)parse.live);
+    EXPECT_TRUE(parse.live > 0);
+    EXPECT_EQ_SIZE_T(1, parse.frees);
+    {
+        xAllocatorScope scope(nullptr, &stringify);
+        char* out = xStringify(&v, &length);
+        free(out);
+    }
+    EXPECT_EQ_SIZE_T(1, stringify.allocs);
+    EXPECT_EQ_SIZE_T(0, stringify.reallocs);
+    {
+        xAllocatorScope scope(nullptr, &release);
+        xHelper::xSetNull(&v);
+    }
+    EXPECT_EQ_SIZE_T(parse.allocs - parse.frees, release.frees);
+    EXPECT_EQ_INT(-parse.live, release.live);
+}
+
+static void test_alloc_pool() {
+    xTestPool pool;
+    xAllocator allocator = { test_alloc, test_realloc, test_free, &pool };
+    xValue v, p;
+    size_t length;
+    {
+        xAllocatorScope scope(&allocator);
+        xHelper hv(&v), hp(&p);
+        EXPECT_EQ_INT(xState::X_PARSE_OK, xParse(&v, test_json));
+        EXPECT_EQ_INT(xState::X_PARSE_OK, xParse(&p,
+            "[{\"op\":\"remove\",\"path\":\"/a/1\"},"
+            "{\"op\":\"move\",\"from\":\"/c\",\"path\":\"/e/c\"},"
+            "{\"op\":\"remove\",\"path\":\"/e/f\"},"
+            "{\"op\":\"add\",\"path\":\"/a/0\",\"value\":\"x\"}]"));
+        EXPECT_EQ_INT(xPatchState::X_PATCH_OK, xApplyPatch(&v, &p, nullptr));
+        char* out = xStringify(&v, &length);
+        EXPECT_EQ_STRING("{\"a\":[\"x\",1,{\"b\":null}],\"e\":{\"c\":\"d\"}}",
+            out, length);
+        xDealloc(out, length + 1);
+        xHelper::xSetNull(&v);
+        EXPECT_EQ_INT(xState::X_PARSE_MISS_COMMA_OR_CURLY_BRACKET,
+            xParse(&v, "{\"k\":[\"s\"] \"l\"}"));
+    }
+    EXPECT_TRUE(pool.calls > 0);
+    EXPECT_EQ_SIZE_T(0, pool.mismatches);
+    EXPECT_EQ_SIZE_T(0, pool.blocks.size());
+}
+
+static void test_alloc_document() {
+    xTestPool pool;
+    xAllocator allocator = { test_alloc, test_realloc, test_free, &pool };
+    {
+        xDocument doc(&allocator);
+        EXPECT_EQ_INT(xState::X_PARSE_OK, doc.parse(test_json));
+        EXPECT_TRUE(pool.blocks.size() > 0);
+        xDocument copy = doc.clone();
+        xDocument other;
+        other = std::move(copy);
+        EXPECT_TRUE(xEqual(doc.value(), other.value()));
+    }
+    EXPECT_EQ_SIZE_T(0, pool.mismatches);
+    EXPECT_EQ_SIZE_T(0, pool.blocks.size());
+
+    const xAllocator* old = xSetDefaultAllocator(&allocator);
+    {
+        xValue v;
+        xHelper h(&v);
+        EXPECT_EQ_INT(xState::X_PARSE_OK, xParse(&v, "[\"a\",{\"b\":1}]"));
+        xHelper::xSetString(xHelper::xInsertArrayElement(&v, 1), "c", 1);
+        xHelper::xEraseArrayElement(&v, 0, 2);
+        EXPECT_TRUE(pool.blocks.size() > 0);
+    }
+    EXPECT_TRUE(xSetDefaultAllocator(old) == &allocator);
+    EXPECT_EQ_SIZE_T(0, pool.mismatches);
+    EXPECT_EQ_SIZE_T(0, pool.blocks.size());
+}
+
+int main() {
+    test_alloc_stats();
+    test_alloc_pool();
+    test_alloc_document();
+    TEST_SUMMARY();
+    return main_ret;
+}
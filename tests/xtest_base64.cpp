@@ -0,0 +1,59 @@
+/*copyright 2021 xkxsxkx*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include "../src/xjson_base64.h"
+#include "xtest.h"
+
+using namespace xJson;
+
+/* lengths around the 12 byte and 16 character blocks of the vector loops */
+static void test_base64_paths() {
+    uint8_t bytes[100], back[100];
+    char scalar[136], vector[136];
+    size_t n, len, m;
+    bool simd = xBase64::hasVector();
+    for (n = 0; n < sizeof(bytes); n++)
+        bytes[n] = (uint8_t)(n * 37 + 11);
+    for (n = 0; n <= sizeof(bytes); n++) {
+        len = xBase64::encodedLength(n);
+        xBase64::encode(bytes, n, scalar, false);
+        EXPECT_TRUE(xBase64::decode(scalar, len, back, &m, false));
+        EXPECT_TRUE(m == n && memcmp(back, bytes, n) == 0);
+        if (!simd)
+            continue;
+        xBase64::encode(bytes, n, vector, true);
+        EXPECT_TRUE(memcmp(scalar, vector, len) == 0);
+        memset(back, 0, sizeof(back));
+        EXPECT_TRUE(xBase64::decode(scalar, len, back, &m, true));
+        EXPECT_TRUE(m == n && memcmp(back, bytes, n) == 0);
+    }
+    xBase64::encode((const uint8_t*)"hello", 5, scalar, false);
+    EXPECT_EQ_STRING("aGVsbG8=", scalar, 8);
+}
+
+static void test_base64_invalid() {
+    std::string text(64, 'A');
+    uint8_t out[48];
+    size_t n;
+    for (int vector = 0; vector < (xBase64::hasVector() ? 2 : 1); vector++) {
+        /* inside the first block, in the tail, and padding mid-text */
+        text[5] = '*';
+        EXPECT_FALSE(xBase64::decode(text.data(), text.size(), out, &n, vector));
+        text[5] = 'A', text[61] = '-';
+        EXPECT_FALSE(xBase64::decode(text.data(), text.size(), out, &n, vector));
+        text[61] = 'A', text[20] = '=';
+        EXPECT_FALSE(xBase64::decode(text.data(), text.size(), out, &n, vector));
+        text[20] = 'A';
+        EXPECT_TRUE(xBase64::decode(text.data(), text.size(), out, &n, vector));
+        EXPECT_EQ_SIZE_T(48, n);
+    }
+}
+
+int main() {
+    test_base64_paths();
+    test_base64_invalid();
+    TEST_SUMMARY();
+    return main_ret;
+}
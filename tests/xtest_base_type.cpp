@@ -3,37 +3,10 @@
 #include <stdlib.h>
 #include <string.h>
 #include "xjson.h"
+#include "xtest.h"
 
 using namespace xJson;
 
-static int main_ret = 0;
-static int test_count = 0;
-static int test_pass = 0;
-
-#define EXPECT_EQ_BASE(equality, expect, actual, format) \
-    do {\
-        test_count++;\
-        if (equality)\
-            test_pass++;\
-        else {\
-            fprintf(stderr, "%s:%d: expect: " format " actural: " format "\n", __FILE__, __LINE__, expect, actual);\
-            main_ret = 1;\
-        }\
-    } while (0)
-
-#define EXPECT_EQ_INT(expect, actual) EXPECT_EQ_BASE((expect) == (actual), expect, actual, "%d")
-#define EXPECT_EQ_DOUBLE(expect, actual) EXPECT_EQ_BASE((expect) == (actual), expect, actual, "%.17g")
-#define EXPECT_EQ_STRING(expect, actual, alength) \
-    EXPECT_EQ_BASE(sizeof(expect) - 1 == alength && memcmp(expect, actual, alength) == 0, expect, actual, "%s")
-#define EXPECT_TRUE(actual) EXPECT_EQ_BASE((actual) != 0, "true", "false", "%s")
-#define EXPECT_FALSE(actual) EXPECT_EQ_BASE((actual) == 0, "false", "true", "%s")
-
-#if defined(_MSC_VER)
-#define EXPECT_EQ_SIZE_T(expect, actual) EXPECT_EQ_BASE((expect) == (actual), (size_t)expect, (size_t)actual, "%Iu")
-#else
-#define EXPECT_EQ_SIZE_T(expect, actual) EXPECT_EQ_BASE((expect) == (actual), (size_t)expect, (size_t)actual, "%zu")
-#endif
-
 static void test_parse_null() {
     xValue v;
     // xInit(&v);
@@ -369,7 +342,100 @@ static void test_access_string() {
         xHelper::xGetStringLength(&v));
 }
 
+static void test_access_binary() {
+    xValue v, text;
+    xHelper helper(&v), texts(&text);
+    uint8_t bytes[100];
+    const uint8_t* b;
+    char* json;
+    size_t i, len;
+    for (i = 0; i < sizeof(bytes); i++)
+        bytes[i] = (uint8_t)(i * 37);
+    /* long enough for the vector loops on both sides */
+    xHelper::xSetBinary(&v, bytes, sizeof(bytes));
+    json = xStringify(&v, &len);
+    EXPECT_EQ_SIZE_T(138, len);
+    EXPECT_EQ_INT(xState::X_PARSE_OK, xParse(&text, json));
+    free(json);
+    EXPECT_TRUE(xEqual(&v, &text));
+    EXPECT_TRUE(xHash(&v) == xHash(&text));
+    /* text until it is decoded, the getter never converts it */
+    EXPECT_TRUE(xHelper::xGetBinary(&text, &len) == nullptr);
+    EXPECT_TRUE(xHelper::xDecodeBinary(&text));
+    b = xHelper::xGetBinary(&text, &len);
+    EXPECT_TRUE(b != nullptr && len == sizeof(bytes)
+        && memcmp(b, bytes, len) == 0);
+    EXPECT_TRUE(text.flags & X_VALUE_FLAG_BINARY);
+    EXPECT_TRUE(xEqual(&v, &text));
+    /* read as a string it is base64 text, the value keeps its bytes */
+    const xValue* shared = &v;
+    EXPECT_EQ_SIZE_T(136, xHelper::xGetStringLength(shared));
+    json = xStringify(&text, &len);
+    EXPECT_TRUE(memcmp(xHelper::xGetString(shared), json + 1, 136) == 0);
+    EXPECT_TRUE(xHelper::xGetString(shared)[136] == '\0');
+    free(json);
+    EXPECT_TRUE(v.flags & X_VALUE_FLAG_BINARY);
+    EXPECT_TRUE(v.str.len == sizeof(bytes)
+        && memcmp(v.str.s, bytes, sizeof(bytes)) == 0);
+    EXPECT_TRUE(xEqual(&v, &text));
+    /* two binary strings read at once need buffers of their own */
+    char first[137], second[9];
+    xHelper::xSetBinary(&text, "hello", 5);
+    EXPECT_TRUE(strcmp(xHelper::xGetString(&v, first),
+        xHelper::xGetString(&text, second)) != 0);
+    EXPECT_EQ_STRING("aGVsbG8=", second, 8);
+    EXPECT_TRUE(strcmp(first, xHelper::xGetString(&v)) == 0);
 
+    xHelper::xSetNull(&v);
+    EXPECT_EQ_INT(xState::X_PARSE_OK, xParse(&v, "\"aGVsbG8=\""));
+    uint8_t out[6];
+    EXPECT_TRUE(xHelper::xGetBinary(&v, out, &len));
+    EXPECT_TRUE(len == 5 && memcmp(out, "hello", 5) == 0);
+    EXPECT_FALSE(v.flags & X_VALUE_FLAG_BINARY);
+    EXPECT_TRUE(xHelper::xDecodeBinary(&v));
+    b = xHelper::xGetBinary(&v, &len);
+    EXPECT_TRUE(b != nullptr && len == 5 && memcmp(b, "hello", 5) == 0);
+    json = xStringify(&v, &len);
+    EXPECT_EQ_STRING("\"aGVsbG8=\"", json, len);
+    free(json);
+    /* not canonical base64, nothing changes */
+    xHelper::xSetNull(&v);
+    EXPECT_EQ_INT(xState::X_PARSE_OK, xParse(&v, "\"aGVsbG9=\""));
+    EXPECT_FALSE(xHelper::xDecodeBinary(&v));
+    EXPECT_FALSE(xHelper::xGetBinary(&v, out, &len));
+    EXPECT_EQ_STRING("aGVsbG9=", xHelper::xGetString(&v),
+        xHelper::xGetStringLength(&v));
+    xHelper::xSetNull(&v);
+    EXPECT_EQ_INT(xState::X_PARSE_OK, xParse(&v, "\"hello\""));
+    EXPECT_FALSE(xHelper::xDecodeBinary(&v));
+    xHelper::xSetBinary(&v, bytes, 0);
+    json = xStringify(&v, &len);
+    EXPECT_EQ_STRING("\"\"", json, len);
+    free(json);
+}
+
+static void test_access_object() {
+    xValue v, copy;
+    xHelper helper(&v);
+    xHelper copied(&copy);
+    size_t i;
+    EXPECT_EQ_INT(xState::X_PARSE_OK, xParse(&v,
+        "{\"\":1,\"id\":2,\"a long key over eight bytes\":3,\"i\\u0064\":4}"));
+    /* every member carries the hash of its decoded key */
+    for (i = 0; i < helper.xGetObjectSize(&v); i++)
+        EXPECT_TRUE(v.object.m[i].hash
+            == xHashKey(v.object.m[i].k, v.object.m[i].klen));
+    EXPECT_EQ_SIZE_T(1, xHelper::xFindObjectIndex(&v, "id", 2));
+    EXPECT_EQ_SIZE_T(2, xHelper::xFindObjectIndex(&v,
+        "a long key over eight bytes", 27));
+    EXPECT_TRUE(xHelper::xFindObjectIndex(&v, "i", 1) == X_KEY_NOT_EXIST);
+    xHelper::xSetNumber(xHelper::xSetObjectValue(&v, "new", 3), 5);
+    EXPECT_TRUE(v.object.m[4].hash == xHashKey("new", 3));
+    EXPECT_EQ_SIZE_T(4, xHelper::xFindObjectIndex(&v, "new", 3));
+    xHelper::xCopy(&copy, &v);
+    EXPECT_TRUE(xEqual(&v, &copy));
+    EXPECT_TRUE(xHash(&v) == xHash(&copy));
+}
 
 static void test_parse_invalid_unicode_surrogate() {
     TEST_ERROR(xState::X_PARSE_INVALID_UNICODE_SURROGATE, "\"\\uD800\"");
@@ -493,6 +559,59 @@ static void test_stringify_object() {
     TEST_ROUNDTRIP("{\"n\":null,\"f\":false,\"t\":true,\"i\":123,\"s\":\"abc\",\"a\":[1,2,3],\"o\":{\"1\":1,\"2\":2,\"3\":3}}");
 }
 
+static void test_stringify_deep() {
+    /* far deeper than a recursive walk could go on a thread stack */
+    const size_t depth = 1000000;
+    xValue v;
+    xHelper helper(&v);
+    xValue* e = &v;
+    size_t i, length;
+    char* out;
+    bool nested = true;
+    for (i = 0; i < depth; i += 2) {
+        xHelper::xSetArray(e);
+        e = xHelper::xInsertArrayElement(e, 0);
+        xHelper::xSetObject(e);
+        xHelper::xSetNumber(xHelper::xSetObjectValue(e, "b", 1), 1);
+        e = xHelper::xSetObjectValue(e, "a", 1);
+    }
+    out = xStringify(&v, &length);
+    EXPECT_EQ_SIZE_T(depth / 2 * 14 + 4, length);
+    for (i = 0; i < depth / 2 && nested; i++)
+        nested = memcmp(out + i * 12, "[{\"b\":1,\"a\":", 12) == 0;
+    EXPECT_TRUE(nested);
+    EXPECT_TRUE(memcmp(out + depth / 2 * 12, "null}]}]", 8) == 0);
+    free(out);
+    /* members in key order, whatever the order they were added in */
+    out = xStringifyCanonical(&v, &length);
+    EXPECT_EQ_SIZE_T(depth / 2 * 14 + 4, length);
+    EXPECT_TRUE(memcmp(out, "[{\"a\":[{\"a\":", 12) == 0);
+    EXPECT_TRUE(memcmp(out + length - 16, ",\"b\":1}],\"b\":1}]", 16) == 0);
+    free(out);
+    xHelper::xSetNull(&v);
+
+    /* the key permutation of a wide object comes from the active allocator */
+    xAllocStats plain = {}, canonical = {};
+    char key[4];
+    xHelper::xSetObject(&v);
+    for (i = 0; i < 200; i++) {
+        snprintf(key, sizeof(key), "%03d", (int)(199 - i));
+        xHelper::xSetNumber(xHelper::xSetObjectValue(&v, key, 3), (double)i);
+    }
+    {
+        xAllocatorScope scope(nullptr, &plain);
+        free(xStringify(&v, &length));
+    }
+    {
+        xAllocatorScope scope(nullptr, &canonical);
+        out = xStringifyCanonical(&v, &length);
+    }
+    EXPECT_TRUE(canonical.allocs > plain.allocs);
+    EXPECT_TRUE(memcmp(out, "{\"000\":199,\"001\":198,", 21) == 0);
+    free(out);
+    xHelper::xSetNull(&v);
+}
+
 static void test_stringify() {
     TEST_ROUNDTRIP("null");
     TEST_ROUNDTRIP("false");
@@ -501,6 +620,7 @@ static void test_stringify() {
     test_stringify_string();
     test_stringify_array();
     test_stringify_object();
+    test_stringify_deep();
 }
 
 static void test_access() {
@@ -508,6 +628,8 @@ static void test_access() {
     test_access_boolean();
     test_access_number();
     test_access_string();
+    test_access_binary();
+    test_access_object();
 }
 
 int main() {
@@ -0,0 +1,161 @@
+/*copyright 2021 xkxsxkx*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include "xjson.h"
+#include "xjson_batch.h"
+#include "xtest.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+using namespace xJson;
+
+#define EXPECT_SPAN(expect, span)\
+    EXPECT_EQ_STRING(expect, (span).data, (span).len)
+
+static void test_batch_add() {
+    static const char* docs[] = {
+        "{\"id\":1,\"name\":\"a\\nb\"}", "[1,2.5,null]", "\"text\"", "true"
+    };
+    xValue v;
+    xHelper h(&v);
+    xBatchWriter w;
+    const xSpan* spans;
+    size_t i, len, total = 0;
+    for (i = 0; i < 4; i++) {
+        EXPECT_EQ_INT(xState::X_PARSE_OK, xParse(&v, docs[i]));
+        EXPECT_EQ_SIZE_T(i, w.add(&v));
+        xHelper::xSetNull(&v);
+    }
+    EXPECT_EQ_SIZE_T(4, w.size());
+    spans = w.spans();
+    for (i = 0; i < 4; i++) {
+        len = strlen(docs[i]);
+        EXPECT_TRUE(spans[i].len == len && memcmp(spans[i].data, docs[i], len) == 0);
+        EXPECT_TRUE(spans[i].data == w.data() + total);
+        total += len;
+    }
+    EXPECT_EQ_SIZE_T(total, w.length());
+
+    /* the arena is kept, the next batch starts over at its head */
+    const char* arena = w.data();
+    w.clear();
+    EXPECT_EQ_SIZE_T(0, w.size());
+    EXPECT_EQ_INT(xState::X_PARSE_OK, xParse(&v, "{\"b\":1,\"a\":2}"));
+    w.add(&v);
+    w.addCanonical(&v);
+    EXPECT_TRUE(w.data() == arena);
+    EXPECT_SPAN("{\"b\":1,\"a\":2}", w.span(0));
+    EXPECT_SPAN("{\"a\":2,\"b\":1}", w.span(1));
+    w.release();
+    EXPECT_EQ_SIZE_T(0, w.length());
+}
+
+static void test_batch_grow() {
+    xValue v;
+    xHelper h(&v);
+    xBatchWriter w;
+    std::string expect;
+    size_t i;
+    xHelper::xSetArray(&v);
+    for (i = 0; i < 100; i++)
+        xHelper::xSetNumber(xHelper::xInsertArrayElement(&v, i), (double)i);
+    /* spans made after the arena moved point into the new block */
+    for (i = 0; i < 100; i++) {
+        w.add(&v);
+        w.add(h.xGetArrayElement(&v, i));
+    }
+    const xSpan* spans = w.spans();
+    for (i = 0; i < 200; i++) {
+        expect = i % 2 == 0 ? "" : std::to_string(i / 2);
+        if (i % 2 == 0) {
+            for (size_t j = 0; j < 100; j++)
+                expect += (j == 0 ? "[" : ",") + std::to_string(j);
+            expect += "]";
+        }
+        EXPECT_TRUE(spans[i].len == expect.size()
+            && memcmp(spans[i].data, expect.data(), expect.size()) == 0);
+    }
+}
+
+static void* test_alloc(void* ctx, size_t size) {
+    ++*(size_t*)ctx;
+    return malloc(size);
+}
+
+static void* test_realloc(void* ctx, void* p, size_t oldSize, size_t size) {
+    ++*(size_t*)ctx;
+    (void)oldSize;
+    return realloc(p, size);
+}
+
+static void test_free(void* ctx, void* p, size_t size) {
+    ++*(size_t*)ctx;
+    (void)size;
+    free(p);
+}
+
+static void test_batch_local() {
+    xBatchWriter* main = &xBatchWriter::local();
+    xBatchWriter* other = nullptr;
+    EXPECT_TRUE(main == &xBatchWriter::local());
+    std::thread t([&other] { other = &xBatchWriter::local(); });
+    t.join();
+    EXPECT_TRUE(other != nullptr && other != main);
+
+    /* a scope open at first use does not become the arena allocator */
+    size_t calls = 0;
+    xAllocator counting = { test_alloc, test_realloc, test_free, &calls };
+    std::thread scoped([&counting] {
+        xValue v;
+        xHelper h(&v);
+        xHelper::xSetNumber(&v, 1);
+        {
+            xAllocatorScope scope(&counting);
+            xBatchWriter::local().add(&v);
+        }
+        xBatchWriter::local().add(&v);
+    });
+    scoped.join();
+    EXPECT_EQ_SIZE_T(0, calls);
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+static void test_batch_writev() {
+    xValue v;
+    xHelper h(&v);
+    xBatchWriter& w = xBatchWriter::local();
+    char buffer[64];
+    int fds[2];
+    ssize_t n;
+    w.clear();
+    EXPECT_EQ_INT(xState::X_PARSE_OK, xParse(&v, "[\"x\",{}]"));
+    w.add(&v);
+    xHelper::xSetNumber(&v, 7);
+    w.add(&v);
+    EXPECT_EQ_INT(0, pipe(fds));
+    n = writev(fds[1], (const struct iovec*)w.spans(), (int)w.size());
+    EXPECT_TRUE(n == (ssize_t)w.length());
+    n = read(fds[0], buffer, sizeof(buffer));
+    EXPECT_EQ_STRING("[\"x\",{}]7", buffer, (size_t)n);
+    close(fds[0]);
+    close(fds[1]);
+    w.release();
+}
+#endif
+
+int main() {
+    test_batch_add();
+    test_batch_grow();
+    test_batch_local();
+#if defined(__unix__) || defined(__APPLE__)
+    test_batch_writev();
+#endif
+    TEST_SUMMARY();
+    return main_ret;
+}
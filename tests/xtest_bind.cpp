@@ -0,0 +1,199 @@
+/*copyright 2021 xkxsxkx*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "xjson_bind.h"
+#include "xjson_phash.h"
+#include "xtest.h"
+
+using namespace xJson;
+
+struct Point {
+    int x;
+    double y;
+};
+
+struct Order {
+    long long id;
+    bool paid;
+    std::string name;
+    std::vector<Point> points;
+    std::vector<unsigned> tags;
+    Point origin;
+};
+
+template <> struct xJson::xBinding<Point> {
+    static constexpr auto fields = std::make_tuple(
+        xField("x", &Point::x),
+        xField("y", &Point::y));
+};
+
+template <> struct xJson::xBinding<Order> {
+    static constexpr auto fields = std::make_tuple(
+        xField("id", &Order::id),
+        xField("paid", &Order::paid),
+        xField("name", &Order::name),
+        xField("points", &Order::points),
+        xField("tags", &Order::tags),
+        xField("origin", &Order::origin));
+};
+
+static void test_bind_parse() {
+    Order o = Order();
+    EXPECT_EQ_INT(xState::X_PARSE_OK, xBindParse(
+        " { \"name\" : \"a\\nb\\u00A2\", \"unknown\" : [ { \"x\" : 1 }, null ],"
+        "\"id\" : -9007199254740993, \"paid\" : true,"
+        "\"points\" : [ { \"x\" : 1, \"y\" : 2.5 }, { \"y\" : -1e2, \"x\" : -3 } ],"
+        "\"tags\" : [ 1, 2, 3 ], \"origin\" : null, \"o\\u0072igin\" : { \"x\" : 7 } } ",
+        &o));
+    EXPECT_TRUE(o.id == -9007199254740993LL);
+    EXPECT_TRUE(o.paid);
+    EXPECT_EQ_STRING("a\nb\xC2\xA2", o.name.data(), o.name.size());
+    EXPECT_EQ_SIZE_T(2, o.points.size());
+    EXPECT_EQ_INT(1, o.points[0].x);
+    EXPECT_EQ_DOUBLE(2.5, o.points[0].y);
+    EXPECT_EQ_INT(-3, o.points[1].x);
+    EXPECT_EQ_DOUBLE(-100.0, o.points[1].y);
+    EXPECT_EQ_SIZE_T(3, o.tags.size());
+    EXPECT_EQ_INT(3, (int)o.tags[2]);
+    EXPECT_EQ_INT(7, o.origin.x);
+
+    /* the integral doubles next to the long long bounds */
+    EXPECT_EQ_INT(xState::X_PARSE_OK,
+        xBindParse("{\"id\":9.223372036854774784e18}", &o));
+    EXPECT_TRUE(o.id == 9223372036854774784LL);
+    EXPECT_EQ_INT(xState::X_PARSE_OK,
+        xBindParse("{\"id\":-9.223372036854775808e18}", &o));
+    EXPECT_TRUE(o.id == std::numeric_limits<long long>::min());
+}
+
+#define TEST_BIND_ERROR(error, T, json)\
+    do {\
+        T t = T();\
+        EXPECT_EQ_INT(error, xBindParse(json, &t));\
+    } while (0)
+
+static void test_bind_error() {
+    TEST_BIND_ERROR(xState::X_PARSE_EXPECT_VALUE, Point, " ");
+    TEST_BIND_ERROR(xState::X_PARSE_ROOT_NOT_SINGULAR, Point, "{} x");
+    TEST_BIND_ERROR(xState::X_PARSE_TYPE_MISMATCH, Point, "{\"x\":\"1\"}");
+    TEST_BIND_ERROR(xState::X_PARSE_TYPE_MISMATCH, Point, "{\"x\":1.5}");
+    TEST_BIND_ERROR(xState::X_PARSE_TYPE_MISMATCH, Point, "[]");
+    TEST_BIND_ERROR(xState::X_PARSE_NUMBER_TOO_BIG, Point, "{\"x\":3000000000}");
+    TEST_BIND_ERROR(xState::X_PARSE_NUMBER_TOO_BIG, Order, "{\"tags\":[-1]}");
+    /* 2^63 and -2^63 - 2048 as exponents, just outside long long */
+    TEST_BIND_ERROR(xState::X_PARSE_NUMBER_TOO_BIG, Order, "{\"id\":9.223372036854775808e18}");
+    TEST_BIND_ERROR(xState::X_PARSE_NUMBER_TOO_BIG, Order, "{\"id\":-9.22337203685477786e18}");
+    TEST_BIND_ERROR(xState::X_PARSE_NUMBER_TOO_BIG, Order, "{\"tags\":[4.294967296e9]}");
+    TEST_BIND_ERROR(xState::X_PARSE_NUMBER_TOO_BIG, Order, "{\"tags\":[-1e0]}");
+    TEST_BIND_ERROR(xState::X_PARSE_MISS_COLON, Point, "{\"x\"}");
+    TEST_BIND_ERROR(xState::X_PARSE_MISS_KEY, Point, "{\"x\":1,}");
+    TEST_BIND_ERROR(xState::X_PARSE_MISS_COMMA_OR_CURLY_BRACKET, Point, "{\"x\":1");
+    TEST_BIND_ERROR(xState::X_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, Order, "{\"tags\":[1 2]}");
+    TEST_BIND_ERROR(xState::X_PARSE_INVALID_VALUE, Order, "{\"skip\":[nul]}");
+    TEST_BIND_ERROR(xState::X_PARSE_MISS_QUOTATION_MARK, Order, "{\"name\":\"abc");
+    TEST_BIND_ERROR(xState::X_PARSE_INVALID_UNICODE_HEX, Order, "{\"name\":\"\\u12\"}");
+}
+
+static void test_bind_stringify() {
+    Order o = Order();
+    o.id = 42;
+    o.paid = false;
+    o.name = "q\"\x01";
+    o.points.push_back(Point{ 1, 0.5 });
+    o.tags.push_back(7);
+    o.origin.x = -2;
+    std::string json = xBindStringify(o);
+    const char expect[] = "{\"id\":42,\"paid\":false,\"name\":\"q\\\"\\u0001\","
+        "\"points\":[{\"x\":1,\"y\":0.5}],\"tags\":[7],"
+        "\"origin\":{\"x\":-2,\"y\":0}}";
+    EXPECT_EQ_STRING(expect, json.data(), json.size());
+
+    Order back = Order();
+    EXPECT_EQ_INT(xState::X_PARSE_OK, xBindParse(json.c_str(), &back));
+    EXPECT_EQ_STRING("q\"\x01", back.name.data(), back.name.size());
+    EXPECT_TRUE(back.id == 42);
+    EXPECT_EQ_DOUBLE(0.5, back.points[0].y);
+}
+
+static void test_perfect_hash() {
+    static constexpr auto keys = xMakePerfectHash(
+        "id", "name", "price", "qty", "sku", "tags", "created_at",
+        "updated_at", "a", "b", "ab", "ba", "");
+    static_assert(keys.size() == 13, "key count");
+    EXPECT_EQ_SIZE_T(0, keys.find("id", 2));
+    EXPECT_EQ_SIZE_T(2, keys.find("price", 5));
+    EXPECT_EQ_SIZE_T(6, keys.find("created_at", 10));
+    EXPECT_EQ_SIZE_T(7, keys.find("updated_at", 10));
+    EXPECT_EQ_SIZE_T(10, keys.find("ab", 2));
+    EXPECT_EQ_SIZE_T(11, keys.find("ba", 2));
+    EXPECT_EQ_SIZE_T(12, keys.find("", 0));
+    EXPECT_EQ_SIZE_T(X_KEY_NOT_EXIST, keys.find("prices", 6));
+    EXPECT_EQ_SIZE_T(X_KEY_NOT_EXIST, keys.find("ic", 2));
+    for (size_t i = 0; i < keys.size(); i++)
+        EXPECT_EQ_SIZE_T(i, keys.find(keys.key(i).data(), keys.key(i).size()));
+
+    /* keys sharing length, first, middle and last byte */
+    static constexpr auto close = xMakePerfectHash("axxb", "ayyb", "azzb");
+    EXPECT_EQ_SIZE_T(1, close.find("ayyb", 4));
+    EXPECT_EQ_SIZE_T(X_KEY_NOT_EXIST, close.find("axyb", 4));
+}
+
+/* the construction stays within the constant expression limits */
+static void test_perfect_hash_large() {
+    static constexpr auto k32 = xMakePerfectHash(
+        "f0", "f1", "f2", "f3", "f4", "f5", "f6", "f7", "f8", "f9", "f10",
+        "f11", "f12", "f13", "f14", "f15", "f16", "f17", "f18", "f19",
+        "f20", "f21", "f22", "f23", "f24", "f25", "f26", "f27", "f28",
+        "f29", "f30", "f31");
+    static constexpr auto k64 = xMakePerfectHash(
+        "field_0", "field_1", "field_2", "field_3", "field_4", "field_5",
+        "field_6", "field_7", "field_8", "field_9", "field_10", "field_11",
+        "field_12", "field_13", "field_14", "field_15", "field_16",
+        "field_17", "field_18", "field_19", "field_20", "field_21",
+        "field_22", "field_23", "field_24", "field_25", "field_26",
+        "field_27", "field_28", "field_29", "field_30", "field_31",
+        "field_32", "field_33", "field_34", "field_35", "field_36",
+        "field_37", "field_38", "field_39", "field_40", "field_41",
+        "field_42", "field_43", "field_44", "field_45", "field_46",
+        "field_47", "field_48", "field_49", "field_50", "field_51",
+        "field_52", "field_53", "field_54", "field_55", "field_56",
+        "field_57", "field_58", "field_59", "field_60", "field_61",
+        "field_62", "field_63");
+    static_assert(k32.find("f0", 2) == 0 && k32.find("f31", 3) == 31,
+        "32 keys");
+    static_assert(k64.find("field_63", 8) == 63
+        && k64.find("field_64", 8) == X_KEY_NOT_EXIST, "64 keys");
+    for (size_t i = 0; i < k32.size(); i++)
+        EXPECT_EQ_SIZE_T(i, k32.find(k32.key(i).data(), k32.key(i).size()));
+    for (size_t i = 0; i < k64.size(); i++)
+        EXPECT_EQ_SIZE_T(i, k64.find(k64.key(i).data(), k64.key(i).size()));
+    EXPECT_EQ_SIZE_T(X_KEY_NOT_EXIST, k32.find("f32", 3));
+    EXPECT_EQ_SIZE_T(X_KEY_NOT_EXIST, k64.find("field_", 6));
+}
+
+static void test_perfect_hash_members() {
+    static constexpr auto keys = xMakePerfectHash("x", "y", "z");
+    xValue v;
+    xHelper h(&v);
+    xValue* values[3];
+    EXPECT_EQ_INT(xState::X_PARSE_OK,
+        xParse(&v, "{\"w\":0,\"z\":3,\"x\":1,\"x\":2}"));
+    EXPECT_EQ_SIZE_T(2, keys.collect(&v, values));
+    EXPECT_EQ_DOUBLE(1.0, xHelper::xGetNumber(values[0]));
+    EXPECT_TRUE(values[1] == nullptr);
+    EXPECT_EQ_DOUBLE(3.0, xHelper::xGetNumber(values[2]));
+}
+
+int main() {
+    test_perfect_hash();
+    test_perfect_hash_large();
+    test_perfect_hash_members();
+    test_bind_parse();
+    test_bind_error();
+    test_bind_stringify();
+    TEST_SUMMARY();
+    return main_ret;
+}
@@ -0,0 +1,191 @@
+/*copyright 2021 xkxsxkx*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include "xjson.h"
+#include "xjson_column.h"
+#include "xtest.h"
+
+using namespace xJson;
+
+#define RECORDS "[{\"id\":1,\"price\":5,\"name\":\"a\",\"ok\":true},"\
+    "{\"id\":2,\"price\":12.5,\"name\":\"b\\u0041\",\"ok\":false,\"tag\":[1, {}]},"\
+    "{\"name\":null,\"price\":3,\"id\":3},"\
+    "{\"id\":4,\"price\":1e2,\"name\":\"\",\"ok\":true,\"tag\":\"t\"}]"
+
+#define EXPECT_COLUMN_TEXT(expect, c, row)\
+    do {\
+        size_t len;\
+        const char* s = (c)->text(row, &len);\
+        EXPECT_EQ_STRING(expect, s, len);\
+    } while (0)
+
+static void check_records(const xColumnTable& t) {
+    EXPECT_EQ_SIZE_T(4, t.size());
+    EXPECT_EQ_SIZE_T(5, t.columnCount());
+    EXPECT_TRUE(t.column(0).name == "id");
+    EXPECT_TRUE(t.column("missing", 7) == nullptr);
+
+    const xColumn* id = t.column("id", 2);
+    EXPECT_EQ_INT(xColumnType::X_COLUMN_INT64, id->type);
+    EXPECT_EQ_SIZE_T(4, id->ints.size());
+    EXPECT_TRUE(id->ints[0] == 1 && id->ints[2] == 3 && id->ints[3] == 4);
+
+    /* integers seen first are widened */
+    const xColumn* price = t.column("price", 5);
+    EXPECT_EQ_INT(xColumnType::X_COLUMN_DOUBLE, price->type);
+    EXPECT_TRUE(price->ints.empty());
+    EXPECT_EQ_DOUBLE(5.0, price->doubles[0]);
+    EXPECT_EQ_DOUBLE(12.5, price->doubles[1]);
+    EXPECT_EQ_DOUBLE(100.0, price->doubles[3]);
+
+    const xColumn* name = t.column("name", 4);
+    EXPECT_EQ_INT(xColumnType::X_COLUMN_STRING, name->type);
+    EXPECT_COLUMN_TEXT("a", name, 0);
+    EXPECT_COLUMN_TEXT("bA", name, 1);
+    EXPECT_FALSE(name->isValid(2));
+    EXPECT_COLUMN_TEXT("", name, 2);
+    EXPECT_TRUE(name->isValid(3));
+    EXPECT_COLUMN_TEXT("", name, 3);
+
+    const xColumn* ok = t.column("ok", 2);
+    EXPECT_EQ_INT(xColumnType::X_COLUMN_BOOL, ok->type);
+    EXPECT_TRUE(ok->bools[0] == 1 && ok->bools[1] == 0 && ok->bools[3] == 1);
+    EXPECT_FALSE(ok->isValid(2));
+
+    /* an array then a string, kept as json text */
+    const xColumn* tag = t.column("tag", 3);
+    EXPECT_EQ_INT(xColumnType::X_COLUMN_JSON, tag->type);
+    EXPECT_FALSE(tag->isValid(0));
+    EXPECT_COLUMN_TEXT("[1,{}]", tag, 1);
+    EXPECT_FALSE(tag->isValid(2));
+    EXPECT_COLUMN_TEXT("\"t\"", tag, 3);
+}
+
+static void test_column_parse() {
+    xColumnTable t;
+    EXPECT_EQ_INT(xState::X_PARSE_OK, t.parse(RECORDS, sizeof(RECORDS) - 1));
+    check_records(t);
+
+    xColumnTable empty;
+    EXPECT_EQ_INT(xState::X_PARSE_OK, empty.parse(" [ ] ", 5));
+    EXPECT_EQ_SIZE_T(0, empty.size());
+    EXPECT_EQ_INT(xState::X_PARSE_OK, empty.parse("[{}, {}]", 8));
+    EXPECT_EQ_SIZE_T(2, empty.size());
+    EXPECT_EQ_SIZE_T(0, empty.columnCount());
+}
+
+static void test_column_value() {
+    xValue v;
+    xHelper h(&v);
+    xColumnTable t;
+    EXPECT_EQ_INT(xState::X_PARSE_OK, xParse(&v, RECORDS));
+    EXPECT_EQ_INT(xState::X_PARSE_OK, t.append(&v));
+    check_records(t);
+
+    /* appending to the same table keeps the columns */
+    const char more[] = "[{\"price\":1,\"new\":7}]";
+    EXPECT_EQ_INT(xState::X_PARSE_OK, t.parse(more, sizeof(more) - 1));
+    EXPECT_EQ_SIZE_T(5, t.size());
+    const xColumn* added = t.column("new", 3);
+    EXPECT_EQ_SIZE_T(5, added->ints.size());
+    EXPECT_FALSE(added->isValid(3));
+    EXPECT_TRUE(added->isValid(4) && added->ints[4] == 7);
+    EXPECT_FALSE(t.column("id", 2)->isValid(4));
+
+    /* a lazy tree gives the columns the text gives */
+    const char big[] = "[{\"a\":1234567890123456789,\"b\":1.5e3},"
+        "{\"a\":9223372036854775807,\"b\":2}]";
+    xColumnTable text, tree;
+    EXPECT_EQ_INT(xState::X_PARSE_OK, text.parse(big, sizeof(big) - 1));
+    xHelper::xSetNull(&v);
+    EXPECT_EQ_INT(xState::X_PARSE_OK, xParseWith<xLazyPolicy>(&v, big));
+    EXPECT_EQ_INT(xState::X_PARSE_OK, tree.append(&v));
+    for (const xColumnTable* c : { &text, &tree }) {
+        const xColumn* a = c->column("a", 1);
+        const xColumn* b = c->column("b", 1);
+        EXPECT_EQ_INT(xColumnType::X_COLUMN_INT64, a->type);
+        EXPECT_TRUE(a->ints[0] == 1234567890123456789LL
+            && a->ints[1] == INT64_MAX);
+        EXPECT_EQ_INT(xColumnType::X_COLUMN_DOUBLE, b->type);
+        EXPECT_EQ_DOUBLE(1500.0, b->doubles[0]);
+        EXPECT_EQ_DOUBLE(2.0, b->doubles[1]);
+    }
+}
+
+static void test_column_widen() {
+    xColumnTable t;
+    const char json[] = "[{\"a\":1,\"b\":\"x\\n\",\"c\":true},"
+        "{\"a\":9223372036854775807,\"b\":2.5,\"c\":1},"
+        "{\"a\":9223372036854775808,\"b\":null,\"c\":null}]";
+    EXPECT_EQ_INT(xState::X_PARSE_OK, t.parse(json, sizeof(json) - 1));
+    const xColumn* a = t.column("a", 1);
+    EXPECT_EQ_INT(xColumnType::X_COLUMN_DOUBLE, a->type);
+    EXPECT_EQ_DOUBLE(9223372036854775808.0, a->doubles[2]);
+    const xColumn* b = t.column("b", 1);
+    EXPECT_EQ_INT(xColumnType::X_COLUMN_JSON, b->type);
+    EXPECT_COLUMN_TEXT("\"x\\n\"", b, 0);
+    EXPECT_COLUMN_TEXT("2.5", b, 1);
+    const xColumn* c = t.column("c", 1);
+    EXPECT_EQ_INT(xColumnType::X_COLUMN_JSON, c->type);
+    EXPECT_COLUMN_TEXT("true", c, 0);
+    EXPECT_COLUMN_TEXT("1", c, 1);
+    EXPECT_FALSE(c->isValid(2));
+
+    /* bitmaps span several words */
+    std::string many = "[";
+    for (int i = 0; i < 200; i++)
+        many += i % 3 == 0 ? "{\"x\":null}," : "{\"x\":" + std::to_string(i) + "},";
+    many.back() = ']';
+    xColumnTable m;
+    EXPECT_EQ_INT(xState::X_PARSE_OK, m.parse(many.data(), many.size()));
+    const xColumn* x = m.column("x", 1);
+    EXPECT_EQ_SIZE_T(4, x->valid.size());
+    EXPECT_FALSE(x->isValid(198));
+    EXPECT_TRUE(x->isValid(199) && x->ints[199] == 199);
+}
+
+static void test_column_error() {
+    xColumnTable t;
+    size_t offset = 0;
+    EXPECT_EQ_INT(xState::X_PARSE_TYPE_MISMATCH, t.parse("{}", 2, &offset));
+    EXPECT_EQ_SIZE_T(0, offset);
+    EXPECT_EQ_INT(xState::X_PARSE_TYPE_MISMATCH, t.parse("[{}, 1]", 7, &offset));
+    EXPECT_EQ_SIZE_T(5, offset);
+    EXPECT_EQ_INT(xState::X_PARSE_EXPECT_VALUE, t.parse("", 0));
+    EXPECT_EQ_INT(xState::X_PARSE_INVALID_VALUE, t.parse("x", 1));
+    EXPECT_EQ_INT(xState::X_PARSE_INVALID_VALUE, t.parse("[{}, ?]", 7));
+    EXPECT_EQ_INT(xState::X_PARSE_ROOT_NOT_SINGULAR, t.parse("[] x", 4));
+    t.clear();
+
+    /* the broken record is rolled back */
+    const char json[] = "[{\"a\":1},{\"a\":2,\"b\":3,\"c\":[tru]}]";
+    EXPECT_EQ_INT(xState::X_PARSE_INVALID_VALUE, t.parse(json, sizeof(json) - 1, &offset));
+    EXPECT_EQ_SIZE_T(27, offset);
+    EXPECT_EQ_SIZE_T(1, t.size());
+    EXPECT_EQ_SIZE_T(1, t.columnCount());
+    EXPECT_EQ_SIZE_T(1, t.column("a", 1)->ints.size());
+    EXPECT_EQ_INT(xState::X_PARSE_MISS_COMMA_OR_CURLY_BRACKET, t.parse("[{\"a\":1", 7));
+    EXPECT_EQ_SIZE_T(1, t.size());
+
+    xValue v;
+    xHelper h(&v);
+    EXPECT_EQ_INT(xState::X_PARSE_OK, xParse(&v, "[{\"a\":1}, []]"));
+    EXPECT_EQ_INT(xState::X_PARSE_TYPE_MISMATCH, t.append(&v));
+    EXPECT_EQ_SIZE_T(1, t.size());
+
+    /* a trailing comma is a syntax error, not a record of another type */
+    EXPECT_EQ_INT(xState::X_PARSE_INVALID_VALUE, t.parse("[{\"a\":1},]", 10, &offset));
+    EXPECT_EQ_SIZE_T(9, offset);
+    EXPECT_EQ_SIZE_T(2, t.size());
+}
+
+int main() {
+    test_column_parse();
+    test_column_value();
+    test_column_widen();
+    test_column_error();
+    TEST_SUMMARY();
+    return main_ret;
+}
@@ -0,0 +1,178 @@
+/*copyright 2021 xkxsxkx*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <utility>
+#include "xjson.h"
+#include "xtest.h"
+
+using namespace xJson;
+
+#define TEST_STRINGIFY(expect, value)\
+    do {\
+        size_t length;\
+        char* json = xStringify(value, &length);\
+        EXPECT_EQ_STRING(expect, json, length);\
+        free(json);\
+    } while (0)
+
+static const char* sample =
+    "{\"n\":null,\"f\":false,\"t\":true,\"i\":123,\"s\":\"abc\","
+    "\"a\":[1,2,[\"x\"]],\"o\":{\"1\":1,\"2\":\"2\",\"3\":[]}}";
+
+static void test_copy() {
+    xValue v1, v2;
+    xHelper h1(&v1);
+    xHelper h2(&v2);
+    EXPECT_EQ_INT(xState::X_PARSE_OK, xParse(&v1, sample));
+    xHelper::xSetString(&v2, "old", 3);
+    xHelper::xCopy(&v2, &v1);
+    TEST_STRINGIFY("{\"n\":null,\"f\":false,\"t\":true,\"i\":123,"
+        "\"s\":\"abc\",\"a\":[1,2,[\"x\"]],"
+        "\"o\":{\"1\":1,\"2\":\"2\",\"3\":[]}}", &v2);
+    /* the copy must not share any buffer with the source */
+    EXPECT_TRUE(xHelper::xGetString(&v1.object.m[4].v)
+        != xHelper::xGetString(&v2.object.m[4].v));
+    EXPECT_TRUE(v1.object.m[5].v.array.e != v2.object.m[5].v.array.e);
+    xHelper::xSetNull(&v1);
+    TEST_STRINGIFY("[1,2,[\"x\"]]", &v2.object.m[5].v);
+}
+
+static void test_move() {
+    xValue v1, v2, v3;
+    xHelper h1(&v1);
+    xHelper h2(&v2);
+    xHelper h3(&v3);
+    EXPECT_EQ_INT(xState::X_PARSE_OK, xParse(&v1, "[1,\"a\"]"));
+    xHelper::xMove(&v2, &v1);
+    EXPECT_EQ_INT(xType::X_TYPE_NULL, xHelper::xGetType(&v1));
+    TEST_STRINGIFY("[1,\"a\"]", &v2);
+    xHelper::xSetNumber(&v3, 1.5);
+    xHelper::xSwap(&v2, &v3);
+    TEST_STRINGIFY("1.5", &v2);
+    TEST_STRINGIFY("[1,\"a\"]", &v3);
+}
+
+static void test_document() {
+    xDocument d1;
+    EXPECT_EQ_INT(xType::X_TYPE_NULL, xHelper::xGetType(d1.value()));
+    EXPECT_EQ_INT(xState::X_PARSE_OK, d1.parse("{\"k\":[true,\"v\"]}"));
+    const xValue* root = d1.value();
+
+    xDocument d2(std::move(d1));
+    EXPECT_TRUE(d2.value()->object.m == root->object.m);
+    EXPECT_EQ_INT(xType::X_TYPE_NULL, xHelper::xGetType(d1.value()));
+
+    xDocument d3 = d2.clone();
+    EXPECT_TRUE(d3.value()->object.m != d2.value()->object.m);
+    TEST_STRINGIFY("{\"k\":[true,\"v\"]}", d3.value());
+
+    EXPECT_EQ_INT(xState::X_PARSE_OK, d1.parse("42"));
+    d1.swap(d3);
+    TEST_STRINGIFY("42", d3.value());
+    TEST_STRINGIFY("{\"k\":[true,\"v\"]}", d1.value());
+
+    d2 = std::move(d3);
+    TEST_STRINGIFY("42", d2.value());
+    EXPECT_EQ_INT(xType::X_TYPE_NULL, xHelper::xGetType(d3.value()));
+
+    size_t length;
+    char* json = d1.stringify(&length);
+    EXPECT_EQ_STRING("{\"k\":[true,\"v\"]}", json, length);
+    free(json);
+}
+
+#define TEST_EQUAL(json1, json2, equality)\
+    do {\
+        xValue v1, v2;\
+        xHelper h1(&v1);\
+        xHelper h2(&v2);\
+        EXPECT_EQ_INT(xState::X_PARSE_OK, xParse(&v1, json1));\
+        EXPECT_EQ_INT(xState::X_PARSE_OK, xParse(&v2, json2));\
+        EXPECT_EQ_INT(equality, xEqual(&v1, &v2));\
+        if (equality)\
+            EXPECT_TRUE(xHash(&v1) == xHash(&v2));\
+    } while (0)
+
+static void test_equal() {
+    TEST_EQUAL("true", "true", 1);
+    TEST_EQUAL("true", "false", 0);
+    TEST_EQUAL("false", "false", 1);
+    TEST_EQUAL("null", "null", 1);
+    TEST_EQUAL("null", "0", 0);
+    TEST_EQUAL("123", "123", 1);
+    TEST_EQUAL("123", "456", 0);
+    TEST_EQUAL("0", "-0", 1);
+    TEST_EQUAL("\"abc\"", "\"abc\"", 1);
+    TEST_EQUAL("\"abc\"", "\"abcd\"", 0);
+    TEST_EQUAL("[]", "[]", 1);
+    TEST_EQUAL("[]", "null", 0);
+    TEST_EQUAL("[1,2,3]", "[1,2,3]", 1);
+    TEST_EQUAL("[1,2,3]", "[1,2,3,4]", 0);
+    TEST_EQUAL("[1,2,3]", "[3,2,1]", 0);
+    TEST_EQUAL("[[]]", "[[]]", 1);
+    TEST_EQUAL("{}", "{}", 1);
+    TEST_EQUAL("{}", "null", 0);
+    TEST_EQUAL("{}", "[]", 0);
+    TEST_EQUAL("{\"a\":1,\"b\":2}", "{\"a\":1,\"b\":2}", 1);
+    TEST_EQUAL("{\"a\":1,\"b\":2}", "{\"b\":2,\"a\":1}", 1);
+    TEST_EQUAL("{\"a\":1,\"b\":2}", "{\"a\":1,\"b\":3}", 0);
+    TEST_EQUAL("{\"a\":1,\"b\":2}", "{\"a\":1,\"b\":2,\"c\":3}", 0);
+    TEST_EQUAL("{\"a\":{\"b\":{\"c\":{}}}}", "{\"a\":{\"b\":{\"c\":{}}}}", 1);
+    TEST_EQUAL("{\"a\":{\"b\":{\"c\":{}}}}", "{\"a\":{\"b\":{\"c\":[]}}}", 0);
+    TEST_EQUAL("9007199254740992", "9007199254740992.0", 1);
+    TEST_EQUAL("[1,2.5]", "[1.0,2.5]", 1);
+
+    /* integers compare exactly against doubles, so equality stays transitive */
+    const int64_t big[] = { 9007199254740993 };
+    const int64_t near[] = { 9007199254740992 };
+    xValue a, b, c;
+    xHelper ha(&a), hb(&b), hc(&c);
+    xHelper::xSetInt64Array(&a, big, 1);
+    xHelper::xSetInt64Array(&b, near, 1);
+    EXPECT_EQ_INT(xState::X_PARSE_OK, xParse(&c, "[9007199254740992.0]"));
+    EXPECT_FALSE(xEqual(&a, &b));
+    EXPECT_FALSE(xEqual(&a, &c));
+    EXPECT_FALSE(xEqual(&c, &a));
+    EXPECT_TRUE(xEqual(&b, &c));
+    EXPECT_TRUE(xHash(&b) == xHash(&c));
+    EXPECT_TRUE(xHelper::xGetInt64Array(&a) != nullptr);
+    xHelper::xSetNull(&c);
+    EXPECT_EQ_INT(xState::X_PARSE_OK, xParseWith<xDensePolicy>(&c,
+        "[9007199254740992.0]"));
+    EXPECT_TRUE(xEqual(&b, &c));
+    EXPECT_TRUE(xHash(&b) == xHash(&c));
+    EXPECT_FALSE(xEqual(&a, &c));
+}
+
+static void test_hash() {
+    xValue v1, v2;
+    xHelper h1(&v1);
+    xHelper h2(&v2);
+    xHashCache cache;
+    EXPECT_EQ_INT(xState::X_PARSE_OK, xParse(&v1, sample));
+    xHelper::xCopy(&v2, &v1);
+    uint64_t h = xHash(&v1, &cache);
+    EXPECT_TRUE(h == xHash(&v2));
+    EXPECT_TRUE(cache.size() > 0);
+    EXPECT_TRUE(h == xHash(&v1, &cache));
+    EXPECT_TRUE(xEqual(&v1, &v1));
+    xHelper::xSetNumber(xHelper::xFindObjectValue(&v2, "i", 1), 124);
+    EXPECT_FALSE(xEqual(&v1, &v2));
+    EXPECT_TRUE(h != xHash(&v2));
+    EXPECT_TRUE(xHash(xHelper::xFindObjectValue(&v1, "a", 1))
+        != xHash(xHelper::xFindObjectValue(&v1, "o", 1)));
+    EXPECT_TRUE(xHelper::xFindObjectValue(&v1, "x", 1) == nullptr);
+    EXPECT_EQ_SIZE_T(X_KEY_NOT_EXIST, xHelper::xFindObjectIndex(&v1, "x", 1));
+    EXPECT_EQ_SIZE_T(6, xHelper::xFindObjectIndex(&v1, "o", 1));
+}
+
+int main() {
+    test_equal();
+    test_hash();
+    test_copy();
+    test_move();
+    test_document();
+    TEST_SUMMARY();
+    return main_ret;
+}
@@ -0,0 +1,116 @@
+/*copyright 2021 xkxsxkx*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include "xjson.h"
+#include "xjson_file.h"
+#include "xtest.h"
+
+using namespace xJson;
+
+#define TEST_FILE_PATH "xtest_file.json"
+
+static void writeFile(const char* text, size_t len) {
+    FILE* f = fopen(TEST_FILE_PATH, "wb");
+    EXPECT_TRUE(f != nullptr);
+    if (f == nullptr)
+        return;
+    fwrite(text, 1, len, f);
+    fclose(f);
+}
+
+#define TEST_FILE(expect, json)\
+    do {\
+        xValue v;\
+        xHelper h(&v);\
+        writeFile(json, sizeof(json) - 1);\
+        EXPECT_EQ_INT(expect, xParseFile(&v, TEST_FILE_PATH));\
+    } while (0)
+
+static void test_file_parse() {
+    xValue v;
+    xHelper h(&v);
+    writeFile("{\"a\" : [1, \"x\"]}\n", 17);
+    EXPECT_EQ_INT(xState::X_PARSE_OK, xParseFile(&v, TEST_FILE_PATH));
+    size_t length;
+    char* out = xStringify(&v, &length);
+    EXPECT_EQ_STRING("{\"a\":[1,\"x\"]}", out, length);
+    free(out);
+
+    TEST_FILE(xState::X_PARSE_OK, " null ");
+    TEST_FILE(xState::X_PARSE_EXPECT_VALUE, "");
+    TEST_FILE(xState::X_PARSE_INVALID_VALUE, "nul");
+    TEST_FILE(xState::X_PARSE_ROOT_NOT_SINGULAR, "[1]\0[2]");
+    TEST_FILE(xState::X_PARSE_MISS_QUOTATION_MARK, "\"a\0b\"");
+
+    xMapOptions relaxed;
+    relaxed.populate = true;
+    relaxed.hugePages = true;
+    xHelper::xSetNull(&v);
+    writeFile("[1, 2, ] // end", 15);
+    EXPECT_EQ_INT(xState::X_PARSE_OK,
+        xParseFileWith<xRelaxedPolicy>(&v, TEST_FILE_PATH, &relaxed));
+    EXPECT_EQ_SIZE_T(2, xHelper::xGetArraySize(&v));
+
+    xHelper::xSetNull(&v);
+    remove(TEST_FILE_PATH);
+    EXPECT_EQ_INT(xState::X_PARSE_FILE_ERROR, xParseFile(&v, TEST_FILE_PATH));
+    EXPECT_EQ_INT(xType::X_TYPE_NULL, xHelper::xGetType(&v));
+}
+
+static void test_file_page_boundary() {
+    /* the text fills whole pages, the terminator lies behind them */
+    std::string json = "[";
+    while (json.size() < 8192 - 3)
+        json += "0,";
+    json += " 0]";
+    writeFile(json.data(), json.size());
+    xMappedFile file;
+    EXPECT_EQ_INT(xState::X_PARSE_OK, file.open(TEST_FILE_PATH));
+    EXPECT_EQ_SIZE_T(json.size(), file.size());
+    EXPECT_TRUE(file.data()[file.size()] == '\0');
+    EXPECT_TRUE(file.mutableData() == nullptr);
+    EXPECT_EQ_INT(xState::X_PARSE_OK, xValidate(file.data(), file.size()));
+
+    xValue v;
+    xHelper h(&v);
+    EXPECT_EQ_INT(xState::X_PARSE_OK, xParseFile(&v, TEST_FILE_PATH));
+    EXPECT_EQ_SIZE_T(4095, xHelper::xGetArraySize(&v));
+    remove(TEST_FILE_PATH);
+}
+
+static void test_file_insitu() {
+    writeFile("{\"k\":\"a\\nb\",\"n\":12.50}", 22);
+    xMapOptions options;
+    options.writable = true;
+    xMappedFile file;
+    EXPECT_EQ_INT(xState::X_PARSE_OK, file.open(TEST_FILE_PATH, &options));
+    remove(TEST_FILE_PATH);
+
+    xValue v;
+    xHelper h(&v);
+    EXPECT_EQ_INT(xState::X_PARSE_OK, xParseInsitu<xLazyPolicy>(&v, &file));
+    const xValue* s = xHelper::xFindObjectValue(&v, "k", 1);
+    const xValue* n = xHelper::xFindObjectValue(&v, "n", 1);
+    /* the values borrow the private pages of the mapping */
+    EXPECT_TRUE(s->str.s > file.data() && s->str.s < file.data() + file.size());
+    size_t len;
+    const char* text = xHelper::xGetNumberText(n, &len);
+    EXPECT_EQ_STRING("12.50", text, len);
+
+    xMappedFile moved(std::move(file));
+    EXPECT_TRUE(file.data() == nullptr);
+    text = xHelper::xGetString(s);
+    len = xHelper::xGetStringLength(s);
+    EXPECT_EQ_STRING("a\nb", text, len);
+    xHelper::xSetNull(&v);
+}
+
+int main() {
+    test_file_parse();
+    test_file_page_boundary();
+    test_file_insitu();
+    TEST_SUMMARY();
+    return main_ret;
+}
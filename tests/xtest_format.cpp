@@ -0,0 +1,98 @@
+/*copyright 2021 xkxsxkx*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include "xjson.h"
+#include "xtest.h"
+
+using namespace xJson;
+
+static void test_write_string(void* ctx, const char* data, size_t len) {
+    ((std::string*)ctx)->append(data, len);
+}
+
+#define TEST_FORMAT(expect, json, options)\
+    do {\
+        std::string out;\
+        xWriter w = { test_write_string, &out };\
+        EXPECT_EQ_INT(xState::X_PARSE_OK,\
+            xFormat(json, sizeof(json) - 1, &w, options));\
+        EXPECT_EQ_STRING(expect, out.data(), out.size());\
+    } while (0)
+
+static void test_format_minify() {
+    TEST_FORMAT("{\"a\":[1,2.50,-0E+3],\"b c\":{},\"d\":[]}",
+        " { \"a\" : [ 1 ,\n2.50,\t-0E+3 ] , \"b c\":{ } ,\"d\" :[\r\n] } ",
+        nullptr);
+    /* lexemes are kept verbatim, unlike a parse and stringify round trip */
+    TEST_FORMAT("[1.0e2,\"\\u00e9\\/\",12345678901234567890]",
+        "[ 1.0e2 , \"\\u00e9\\/\" , 12345678901234567890 ]", nullptr);
+    TEST_FORMAT("\"  spaced  \"", "  \"  spaced  \"  ", nullptr);
+}
+
+static void test_format_pretty() {
+    xFormatOptions pretty;
+    pretty.indent = 2;
+    TEST_FORMAT("{\n  \"a\": [\n    1,\n    {}\n  ],\n  \"b\": null\n}",
+        "{\"a\":[1,{}],\"b\":null}", &pretty);
+    TEST_FORMAT("[]", "[ ]", &pretty);
+
+    xFormatOptions tabs;
+    tabs.indent = 1;
+    tabs.tabs = true;
+    TEST_FORMAT("[\n\t[\n\t\ttrue\n\t]\n]", "[[true]]", &tabs);
+    /* tabs pretty-print on their own, indent only counts spaces */
+    tabs.indent = 0;
+    TEST_FORMAT("{\n\t\"a\": [\n\t\ttrue\n\t]\n}", "{\"a\":[true]}", &tabs);
+
+    /* indentation wider than the space block */
+    xFormatOptions wide;
+    wide.indent = 40;
+    std::string expect = "[\n" + std::string(40, ' ') + "1\n]";
+    std::string out;
+    xWriter w = { test_write_string, &out };
+    EXPECT_EQ_INT(xState::X_PARSE_OK, xFormat("[1]", 3, &w, &wide));
+    EXPECT_TRUE(out == expect);
+}
+
+static void test_format_error() {
+    std::string out;
+    xWriter w = { test_write_string, &out };
+    size_t offset = 0;
+    EXPECT_EQ_INT(xState::X_PARSE_MISS_COMMA_OR_SQUARE_BRACKET,
+        xFormat("[1, 2 3]", 8, &w, nullptr, &offset));
+    EXPECT_EQ_SIZE_T(6, offset);
+    EXPECT_EQ_STRING("[1,2", out.data(), out.size());
+    out.clear();
+    EXPECT_EQ_INT(xState::X_PARSE_INVALID_STRING_CHAR,
+        xFormat("{\"a\":\"\x01\"}", 9, &w));
+    EXPECT_EQ_INT(xState::X_PARSE_ROOT_NOT_SINGULAR, xFormat("1 2", 3, &w));
+}
+
+static void test_format_large() {
+    /* strings longer than the internal buffer are passed through */
+    std::string big(10000, 'x');
+    std::string json = "[\"" + big + "\",\"" + big + "\"]";
+    std::string out;
+    xWriter w = { test_write_string, &out };
+    EXPECT_EQ_INT(xState::X_PARSE_OK, xFormat(json.data(), json.size(), &w));
+    EXPECT_TRUE(out == json);
+
+    json.clear();
+    for (int i = 0; i < 2000; i++)
+        json += i == 0 ? "[ 1" : " , 1";
+    json += " ]";
+    out.clear();
+    EXPECT_EQ_INT(xState::X_PARSE_OK, xFormat(json.data(), json.size(), &w));
+    EXPECT_EQ_SIZE_T(2 * 2000 + 1, out.size());
+}
+
+int main() {
+    test_format_minify();
+    test_format_pretty();
+    test_format_error();
+    test_format_large();
+    TEST_SUMMARY();
+    return main_ret;
+}
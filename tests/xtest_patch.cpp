@@ -0,0 +1,248 @@
+/*copyright 2021 xkxsxkx*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "xjson.h"
+#include "xjson_patch.h"
+#include "xtest.h"
+
+using namespace xJson;
+
+#define TEST_PATCH(expect_state, expect, json, patch)\
+    do {\
+        xValue v, p;\
+        xHelper hv(&v), hp(&p);\
+        size_t length;\
+        EXPECT_EQ_INT(xState::X_PARSE_OK, xParse(&v, json));\
+        EXPECT_EQ_INT(xState::X_PARSE_OK, xParse(&p, patch));\
+        EXPECT_EQ_INT(expect_state, xApplyPatch(&v, &p, nullptr));\
+        char* out = xStringify(&v, &length);\
+        EXPECT_EQ_STRING(expect, out, length);\
+        free(out);\
+    } while (0)
+
+#define TEST_MERGE_PATCH(expect, json, patch)\
+    do {\
+        xValue v, p;\
+        xHelper hv(&v), hp(&p);\
+        size_t length;\
+        EXPECT_EQ_INT(xState::X_PARSE_OK, xParse(&v, json));\
+        EXPECT_EQ_INT(xState::X_PARSE_OK, xParse(&p, patch));\
+        xApplyMergePatch(&v, &p);\
+        char* out = xStringify(&v, &length);\
+        EXPECT_EQ_STRING(expect, out, length);\
+        free(out);\
+    } while (0)
+
+#define TEST_DIFF(expect, from, to, options)\
+    do {\
+        xValue a, b, p;\
+        xHelper ha(&a), hb(&b), hp(&p);\
+        size_t length;\
+        EXPECT_EQ_INT(xState::X_PARSE_OK, xParse(&a, from));\
+        EXPECT_EQ_INT(xState::X_PARSE_OK, xParse(&b, to));\
+        xDiff(&p, &a, &b, options);\
+        char* out = xStringify(&p, &length);\
+        EXPECT_EQ_STRING(expect, out, length);\
+        free(out);\
+        EXPECT_EQ_INT(xPatchState::X_PATCH_OK, xApplyPatch(&a, &p, nullptr));\
+        EXPECT_TRUE(xEqual(&a, &b));\
+    } while (0)
+
+static void test_pointer() {
+    xValue v;
+    xHelper h(&v);
+    EXPECT_EQ_INT(xState::X_PARSE_OK,
+        xParse(&v, "{\"a\":[1,{\"b/c\":2,\"d~e\":3}],\"\":4}"));
+    EXPECT_TRUE(xResolvePointer(&v, "", 0) == &v);
+    EXPECT_EQ_DOUBLE(1.0, xHelper::xGetNumber(xResolvePointer(&v, "/a/0", 4)));
+    EXPECT_EQ_DOUBLE(2.0, xHelper::xGetNumber(xResolvePointer(&v, "/a/1/b~1c", 9)));
+    EXPECT_EQ_DOUBLE(3.0, xHelper::xGetNumber(xResolvePointer(&v, "/a/1/d~0e", 9)));
+    EXPECT_EQ_DOUBLE(4.0, xHelper::xGetNumber(xResolvePointer(&v, "/", 1)));
+    EXPECT_TRUE(xResolvePointer(&v, "a", 1) == nullptr);
+    EXPECT_TRUE(xResolvePointer(&v, "/a/2", 4) == nullptr);
+    EXPECT_TRUE(xResolvePointer(&v, "/a/01", 5) == nullptr);
+    EXPECT_TRUE(xResolvePointer(&v, "/a/-", 4) == nullptr);
+    EXPECT_TRUE(xResolvePointer(&v, "/a/1/b~2c", 9) == nullptr);
+}
+
+static void test_patch_operations() {
+    TEST_PATCH(xPatchState::X_PATCH_OK, "{\"a\":1,\"b\":[0,1,2]}",
+        "{\"a\":1}", "[{\"op\":\"add\",\"path\":\"/b\",\"value\":[0,2]},"
+        "{\"op\":\"add\",\"path\":\"/b/1\",\"value\":1}]");
+    TEST_PATCH(xPatchState::X_PATCH_OK, "[1,2,3]",
+        "[1,2]", "[{\"op\":\"add\",\"path\":\"/-\",\"value\":3}]");
+    TEST_PATCH(xPatchState::X_PATCH_OK, "{\"a\":2}",
+        "{\"a\":1}", "[{\"op\":\"add\",\"path\":\"/a\",\"value\":2}]");
+    TEST_PATCH(xPatchState::X_PATCH_OK, "{\"b\":[2]}",
+        "{\"a\":1,\"b\":[1,2]}", "[{\"op\":\"remove\",\"path\":\"/a\"},"
+        "{\"op\":\"remove\",\"path\":\"/b/0\"}]");
+    TEST_PATCH(xPatchState::X_PATCH_OK, "[\"x\"]",
+        "{\"a\":1}", "[{\"op\":\"replace\",\"path\":\"\",\"value\":[\"x\"]}]");
+    TEST_PATCH(xPatchState::X_PATCH_OK, "{\"b\":{\"c\":[1,2]}}",
+        "{\"a\":[1,2],\"b\":{}}",
+        "[{\"op\":\"move\",\"from\":\"/a\",\"path\":\"/b/c\"}]");
+    /* the replaced target of a move is released */
+    TEST_PATCH(xPatchState::X_PATCH_OK, "{\"b\":1}",
+        "{\"a\":1,\"b\":[1,2]}",
+        "[{\"op\":\"move\",\"from\":\"/a\",\"path\":\"/b\"}]");
+    TEST_PATCH(xPatchState::X_PATCH_OK, "{\"c\":\"d\"}",
+        "{\"a\":{\"c\":\"d\"},\"b\":[1,2]}",
+        "[{\"op\":\"move\",\"from\":\"/a\",\"path\":\"\"}]");
+    TEST_PATCH(xPatchState::X_PATCH_OK, "[2,3,1]",
+        "[1,2,3]", "[{\"op\":\"move\",\"from\":\"/0\",\"path\":\"/-\"}]");
+    TEST_PATCH(xPatchState::X_PATCH_OK, "{\"a\":{\"x\":1},\"b\":{\"x\":1}}",
+        "{\"a\":{\"x\":1}}",
+        "[{\"op\":\"copy\",\"from\":\"/a\",\"path\":\"/b\"}]");
+    TEST_PATCH(xPatchState::X_PATCH_OK, "{\"a\":[1,{\"b\":null}]}",
+        "{\"a\":[1,{\"b\":null}]}",
+        "[{\"op\":\"test\",\"path\":\"/a\",\"value\":[1,{\"b\":null}]}]");
+}
+
+#define PATCH_DOC "{\"a\":1,\"b\":[1,2,3],\"c\":{\"d\":\"e\"}}"
+
+static void test_patch_rollback() {
+    TEST_PATCH(xPatchState::X_PATCH_TEST_FAILED, PATCH_DOC, PATCH_DOC,
+        "[{\"op\":\"remove\",\"path\":\"/a\"},"
+        "{\"op\":\"add\",\"path\":\"/b/0\",\"value\":0},"
+        "{\"op\":\"replace\",\"path\":\"/c/d\",\"value\":\"f\"},"
+        "{\"op\":\"move\",\"from\":\"/b\",\"path\":\"/c/b\"},"
+        "{\"op\":\"add\",\"path\":\"/z\",\"value\":true},"
+        "{\"op\":\"replace\",\"path\":\"\",\"value\":null},"
+        "{\"op\":\"test\",\"path\":\"\",\"value\":false}]");
+    TEST_PATCH(xPatchState::X_PATCH_PATH_NOT_FOUND, PATCH_DOC, PATCH_DOC,
+        "[{\"op\":\"remove\",\"path\":\"/b/1\"},"
+        "{\"op\":\"move\",\"from\":\"/b\",\"path\":\"/x/y\"}]");
+    TEST_PATCH(xPatchState::X_PATCH_PATH_NOT_FOUND, PATCH_DOC, PATCH_DOC,
+        "[{\"op\":\"add\",\"path\":\"/b/4\",\"value\":1}]");
+    TEST_PATCH(xPatchState::X_PATCH_INVALID_OPERATION, PATCH_DOC, PATCH_DOC,
+        "[{\"op\":\"move\",\"from\":\"/c\",\"path\":\"/c/x\"}]");
+    TEST_PATCH(xPatchState::X_PATCH_INVALID_OPERATION, PATCH_DOC, PATCH_DOC,
+        "[{\"op\":\"remove\",\"path\":\"/a\"},{\"op\":\"nop\",\"path\":\"\"}]");
+    TEST_PATCH(xPatchState::X_PATCH_INVALID_POINTER, PATCH_DOC, PATCH_DOC,
+        "[{\"op\":\"remove\",\"path\":\"a\"}]");
+
+    /* untouched subtrees keep their address across a failed patch */
+    xValue v, p;
+    xHelper hv(&v), hp(&p);
+    size_t failed = 0;
+    EXPECT_EQ_INT(xState::X_PARSE_OK, xParse(&v, PATCH_DOC));
+    EXPECT_EQ_INT(xState::X_PARSE_OK, xParse(&p,
+        "[{\"op\":\"add\",\"path\":\"/b/-\",\"value\":4},"
+        "{\"op\":\"test\",\"path\":\"/a\",\"value\":2}]"));
+    xValue* c = xResolvePointer(&v, "/c", 2);
+    EXPECT_EQ_INT(xPatchState::X_PATCH_TEST_FAILED, xApplyPatch(&v, &p, &failed));
+    EXPECT_EQ_SIZE_T(1, failed);
+    EXPECT_TRUE(c == xResolvePointer(&v, "/c", 2));
+    EXPECT_EQ_SIZE_T(3, xHelper::xGetArraySize(xResolvePointer(&v, "/b", 2)));
+}
+
+static void test_patch_dense() {
+    xValue v, p;
+    xHelper hv(&v), hp(&p);
+    size_t failed = 99, length;
+    char* out;
+    /* a patch of numbers is stored densely */
+    EXPECT_EQ_INT(xState::X_PARSE_OK, xParse(&v, PATCH_DOC));
+    EXPECT_EQ_INT(xState::X_PARSE_OK, xParseWith<xDensePolicy>(&p, "[1,2]"));
+    EXPECT_EQ_INT(xPatchState::X_PATCH_INVALID_OPERATION,
+        xApplyPatch(&v, &p, &failed));
+    EXPECT_EQ_SIZE_T(0, failed);
+    /* and so is the array of a document it edits */
+    xHelper::xSetNull(&v);
+    xHelper::xSetNull(&p);
+    EXPECT_EQ_INT(xState::X_PARSE_OK, xParseWith<xDensePolicy>(&v,
+        "{\"b\":[1,2,3]}"));
+    EXPECT_EQ_INT(xState::X_PARSE_OK, xParseWith<xDensePolicy>(&p,
+        "[{\"op\":\"add\",\"path\":\"/b/1\",\"value\":[4,5]},"
+        "{\"op\":\"remove\",\"path\":\"/b/0\"}]"));
+    EXPECT_EQ_INT(xPatchState::X_PATCH_OK, xApplyPatch(&v, &p, nullptr));
+    out = xStringify(&v, &length);
+    EXPECT_EQ_STRING("{\"b\":[[4,5],2,3]}", out, length);
+    free(out);
+}
+
+static void test_merge_patch() {
+    TEST_MERGE_PATCH("{\"a\":\"z\",\"c\":{\"d\":\"e\"}}",
+        "{\"a\":\"b\",\"c\":{\"d\":\"e\",\"f\":\"g\"}}",
+        "{\"a\":\"z\",\"c\":{\"f\":null}}");
+    TEST_MERGE_PATCH("{\"a\":[1]}", "{\"a\":{\"b\":1}}", "{\"a\":[1]}");
+    TEST_MERGE_PATCH("{\"b\":{\"c\":1}}", "[1]", "{\"a\":null,\"b\":{\"c\":1}}");
+    TEST_MERGE_PATCH("\"x\"", "{\"a\":1}", "\"x\"");
+    TEST_MERGE_PATCH("{}", "{\"a\":1}", "{\"a\":null}");
+}
+
+static void test_diff() {
+    xDiffOptions keyed;
+    keyed.key = "id";
+    keyed.klen = 2;
+    TEST_DIFF("[]", "{\"a\":[1,{\"b\":2}]}", "{\"a\":[1,{\"b\":2}]}", nullptr);
+    TEST_DIFF("[{\"op\":\"replace\",\"path\":\"\",\"value\":[]}]", "{}", "[]", nullptr);
+    TEST_DIFF("[{\"op\":\"replace\",\"path\":\"/b\",\"value\":3}]",
+        "{\"a\":1,\"b\":2}", "{\"b\":3,\"a\":1}", nullptr);
+    TEST_DIFF("[{\"op\":\"remove\",\"path\":\"/a~1b\"},"
+        "{\"op\":\"add\",\"path\":\"/c~0\",\"value\":{\"d\":null}}]",
+        "{\"a/b\":1}", "{\"c~\":{\"d\":null}}", nullptr);
+    TEST_DIFF("[{\"op\":\"add\",\"path\":\"/2\",\"value\":9}]",
+        "[1,2,3,4]", "[1,2,9,3,4]", nullptr);
+    TEST_DIFF("[{\"op\":\"remove\",\"path\":\"/1\"},"
+        "{\"op\":\"add\",\"path\":\"/2\",\"value\":2}]",
+        "[1,2,3,4]", "[1,3,2,4]", nullptr);
+    TEST_DIFF("[{\"op\":\"replace\",\"path\":\"/1/v\",\"value\":5},"
+        "{\"op\":\"add\",\"path\":\"/2\",\"value\":6}]",
+        "[{\"v\":1},{\"v\":2}]", "[{\"v\":1},{\"v\":5},6]", nullptr);
+    TEST_DIFF("[{\"op\":\"remove\",\"path\":\"/0\"},"
+        "{\"op\":\"replace\",\"path\":\"/0/v\",\"value\":3}]",
+        "[{\"id\":1,\"v\":1},{\"id\":2,\"v\":2}]",
+        "[{\"id\":2,\"v\":3}]", &keyed);
+    TEST_DIFF("[{\"op\":\"remove\",\"path\":\"/0\"},"
+        "{\"op\":\"add\",\"path\":\"/0\",\"value\":{\"id\":3,\"v\":1}}]",
+        "[{\"id\":1,\"v\":1}]", "[{\"id\":3,\"v\":1}]", &keyed);
+
+    /* over the lcs limit the middle is diffed by position */
+    xDiffOptions positional;
+    positional.lcsLimit = 0;
+    TEST_DIFF("[{\"op\":\"replace\",\"path\":\"/1\",\"value\":3},"
+        "{\"op\":\"replace\",\"path\":\"/2\",\"value\":2}]",
+        "[1,2,3,4]", "[1,3,2,4]", &positional);
+
+    /* a shared cache is filled once and reused for the next diff */
+    xValue a, b, p;
+    xHelper ha(&a), hb(&b), hp(&p);
+    xHashCache cache;
+    xDiffOptions cached;
+    cached.cache = &cache;
+    EXPECT_EQ_INT(xState::X_PARSE_OK, xParse(&a, "{\"x\":[\"s\",[1]],\"y\":{}}"));
+    EXPECT_EQ_INT(xState::X_PARSE_OK, xParse(&b, "{\"x\":[\"s\",[1]],\"y\":[]}"));
+    xDiff(&p, &a, &b, &cached);
+    EXPECT_EQ_SIZE_T(1, xHelper::xGetArraySize(&p));
+    EXPECT_TRUE(cache.size() > 0);
+
+    /* dense inputs are read in place, both keep their layout */
+    const int64_t from[] = { 1, 2, 3, 4 };
+    const double to[] = { 1, 3, 2.5, 4 };
+    size_t length;
+    xHelper::xSetInt64Array(&a, from, 4);
+    xHelper::xSetDoubleArray(&b, to, 4);
+    xHelper::xSetNull(&p);
+    xDiff(&p, &a, &b, nullptr);
+    EXPECT_TRUE(xHelper::xGetInt64Array(&a) != nullptr);
+    EXPECT_TRUE(xHelper::xGetDoubleArray(&b) != nullptr);
+    char* out = xStringify(&p, &length);
+    EXPECT_EQ_STRING("[{\"op\":\"remove\",\"path\":\"/1\"},"
+        "{\"op\":\"add\",\"path\":\"/2\",\"value\":2.5}]", out, length);
+    free(out);
+    EXPECT_EQ_INT(xPatchState::X_PATCH_OK, xApplyPatch(&a, &p, nullptr));
+    EXPECT_TRUE(xEqual(&a, &b));
+}
+
+int main() {
+    test_pointer();
+    test_patch_operations();
+    test_patch_rollback();
+    test_patch_dense();
+    test_merge_patch();
+    test_diff();
+    TEST_SUMMARY();
+    return main_ret;
+}
@@ -0,0 +1,382 @@
+/*copyright 2021 xkxsxkx*/
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "xjson.h"
+#include "xtest.h"
+
+using namespace xJson;
+
+#define TEST_POLICY(policy, error, json)\
+    do {\
+        xValue v;\
+        xHelper h(&v);\
+        EXPECT_EQ_INT(error, xParseWith<policy>(&v, json));\
+    } while (0)
+
+#define TEST_POLICY_ROUNDTRIP(policy, expect, json)\
+    do {\
+        xValue v;\
+        xHelper h(&v);\
+        size_t length;\
+        EXPECT_EQ_INT(xState::X_PARSE_OK, xParseWith<policy>(&v, json));\
+        char* out = xStringify(&v, &length);\
+        EXPECT_EQ_STRING(expect, out, length);\
+        free(out);\
+    } while (0)
+
+static void test_policy_strict() {
+    TEST_POLICY(xStrictPolicy, xState::X_PARSE_OK, "[1,{\"a\":[]}]");
+    TEST_POLICY(xStrictPolicy, xState::X_PARSE_INVALID_VALUE, "/* c */ 1");
+    TEST_POLICY(xStrictPolicy, xState::X_PARSE_INVALID_VALUE, "[1,]");
+    TEST_POLICY(xStrictPolicy, xState::X_PARSE_MISS_KEY, "{\"a\":1,}");
+    TEST_POLICY(xStrictPolicy, xState::X_PARSE_INVALID_VALUE, "NaN");
+    TEST_POLICY(xStrictPolicy, xState::X_PARSE_INVALID_VALUE, "-Infinity");
+    /* without validation raw bytes are passed through */
+    TEST_POLICY(xStrictPolicy, xState::X_PARSE_OK, "\"\xC0\xAF\"");
+}
+
+static void test_policy_relaxed() {
+    TEST_POLICY_ROUNDTRIP(xRelaxedPolicy, "[1,2]",
+        "// leading comment\n[ 1, /* inner */ 2, ] // trailing");
+    TEST_POLICY_ROUNDTRIP(xRelaxedPolicy, "{\"a\":{\"b\":[]}}",
+        "{ \"a\" : { \"b\" : [ ], }, }");
+    TEST_POLICY_ROUNDTRIP(xRelaxedPolicy, "[NaN,Infinity,-Infinity,-1]",
+        "[NaN, Infinity, -Infinity, -1]");
+    TEST_POLICY(xRelaxedPolicy, xState::X_PARSE_INVALID_VALUE, "[1,,]");
+    TEST_POLICY(xRelaxedPolicy, xState::X_PARSE_INVALID_VALUE, "[,]");
+    TEST_POLICY(xRelaxedPolicy, xState::X_PARSE_MISS_KEY, "{,}");
+    TEST_POLICY(xRelaxedPolicy, xState::X_PARSE_ROOT_NOT_SINGULAR, "1 /* open");
+    TEST_POLICY(xRelaxedPolicy, xState::X_PARSE_ROOT_NOT_SINGULAR, "1 / 2");
+    TEST_POLICY(xRelaxedPolicy, xState::X_PARSE_INVALID_VALUE, "-NaN");
+    TEST_POLICY(xRelaxedPolicy, xState::X_PARSE_INVALID_VALUE, "Inf");
+
+    xValue v;
+    xHelper h(&v);
+    EXPECT_EQ_INT(xState::X_PARSE_OK, xParseWith<xRelaxedPolicy>(&v, "NaN"));
+    EXPECT_TRUE(isnan(xHelper::xGetNumber(&v)));
+}
+
+static void test_policy_safe() {
+    char deep[2048];
+    size_t i;
+    TEST_POLICY(xSafePolicy, xState::X_PARSE_OK, "\"\xC2\xA2\xE2\x82\xAC\xF0\x9D\x84\x9E\"");
+    TEST_POLICY(xSafePolicy, xState::X_PARSE_INVALID_UTF8, "\"\xC0\xAF\"");
+    TEST_POLICY(xSafePolicy, xState::X_PARSE_INVALID_UTF8, "\"\xE2\x82\"");
+    TEST_POLICY(xSafePolicy, xState::X_PARSE_INVALID_UTF8, "\"\xED\xA0\x80\"");
+    TEST_POLICY(xSafePolicy, xState::X_PARSE_INVALID_UTF8, "\"\xF4\x90\x80\x80\"");
+    TEST_POLICY(xSafePolicy, xState::X_PARSE_INVALID_UTF8, "[\"a\", {\"\xFF\":1}]");
+
+    for (i = 0; i < 512; i++)
+        deep[i] = '[';
+    for (; i < 1024; i++)
+        deep[i] = ']';
+    deep[i] = '\0';
+    TEST_POLICY(xSafePolicy, xState::X_PARSE_OK, deep);
+    memset(deep, '[', 513);
+    memset(deep + 513, ']', 513);
+    deep[1026] = '\0';
+    TEST_POLICY(xSafePolicy, xState::X_PARSE_DEPTH_EXCEEDED, deep);
+    TEST_POLICY(xStrictPolicy, xState::X_PARSE_OK, deep);
+}
+
+static void test_policy_insitu() {
+    char json[] = "{\"k\\u0065y\":[\"a\\nb\", \"plain\", 1], \"k2\":\"\\uD834\\uDD1E\"}";
+    xValue v;
+    xHelper h(&v);
+    EXPECT_EQ_INT(xState::X_PARSE_OK, xParseInsitu<xStrictPolicy>(&v, json));
+    EXPECT_EQ_SIZE_T(2, h.xGetObjectSize(&v));
+    const char* key = h.xGetObjectKey(&v, 0);
+    EXPECT_TRUE(key >= json && key < json + sizeof(json));
+    EXPECT_EQ_STRING("key", key, h.xGetObjectKeyLength(&v, 0));
+    EXPECT_EQ_INT('\0', key[3]);
+    xValue* a = h.xGetObjectValue(&v, 0);
+    EXPECT_EQ_STRING("a\nb", xHelper::xGetString(h.xGetArrayElement(a, 0)),
+        xHelper::xGetStringLength(h.xGetArrayElement(a, 0)));
+    EXPECT_TRUE(h.xGetArrayElement(a, 1)->flags & X_VALUE_FLAG_BORROWED);
+    EXPECT_EQ_STRING("\xF0\x9D\x84\x9E",
+        xHelper::xGetString(h.xGetObjectValue(&v, 1)),
+        xHelper::xGetStringLength(h.xGetObjectValue(&v, 1)));
+
+    /* copies own their memory and outlive the buffer */
+    xValue copy;
+    xHelper hc(&copy);
+    xHelper::xCopy(&copy, &v);
+    EXPECT_FALSE(h.xGetArrayElement(h.xGetObjectValue(&copy, 0), 1)->flags
+        & X_VALUE_FLAG_BORROWED);
+    xHelper::xSetNull(&v);
+    memset(json, 'x', sizeof(json) - 1);
+    EXPECT_EQ_STRING("plain",
+        xHelper::xGetString(h.xGetArrayElement(h.xGetObjectValue(&copy, 0), 1)),
+        xHelper::xGetStringLength(h.xGetArrayElement(h.xGetObjectValue(&copy, 0), 1)));
+    EXPECT_EQ_STRING("key", h.xGetObjectKey(&copy, 0),
+        h.xGetObjectKeyLength(&copy, 0));
+
+    char bad[] = "[\"abc\", tru]";
+    EXPECT_EQ_INT(xState::X_PARSE_INVALID_VALUE,
+        xParseInsitu<xRelaxedPolicy>(&v, bad));
+    EXPECT_EQ_INT(xType::X_TYPE_NULL, xHelper::xGetType(&v));
+}
+
+static void test_policy_lazy_numbers() {
+    /* numbers are written back exactly as they were read */
+    TEST_POLICY_ROUNDTRIP(xLazyPolicy,
+        "[18446744073709551617,0.1000000000000000000001,-0E+00,1e-400]",
+        "[ 18446744073709551617, 0.1000000000000000000001, -0E+00, 1e-400 ]");
+    TEST_POLICY(xLazyPolicy, xState::X_PARSE_NUMBER_TOO_BIG, "[1e309]");
+    TEST_POLICY(xLazyPolicy, xState::X_PARSE_NUMBER_TOO_BIG, "-1.8e308");
+    TEST_POLICY(xLazyPolicy, xState::X_PARSE_MISS_COMMA_OR_SQUARE_BRACKET,
+        "[01]");
+
+    xValue v;
+    xHelper h(&v);
+    size_t len;
+    int64_t i;
+    EXPECT_EQ_INT(xState::X_PARSE_OK, xParseWith<xLazyPolicy>(&v,
+        "[9223372036854775807,-9223372036854775808,123456789012345678,"
+        "-42,1.5e3,2.5,9223372036854775808,1e19,1234567890123456789,"
+        "-9223372036854775809,12345678901234567890]"));
+    EXPECT_TRUE(h.xGetArrayElement(&v, 0)->flags & X_VALUE_FLAG_RAW_NUMBER);
+    const char* text = xHelper::xGetNumberText(h.xGetArrayElement(&v, 0), &len);
+    EXPECT_EQ_STRING("9223372036854775807", text, len);
+    EXPECT_TRUE(xHelper::xGetInt64(h.xGetArrayElement(&v, 2), &i));
+    EXPECT_TRUE(i == 123456789012345678LL);
+    EXPECT_TRUE(xHelper::xGetInt64(h.xGetArrayElement(&v, 3), &i));
+    EXPECT_TRUE(i == -42);
+    EXPECT_TRUE(xHelper::xGetInt64(h.xGetArrayElement(&v, 4), &i));
+    EXPECT_TRUE(i == 1500);
+    EXPECT_EQ_DOUBLE(1500.0, xHelper::xGetNumber(h.xGetArrayElement(&v, 4)));
+    EXPECT_FALSE(xHelper::xGetInt64(h.xGetArrayElement(&v, 5), &i));
+    EXPECT_EQ_DOUBLE(2.5, xHelper::xGetNumber(h.xGetArrayElement(&v, 5)));
+    EXPECT_FALSE(xHelper::xGetInt64(h.xGetArrayElement(&v, 6), &i));
+    EXPECT_FALSE(xHelper::xGetInt64(h.xGetArrayElement(&v, 7), &i));
+    /* 19 digit integers are exact up to the bounds, one past them fails */
+    EXPECT_TRUE(xHelper::xGetInt64(h.xGetArrayElement(&v, 0), &i));
+    EXPECT_TRUE(i == INT64_MAX);
+    EXPECT_TRUE(xHelper::xGetInt64(h.xGetArrayElement(&v, 1), &i));
+    EXPECT_TRUE(i == INT64_MIN);
+    EXPECT_TRUE(xHelper::xGetInt64(h.xGetArrayElement(&v, 8), &i));
+    EXPECT_TRUE(i == 1234567890123456789LL);
+    EXPECT_FALSE(xHelper::xGetInt64(h.xGetArrayElement(&v, 9), &i));
+    EXPECT_FALSE(xHelper::xGetInt64(h.xGetArrayElement(&v, 10), &i));
+
+    /* raw and converted numbers compare and hash by value */
+    xValue eager;
+    xHelper he(&eager);
+    EXPECT_EQ_INT(xState::X_PARSE_OK, xParse(&eager, "[1500,2.50]"));
+    EXPECT_TRUE(xEqual(h.xGetArrayElement(&v, 4), h.xGetArrayElement(&eager, 0)));
+    EXPECT_TRUE(xEqual(h.xGetArrayElement(&v, 5), h.xGetArrayElement(&eager, 1)));
+    EXPECT_TRUE(xHash(h.xGetArrayElement(&v, 4))
+        == xHash(h.xGetArrayElement(&eager, 0)));
+    EXPECT_TRUE(xHelper::xGetNumberText(h.xGetArrayElement(&eager, 0), &len)
+        == nullptr);
+    EXPECT_TRUE(xHelper::xGetInt64(h.xGetArrayElement(&eager, 0), &i));
+    EXPECT_TRUE(i == 1500);
+
+    /* in place the text is borrowed, copies own a terminated copy */
+    char json[] = "{\"n\":123.450}";
+    xValue copy;
+    xHelper hc(&copy);
+    xHelper::xSetNull(&v);
+    EXPECT_EQ_INT(xState::X_PARSE_OK, xParseInsitu<xLazyPolicy>(&v, json));
+    EXPECT_TRUE(xHelper::xGetNumberText(h.xGetObjectValue(&v, 0), &len)
+        == json + 5);
+    EXPECT_EQ_DOUBLE(123.45, xHelper::xGetNumber(h.xGetObjectValue(&v, 0)));
+    xHelper::xCopy(&copy, &v);
+    xHelper::xSetNull(&v);
+    memset(json, 'x', sizeof(json) - 1);
+    char* out = xStringify(&copy, &len);
+    EXPECT_EQ_STRING("{\"n\":123.450}", out, len);
+    free(out);
+    xHelper::xSetNumber(h.xGetObjectValue(&copy, 0), 2);
+    out = xStringify(&copy, &len);
+    EXPECT_EQ_STRING("{\"n\":2}", out, len);
+    free(out);
+}
+
+static void test_policy_lazy_strings() {
+    /* escapes in values are written back as read, keys are decoded */
+    TEST_POLICY_ROUNDTRIP(xLazyPolicy,
+        "[\"a\\u0041\\/\",\"plain\",{\"key\":\"\\uD834\\uDD1E\"}]",
+        "[ \"a\\u0041\\/\", \"plain\", { \"k\\u0065y\" : \"\\uD834\\uDD1E\" } ]");
+    /* empty raw text */
+    TEST_POLICY_ROUNDTRIP(xLazyPolicy, "\"\"", "\"\"");
+    TEST_POLICY_ROUNDTRIP(xLazyPolicy, "[\"\"]", "[\"\"]");
+    TEST_POLICY_ROUNDTRIP(xLazyPolicy, "{\"a\":\"\"}", "{\"a\":\"\"}");
+    TEST_POLICY(xLazyPolicy, xState::X_PARSE_INVALID_STRING_ESCAPE, "\"\\x\"");
+    TEST_POLICY(xLazyPolicy, xState::X_PARSE_INVALID_UNICODE_SURROGATE,
+        "\"\\uD800\"");
+    TEST_POLICY(xLazyPolicy, xState::X_PARSE_MISS_QUOTATION_MARK, "\"abc");
+
+    xValue v;
+    xHelper h(&v);
+    EXPECT_EQ_INT(xState::X_PARSE_OK, xParseWith<xLazyPolicy>(&v,
+        "[\"a\\nb\\u00e9\",\"plain\",\"\\uD834\\uDD1E\"]"));
+    xValue* e = h.xGetArrayElement(&v, 0);
+    EXPECT_TRUE(e->flags & X_VALUE_FLAG_ESCAPED);
+    EXPECT_FALSE(h.xGetArrayElement(&v, 1)->flags & X_VALUE_FLAG_ESCAPED);
+    EXPECT_TRUE(h.xGetArrayElement(&v, 1)->flags & X_VALUE_FLAG_RAW_STRING);
+    /* the first read decodes, later reads and stringify see the result */
+    EXPECT_EQ_STRING("a\nb\xC3\xA9", xHelper::xGetString(e),
+        xHelper::xGetStringLength(e));
+    EXPECT_FALSE(e->flags & (X_VALUE_FLAG_ESCAPED | X_VALUE_FLAG_RAW_STRING));
+    EXPECT_EQ_STRING("a\nb\xC3\xA9", xHelper::xGetString(e),
+        xHelper::xGetStringLength(e));
+    size_t len;
+    char* out = xStringify(&v, &len);
+    EXPECT_EQ_STRING("[\"a\\nb\xC3\xA9\",\"plain\",\"\\uD834\\uDD1E\"]",
+        out, len);
+    free(out);
+
+    /* comparisons decode both sides */
+    xValue eager;
+    xHelper he(&eager);
+    EXPECT_EQ_INT(xState::X_PARSE_OK, xParse(&eager, "\"\xF0\x9D\x84\x9E\""));
+    EXPECT_TRUE(xHash(&eager) == xHash(h.xGetArrayElement(&v, 2)));
+    EXPECT_TRUE(xEqual(&eager, h.xGetArrayElement(&v, 2)));
+
+    /* in place the text is decoded inside the caller's buffer */
+    char json[] = "{\"s\":\"x\\ty\"}";
+    xHelper::xSetNull(&v);
+    EXPECT_EQ_INT(xState::X_PARSE_OK, xParseInsitu<xLazyPolicy>(&v, json));
+    e = h.xGetObjectValue(&v, 0);
+    EXPECT_TRUE(e->flags & X_VALUE_FLAG_BORROWED);
+    EXPECT_TRUE(xHelper::xGetString(e) == json + 6);
+    EXPECT_EQ_STRING("x\ty", xHelper::xGetString(e), xHelper::xGetStringLength(e));
+    EXPECT_EQ_INT('\0', json[9]);
+}
+
+static void test_policy_dense_arrays() {
+    TEST_POLICY_ROUNDTRIP(xDensePolicy, "[1,-2,3,-123456789012345678]",
+        "[ 1, -2, 3, -123456789012345678 ]");
+    TEST_POLICY_ROUNDTRIP(xDensePolicy, "[1,2.5,-0,1000]", "[1,2.5,-0,1e3]");
+    TEST_POLICY_ROUNDTRIP(xDensePolicy, "[[1,2],[],{\"a\":[3]},[4,\"x\",5]]",
+        "[[1,2],[],{\"a\":[3]},[4,\"x\",5]]");
+    TEST_POLICY(xDensePolicy, xState::X_PARSE_NUMBER_TOO_BIG, "[1,2,1e309]");
+    TEST_POLICY(xDensePolicy, xState::X_PARSE_MISS_COMMA_OR_SQUARE_BRACKET,
+        "[1 2]");
+    TEST_POLICY(xDensePolicy, xState::X_PARSE_INVALID_VALUE, "[1,-]");
+    TEST_POLICY(xDensePolicy, xState::X_PARSE_INVALID_VALUE, "[1,2,tru]");
+
+    xValue v, g;
+    xHelper h(&v);
+    xHelper hg(&g);
+    EXPECT_EQ_INT(xState::X_PARSE_OK, xParseWith<xDensePolicy>(&v,
+        "[ 1 , 2, 123456789012345678 ]"));
+    const int64_t* ints = xHelper::xGetInt64Array(&v);
+    EXPECT_TRUE(ints != nullptr && xHelper::xGetDoubleArray(&v) == nullptr);
+    EXPECT_EQ_SIZE_T(3, xHelper::xGetArraySize(&v));
+    EXPECT_TRUE(ints[2] == 123456789012345678LL);
+
+    /* equal and hashed alike whatever the layout, integers exactly */
+    EXPECT_EQ_INT(xState::X_PARSE_OK, xParseWith<xLazyPolicy>(&g,
+        "[1,2,123456789012345678]"));
+    EXPECT_TRUE(xEqual(&v, &g) && xHash(&v) == xHash(&g));
+    xHelper::xSetNull(&g);
+    EXPECT_EQ_INT(xState::X_PARSE_OK, xParse(&g,
+        "[1,2,123456789012345678]"));
+    EXPECT_FALSE(xEqual(&v, &g));
+
+    /* one fraction turns the integers into doubles */
+    xHelper::xSetNull(&v);
+    EXPECT_EQ_INT(xState::X_PARSE_OK, xParseWith<xDensePolicy>(&v,
+        "[3,4,0.5]"));
+    const double* d = xHelper::xGetDoubleArray(&v);
+    EXPECT_TRUE(d != nullptr && xHelper::xGetInt64Array(&v) == nullptr);
+    EXPECT_EQ_DOUBLE(3.0, d[0]);
+    EXPECT_EQ_DOUBLE(0.5, d[2]);
+
+    /* copies stay dense */
+    xHelper::xCopy(&g, &v);
+    EXPECT_TRUE(xHelper::xGetDoubleArray(&g) != nullptr);
+    EXPECT_TRUE(xHelper::xGetDoubleArray(&g) != d);
+    EXPECT_TRUE(xEqual(&v, &g));
+
+    /* a mixed array falls back after the numbers */
+    xHelper::xSetNull(&v);
+    EXPECT_EQ_INT(xState::X_PARSE_OK, xParseWith<xDensePolicy>(&v,
+        "[7,8.5,null]"));
+    EXPECT_TRUE(xHelper::xGetDoubleArray(&v) == nullptr);
+    EXPECT_EQ_DOUBLE(7.0, xHelper::xGetNumber(h.xGetArrayElement(&v, 0)));
+    EXPECT_EQ_DOUBLE(8.5, xHelper::xGetNumber(h.xGetArrayElement(&v, 1)));
+    EXPECT_EQ_INT(xType::X_TYPE_NULL, h.xGetArrayElement(&v, 2)->type);
+
+    /* writing to an element expands the array */
+    int64_t src[] = { 5, -6 };
+    xHelper::xSetInt64Array(&v, src, 2);
+    xHelper::xSetNumber(xHelper::xInsertArrayElement(&v, 1), 0.25);
+    EXPECT_TRUE(xHelper::xGetInt64Array(&v) == nullptr);
+    size_t length;
+    char* out = xStringify(&v, &length);
+    EXPECT_EQ_STRING("[5,0.25,-6]", out, length);
+    free(out);
+    xHelper::xSetDoubleArray(&v, nullptr, 0);
+    out = xStringify(&v, &length);
+    EXPECT_EQ_STRING("[]", out, length);
+    free(out);
+}
+
+static void test_policy_sorted_keys() {
+    TEST_POLICY_ROUNDTRIP(xSortedPolicy,
+        "{\"\":0,\"a\":2,\"a\":3,\"ab\":[{\"x\":1,\"y\":2}],\"b\":1}",
+        "{\"b\":1,\"a\":2,\"ab\":[{\"y\":2,\"x\":1}],\"a\":3,\"\":0}");
+
+    xValue v;
+    xHelper h(&v);
+    EXPECT_EQ_INT(xState::X_PARSE_OK, xParseWith<xSortedPolicy>(&v,
+        "{\"m\":1,\"c\":2,\"x\":3,\"a\":4,\"c\":5}"));
+    EXPECT_TRUE(v.flags & X_VALUE_FLAG_SORTED_KEYS);
+    EXPECT_EQ_SIZE_T(1, xHelper::xFindObjectIndex(&v, "c", 1));
+    EXPECT_EQ_DOUBLE(2.0, xHelper::xGetNumber(h.xGetObjectValue(&v, 1)));
+    EXPECT_EQ_SIZE_T(0, xHelper::xFindObjectIndex(&v, "a", 1));
+    EXPECT_EQ_SIZE_T(4, xHelper::xFindObjectIndex(&v, "x", 1));
+    EXPECT_TRUE(xHelper::xFindObjectIndex(&v, "b", 1) == X_KEY_NOT_EXIST);
+    EXPECT_TRUE(xHelper::xFindObjectIndex(&v, "z", 1) == X_KEY_NOT_EXIST);
+
+    /* appending keeps the order only while keys grow */
+    xHelper::xSetObjectValue(&v, "y", 1);
+    EXPECT_TRUE(v.flags & X_VALUE_FLAG_SORTED_KEYS);
+    xHelper::xSetObjectValue(&v, "b", 1);
+    EXPECT_FALSE(v.flags & X_VALUE_FLAG_SORTED_KEYS);
+    EXPECT_EQ_SIZE_T(6, xHelper::xFindObjectIndex(&v, "b", 1));
+    xHelper::xSortObjectKeys(&v);
+    EXPECT_TRUE(v.flags & X_VALUE_FLAG_SORTED_KEYS);
+    EXPECT_EQ_SIZE_T(1, xHelper::xFindObjectIndex(&v, "b", 1));
+    EXPECT_EQ_SIZE_T(2, xHelper::xFindObjectIndex(&v, "c", 1));
+
+    /* canonical text does not depend on the order or storage read */
+    xValue g, l;
+    xHelper hg(&g);
+    xHelper hl(&l);
+    const char* json = "{\"n\":[1.50,123456789012345678],"
+        "\"s\":\"\\u0041\\n\",\"e\":{\"b\":true,\"a\":null}}";
+    size_t glen, llen, dlen;
+    EXPECT_EQ_INT(xState::X_PARSE_OK, xParse(&g, json));
+    EXPECT_EQ_INT(xState::X_PARSE_OK, xParseWith<xLazyPolicy>(&l, json));
+    xHelper::xSetNull(&v);
+    EXPECT_EQ_INT(xState::X_PARSE_OK, xParseWith<xDensePolicy>(&v, json));
+    char* gs = xStringifyCanonical(&g, &glen);
+    char* ls = xStringifyCanonical(&l, &llen);
+    char* ds = xStringifyCanonical(&v, &dlen);
+    EXPECT_EQ_STRING("{\"e\":{\"a\":null,\"b\":true},"
+        "\"n\":[1.5,1.2345678901234568e+17],\"s\":\"A\\n\"}", gs, glen);
+    EXPECT_TRUE(llen == glen && memcmp(gs, ls, glen) == 0);
+    EXPECT_TRUE(dlen == glen && memcmp(gs, ds, glen) == 0);
+    free(gs);
+    free(ls);
+    free(ds);
+}
+
+int main() {
+    test_policy_strict();
+    test_policy_relaxed();
+    test_policy_safe();
+    test_policy_lazy_numbers();
+    test_policy_lazy_strings();
+    test_policy_dense_arrays();
+    test_policy_sorted_keys();
+    test_policy_insitu();
+    TEST_SUMMARY();
+    return main_ret;
+}
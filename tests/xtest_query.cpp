@@ -0,0 +1,174 @@
+/*copyright 2021 xkxsxkx*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include "xjson.h"
+#include "xjson_query.h"
+#include "xtest.h"
+
+using namespace xJson;
+
+static void test_write_string(void* ctx, const char* data, size_t len) {
+    ((std::string*)ctx)->append(data, len);
+}
+
+#define ITEMS "{\"items\":[{\"id\":1,\"price\":5,\"tags\":[\"a\"]},"\
+    "{\"id\":2,\"price\":12.5,\"name\":\"b\\u0041\"},"\
+    "{\"id\":3,\"price\":\"11\"},{\"id\":4,\"price\":40,\"tags\":[]}]}"
+
+#define TEST_QUERY(expect, expr, json)\
+    do {\
+        xQuery q;\
+        std::string out;\
+        xWriter w = { test_write_string, &out };\
+        EXPECT_EQ_INT(xQueryState::X_QUERY_OK, q.compile(expr));\
+        EXPECT_EQ_INT(xState::X_PARSE_OK, q.run(json, sizeof(json) - 1, &w));\
+        EXPECT_EQ_STRING(expect, out.data(), out.size());\
+    } while (0)
+
+#define TEST_QUERY_COMPILE(expect, expr)\
+    do {\
+        xQuery q;\
+        EXPECT_EQ_INT(expect, q.compile(expr));\
+        EXPECT_TRUE(q.plan().empty());\
+    } while (0)
+
+static void test_query_path() {
+    TEST_QUERY("{\"a\":1}\n", ".", " { \"a\" : 1 } ");
+    TEST_QUERY("[1,2]\n", ".a.b", "{\"x\":{},\"a\":{\"b\":[1, 2]}}");
+    TEST_QUERY("2\n", ".a[1]", "{\"a\":[1,2,3]}");
+    TEST_QUERY("3\n", ".[\"a b\"]", "{\"a b\":3}");
+    TEST_QUERY("3\n", ".\"a b\"", "{\"a b\":3}");
+    TEST_QUERY("1\n2\n3\n", ".[]", "[1,2,3]");
+    TEST_QUERY("1\n2\n", ".[]", "{\"x\":1,\"y\":2}");
+    TEST_QUERY("1\n2\n3\n4\n", ".items[].id", ITEMS);
+    TEST_QUERY("\"a\"\n", ".items[].tags[]", ITEMS);
+    TEST_QUERY("1\n2\n3\n4\n", ".items | .[] | .id", ITEMS);
+    /* escaped keys match their decoded name, the first member wins */
+    TEST_QUERY("1\n", ".ab", "{\"a\\u0062\":1,\"ab\":2}");
+    /* steps that do not apply read as null, [] of a scalar is empty */
+    TEST_QUERY("null\nnull\nnull\n", ".a.b", "{} {\"a\":1} {\"a\":[{\"b\":2}]}");
+    TEST_QUERY("null\n", ".[5]", "[1]");
+    TEST_QUERY("", ".[]", "1 \"s\" null [] {}");
+    TEST_QUERY("", ".a", "");
+}
+
+static void test_query_select() {
+    /* jq orders strings after numbers, < "" keeps only the numbers */
+    TEST_QUERY("{\"id\":2,\"price\":12.5}\n{\"id\":4,\"price\":40}\n",
+        ".items[] | select(.price > 10 and .price < \"\") | {id, price}", ITEMS);
+    TEST_QUERY("2\n3\n4\n", ".items[] | select(.price >= 10) | .id", ITEMS);
+    TEST_QUERY("1\n", ".items[] | select(10 > .price) | .id", ITEMS);
+    TEST_QUERY("3\n", ".items[] | select(.price == \"11\") | .id", ITEMS);
+    TEST_QUERY("2\n", ".items[] | select(.name == \"bA\") | .id", ITEMS);
+    TEST_QUERY("1\n2\n4\n", ".items[] | select(.price != \"11\") | .id", ITEMS);
+    TEST_QUERY("1\n4\n", ".items[] | select(.tags) | .id", ITEMS);
+    TEST_QUERY("2\n3\n", ".items[] | select(.tags == null) | .id", ITEMS);
+    TEST_QUERY("1\n3\n4\n", ".items[] | select(.id == 1 or (.id > 2 and .price >= 20)) | .id",
+        ITEMS);
+    TEST_QUERY("1\n", ".items[] | select(.tags[0] == \"a\") | .id", ITEMS);
+    /* like jq, only null and false are falsy */
+    TEST_QUERY("{\"b\":true}\n{\"b\":0}\n", "select(.a <= false) | select(.b) | {b}",
+        "{\"a\":true} {\"a\":false,\"b\":true} {\"b\":0}");
+}
+
+static void test_query_object() {
+    TEST_QUERY("{\"id\":1,\"n\":\"x\",\"t\":[1,2],\"m\":null}\n",
+        "{id, n: .o.name, \"t\": .o.t, m: .missing}",
+        "{\"o\" : {\"t\" : [ 1 , 2 ], \"name\":\"x\"}, \"id\": 1}");
+    TEST_QUERY("{\"a\\\"b\":1}\n", "{\"a\\\"b\"}", "{\"a\\\"b\":1}");
+    TEST_QUERY("{}\n", "{}", "[1]");
+    /* an object stage feeding the next one */
+    TEST_QUERY("{\"v\":2}\n", "{x: .a} | select(.x > 1) | {v: .x}",
+        "{\"a\":1}\n{\"a\":2}\n");
+    TEST_QUERY("5\n", "{x: .a} | .x", "{\"a\":5}");
+}
+
+static void test_query_ndjson() {
+    std::string data, out, expect;
+    for (int i = 0; i < 2000; i++) {
+        data += "{\"id\":" + std::to_string(i) + ",\"big\":[[{\"x\":\"skipped\"}]],\"v\":"
+            + std::to_string(i % 7) + "}\n";
+        if (i % 7 == 3)
+            expect += "{\"id\":" + std::to_string(i) + "}\n";
+    }
+    xQuery q;
+    size_t count = 0;
+    xWriter w = { test_write_string, &out };
+    EXPECT_EQ_INT(xQueryState::X_QUERY_OK, q.compile("select(.v == 3) | {id}"));
+    EXPECT_EQ_INT(xState::X_PARSE_OK, q.run(data.data(), data.size(), &w, &count));
+    EXPECT_EQ_SIZE_T(286, count);
+    EXPECT_TRUE(out == expect);
+}
+
+static void test_query_error() {
+    xQuery q;
+    std::string out;
+    size_t count = 0, offset = 0;
+    xWriter w = { test_write_string, &out };
+    const char json[] = "[1,2,x]";
+    EXPECT_EQ_INT(xQueryState::X_QUERY_OK, q.compile(".[]"));
+    EXPECT_EQ_INT(xState::X_PARSE_INVALID_VALUE,
+        q.run(json, sizeof(json) - 1, &w, &count, &offset));
+    /* results before the error are written */
+    EXPECT_EQ_STRING("1\n2\n", out.data(), out.size());
+    EXPECT_EQ_SIZE_T(2, count);
+    EXPECT_EQ_SIZE_T(5, offset);
+
+    /* members that are skipped are still checked */
+    out.clear();
+    const char skipped[] = "{\"a\":1,\"b\":[tru]}";
+    EXPECT_EQ_INT(xQueryState::X_QUERY_OK, q.compile(".a"));
+    EXPECT_EQ_INT(xState::X_PARSE_INVALID_VALUE,
+        q.run(skipped, sizeof(skipped) - 1, &w, nullptr, &offset));
+    EXPECT_EQ_SIZE_T(12, offset);
+    const char unclosed[] = "{\"a\":1";
+    EXPECT_EQ_INT(xState::X_PARSE_MISS_COMMA_OR_CURLY_BRACKET,
+        q.run(unclosed, sizeof(unclosed) - 1, &w));
+    EXPECT_EQ_INT(xQueryState::X_QUERY_OK, q.compile("select(.a)"));
+    EXPECT_EQ_INT(xState::X_PARSE_MISS_COMMA_OR_CURLY_BRACKET,
+        q.run(unclosed, sizeof(unclosed) - 1, &w));
+}
+
+static void test_query_compile() {
+    size_t offset = 0;
+    xQuery q;
+    EXPECT_EQ_INT(xQueryState::X_QUERY_INVALID, q.compile(".a | | .b", &offset));
+    EXPECT_EQ_SIZE_T(5, offset);
+    TEST_QUERY_COMPILE(xQueryState::X_QUERY_INVALID, "");
+    TEST_QUERY_COMPILE(xQueryState::X_QUERY_INVALID, ".a.");
+    TEST_QUERY_COMPILE(xQueryState::X_QUERY_INVALID, ".a[1");
+    TEST_QUERY_COMPILE(xQueryState::X_QUERY_INVALID, "select(.a > )");
+    TEST_QUERY_COMPILE(xQueryState::X_QUERY_INVALID, "select(.a > 1");
+    TEST_QUERY_COMPILE(xQueryState::X_QUERY_INVALID, "{a b}");
+    TEST_QUERY_COMPILE(xQueryState::X_QUERY_INVALID, ".\"a");
+    TEST_QUERY_COMPILE(xQueryState::X_QUERY_UNSUPPORTED, "..");
+    TEST_QUERY_COMPILE(xQueryState::X_QUERY_UNSUPPORTED, ".a[-1]");
+    TEST_QUERY_COMPILE(xQueryState::X_QUERY_UNSUPPORTED, ".a[1:2]");
+    TEST_QUERY_COMPILE(xQueryState::X_QUERY_UNSUPPORTED, ".a, .b");
+    TEST_QUERY_COMPILE(xQueryState::X_QUERY_UNSUPPORTED, "map(.a)");
+    TEST_QUERY_COMPILE(xQueryState::X_QUERY_UNSUPPORTED, "[.a]");
+    TEST_QUERY_COMPILE(xQueryState::X_QUERY_UNSUPPORTED, "select(.a[] > 1)");
+    TEST_QUERY_COMPILE(xQueryState::X_QUERY_UNSUPPORTED, "select(.a == .b)");
+    TEST_QUERY_COMPILE(xQueryState::X_QUERY_UNSUPPORTED, "select(length > 1)");
+    TEST_QUERY_COMPILE(xQueryState::X_QUERY_UNSUPPORTED, "select(true)");
+    TEST_QUERY_COMPILE(xQueryState::X_QUERY_UNSUPPORTED, "{a: 1}");
+
+    /* consecutive paths are merged into one stage */
+    EXPECT_EQ_INT(xQueryState::X_QUERY_OK,
+        q.compile(".items | .[] | select(.a) | {a}"));
+    EXPECT_EQ_SIZE_T(3, q.plan().size());
+    EXPECT_EQ_SIZE_T(2, q.plan()[0].path.size());
+}
+
+int main() {
+    test_query_path();
+    test_query_select();
+    test_query_object();
+    test_query_ndjson();
+    test_query_error();
+    test_query_compile();
+    TEST_SUMMARY();
+    return main_ret;
+}
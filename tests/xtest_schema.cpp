@@ -0,0 +1,266 @@
+/*copyright 2021 xkxsxkx*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "xjson.h"
+#include "xjson_schema.h"
+#include "xtest.h"
+
+using namespace xJson;
+
+#define TEST_COMPILE(state, json)\
+    do {\
+        xValue s;\
+        xSchema schema;\
+        xHelper h(&s);\
+        EXPECT_EQ_INT(xState::X_PARSE_OK, xParse(&s, json));\
+        EXPECT_EQ_INT(state, schema.compile(&s));\
+    } while (0)
+
+/* json is parsed against schema, a mismatch must leave v null */
+#define TEST_SCHEMA(expect, schemaJson, json)\
+    do {\
+        xValue s, v;\
+        xSchema schema;\
+        xHelper hs(&s), hv(&v);\
+        EXPECT_EQ_INT(xState::X_PARSE_OK, xParse(&s, schemaJson));\
+        EXPECT_EQ_INT(xSchemaState::X_SCHEMA_OK, schema.compile(&s));\
+        EXPECT_EQ_INT(expect, xParseWithSchema(&v, json, schema));\
+        if (expect != xState::X_PARSE_OK)\
+            EXPECT_EQ_INT(xType::X_TYPE_NULL, v.type);\
+    } while (0)
+
+#define TEST_SCHEMA_OK(schemaJson, json)\
+    TEST_SCHEMA(xState::X_PARSE_OK, schemaJson, json)
+#define TEST_SCHEMA_FAIL(schemaJson, json)\
+    TEST_SCHEMA(xState::X_PARSE_SCHEMA_MISMATCH, schemaJson, json)
+
+#define TEST_SCHEMA_ERROR(expectPath, expectKeyword, expectOffset, schemaJson, json)\
+    do {\
+        xValue s, v;\
+        xSchema schema;\
+        xSchemaError error;\
+        xHelper hs(&s), hv(&v);\
+        EXPECT_EQ_INT(xState::X_PARSE_OK, xParse(&s, schemaJson));\
+        EXPECT_EQ_INT(xSchemaState::X_SCHEMA_OK, schema.compile(&s));\
+        EXPECT_EQ_INT(xState::X_PARSE_SCHEMA_MISMATCH,\
+            xParseWithSchema(&v, json, schema, &error));\
+        EXPECT_EQ_STRING(expectPath, error.path.c_str(), error.path.size());\
+        EXPECT_EQ_STRING(expectKeyword, error.keyword, strlen(error.keyword));\
+        EXPECT_EQ_SIZE_T((size_t)expectOffset, error.offset);\
+    } while (0)
+
+static void test_schema_compile() {
+    TEST_COMPILE(xSchemaState::X_SCHEMA_OK, "true");
+    TEST_COMPILE(xSchemaState::X_SCHEMA_OK, "false");
+    TEST_COMPILE(xSchemaState::X_SCHEMA_OK, "{}");
+    TEST_COMPILE(xSchemaState::X_SCHEMA_OK,
+        "{\"$schema\":\"x\",\"title\":\"t\",\"type\":[\"string\",\"null\"]}");
+    TEST_COMPILE(xSchemaState::X_SCHEMA_OK,
+        "{\"type\":\"object\",\"properties\":{\"a\":{\"type\":\"integer\"}},"
+        "\"required\":[\"a\",\"b\"],\"additionalProperties\":false}");
+    TEST_COMPILE(xSchemaState::X_SCHEMA_INVALID, "1");
+    TEST_COMPILE(xSchemaState::X_SCHEMA_INVALID, "{\"type\":\"float\"}");
+    TEST_COMPILE(xSchemaState::X_SCHEMA_INVALID, "{\"minimum\":\"0\"}");
+    TEST_COMPILE(xSchemaState::X_SCHEMA_INVALID, "{\"maxLength\":-1}");
+    TEST_COMPILE(xSchemaState::X_SCHEMA_INVALID, "{\"required\":[1]}");
+    TEST_COMPILE(xSchemaState::X_SCHEMA_UNSUPPORTED, "{\"$ref\":\"#\"}");
+    TEST_COMPILE(xSchemaState::X_SCHEMA_UNSUPPORTED,
+        "{\"properties\":{\"a\":{\"anyOf\":[]}}}");
+    TEST_COMPILE(xSchemaState::X_SCHEMA_UNSUPPORTED, "{\"items\":[{}]}");
+
+    xValue s;
+    xSchema schema;
+    std::string error;
+    xHelper h(&s);
+    EXPECT_EQ_INT(xState::X_PARSE_OK,
+        xParse(&s, "{\"items\":{\"properties\":{\"a\":{\"pattern\":\"x\"}}}}"));
+    EXPECT_EQ_INT(xSchemaState::X_SCHEMA_UNSUPPORTED, schema.compile(&s, &error));
+    EXPECT_EQ_STRING("/items/properties/a/pattern", error.c_str(), error.size());
+    EXPECT_TRUE(schema.root() == nullptr);
+}
+
+static void test_schema_type() {
+    TEST_SCHEMA_OK("true", "[1,{\"a\":null}]");
+    TEST_SCHEMA_FAIL("false", "null");
+    TEST_SCHEMA_OK("{\"type\":\"null\"}", "null");
+    TEST_SCHEMA_FAIL("{\"type\":\"null\"}", "false");
+    TEST_SCHEMA_OK("{\"type\":\"boolean\"}", "true");
+    TEST_SCHEMA_OK("{\"type\":\"string\"}", "\"a\"");
+    TEST_SCHEMA_FAIL("{\"type\":\"string\"}", "1");
+    TEST_SCHEMA_OK("{\"type\":\"integer\"}", "-3");
+    TEST_SCHEMA_OK("{\"type\":\"integer\"}", "3.0");
+    TEST_SCHEMA_FAIL("{\"type\":\"integer\"}", "3.5");
+    TEST_SCHEMA_OK("{\"type\":\"number\"}", "3.5");
+    TEST_SCHEMA_OK("{\"type\":[\"array\",\"object\"]}", "{}");
+    TEST_SCHEMA_FAIL("{\"type\":[\"array\",\"object\"]}", "\"x\"");
+    /* the grammar is still checked first for anything that is not a value */
+    TEST_SCHEMA(xState::X_PARSE_INVALID_VALUE, "{\"type\":\"string\"}", "?");
+    TEST_SCHEMA(xState::X_PARSE_EXPECT_VALUE, "{\"type\":\"string\"}", "");
+    TEST_SCHEMA(xState::X_PARSE_ROOT_NOT_SINGULAR, "true", "1 2");
+}
+
+static void test_schema_early() {
+    /* the object is refused on its first byte, the broken tail is never read */
+    TEST_SCHEMA_ERROR("", "type", 0, "{\"type\":\"array\"}", "{\"a\":[1,2,");
+    TEST_SCHEMA_ERROR("/1", "type", 4, "{\"items\":{\"type\":\"number\"}}",
+        "[1, \"x\", ???");
+    TEST_SCHEMA_ERROR("/b", "additionalProperties", 11,
+        "{\"properties\":{\"a\":true},\"additionalProperties\":false}",
+        "{\"a\":1,\"b\":[[[");
+}
+
+static void test_schema_object() {
+    const char* person = "{\"type\":\"object\","
+        "\"properties\":{\"name\":{\"type\":\"string\"},\"age\":{\"type\":\"integer\"}},"
+        "\"required\":[\"name\",\"id\"]}";
+    TEST_SCHEMA_OK(person, "{\"name\":\"a\",\"id\":1}");
+    TEST_SCHEMA_OK(person, "{\"id\":null,\"age\":3,\"name\":\"a\",\"x\":[]}");
+    TEST_SCHEMA_FAIL(person, "{\"name\":\"a\"}");
+    TEST_SCHEMA_FAIL(person, "{\"name\":\"a\",\"name\":\"b\"}");
+    TEST_SCHEMA_FAIL(person, "{\"name\":\"a\",\"id\":1,\"age\":1.5}");
+    TEST_SCHEMA_FAIL(person, "{}");
+    TEST_SCHEMA_ERROR("/id", "required", 11, person, "{\"name\":\"a\"}");
+    TEST_SCHEMA_OK("{\"additionalProperties\":{\"type\":\"number\"}}",
+        "{\"a\":1,\"b\":2}");
+    TEST_SCHEMA_ERROR("/b", "type", 11,
+        "{\"additionalProperties\":{\"type\":\"number\"}}", "{\"a\":1,\"b\":\"2\"}");
+    TEST_SCHEMA_OK("{\"minProperties\":1,\"maxProperties\":2}", "{\"a\":1}");
+    TEST_SCHEMA_FAIL("{\"minProperties\":1,\"maxProperties\":2}", "{}");
+    TEST_SCHEMA_FAIL("{\"minProperties\":1,\"maxProperties\":2}",
+        "{\"a\":1,\"b\":2,\"c\":3}");
+    /* escaped and pointer-escaped keys */
+    TEST_SCHEMA_ERROR("/a~1b~0/0", "type", 10,
+        "{\"properties\":{\"a/b~\":{\"items\":{\"type\":\"null\"}}}}",
+        "{\"a\\/b~\":[0]}");
+}
+
+static void test_schema_required_many() {
+    /* more required keys than fit one word */
+    std::string schemaJson = "{\"required\":[";
+    std::string json = "{";
+    for (int i = 0; i < 70; i++) {
+        schemaJson += (i ? ",\"k" : "\"k") + std::to_string(i) + "\"";
+        if (i != 66)
+            json += (json.size() > 1 ? ",\"k" : "\"k") + std::to_string(i) + "\":0";
+    }
+    schemaJson += "]}";
+    json += "}";
+    xValue s, v;
+    xSchema schema;
+    xSchemaError error;
+    xHelper hs(&s), hv(&v);
+    EXPECT_EQ_INT(xState::X_PARSE_OK, xParse(&s, schemaJson.c_str()));
+    EXPECT_EQ_INT(xSchemaState::X_SCHEMA_OK, schema.compile(&s));
+    EXPECT_EQ_INT(xState::X_PARSE_SCHEMA_MISMATCH,
+        xParseWithSchema(&v, json.c_str(), schema, &error));
+    EXPECT_EQ_STRING("/k66", error.path.c_str(), error.path.size());
+    json.insert(1, "\"k66\":1,");
+    EXPECT_EQ_INT(xState::X_PARSE_OK, xParseWithSchema(&v, json.c_str(), schema));
+    EXPECT_EQ_SIZE_T((size_t)70, v.object.size);
+}
+
+static void test_schema_number() {
+    TEST_SCHEMA_OK("{\"minimum\":1,\"maximum\":3}", "1");
+    TEST_SCHEMA_OK("{\"minimum\":1,\"maximum\":3}", "3");
+    TEST_SCHEMA_FAIL("{\"minimum\":1,\"maximum\":3}", "0.5");
+    TEST_SCHEMA_FAIL("{\"minimum\":1,\"maximum\":3}", "3.5");
+    TEST_SCHEMA_FAIL("{\"exclusiveMinimum\":1}", "1");
+    TEST_SCHEMA_OK("{\"exclusiveMinimum\":1}", "1.5");
+    TEST_SCHEMA_FAIL("{\"exclusiveMaximum\":1}", "1");
+    /* numeric keywords do not constrain other types */
+    TEST_SCHEMA_OK("{\"minimum\":1}", "\"0\"");
+    TEST_SCHEMA_ERROR("/0/v", "maximum", 7, "{\"items\":{\"properties\":"
+        "{\"v\":{\"maximum\":10}}}}", "[{\"v\": 11}]");
+}
+
+static void test_schema_string() {
+    TEST_SCHEMA_OK("{\"minLength\":2,\"maxLength\":3}", "\"ab\"");
+    TEST_SCHEMA_FAIL("{\"minLength\":2,\"maxLength\":3}", "\"a\"");
+    TEST_SCHEMA_FAIL("{\"minLength\":2,\"maxLength\":3}", "\"abcd\"");
+    /* lengths are in code points, escapes are decoded first */
+    TEST_SCHEMA_OK("{\"maxLength\":2}", "\"\\u00e9\\uD834\\uDD1E\"");
+    TEST_SCHEMA_OK("{\"minLength\":2}", "\"\\u00e9\\u00e9\"");
+    TEST_SCHEMA_FAIL("{\"maxLength\":1}", "\"\\u00e9\\u00e9\"");
+}
+
+static void test_schema_array() {
+    const char* list = "{\"type\":\"array\",\"items\":{\"type\":\"integer\"},"
+        "\"minItems\":1,\"maxItems\":3}";
+    TEST_SCHEMA_OK(list, "[1]");
+    TEST_SCHEMA_OK(list, "[1,2,3]");
+    TEST_SCHEMA_FAIL(list, "[]");
+    TEST_SCHEMA_FAIL(list, "[1,2,3,4]");
+    TEST_SCHEMA_FAIL(list, "[1,[2]]");
+    TEST_SCHEMA_OK("{\"items\":false}", "[]");
+    TEST_SCHEMA_FAIL("{\"items\":false}", "[0]");
+    TEST_SCHEMA_ERROR("/a/1/b", "type", 20, "{\"properties\":{\"a\":{\"items\":"
+        "{\"properties\":{\"b\":{\"type\":\"string\"}}}}}}",
+        "{\"a\":[{\"b\":\"\"},{\"b\":0}]}");
+    TEST_SCHEMA_ERROR("", "maxItems", 8, list, "[1,2,3,4]");
+}
+
+static void test_schema_enum() {
+    const char* colors = "{\"enum\":[\"red\",\"green\",null,[1,{\"a\":2}]]}";
+    TEST_SCHEMA_OK(colors, "\"red\"");
+    TEST_SCHEMA_OK(colors, "null");
+    TEST_SCHEMA_OK(colors, "[1, {\"a\": 2.0}]");
+    TEST_SCHEMA_FAIL(colors, "\"blue\"");
+    TEST_SCHEMA_FAIL(colors, "[1,{\"a\":3}]");
+    TEST_SCHEMA_OK("{\"const\":{\"v\":1}}", "{\"v\":1}");
+    TEST_SCHEMA_ERROR("", "enum", 0, "{\"const\":{\"v\":1}}", "{\"v\":2}");
+}
+
+static void test_schema_content_encoding() {
+    const char* blob = "{\"properties\":{\"blob\":"
+        "{\"type\":\"string\",\"contentEncoding\":\"base64\"}}}";
+    xValue s, v;
+    xSchema schema;
+    xHelper hs(&s), hv(&v);
+    const xValue* b;
+    const uint8_t* bytes;
+    char* json;
+    size_t len;
+    TEST_COMPILE(xSchemaState::X_SCHEMA_INVALID, "{\"contentEncoding\":1}");
+    /* other encodings are annotations */
+    TEST_SCHEMA_OK("{\"contentEncoding\":\"base32\"}", "\"a\"");
+    TEST_SCHEMA_OK(blob, "{\"blob\":\"\\/w==\"}");
+    TEST_SCHEMA_ERROR("/blob", "contentEncoding", 8, blob, "{\"blob\":\"abc\"}");
+    TEST_SCHEMA_ERROR("/blob", "contentEncoding", 8, blob, "{\"blob\":\"YQ=\"}");
+    /* length and enum see the text */
+    TEST_SCHEMA_OK("{\"contentEncoding\":\"base64\",\"maxLength\":4}", "\"AAE=\"");
+    TEST_SCHEMA_FAIL("{\"contentEncoding\":\"base64\",\"maxLength\":4}",
+        "\"AAECAw==\"");
+    TEST_SCHEMA_OK("{\"contentEncoding\":\"base64\",\"enum\":[\"AAE=\"]}",
+        "\"AAE=\"");
+
+    EXPECT_EQ_INT(xState::X_PARSE_OK, xParse(&s, blob));
+    EXPECT_EQ_INT(xSchemaState::X_SCHEMA_OK, schema.compile(&s));
+    EXPECT_EQ_INT(xState::X_PARSE_OK, xParseWithSchema(&v,
+        "{\"blob\":\"aGVsbG8gd29ybGQ=\",\"text\":\"aGk=\"}", schema));
+    b = xHelper::xFindObjectValue(&v, "blob", 4);
+    EXPECT_TRUE(b->flags & X_VALUE_FLAG_BINARY);
+    bytes = xHelper::xGetBinary(b, &len);
+    EXPECT_TRUE(len == 11 && memcmp(bytes, "hello world", 11) == 0);
+    EXPECT_FALSE(xHelper::xFindObjectValue(&v, "text", 4)->flags
+        & X_VALUE_FLAG_BINARY);
+    json = xStringify(&v, &len);
+    EXPECT_EQ_STRING("{\"blob\":\"aGVsbG8gd29ybGQ=\",\"text\":\"aGk=\"}",
+        json, len);
+    free(json);
+}
+
+int main() {
+    test_schema_compile();
+    test_schema_type();
+    test_schema_early();
+    test_schema_object();
+    test_schema_required_many();
+    test_schema_number();
+    test_schema_string();
+    test_schema_array();
+    test_schema_enum();
+    test_schema_content_encoding();
+    TEST_SUMMARY();
+    return main_ret;
+}
@@ -0,0 +1,307 @@
+/*copyright 2021 xkxsxkx*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "xjson.h"
+#include "xjson_shared.h"
+#include "xtest.h"
+
+using namespace xJson;
+
+#define SHARED_DOC "{\"a\":[1,{\"b\":\"x\"}],\"c\":{\"d\":[true,null]},\"e\":\"s\"}"
+
+#define EXPECT_EQ_JSON(expect, v)\
+    do {\
+        size_t length;\
+        char* out = xStringify(v, &length);\
+        EXPECT_EQ_STRING(expect, out, length);\
+        free(out);\
+    } while (0)
+
+#define TEST_SHARED_SET(expect, pointer, json)\
+    do {\
+        xValue s, n;\
+        xHelper hs(&s), hn(&n);\
+        EXPECT_EQ_INT(xState::X_PARSE_OK, xParse(&s, SHARED_DOC));\
+        EXPECT_EQ_INT(xState::X_PARSE_OK, xParse(&n, json));\
+        xSharedDocument doc(&s), next;\
+        EXPECT_EQ_INT(xPatchState::X_PATCH_OK,\
+            doc.set(&next, pointer, strlen(pointer), &n));\
+        EXPECT_EQ_JSON(expect, next.value());\
+        EXPECT_EQ_JSON(SHARED_DOC, doc.value());\
+    } while (0)
+
+#define TEST_SHARED_REMOVE(expect, pointer)\
+    do {\
+        xValue s;\
+        xHelper hs(&s);\
+        EXPECT_EQ_INT(xState::X_PARSE_OK, xParse(&s, SHARED_DOC));\
+        xSharedDocument doc(&s), next;\
+        EXPECT_EQ_INT(xPatchState::X_PATCH_OK,\
+            doc.remove(&next, pointer, strlen(pointer)));\
+        EXPECT_EQ_JSON(expect, next.value());\
+        EXPECT_EQ_JSON(SHARED_DOC, doc.value());\
+    } while (0)
+
+#define TEST_SHARED_ERROR(error, pointer)\
+    do {\
+        xValue s, n;\
+        xHelper hs(&s), hn(&n);\
+        EXPECT_EQ_INT(xState::X_PARSE_OK, xParse(&s, SHARED_DOC));\
+        xSharedDocument doc(&s), next;\
+        EXPECT_EQ_INT(error, doc.set(&next, pointer, strlen(pointer), &n));\
+        EXPECT_TRUE(next.value()->type == xType::X_TYPE_NULL);\
+    } while (0)
+
+static void test_shared_freeze() {
+    xSharedDocument empty;
+    EXPECT_EQ_INT(xType::X_TYPE_NULL, xHelper::xGetType(empty.value()));
+
+    xSharedDocument doc;
+    {
+        xValue v;
+        xHelper h(&v);
+        EXPECT_EQ_INT(xState::X_PARSE_OK, xParse(&v, SHARED_DOC));
+        doc = xSharedDocument(&v);
+    }
+    /* the source is gone, copies share the same tree */
+    xSharedDocument copy(doc);
+    EXPECT_TRUE(copy == doc);
+    EXPECT_TRUE(copy.value() == doc.value());
+    EXPECT_EQ_JSON(SHARED_DOC, copy.value());
+
+    /* escapes are decoded once, reads never write to the tree */
+    char json[] = "[\"a\\u0041\", 12.50]";
+    xValue v;
+    xHelper h(&v);
+    EXPECT_EQ_INT(xState::X_PARSE_OK, xParseInsitu<xLazyPolicy>(&v, json));
+    xSharedDocument lazy(&v);
+    xHelper::xSetNull(&v);
+    memset(json, 'x', sizeof(json) - 1);
+    EXPECT_FALSE(lazy.value()->array.e[0].flags & X_VALUE_FLAG_ESCAPED);
+    EXPECT_EQ_JSON("[\"aA\",12.50]", lazy.value());
+}
+
+/* base64 in a frozen tree is decoded into the reader's buffer */
+static void test_shared_binary() {
+    xValue v;
+    xHelper h(&v);
+    uint8_t out[3];
+    size_t len;
+    EXPECT_EQ_INT(xState::X_PARSE_OK, xParse(&v, "{\"img\":\"AAAA\",\"raw\":1}"));
+    xHelper::xSetBinary(xHelper::xFindObjectValue(&v, "raw", 3), "\x01\x02", 2);
+    xSharedDocument doc(&v);
+    const xValue* img = &doc.value()->object.m[0].v;
+    EXPECT_TRUE(xHelper::xGetBinary(img, &len) == nullptr);
+    EXPECT_TRUE(xHelper::xGetBinary(img, out, &len));
+    EXPECT_TRUE(len == 3 && out[0] == 0 && out[1] == 0 && out[2] == 0);
+    EXPECT_FALSE(img->flags & X_VALUE_FLAG_BINARY);
+    const uint8_t* raw = xHelper::xGetBinary(&doc.value()->object.m[1].v, &len);
+    EXPECT_TRUE(raw != nullptr && len == 2 && raw[0] == 1 && raw[1] == 2);
+    EXPECT_EQ_JSON("{\"img\":\"AAAA\",\"raw\":\"AQI=\"}", doc.value());
+}
+
+static void test_shared_set() {
+    TEST_SHARED_SET("{\"a\":[1,{\"b\":\"y\"}],\"c\":{\"d\":[true,null]},\"e\":\"s\"}",
+        "/a/1/b", "\"y\"");
+    TEST_SHARED_SET("{\"a\":[1,{\"b\":\"x\",\"z\":0}],\"c\":{\"d\":[true,null]},\"e\":\"s\"}",
+        "/a/1/z", "0");
+    TEST_SHARED_SET("{\"a\":[1,{\"b\":\"x\"}],\"c\":{\"d\":[true,null,[]]},\"e\":\"s\"}",
+        "/c/d/-", "[]");
+    TEST_SHARED_SET("{\"a\":[1,{\"b\":\"x\"}],\"c\":{\"d\":[false,null]},\"e\":\"s\"}",
+        "/c/d/0", "false");
+    TEST_SHARED_SET("[0]", "", "[0]");
+    TEST_SHARED_ERROR(xPatchState::X_PATCH_INVALID_POINTER, "a");
+    TEST_SHARED_ERROR(xPatchState::X_PATCH_INVALID_POINTER, "/a~2");
+    TEST_SHARED_ERROR(xPatchState::X_PATCH_PATH_NOT_FOUND, "/x/y");
+    TEST_SHARED_ERROR(xPatchState::X_PATCH_PATH_NOT_FOUND, "/a/2");
+    TEST_SHARED_ERROR(xPatchState::X_PATCH_PATH_NOT_FOUND, "/a/-/b");
+    TEST_SHARED_ERROR(xPatchState::X_PATCH_PATH_NOT_FOUND, "/e/0");
+}
+
+static void test_shared_remove() {
+    TEST_SHARED_REMOVE("{\"a\":[1,{\"b\":\"x\"}],\"e\":\"s\"}", "/c");
+    TEST_SHARED_REMOVE("{\"a\":[{\"b\":\"x\"}],\"c\":{\"d\":[true,null]},\"e\":\"s\"}",
+        "/a/0");
+    TEST_SHARED_REMOVE("{\"a\":[1,{}],\"c\":{\"d\":[true,null]},\"e\":\"s\"}",
+        "/a/1/b");
+
+    xValue s;
+    xHelper hs(&s);
+    EXPECT_EQ_INT(xState::X_PARSE_OK, xParse(&s, SHARED_DOC));
+    xSharedDocument doc(&s), next;
+    EXPECT_EQ_INT(xPatchState::X_PATCH_INVALID_POINTER, doc.remove(&next, "", 0));
+    EXPECT_EQ_INT(xPatchState::X_PATCH_PATH_NOT_FOUND,
+        doc.remove(&next, "/a/-", 4));
+    EXPECT_EQ_INT(xPatchState::X_PATCH_PATH_NOT_FOUND,
+        doc.remove(&next, "/x", 2));
+}
+
+static void test_shared_path_copy() {
+    xValue s, n;
+    xHelper hs(&s), hn(&n);
+    EXPECT_EQ_INT(xState::X_PARSE_OK, xParse(&s, SHARED_DOC));
+    xHelper::xSetNumber(&n, 2);
+    xSharedDocument doc(&s), next;
+    EXPECT_EQ_INT(xPatchState::X_PATCH_OK, doc.set(&next, "/a/0", 4, &n));
+    const xValue* before = doc.value();
+    const xValue* after = next.value();
+    /* the path is copied ... */
+    EXPECT_TRUE(before->object.m != after->object.m);
+    EXPECT_TRUE(before->object.m[0].v.array.e != after->object.m[0].v.array.e);
+    /* ... every other array is shared */
+    EXPECT_TRUE(before->object.m[1].v.object.m == after->object.m[1].v.object.m);
+    EXPECT_TRUE(before->object.m[0].v.array.e[1].object.m
+        == after->object.m[0].v.array.e[1].object.m);
+    /* ... and so are the keys and texts of the copied arrays */
+    EXPECT_TRUE(before->object.m[2].k == after->object.m[2].k);
+    EXPECT_TRUE(before->object.m[2].v.str.s == after->object.m[2].v.str.s);
+
+    /* the shared arrays outlive the version they were built for */
+    doc = xSharedDocument();
+    EXPECT_EQ_JSON("{\"a\":[2,{\"b\":\"x\"}],\"c\":{\"d\":[true,null]},\"e\":\"s\"}",
+        next.value());
+    EXPECT_EQ_INT(xPatchState::X_PATCH_OK, next.set(&next, "/c/d/1", 6, &n));
+    EXPECT_EQ_JSON("{\"a\":[2,{\"b\":\"x\"}],\"c\":{\"d\":[true,2]},\"e\":\"s\"}",
+        next.value());
+}
+
+static void test_shared_allocator() {
+    xAllocStats stats = {};
+    {
+        xAllocatorScope scope(nullptr, &stats);
+        xValue s, n, expect;
+        xHelper hs(&s), hn(&n), he(&expect);
+        EXPECT_EQ_INT(xState::X_PARSE_OK, xParse(&s, SHARED_DOC));
+        EXPECT_EQ_INT(xState::X_PARSE_OK, xParse(&n, "{\"k\":\"v\"}"));
+        EXPECT_EQ_INT(xState::X_PARSE_OK,
+            xParse(&expect, "{\"c\":{\"d\":[{\"k\":\"v\"},null]},\"e\":\"s\"}"));
+        xSharedDocument doc(&s), a, b;
+        EXPECT_EQ_INT(xPatchState::X_PATCH_OK, doc.set(&a, "/c/d/0", 6, &n));
+        EXPECT_EQ_INT(xPatchState::X_PATCH_OK, a.remove(&b, "/a", 2));
+        doc = a = xSharedDocument();
+        EXPECT_TRUE(xEqual(&expect, b.value()));
+    }
+    EXPECT_TRUE(stats.live == 0);
+}
+
+static void test_shared_threads() {
+    /* a and b are always published together, readers must never see them differ */
+    xValue s, n;
+    xHelper hs(&s), hn(&n);
+    EXPECT_EQ_INT(xState::X_PARSE_OK, xParse(&s, "{\"a\":0,\"b\":0,\"big\":[[1],[2],[3]]}"));
+    xSharedDocument first(&s);
+    xSharedSlot slot(first);
+    std::atomic<bool> done(false);
+    std::atomic<int> torn(0);
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 4; t++) {
+        readers.emplace_back([&] {
+            while (!done.load()) {
+                xSharedDocument doc = slot.load();
+                const xValue* v = doc.value();
+                if (xHelper::xGetNumber(xHelper::xFindObjectValue(v, "a", 1))
+                    != xHelper::xGetNumber(xHelper::xFindObjectValue(v, "b", 1)))
+                    torn++;
+            }
+        });
+    }
+    for (int i = 1; i <= 500; i++) {
+        xSharedDocument cur = slot.load(), mid, next;
+        xHelper::xSetNumber(&n, i);
+        cur.set(&mid, "/a", 2, &n);
+        mid.set(&next, "/b", 2, &n);
+        EXPECT_TRUE(slot.compareExchange(cur, next));
+    }
+    done = true;
+    for (std::thread& t : readers)
+        t.join();
+    EXPECT_EQ_INT(0, torn.load());
+    EXPECT_EQ_JSON("{\"a\":500,\"b\":500,\"big\":[[1],[2],[3]]}", slot.load().value());
+    EXPECT_FALSE(slot.compareExchange(xSharedDocument(), xSharedDocument()));
+}
+
+static std::atomic<ptrdiff_t> contended_live(0);
+
+static void* contended_alloc(void* ctx, size_t size) {
+    (void)ctx;
+    contended_live += size;
+    return malloc(size);
+}
+
+static void* contended_realloc(void* ctx, void* p, size_t oldSize,
+    size_t newSize) {
+    (void)ctx;
+    contended_live += (ptrdiff_t)newSize - (ptrdiff_t)oldSize;
+    return realloc(p, newSize);
+}
+
+static void contended_free(void* ctx, void* p, size_t size) {
+    (void)ctx;
+    contended_live -= size;
+    free(p);
+}
+
+static void test_shared_contention() {
+    /* readers race two publishers, every retired version must be freed once */
+    const xAllocator counting = { contended_alloc, contended_realloc,
+        contended_free, nullptr };
+    xValue s, n;
+    xHelper hs(&s), hn(&n);
+    EXPECT_EQ_INT(xState::X_PARSE_OK, xParse(&s, "{\"v\":0,\"t\":\"text\"}"));
+    {
+        xSharedSlot slot(xSharedDocument(&s, &counting));
+        std::atomic<bool> done(false);
+        std::atomic<int> bad(0);
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; t++) {
+            threads.emplace_back([&] {
+                while (!done.load()) {
+                    xSharedDocument doc = slot.load();
+                    const xValue* text = xHelper::xFindObjectValue(doc.value(), "t", 1);
+                    if (text == nullptr || strcmp(xHelper::xGetString(text), "text") != 0)
+                        bad++;
+                }
+            });
+        }
+        for (int p = 0; p < 2; p++) {
+            threads.emplace_back([&, p] {
+                xValue v;
+                xHelper hv(&v);
+                for (int i = 1; i <= 300; i++) {
+                    xSharedDocument next;
+                    xHelper::xSetNumber(&v, i);
+                    slot.load().set(&next, "/v", 2, &v);
+                    if (p == 0)
+                        slot.store(next);
+                    else
+                        slot.compareExchange(slot.load(), next);
+                }
+            });
+        }
+        threads[4].join();
+        threads[5].join();
+        done = true;
+        for (int t = 0; t < 4; t++)
+            threads[t].join();
+        EXPECT_EQ_INT(0, bad.load());
+        EXPECT_TRUE(contended_live.load() > 0);
+    }
+    EXPECT_TRUE(contended_live.load() == 0);
+}
+
+int main() {
+    test_shared_freeze();
+    test_shared_binary();
+    test_shared_set();
+    test_shared_remove();
+    test_shared_path_copy();
+    test_shared_allocator();
+    test_shared_threads();
+    test_shared_contention();
+    TEST_SUMMARY();
+    return main_ret;
+}
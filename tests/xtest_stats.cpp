@@ -0,0 +1,87 @@
+/*copyright 2021 xkxsxkx*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "xjson.h"
+#include "xtest.h"
+
+using namespace xJson;
+
+#define TYPE(t) ((int)xType::t)
+
+struct xTestTrace {
+    int parses = 0;
+    int stringifies = 0;
+};
+
+static void test_trace_phase(void* ctx, const char* name, const xStats*,
+    uint64_t) {
+    xTestTrace* trace = (xTestTrace*)ctx;
+    if (strcmp(name, "parse") == 0)
+        trace->parses++;
+    else if (strcmp(name, "stringify") == 0)
+        trace->stringifies++;
+}
+
+static void test_stats_parse() {
+    xValue v;
+    xHelper h(&v);
+    xStats stats = {};
+    {
+        xStatsScope scope(&stats);
+        EXPECT_EQ_INT(xState::X_PARSE_OK, xParse(&v,
+            "{\"a\":[1,2.5,\"x\\ny\"],\"b\\\\\":{\"c\":[true,false,null]}}"));
+    }
+    EXPECT_EQ_SIZE_T(1, stats.parses);
+    EXPECT_EQ_SIZE_T(2, stats.values[TYPE(X_TYPE_NUMBER)]);
+    EXPECT_EQ_SIZE_T(1, stats.values[TYPE(X_TYPE_STRING)]);
+    EXPECT_EQ_SIZE_T(2, stats.values[TYPE(X_TYPE_ARRAY)]);
+    EXPECT_EQ_SIZE_T(2, stats.values[TYPE(X_TYPE_OBJECT)]);
+    EXPECT_EQ_SIZE_T(1, stats.values[TYPE(X_TYPE_TRUE)]);
+    EXPECT_EQ_SIZE_T(1, stats.values[TYPE(X_TYPE_FALSE)]);
+    EXPECT_EQ_SIZE_T(1, stats.values[TYPE(X_TYPE_NULL)]);
+    /* a b\ c x\ny */
+    EXPECT_EQ_SIZE_T(1 + 2 + 1 + 3, stats.stringBytes);
+    EXPECT_EQ_SIZE_T(2, stats.escapes);
+    EXPECT_EQ_SIZE_T(3, stats.maxDepth);
+    EXPECT_TRUE(stats.stackPeak >= 3 * sizeof(xValue));
+    EXPECT_TRUE(stats.parseNs == 0);
+
+    /* outside a scope nothing is counted */
+    xHelper::xSetNull(&v);
+    EXPECT_EQ_INT(xState::X_PARSE_OK, xParse(&v, "[1]"));
+    EXPECT_EQ_SIZE_T(1, stats.parses);
+}
+
+static void test_stats_stringify() {
+    xValue v;
+    xHelper h(&v);
+    xStats stats = {};
+    xTestTrace trace;
+    xTracer tracer = { test_trace_phase, &trace };
+    size_t length;
+    EXPECT_EQ_INT(xState::X_PARSE_OK, xParse(&v, "[\"a\\tb\",{\"k\":1}]"));
+    {
+        xStatsScope scope(&stats, false, &tracer);
+        char* out = xStringify(&v, &length);
+        free(out);
+        xHelper::xSetNull(&v);
+        EXPECT_EQ_INT(xState::X_PARSE_OK, xParse(&v, "[]"));
+    }
+    EXPECT_EQ_SIZE_T(1, stats.stringifies);
+    EXPECT_EQ_SIZE_T(length, stats.outputBytes);
+    EXPECT_EQ_SIZE_T(1, stats.values[TYPE(X_TYPE_STRING)]);
+    EXPECT_EQ_SIZE_T(3 + 1, stats.stringBytes);
+    EXPECT_EQ_SIZE_T(1, stats.escapes);
+    EXPECT_EQ_INT(1, trace.parses);
+    EXPECT_EQ_INT(1, trace.stringifies);
+}
+
+int main() {
+#if X_JSON_STATS
+    test_stats_parse();
+    test_stats_stringify();
+#endif
+    TEST_SUMMARY();
+    return main_ret;
+}
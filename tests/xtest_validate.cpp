@@ -0,0 +1,159 @@
+/*copyright 2021 xkxsxkx*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include "xjson.h"
+#include "xtest.h"
+
+using namespace xJson;
+
+/* xValidate must agree with xParse on every input */
+#define TEST_VALIDATE(json)\
+    do {\
+        xValue v;\
+        xHelper h(&v);\
+        EXPECT_EQ_INT(xParse(&v, json), xValidate(json, strlen(json)));\
+    } while (0)
+
+#define TEST_VALIDATE_OFFSET(error, offset, json)\
+    do {\
+        size_t at = 0;\
+        EXPECT_EQ_INT(error, xValidate(json, sizeof(json) - 1, &at));\
+        EXPECT_EQ_SIZE_T(offset, at);\
+    } while (0)
+
+static void test_validate_agrees() {
+    static const char* cases[] = {
+        "null", "true", "false", " \t\r\n[ ] ", "{ }", "0", "-0.0", "1e10",
+        "-1.5E-3", "123456789012345678901234567890", "1e-400", "0e99999",
+        "1.7976931348623157e308", "1.7976931348623159e308", "17976931348623159e292",
+        "0.00017976931348623159e312", "-1e309", "1e309", "1E+400",
+        "\"\"", "\"a\\\"\\\\\\/\\b\\f\\n\\r\\t\"", "\"\\u00e9\\uD834\\uDD1E\"",
+        "[1,\"a\",{\"b\":[null,{}]}]", "{\"a\":{\"b\":{\"c\":[]}},\"d\":0}",
+        "", " ", "nul", "tru", "?", "+1", ".1", "01", "1.", "1e", "-", "INF",
+        "[1,]", "[1 2]", "[1", "[", "{", "{\"a\"}", "{\"a\":}", "{\"a\":1,}",
+        "{1:1}", "{\"a\":1 \"b\":2}", "{\"a\":1", "\"abc", "\"\\v\"", "\"\\",
+        "\"\\u12\"", "\"\\u123g\"", "\"\\uD800\"", "\"\\uD800\\u0041\"",
+        "\"\\uD800\\uE000\"", "\"\\uD800x\"", "\"\\uDC00\"", "\"\x01\"",
+        "null x", "[]]", "1 2", "\"a\"\"b\"", "[\"\\uD834\\uDD1E\", 1e5]",
+        "{\"\\u0000\":\"\\\"\"}", "[[[[[[[[[[]]]]]]]]]]", "[[[[[[[[[[]]]]]]]]]",
+        "\"0123456789abcdef0123456789abcdef\\n0123456789abcdef\x1f\"",
+    };
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+        TEST_VALIDATE(cases[i]);
+}
+
+static void test_validate_offset() {
+    TEST_VALIDATE_OFFSET(xState::X_PARSE_OK, 7, "[1, 2] ");
+    TEST_VALIDATE_OFFSET(xState::X_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, 3, "[1 2]");
+    TEST_VALIDATE_OFFSET(xState::X_PARSE_INVALID_STRING_ESCAPE, 3,
+        "[\"a\\x\"]");
+    TEST_VALIDATE_OFFSET(xState::X_PARSE_MISS_COLON, 5, "{\"a\" 1}");
+    TEST_VALIDATE_OFFSET(xState::X_PARSE_INVALID_VALUE, 5, "{\"a\":-x}");
+    TEST_VALIDATE_OFFSET(xState::X_PARSE_NUMBER_TOO_BIG, 1, "[1e999]");
+    TEST_VALIDATE_OFFSET(xState::X_PARSE_ROOT_NOT_SINGULAR, 5, "true false");
+    /* an embedded nul is not the end of the text */
+    TEST_VALIDATE_OFFSET(xState::X_PARSE_INVALID_STRING_CHAR, 2, "\"a\0\"");
+    TEST_VALIDATE_OFFSET(xState::X_PARSE_ROOT_NOT_SINGULAR, 1, "1\0");
+}
+
+static void test_validate_bounded() {
+    /* only len bytes are read, the buffer is not terminated */
+    char* json = (char*)malloc(12);
+    memcpy(json, "[\"abcdefgh\"]", 12);
+    EXPECT_EQ_INT(xState::X_PARSE_OK, xValidate(json, 12));
+    EXPECT_EQ_INT(xState::X_PARSE_MISS_QUOTATION_MARK, xValidate(json, 10));
+    EXPECT_EQ_INT(xState::X_PARSE_MISS_COMMA_OR_SQUARE_BRACKET,
+        xValidate(json, 11));
+    free(json);
+
+    size_t n = 100000;
+    char* deep = (char*)malloc(2 * n);
+    memset(deep, '[', n);
+    memset(deep + n, ']', n);
+    EXPECT_EQ_INT(xState::X_PARSE_DEPTH_EXCEEDED, xValidate(deep, 2 * n));
+    EXPECT_EQ_INT(xState::X_PARSE_OK, xValidate(deep + n - 1000, 2000));
+    free(deep);
+}
+
+#define TEST_SKIP(error, expectEnd, expectCount, json)\
+    do {\
+        size_t at = 0, n = 99;\
+        EXPECT_EQ_INT(error, xSkip(json, sizeof(json) - 1, &at, &n));\
+        EXPECT_EQ_SIZE_T(expectEnd, at);\
+        EXPECT_EQ_SIZE_T(expectCount, n);\
+    } while (0)
+
+static void test_skip() {
+    TEST_SKIP(xState::X_PARSE_OK, 2, 0, "[] ,");
+    TEST_SKIP(xState::X_PARSE_OK, 5, 0, "  { }");
+    TEST_SKIP(xState::X_PARSE_OK, 3, 1, "[1]");
+    TEST_SKIP(xState::X_PARSE_OK, 31, 4,
+        "[1, [2,3], {\"a,b\":[4]}, \"]\\\"[\"] tail");
+    TEST_SKIP(xState::X_PARSE_OK, 19, 2, "{\"a\":1,\"b\":{\"c\":2}},x");
+    TEST_SKIP(xState::X_PARSE_OK, 6, 0, "\"a\\\"b\" rest");
+    TEST_SKIP(xState::X_PARSE_OK, 3, 0, "123,");
+    TEST_SKIP(xState::X_PARSE_OK, 4, 0, "true]");
+    TEST_SKIP(xState::X_PARSE_EXPECT_VALUE, 1, 0, " ");
+    TEST_SKIP(xState::X_PARSE_INVALID_VALUE, 0, 0, "]");
+    TEST_SKIP(xState::X_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, 4, 0, "[1,2");
+    TEST_SKIP(xState::X_PARSE_MISS_COMMA_OR_CURLY_BRACKET, 7, 0, "{\"a\":[]");
+    TEST_SKIP(xState::X_PARSE_MISS_QUOTATION_MARK, 3, 0, "{\"a");
+    TEST_SKIP(xState::X_PARSE_MISS_QUOTATION_MARK, 5, 0, "\"abc\\");
+}
+
+static void test_skip_large() {
+    /* strings with brackets, commas and escapes across 16 byte blocks */
+    std::string json = "{\"page\":[";
+    size_t i, start, at, n;
+    for (i = 0; i < 1000; i++) {
+        if (i > 0)
+            json += i % 3 == 0 ? ", " : ",";
+        json += i % 2 == 0 ? "{\"id\":" + std::to_string(i) + ",\"t\":\"]}\\\"[,\"}"
+            : "[\"" + std::string(i % 40, 'x') + "\\\\\\\",{]\"]";
+    }
+    json += "],\"next\":null}";
+    EXPECT_EQ_INT(xState::X_PARSE_OK, xValidate(json.data(), json.size()));
+    start = json.find('[');
+    EXPECT_EQ_INT(xState::X_PARSE_OK,
+        xSkip(json.data() + start, json.size() - start, &at, &n));
+    EXPECT_EQ_SIZE_T(1000, n);
+    EXPECT_EQ_SIZE_T(json.size() - 13 - start, at);
+
+    /* the slice is a document of its own */
+    xValue v;
+    xHelper h(&v);
+    std::string slice = json.substr(start, at);
+    EXPECT_EQ_INT(xState::X_PARSE_OK, xParse(&v, slice.c_str()));
+    EXPECT_EQ_SIZE_T(1000, xHelper::xGetArraySize(&v));
+    EXPECT_EQ_INT(xState::X_PARSE_OK, xSkip(json.data(), json.size(), &at, &n));
+    EXPECT_EQ_SIZE_T(json.size(), at);
+    EXPECT_EQ_SIZE_T(2, n);
+
+    /* only len bytes are read */
+    char* text = (char*)malloc(json.size());
+    memcpy(text, json.data(), json.size());
+    EXPECT_EQ_INT(xState::X_PARSE_MISS_COMMA_OR_CURLY_BRACKET,
+        xSkip(text, json.size() - 1, &at));
+    EXPECT_EQ_SIZE_T(json.size() - 1, at);
+    free(text);
+
+    /* no stack, so no depth limit */
+    size_t depth = 100000;
+    std::string deep(depth, '[');
+    deep.append(depth, ']');
+    EXPECT_EQ_INT(xState::X_PARSE_OK, xSkip(deep.data(), deep.size(), &at, &n));
+    EXPECT_EQ_SIZE_T(deep.size(), at);
+    EXPECT_EQ_SIZE_T(1, n);
+}
+
+int main() {
+    test_validate_agrees();
+    test_validate_offset();
+    test_validate_bounded();
+    test_skip();
+    test_skip_large();
+    TEST_SUMMARY();
+    return main_ret;
+}